@@ -0,0 +1,228 @@
+#include "AllocatorBench.h"
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <string>
+#include <random>
+#include <chrono>
+#include "TlsfAllocator.h"
+#include "RingAllocator.h"
+
+namespace {
+    struct LiveRange {
+        uint32_t handle;
+        VkDeviceSize offset;
+        VkDeviceSize size;
+    };
+
+    bool fail(const char *test, const std::string &message) {
+        std::cout << test << ": FAILED - " << message << std::endl;
+        return false;
+    }
+
+    // Sizes spread over 16 B .. 4 MiB like a mix of uniform buffers, meshes and textures
+    VkDeviceSize randomSize(std::mt19937_64 &random) {
+        VkDeviceSize base = 16ull << (random() % 19);
+        return base + random() % base;
+    }
+
+    bool overlaps(const std::map<VkDeviceSize, VkDeviceSize> &ranges, VkDeviceSize offset, VkDeviceSize size) {
+        auto next = ranges.lower_bound(offset);
+        if (next != ranges.end() && next->first < offset + size) {
+            return true;
+        }
+        if (next != ranges.begin()) {
+            auto prev = std::prev(next);
+            if (prev->first + prev->second > offset) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool checkTlsf() {
+        const char *test = "TLSF random allocate/free";
+        const VkDeviceSize capacity = 256ull * 1024 * 1024;
+
+        TlsfAllocator tlsf;
+        tlsf.init(capacity);
+        std::mt19937_64 random(1234);
+
+        std::vector<LiveRange> live;
+        std::map<VkDeviceSize, VkDeviceSize> ranges;
+        VkDeviceSize liveBytes = 0;
+        uint32_t outOfSpace = 0;
+
+        for (uint32_t op = 0; op < 200000; ++op) {
+            if (live.empty() || random() % 100 < 55) {
+                VkDeviceSize size = randomSize(random);
+                VkDeviceSize alignment = 1ull << (random() % 17); // up to 64 KiB like bufferImageGranularity
+
+                VkDeviceSize offset;
+                uint32_t handle = tlsf.allocate(size, alignment, offset);
+                if (handle == TlsfAllocator::invalidHandle) {
+                    ++outOfSpace;
+                    continue;
+                }
+                if (offset % alignment != 0) {
+                    return fail(test, "misaligned offset");
+                }
+                if (offset + size > capacity) {
+                    return fail(test, "range outside of the block");
+                }
+                if (overlaps(ranges, offset, size)) {
+                    return fail(test, "overlapping ranges");
+                }
+                ranges[offset] = size;
+                live.push_back(LiveRange{ handle, offset, size });
+                liveBytes += size;
+            } else {
+                size_t index = random() % live.size();
+                tlsf.free(live[index].handle);
+                ranges.erase(live[index].offset);
+                liveBytes -= live[index].size;
+                live[index] = live.back();
+                live.pop_back();
+            }
+
+            if (tlsf.getUsed() != liveBytes || tlsf.getAllocationCount() != live.size()) {
+                return fail(test, "used bytes or allocation count out of sync");
+            }
+        }
+
+        VkDeviceSize freeBytes = capacity - tlsf.getUsed();
+        double fragmentation = freeBytes > 0 ? 1.0 - (double)tlsf.largestFreeRange() / freeBytes : 0.0;
+
+        for (const LiveRange &range : live) {
+            tlsf.free(range.handle);
+        }
+        if (!tlsf.isEmpty() || tlsf.getUsed() != 0 || tlsf.largestFreeRange() != capacity) {
+            return fail(test, "free ranges were not merged back into one");
+        }
+
+        std::cout << test << ": passed | " << outOfSpace << " allocations out of space | fragmentation after churn " <<
+            fragmentation * 100.0 << " %" << std::endl;
+        return true;
+    }
+
+    bool checkRing() {
+        const char *test = "Ring frames in flight";
+        const VkDeviceSize capacity = 1024 * 1024;
+        const uint32_t framesInFlight = 3;
+        const VkDeviceSize alignment = 256;
+
+        RingAllocator ring;
+        ring.init(capacity);
+        std::mt19937_64 random(5678);
+
+        // Ranges of the frames still in flight, by frame slot
+        std::vector<std::vector<std::pair<VkDeviceSize, VkDeviceSize>>> frameRanges(framesInFlight);
+        std::vector<VkDeviceSize> frameEnds(framesInFlight, 0);
+        uint32_t previousSlot = UINT32_MAX;
+        uint64_t allocations = 0;
+        uint64_t wraps = 0;
+
+        for (uint32_t frame = 0; frame < 10000; ++frame) {
+            uint32_t slot = frame % framesInFlight;
+            if (previousSlot != UINT32_MAX) {
+                frameEnds[previousSlot] = ring.getHead();
+            }
+            ring.release(frameEnds[slot]);
+            frameRanges[slot].clear();
+            previousSlot = slot;
+
+            VkDeviceSize lastOffset = 0;
+            for (uint32_t i = 0; i < 16; ++i) {
+                VkDeviceSize size = 1 + random() % (64 * 1024);
+                VkDeviceSize offset;
+                if (!ring.allocate(size, alignment, offset)) {
+                    break; // full for this frame
+                }
+                if (offset % alignment != 0 || offset + size > capacity) {
+                    return fail(test, "misaligned or out of bounds");
+                }
+                for (const auto &ranges : frameRanges) {
+                    for (const auto &range : ranges) {
+                        if (offset < range.first + range.second && range.first < offset + size) {
+                            return fail(test, "overwrote data of a frame in flight");
+                        }
+                    }
+                }
+                if (offset < lastOffset) {
+                    ++wraps;
+                }
+                lastOffset = offset;
+                frameRanges[slot].push_back(std::make_pair(offset, size));
+                ++allocations;
+            }
+        }
+
+        std::cout << test << ": passed | " << allocations << " allocations | " << wraps << " wraps" << std::endl;
+        return true;
+    }
+
+    void benchTlsf() {
+        const VkDeviceSize capacity = 1024ull * 1024 * 1024;
+        const uint32_t liveAllocations = 4096;
+        const uint32_t iterations = 1000000;
+
+        TlsfAllocator tlsf;
+        tlsf.init(capacity);
+        std::mt19937_64 random(42);
+
+        // Random numbers are drawn up front so only the allocator is timed
+        std::vector<VkDeviceSize> sizes(iterations);
+        std::vector<uint32_t> victims(iterations);
+        for (uint32_t i = 0; i < iterations; ++i) {
+            sizes[i] = 256 + random() % (64 * 1024);
+            victims[i] = (uint32_t)(random() % liveAllocations);
+        }
+
+        std::vector<uint32_t> handles(liveAllocations);
+        VkDeviceSize offset;
+        for (uint32_t i = 0; i < liveAllocations; ++i) {
+            handles[i] = tlsf.allocate(sizes[i], 256, offset);
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (uint32_t i = 0; i < iterations; ++i) {
+            tlsf.free(handles[victims[i]]);
+            handles[victims[i]] = tlsf.allocate(sizes[i], 256, offset);
+        }
+        double nanoseconds = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+
+        std::cout << "TLSF free + allocate with " << liveAllocations << " live allocations: " << nanoseconds / iterations << " ns" << std::endl;
+    }
+
+    void benchRing() {
+        const uint32_t iterations = 10000000;
+        RingAllocator ring;
+        ring.init(64 * 1024 * 1024);
+
+        VkDeviceSize offset;
+        VkDeviceSize checksum = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (uint32_t i = 0; i < iterations; ++i) {
+            if (!ring.allocate(64 + (i & 1023), 64, offset)) {
+                ring.release(ring.getHead());
+                ring.allocate(64 + (i & 1023), 64, offset);
+            }
+            checksum += offset;
+        }
+        double nanoseconds = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+
+        std::cout << "Ring allocate: " << nanoseconds / iterations << " ns (checksum " << checksum % 1000 << ")" << std::endl;
+    }
+}
+
+bool runAllocatorBench() {
+    bool passed = checkTlsf();
+    passed = checkRing() && passed;
+
+    benchTlsf();
+    benchRing();
+
+    std::cout << (passed ? "Allocator bench passed" : "Allocator bench FAILED") << std::endl;
+    return passed;
+}
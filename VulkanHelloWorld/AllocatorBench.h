@@ -0,0 +1,5 @@
+#pragma once
+
+// CPU only checks and timings of TlsfAllocator and RingAllocator, no Vulkan device needed.
+// Returns false if an invariant was violated.
+bool runAllocatorBench();
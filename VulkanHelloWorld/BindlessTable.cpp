@@ -0,0 +1,210 @@
+#include "BindlessTable.h"
+
+#include <algorithm>
+#include <iostream>
+#include "VulkanUtils.h"
+
+namespace {
+    const uint32_t bufferBinding = 0;
+    const uint32_t imageBinding = 1;
+    const VkShaderStageFlags tableStages = VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT;
+}
+
+bool BindlessTable::checkSupport(VkInstance instance, VkPhysicalDevice physicalDevice, VkPhysicalDeviceFeatures &usedFeatures,
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT &indexingFeatures, uint32_t &bufferCapacity, uint32_t &imageCapacity) {
+    auto getFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR");
+    auto getProperties2 = (PFN_vkGetPhysicalDeviceProperties2KHR)vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceProperties2KHR");
+    if (getFeatures2 == nullptr || getProperties2 == nullptr) {
+        return false;
+    }
+
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT supportedIndexing = {};
+    supportedIndexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+    VkPhysicalDeviceFeatures2KHR supported = {};
+    supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+    supported.pNext = &supportedIndexing;
+    getFeatures2(physicalDevice, &supported);
+
+    // The slots come from push constants and are dynamically uniform, so dynamic indexing is enough
+    if (!supported.features.shaderStorageBufferArrayDynamicIndexing || !supported.features.shaderSampledImageArrayDynamicIndexing ||
+        !supportedIndexing.runtimeDescriptorArray || !supportedIndexing.descriptorBindingPartiallyBound ||
+        !supportedIndexing.descriptorBindingUpdateUnusedWhilePending || !supportedIndexing.descriptorBindingStorageBufferUpdateAfterBind ||
+        !supportedIndexing.descriptorBindingSampledImageUpdateAfterBind) {
+        return false;
+    }
+
+    VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties = {};
+    indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+    VkPhysicalDeviceProperties2KHR properties = {};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+    properties.pNext = &indexingProperties;
+    getProperties2(physicalDevice, &properties);
+
+    // Every stage sees both bindings, a combined image sampler counts as sampled image and as sampler
+    bufferCapacity = std::min({ bufferCapacity, indexingProperties.maxDescriptorSetUpdateAfterBindStorageBuffers,
+        indexingProperties.maxPerStageDescriptorUpdateAfterBindStorageBuffers });
+    imageCapacity = std::min({ imageCapacity, indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages,
+        indexingProperties.maxDescriptorSetUpdateAfterBindSamplers, indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+        indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers });
+    uint32_t maxResources = indexingProperties.maxPerStageUpdateAfterBindResources;
+    if ((uint64_t)bufferCapacity + imageCapacity > maxResources) {
+        bufferCapacity = std::min(bufferCapacity, maxResources / 2);
+        imageCapacity = std::min(imageCapacity, maxResources - bufferCapacity);
+    }
+    if (bufferCapacity == 0 || imageCapacity < 2) {
+        return false;
+    }
+
+    usedFeatures.shaderStorageBufferArrayDynamicIndexing = VK_TRUE;
+    usedFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+    indexingFeatures = {};
+    indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+    indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+    indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+    indexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+    indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    return true;
+}
+
+void BindlessTable::init(VkDevice device, uint32_t bufferCapacity, uint32_t imageCapacity) {
+    this->device = device;
+    bufferSlots.init(bufferCapacity);
+    imageSlots.init(imageCapacity);
+
+    VkDescriptorSetLayoutBinding bindings[2];
+    bindings[0].binding = bufferBinding;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[0].descriptorCount = bufferCapacity;
+    bindings[0].stageFlags = tableStages;
+    bindings[0].pImmutableSamplers = nullptr;
+    bindings[1].binding = imageBinding;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[1].descriptorCount = imageCapacity;
+    bindings[1].stageFlags = tableStages;
+    bindings[1].pImmutableSamplers = nullptr;
+
+    // Unwritten slots are fine as long as no shader reads them, and slots may be written while the set is bound
+    // by command buffers which do not use them
+    VkDescriptorBindingFlagsEXT bindingFlags[2];
+    bindingFlags[0] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+        VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT;
+    bindingFlags[1] = bindingFlags[0];
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsCreateInfo;
+    bindingFlagsCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+    bindingFlagsCreateInfo.pNext = nullptr;
+    bindingFlagsCreateInfo.bindingCount = 2;
+    bindingFlagsCreateInfo.pBindingFlags = bindingFlags;
+
+    VkDescriptorSetLayoutCreateInfo setLayoutCreateInfo;
+    setLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    setLayoutCreateInfo.pNext = &bindingFlagsCreateInfo;
+    setLayoutCreateInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+    setLayoutCreateInfo.bindingCount = 2;
+    setLayoutCreateInfo.pBindings = bindings;
+
+    VkResult result = vkCreateDescriptorSetLayout(device, &setLayoutCreateInfo, nullptr, &setLayout);
+    ASSERT_VULKAN(result);
+
+    VkDescriptorPoolSize poolSizes[2];
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[0].descriptorCount = bufferCapacity;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[1].descriptorCount = imageCapacity;
+
+    // The only set ever allocated from it
+    VkDescriptorPoolCreateInfo poolCreateInfo;
+    poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolCreateInfo.pNext = nullptr;
+    poolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+    poolCreateInfo.maxSets = 1;
+    poolCreateInfo.poolSizeCount = 2;
+    poolCreateInfo.pPoolSizes = poolSizes;
+
+    result = vkCreateDescriptorPool(device, &poolCreateInfo, nullptr, &descriptorPool);
+    ASSERT_VULKAN(result);
+
+    VkDescriptorSetAllocateInfo allocateInfo;
+    allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocateInfo.pNext = nullptr;
+    allocateInfo.descriptorPool = descriptorPool;
+    allocateInfo.descriptorSetCount = 1;
+    allocateInfo.pSetLayouts = &setLayout;
+
+    result = vkAllocateDescriptorSets(device, &allocateInfo, &descriptorSet);
+    ASSERT_VULKAN(result);
+}
+
+void BindlessTable::destroy() {
+    vkDestroyDescriptorPool(device, descriptorPool, nullptr); // frees the set
+    vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+    descriptorPool = VK_NULL_HANDLE;
+    setLayout = VK_NULL_HANDLE;
+    descriptorSet = VK_NULL_HANDLE;
+}
+
+uint32_t BindlessTable::addBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+    uint32_t slot = bufferSlots.allocate();
+    if (slot == SlotAllocator::invalidSlot) {
+        return slot;
+    }
+
+    VkDescriptorBufferInfo bufferInfo;
+    bufferInfo.buffer = buffer;
+    bufferInfo.offset = offset;
+    bufferInfo.range = range;
+    write(bufferBinding, slot, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, &bufferInfo, nullptr);
+    return slot;
+}
+
+uint32_t BindlessTable::addImage(VkImageView imageView, VkSampler sampler, VkImageLayout layout) {
+    uint32_t slot = imageSlots.allocate();
+    if (slot == SlotAllocator::invalidSlot) {
+        return slot;
+    }
+
+    VkDescriptorImageInfo imageInfo;
+    imageInfo.sampler = sampler;
+    imageInfo.imageView = imageView;
+    imageInfo.imageLayout = layout;
+    write(imageBinding, slot, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, nullptr, &imageInfo);
+    return slot;
+}
+
+// The stale descriptor stays in the set, partially bound allows that as long as no shader reads it
+void BindlessTable::removeBuffer(uint32_t slot) {
+    bufferSlots.free(slot);
+}
+
+void BindlessTable::removeImage(uint32_t slot) {
+    imageSlots.free(slot);
+}
+
+void BindlessTable::bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout) const {
+    vkCmdBindDescriptorSets(commandBuffer, bindPoint, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+}
+
+void BindlessTable::printStats() const {
+    std::cout << "Bindless table: " << bufferSlots.getUsed() << "/" << bufferSlots.getCapacity() << " buffers | " << imageSlots.getUsed() << "/" <<
+        imageSlots.getCapacity() << " images | " << writes << " descriptor writes" << std::endl;
+}
+
+void BindlessTable::write(uint32_t binding, uint32_t slot, VkDescriptorType type, const VkDescriptorBufferInfo *bufferInfo,
+    const VkDescriptorImageInfo *imageInfo) {
+    VkWriteDescriptorSet descriptorWrite;
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.pNext = nullptr;
+    descriptorWrite.dstSet = descriptorSet;
+    descriptorWrite.dstBinding = binding;
+    descriptorWrite.dstArrayElement = slot;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.descriptorType = type;
+    descriptorWrite.pImageInfo = imageInfo;
+    descriptorWrite.pBufferInfo = bufferInfo;
+    descriptorWrite.pTexelBufferView = nullptr;
+
+    std::lock_guard<std::mutex> lock(writeMutex);
+    vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+    ++writes;
+}
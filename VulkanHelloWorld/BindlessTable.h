@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <vulkan/vulkan.h>
+#include "SlotAllocator.h"
+
+// Per-draw data pushed before every draw, matches the push_constant block of instanced_bindless.frag
+struct DrawConstants {
+    uint32_t material; // buffer slot of the material in the bindless table
+};
+
+// Per-quad data of --textures, matches the push_constant block of textured.vert and textured.frag
+struct QuadConstants {
+    float offset[2]; // top left corner in clip space
+    float scale[2];
+    uint32_t texture; // image slot in the bindless table
+};
+
+// One large descriptor set with an array of storage buffers (binding 0) and one of combined image samplers
+// (binding 1), created with the update-after-bind and partially bound flags of VK_EXT_descriptor_indexing.
+// It is bound once per command buffer and shaders index it with the slots passed in push constants, so
+// switching materials needs no vkCmdBindDescriptorSets and no descriptor set allocations.
+class BindlessTable {
+public:
+    // Fills the features the table needs, false if the device lacks any of them, and lowers the capacities to the
+    // update-after-bind limits of the device. Needs VK_KHR_get_physical_device_properties2 enabled on the instance,
+    // the device needs VK_EXT_descriptor_indexing and VK_KHR_maintenance3.
+    static bool checkSupport(VkInstance instance, VkPhysicalDevice physicalDevice, VkPhysicalDeviceFeatures &usedFeatures,
+        VkPhysicalDeviceDescriptorIndexingFeaturesEXT &indexingFeatures, uint32_t &bufferCapacity, uint32_t &imageCapacity);
+
+    void init(VkDevice device, uint32_t bufferCapacity, uint32_t imageCapacity);
+    void destroy();
+
+    // Any thread may add and remove resources. The slots come from lock-free free lists, only the descriptor
+    // write is serialized because the set has to be externally synchronized. SlotAllocator::invalidSlot if full.
+    uint32_t addBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+    uint32_t addImage(VkImageView imageView, VkSampler sampler, VkImageLayout layout);
+    // No frame in flight may use the slot anymore, it is handed out again right away
+    void removeBuffer(uint32_t slot);
+    void removeImage(uint32_t slot);
+
+    void bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout) const;
+
+    VkDescriptorSetLayout getSetLayout() const { return setLayout; }
+    uint32_t getBufferCount() const { return bufferSlots.getUsed(); }
+    uint32_t getImageCount() const { return imageSlots.getUsed(); }
+    void printStats() const;
+
+private:
+    void write(uint32_t binding, uint32_t slot, VkDescriptorType type, const VkDescriptorBufferInfo *bufferInfo, const VkDescriptorImageInfo *imageInfo);
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+
+    SlotAllocator bufferSlots;
+    SlotAllocator imageSlots;
+    std::mutex writeMutex;
+    uint64_t writes = 0; // guarded by writeMutex
+};
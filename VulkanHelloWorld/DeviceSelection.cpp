@@ -0,0 +1,234 @@
+#include "DeviceSelection.h"
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <stdexcept>
+#include <algorithm>
+#include "VulkanUtils.h"
+
+namespace {
+    int64_t scoreDeviceType(VkPhysicalDeviceType type) {
+        switch (type) {
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return 10000;
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return 5000;
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: return 2000;
+        case VK_PHYSICAL_DEVICE_TYPE_CPU: return 500;
+        default: return 0;
+        }
+    }
+
+    std::vector<VkQueueFamilyProperties> getQueueFamilies(VkPhysicalDevice physicalDevice) {
+        uint32_t amountOfQueueFamilies = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &amountOfQueueFamilies, nullptr);
+        std::vector<VkQueueFamilyProperties> familyProperties(amountOfQueueFamilies);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &amountOfQueueFamilies, familyProperties.data());
+        return familyProperties;
+    }
+
+    QueueFamilies findQueueFamilies(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface) {
+        std::vector<VkQueueFamilyProperties> familyProperties = getQueueFamilies(physicalDevice);
+        QueueFamilies families;
+
+        for (uint32_t i = 0; i < familyProperties.size(); ++i) {
+            if (familyProperties[i].queueCount == 0) {
+                continue;
+            }
+            VkQueueFlags flags = familyProperties[i].queueFlags;
+
+            VkBool32 presentSupport = VK_FALSE;
+            if (surface != VK_NULL_HANDLE) {
+                VkResult result = vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface, &presentSupport);
+                ASSERT_VULKAN(result);
+            }
+
+            // Prefer a graphics family which can present too, so no ownership transfer is needed
+            if ((flags & VK_QUEUE_GRAPHICS_BIT) &&
+                (families.graphics == NO_QUEUE_FAMILY || (presentSupport && families.present != families.graphics))) {
+                families.graphics = i;
+                if (presentSupport) {
+                    families.present = i;
+                }
+            }
+            if (presentSupport && families.present == NO_QUEUE_FAMILY) {
+                families.present = i;
+            }
+
+            // Async compute: compute without graphics
+            if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT) && families.compute == NO_QUEUE_FAMILY) {
+                families.compute = i;
+            }
+            // Dedicated transfer (usually the DMA engine): transfer without graphics and compute
+            if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) && families.transfer == NO_QUEUE_FAMILY) {
+                families.transfer = i;
+            }
+        }
+
+        if (families.compute == NO_QUEUE_FAMILY) {
+            families.compute = families.graphics;
+        }
+        if (families.transfer == NO_QUEUE_FAMILY) {
+            families.transfer = families.compute;
+        }
+        return families;
+    }
+
+    std::string findMissingExtension(VkPhysicalDevice physicalDevice, const std::vector<const char*> &extensions) {
+        uint32_t amountOfExtensions = 0;
+        vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &amountOfExtensions, nullptr);
+        std::vector<VkExtensionProperties> available(amountOfExtensions);
+        vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &amountOfExtensions, available.data());
+
+        for (const char *extension : extensions) {
+            bool found = std::any_of(available.begin(), available.end(), [extension](const VkExtensionProperties &properties) {
+                return std::strcmp(properties.extensionName, extension) == 0;
+            });
+            if (!found) {
+                return extension;
+            }
+        }
+        return "";
+    }
+
+    // VkPhysicalDeviceFeatures only consists of VkBool32 members, so it can be compared as an array
+    bool hasFeatures(VkPhysicalDevice physicalDevice, const VkPhysicalDeviceFeatures &required) {
+        VkPhysicalDeviceFeatures supported;
+        vkGetPhysicalDeviceFeatures(physicalDevice, &supported);
+
+        const VkBool32 *requiredFlags = reinterpret_cast<const VkBool32*>(&required);
+        const VkBool32 *supportedFlags = reinterpret_cast<const VkBool32*>(&supported);
+        for (size_t i = 0; i < sizeof(VkPhysicalDeviceFeatures) / sizeof(VkBool32); ++i) {
+            if (requiredFlags[i] && !supportedFlags[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    DeviceCandidate rateDevice(VkPhysicalDevice physicalDevice, const DeviceRequirements &requirements) {
+        DeviceCandidate candidate;
+        candidate.physicalDevice = physicalDevice;
+        vkGetPhysicalDeviceProperties(physicalDevice, &candidate.properties);
+        candidate.queueFamilies = findQueueFamilies(physicalDevice, requirements.surface);
+
+        std::string missingExtension = findMissingExtension(physicalDevice, requirements.extensions);
+        if (!missingExtension.empty()) {
+            candidate.rejectReason = "missing extension " + missingExtension;
+        } else if (!hasFeatures(physicalDevice, requirements.features)) {
+            candidate.rejectReason = "missing required features";
+        } else if (candidate.queueFamilies.graphics == NO_QUEUE_FAMILY) {
+            candidate.rejectReason = "no graphics queue";
+        } else if (requirements.surface != VK_NULL_HANDLE && candidate.queueFamilies.present == NO_QUEUE_FAMILY) {
+            candidate.rejectReason = "cannot present to the surface";
+        }
+
+        const VkPhysicalDeviceLimits &limits = candidate.properties.limits;
+        candidate.score = scoreDeviceType(candidate.properties.deviceType);
+
+        // One point per 8 MiB of device local memory, the type score still dominates for integrated GPUs sharing system memory
+        VkPhysicalDeviceMemoryProperties memoryProperties;
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+        for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; ++i) {
+            if (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+                candidate.score += (int64_t)(memoryProperties.memoryHeaps[i].size / (1024 * 1024)) / 8;
+            }
+        }
+
+        candidate.score += limits.maxImageDimension2D / 256;
+        candidate.score += limits.maxComputeSharedMemorySize / 4096;
+        if (candidate.queueFamilies.hasAsyncCompute()) {
+            candidate.score += 500;
+        }
+        if (candidate.queueFamilies.hasDedicatedTransfer()) {
+            candidate.score += 500;
+        }
+        return candidate;
+    }
+
+    bool matchesOverride(const DeviceCandidate &candidate, size_t index, const std::string &override) {
+        bool isIndex = !override.empty() && std::all_of(override.begin(), override.end(), [](unsigned char c) { return std::isdigit(c) != 0; });
+        if (isIndex) {
+            // Compared as digits, so an index too large for any integer just matches no device
+            size_t firstDigit = std::min(override.find_first_not_of('0'), override.size() - 1);
+            return override.compare(firstDigit, std::string::npos, std::to_string(index)) == 0;
+        }
+        return std::string(candidate.properties.deviceName).find(override) != std::string::npos;
+    }
+}
+
+std::vector<uint32_t> QueueFamilies::uniqueFamilies() const {
+    std::vector<uint32_t> families;
+    for (uint32_t family : { graphics, present, compute, transfer }) {
+        if (family != NO_QUEUE_FAMILY && std::find(families.begin(), families.end(), family) == families.end()) {
+            families.push_back(family);
+        }
+    }
+    return families;
+}
+
+DeviceCandidate selectPhysicalDevice(VkInstance instance, const DeviceRequirements &requirements, const std::string &override) {
+    uint32_t amountOfPhysicalDevices = 0;
+    VkResult result = vkEnumeratePhysicalDevices(instance, &amountOfPhysicalDevices, nullptr);
+    ASSERT_VULKAN(result);
+
+    std::vector<VkPhysicalDevice> physicalDevices(amountOfPhysicalDevices);
+    result = vkEnumeratePhysicalDevices(instance, &amountOfPhysicalDevices, physicalDevices.data());
+    ASSERT_VULKAN(result);
+
+    std::string deviceOverride = override;
+    if (deviceOverride.empty()) {
+        const char *environment = std::getenv("VULKAN_DEVICE");
+        deviceOverride = environment != nullptr ? environment : "";
+    }
+
+    std::vector<DeviceCandidate> candidates;
+    for (VkPhysicalDevice physicalDevice : physicalDevices) {
+        candidates.push_back(rateDevice(physicalDevice, requirements));
+    }
+
+    int best = -1;
+    int overridden = -1;
+    std::cout << "Physical devices:" << std::endl;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        const DeviceCandidate &candidate = candidates[i];
+        const QueueFamilies &families = candidate.queueFamilies;
+
+        std::cout << "  #" << i << " " << std::left << std::setw(40) << candidate.properties.deviceName << std::right <<
+            " score " << std::setw(6) << candidate.score <<
+            " | graphics " << (int)families.graphics << " present " << (int)families.present <<
+            " compute " << (int)families.compute << " transfer " << (int)families.transfer;
+        if (!candidate.rejectReason.empty()) {
+            std::cout << " | rejected: " << candidate.rejectReason;
+        }
+        std::cout << std::endl;
+
+        if (!candidate.rejectReason.empty()) {
+            continue;
+        }
+        if (best < 0 || candidate.score > candidates[best].score) {
+            best = (int)i;
+        }
+        if (overridden < 0 && !deviceOverride.empty() && matchesOverride(candidate, i, deviceOverride)) {
+            overridden = (int)i;
+        }
+    }
+
+    if (!deviceOverride.empty() && overridden < 0) {
+        std::cout << "No usable device matches '" << deviceOverride << "', using the highest score instead" << std::endl;
+    }
+    if (overridden >= 0) {
+        best = overridden;
+    }
+    if (best < 0) {
+        throw std::runtime_error("No physical device fulfills the requirements!");
+    }
+
+    std::cout << "Using device #" << best << ": " << candidates[best].properties.deviceName << std::endl << std::endl;
+    return candidates[best];
+}
+
+bool supportsDeviceExtension(VkPhysicalDevice physicalDevice, const char *extension) {
+    return findMissingExtension(physicalDevice, { extension }).empty();
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+const uint32_t NO_QUEUE_FAMILY = UINT32_MAX;
+
+// Queue families resolved for a physical device. compute and transfer fall back to the
+// graphics family when the device has no separate family for them.
+struct QueueFamilies {
+    uint32_t graphics = NO_QUEUE_FAMILY;
+    uint32_t present = NO_QUEUE_FAMILY;
+    uint32_t compute = NO_QUEUE_FAMILY;
+    uint32_t transfer = NO_QUEUE_FAMILY;
+
+    bool hasAsyncCompute() const { return compute != graphics; }
+    bool hasDedicatedTransfer() const { return transfer != graphics && transfer != compute; }
+
+    // Every family once, for the queue create infos
+    std::vector<uint32_t> uniqueFamilies() const;
+};
+
+struct DeviceRequirements {
+    std::vector<const char*> extensions;
+    VkPhysicalDeviceFeatures features = {};
+    VkSurfaceKHR surface = VK_NULL_HANDLE; // no present family is needed without a surface
+};
+
+struct DeviceCandidate {
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties properties = {};
+    QueueFamilies queueFamilies;
+    int64_t score = 0;
+    std::string rejectReason; // empty if the device fulfills the requirements
+};
+
+// Scores all devices by type, device local memory, limits and queue families and returns the best
+// one which fulfills the requirements. 'override' (index or part of the device name) wins over
+// the score, an empty override falls back to the VULKAN_DEVICE environment variable.
+DeviceCandidate selectPhysicalDevice(VkInstance instance, const DeviceRequirements &requirements, const std::string &override);
+
+// For optional extensions which are only enabled when the selected device has them
+bool supportsDeviceExtension(VkPhysicalDevice physicalDevice, const char *extension);
@@ -0,0 +1,409 @@
+#include "FrameCapture.h"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <cstdio>
+#include "VulkanUtils.h"
+#include "Profiler.h"
+
+namespace {
+    const uint32_t noBuffer = UINT32_MAX;
+    const uint32_t maxStoredBlock = 65535; // deflate stored blocks hold at most this many bytes
+
+    bool isBgra(VkFormat format) {
+        return format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_B8G8R8A8_SRGB;
+    }
+
+    bool isRgba(VkFormat format) {
+        return format == VK_FORMAT_R8G8B8A8_UNORM || format == VK_FORMAT_R8G8B8A8_SRGB;
+    }
+
+    class Crc32 {
+    public:
+        Crc32() {
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t value = i;
+                for (int bit = 0; bit < 8; ++bit) {
+                    value = (value & 1) ? 0xedb88320u ^ (value >> 1) : value >> 1;
+                }
+                table[i] = value;
+            }
+        }
+
+        void add(const uint8_t *data, size_t size) {
+            for (size_t i = 0; i < size; ++i) {
+                crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+            }
+        }
+        uint32_t get() const { return crc ^ 0xffffffffu; }
+
+    private:
+        uint32_t table[256];
+        uint32_t crc = 0xffffffffu;
+    };
+
+    void putBigEndian(uint8_t *target, uint32_t value) {
+        target[0] = (uint8_t)(value >> 24);
+        target[1] = (uint8_t)(value >> 16);
+        target[2] = (uint8_t)(value >> 8);
+        target[3] = (uint8_t)value;
+    }
+
+    // Writes the bytes and adds them to the checksum of the chunk
+    void writeChunkData(std::ofstream &file, Crc32 &crc, const uint8_t *data, size_t size) {
+        file.write(reinterpret_cast<const char*>(data), size);
+        crc.add(data, size);
+    }
+
+    void writeChunk(std::ofstream &file, const char *type, const uint8_t *data, uint32_t size) {
+        uint8_t header[8];
+        putBigEndian(header, size);
+        std::memcpy(header + 4, type, 4);
+        file.write(reinterpret_cast<const char*>(header), 4);
+        Crc32 crc;
+        writeChunkData(file, crc, header + 4, 4);
+        writeChunkData(file, crc, data, size);
+        uint8_t checksum[4];
+        putBigEndian(checksum, crc.get());
+        file.write(reinterpret_cast<const char*>(checksum), 4);
+    }
+
+    // RGBA8 PNG with stored (uncompressed) deflate blocks. Compression would cost more CPU time than the
+    // writer has per frame at full rate, the files can be recompressed offline.
+    void writePng(const std::string &path, const uint8_t *pixels, VkExtent2D extent, bool swapRedBlue) {
+        std::ofstream file(path, std::ios::binary);
+        if (!file) {
+            std::cerr << "Failed to open '" << path << "' for writing" << std::endl;
+            return;
+        }
+        const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+        file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+        uint8_t header[13];
+        putBigEndian(header, extent.width);
+        putBigEndian(header + 4, extent.height);
+        header[8] = 8; // bits per channel
+        header[9] = 6; // RGBA
+        header[10] = 0; // deflate
+        header[11] = 0; // adaptive filtering, every row uses filter 0
+        header[12] = 0; // not interlaced
+        writeChunk(file, "IHDR", header, sizeof(header));
+
+        // Every row is a filter byte followed by the pixels
+        size_t rowSize = 1 + (size_t)extent.width * 4;
+        size_t rawSize = rowSize * extent.height;
+        size_t blockCount = (rawSize + maxStoredBlock - 1) / maxStoredBlock;
+        uint32_t idatSize = (uint32_t)(2 + rawSize + blockCount * 5 + 4);
+
+        uint8_t idatHeader[8];
+        putBigEndian(idatHeader, idatSize);
+        std::memcpy(idatHeader + 4, "IDAT", 4);
+        file.write(reinterpret_cast<const char*>(idatHeader), 4);
+        Crc32 crc;
+        writeChunkData(file, crc, idatHeader + 4, 4);
+        const uint8_t zlibHeader[2] = { 0x78, 0x01 };
+        writeChunkData(file, crc, zlibHeader, 2);
+
+        std::vector<uint8_t> row(rowSize);
+        uint32_t adlerA = 1;
+        uint32_t adlerB = 0;
+        size_t blockLeft = 0;
+        size_t rawLeft = rawSize;
+        for (uint32_t y = 0; y < extent.height; ++y) {
+            row[0] = 0;
+            const uint8_t *source = pixels + (size_t)y * extent.width * 4;
+            for (uint32_t x = 0; x < extent.width; ++x) {
+                row[1 + x * 4 + 0] = source[x * 4 + (swapRedBlue ? 2 : 0)];
+                row[1 + x * 4 + 1] = source[x * 4 + 1];
+                row[1 + x * 4 + 2] = source[x * 4 + (swapRedBlue ? 0 : 2)];
+                row[1 + x * 4 + 3] = source[x * 4 + 3];
+            }
+            for (uint8_t value : row) {
+                adlerA = (adlerA + value) % 65521;
+                adlerB = (adlerB + adlerA) % 65521;
+            }
+
+            // Rows are split across stored blocks wherever a block is full
+            size_t written = 0;
+            while (written < rowSize) {
+                if (blockLeft == 0) {
+                    blockLeft = std::min<size_t>(rawLeft, maxStoredBlock);
+                    uint8_t blockHeader[5];
+                    blockHeader[0] = rawLeft == blockLeft ? 1 : 0; // final block
+                    blockHeader[1] = (uint8_t)blockLeft;
+                    blockHeader[2] = (uint8_t)(blockLeft >> 8);
+                    blockHeader[3] = (uint8_t)~blockHeader[1];
+                    blockHeader[4] = (uint8_t)~blockHeader[2];
+                    writeChunkData(file, crc, blockHeader, 5);
+                }
+                size_t size = std::min(blockLeft, rowSize - written);
+                writeChunkData(file, crc, row.data() + written, size);
+                written += size;
+                blockLeft -= size;
+                rawLeft -= size;
+            }
+        }
+
+        uint8_t adler[4];
+        putBigEndian(adler, (adlerB << 16) | adlerA);
+        writeChunkData(file, crc, adler, 4);
+        uint8_t checksum[4];
+        putBigEndian(checksum, crc.get());
+        file.write(reinterpret_cast<const char*>(checksum), 4);
+
+        writeChunk(file, "IEND", nullptr, 0);
+    }
+}
+
+bool FrameCapture::supportsFormat(VkFormat format) {
+    return isBgra(format) || isRgba(format);
+}
+
+void FrameCapture::start(VkDevice device, VkPhysicalDevice physicalDevice, MemoryAllocator &memoryAllocator, uint32_t framesInFlight, uint32_t queueDepth,
+    const std::string &directory, CaptureFormat format, uint32_t interval) {
+    this->device = device;
+    this->memoryAllocator = &memoryAllocator;
+    this->directory = directory;
+    this->format = format;
+    this->interval = std::max(1u, interval);
+
+    // The CPU reads every byte, so cached memory is worth the invalidate. Without it uncached reads still work, only slower.
+    VkPhysicalDeviceMemoryProperties deviceMemoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &deviceMemoryProperties);
+    memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    for (uint32_t i = 0; i < deviceMemoryProperties.memoryTypeCount; ++i) {
+        VkMemoryPropertyFlags flags = deviceMemoryProperties.memoryTypes[i].propertyFlags;
+        if ((flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && (flags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT)) {
+            memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+            coherent = (flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+            break;
+        }
+    }
+
+    std::filesystem::create_directories(directory);
+
+    buffers.resize(framesInFlight + queueDepth);
+    recordedBySlot.assign(framesInFlight, noBuffer);
+    for (uint32_t i = 0; i < buffers.size(); ++i) {
+        freeBuffers.push_back(i);
+    }
+    stopping = false;
+    writer = std::thread(&FrameCapture::writerLoop, this);
+
+    std::cout << "Frame capture: every " << this->interval << ". frame to '" << directory << "' as " << (format == CaptureFormat::Png ? "PNG" : "raw") <<
+        " | " << buffers.size() << " readback buffers | " << ((memoryProperties & VK_MEMORY_PROPERTY_HOST_CACHED_BIT) ? "host cached" : "uncached") <<
+        (coherent ? "" : ", invalidated") << std::endl;
+}
+
+void FrameCapture::stop() {
+    for (uint32_t frame = 0; frame < recordedBySlot.size(); ++frame) {
+        collect(frame);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    writer.join();
+
+    for (ReadbackBuffer &readback : buffers) {
+        if (readback.buffer != VK_NULL_HANDLE) {
+            memoryAllocator->destroyBuffer(readback.buffer, readback.allocation);
+        }
+    }
+    buffers.clear();
+    printSummary();
+}
+
+void FrameCapture::recordCopy(VkCommandBuffer commandBuffer, uint32_t frame, uint64_t frameNumber, VkImage image, VkFormat format, VkExtent2D extent) {
+    PROFILE_ZONE("recordCapture");
+    auto start = std::chrono::high_resolution_clock::now();
+
+    uint32_t index = noBuffer;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!freeBuffers.empty()) {
+            index = freeBuffers.back();
+            freeBuffers.pop_back();
+        }
+    }
+    if (index == noBuffer) {
+        // Every buffer waits for the writer, dropping keeps the render loop going
+        ++dropped;
+        ++totalDropped;
+        cpuTimeSum += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        return;
+    }
+
+    // Free buffers are not used by the GPU or the writer, so a resize can replace them right here
+    ReadbackBuffer &readback = buffers[index];
+    VkDeviceSize size = (VkDeviceSize)extent.width * extent.height * 4;
+    if (readback.capacity < size) {
+        if (readback.buffer != VK_NULL_HANDLE) {
+            memoryAllocator->destroyBuffer(readback.buffer, readback.allocation);
+        }
+        VkBufferCreateInfo bufferCreateInfo;
+        bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferCreateInfo.pNext = nullptr;
+        bufferCreateInfo.flags = 0;
+        bufferCreateInfo.size = size;
+        bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        bufferCreateInfo.queueFamilyIndexCount = 0;
+        bufferCreateInfo.pQueueFamilyIndices = nullptr;
+        memoryAllocator->createBuffer(bufferCreateInfo, memoryProperties, readback.buffer, readback.allocation);
+        readback.capacity = size;
+    }
+    readback.frameNumber = frameNumber;
+    readback.format = format;
+    readback.extent = extent;
+
+    VkBufferImageCopy region;
+    region.bufferOffset = 0;
+    region.bufferRowLength = 0; // tightly packed
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = { 0, 0, 0 };
+    region.imageExtent = { extent.width, extent.height, 1 };
+    vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback.buffer, 1, &region);
+
+    VkBufferMemoryBarrier toHost;
+    toHost.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    toHost.pNext = nullptr;
+    toHost.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    toHost.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    toHost.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toHost.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toHost.buffer = readback.buffer;
+    toHost.offset = 0;
+    toHost.size = size;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+        0, nullptr, 1, &toHost, 0, nullptr);
+
+    recordedBySlot[frame] = index;
+    ++captured;
+    ++totalCaptured;
+    cpuTimeSum += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void FrameCapture::collect(uint32_t frame) {
+    ++framesSinceReport;
+    uint32_t index = recordedBySlot[frame];
+    if (index == noBuffer) {
+        return;
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    recordedBySlot[frame] = noBuffer;
+
+    const ReadbackBuffer &readback = buffers[index];
+    if (!coherent) {
+        VkMappedMemoryRange range;
+        range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        range.pNext = nullptr;
+        range.memory = readback.allocation.memory;
+        range.offset = readback.allocation.offset; // non coherent allocations are aligned to nonCoherentAtomSize
+        range.size = readback.allocation.size;
+        VkResult result = vkInvalidateMappedMemoryRanges(device, 1, &range);
+        ASSERT_VULKAN(result);
+    }
+
+    // Never blocks, there are as many queue entries as buffers
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        writeQueue.push_back(index);
+    }
+    wake.notify_one();
+    cpuTimeSum += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void FrameCapture::printReport() {
+    uint64_t queued;
+    uint64_t writtenSinceReport;
+    uint64_t bytes;
+    double writeTime;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queued = writeQueue.size();
+        writtenSinceReport = written;
+        bytes = bytesWritten;
+        writeTime = writeTimeSum;
+        written = 0;
+        bytesWritten = 0;
+        writeTimeSum = 0.0;
+    }
+
+    std::cout << "Frame capture: captured " << captured << " | dropped " << dropped << " | written " << writtenSinceReport << " (" <<
+        bytes / (1024.0 * 1024.0) << " MiB) | queued " << queued << " | CPU per frame: " <<
+        (framesSinceReport > 0 ? cpuTimeSum / framesSinceReport : 0.0) << " ms";
+    if (writtenSinceReport > 0) {
+        std::cout << " | write avg: " << writeTime / writtenSinceReport << " ms";
+    }
+    std::cout << std::endl;
+
+    captured = 0;
+    dropped = 0;
+    cpuTimeSum = 0.0;
+    framesSinceReport = 0;
+}
+
+void FrameCapture::printSummary() const {
+    std::cout << "Frame capture: " << totalCaptured << " frames captured | " << totalDropped << " dropped | " << totalWritten << " written to '" <<
+        directory << "'" << std::endl;
+}
+
+void FrameCapture::writerLoop() {
+    Profiler::setThreadName("Capture writer");
+
+    while (true) {
+        uint32_t index;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this]() { return stopping || !writeQueue.empty(); });
+            if (writeQueue.empty()) {
+                return; // stopping and everything written
+            }
+            index = writeQueue.front();
+            writeQueue.pop_front();
+        }
+
+        PROFILE_ZONE("writeCapture");
+        auto start = std::chrono::high_resolution_clock::now();
+        const ReadbackBuffer &readback = buffers[index];
+        writeFrame(readback);
+        double writeTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        ++written;
+        ++totalWritten;
+        bytesWritten += (uint64_t)readback.extent.width * readback.extent.height * 4;
+        writeTimeSum += writeTime;
+        freeBuffers.push_back(index);
+    }
+}
+
+void FrameCapture::writeFrame(const ReadbackBuffer &readback) const {
+    const uint8_t *pixels = static_cast<const uint8_t*>(readback.allocation.mapped);
+    char name[64];
+    std::snprintf(name, sizeof(name), "frame_%06llu", (unsigned long long)readback.frameNumber);
+    std::string path = directory + "/" + name;
+
+    if (format == CaptureFormat::Png) {
+        writePng(path + ".png", pixels, readback.extent, isBgra(readback.format));
+        return;
+    }
+
+    // Raw files carry the size in the name, the extension tells the channel order
+    path += "_" + std::to_string(readback.extent.width) + "x" + std::to_string(readback.extent.height) + (isBgra(readback.format) ? ".bgra" : ".rgba");
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Failed to open '" << path << "' for writing" << std::endl;
+        return;
+    }
+    file.write(reinterpret_cast<const char*>(pixels), (std::streamsize)readback.extent.width * readback.extent.height * 4);
+}
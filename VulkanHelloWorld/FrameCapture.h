@@ -0,0 +1,87 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "MemoryAllocator.h"
+
+// Raw writes the bytes as copied (.bgra/.rgba), Png an uncompressed RGBA PNG
+enum class CaptureFormat { Raw, Png };
+
+// Copies rendered frames into persistently mapped readback buffers and writes them to disk on a writer
+// thread. The copy is recorded after the render pass, the buffer is handed to the writer once the fence
+// of its frame slot signaled and comes back after the file was written. The render loop never waits:
+// when every buffer is still queued for writing, the frame is dropped instead.
+class FrameCapture {
+public:
+    // Formats with 4 bytes per pixel in RGBA or BGRA order
+    static bool supportsFormat(VkFormat format);
+
+    // queueDepth readback buffers on top of one per frame in flight, they are allocated on first use
+    void start(VkDevice device, VkPhysicalDevice physicalDevice, MemoryAllocator &memoryAllocator, uint32_t framesInFlight, uint32_t queueDepth,
+        const std::string &directory, CaptureFormat format, uint32_t interval);
+    // Call once the fences of all frames in flight signaled, writes everything captured so far before the writer exits
+    void stop();
+    // Between start and stop, also when a swapchain recreate turned capturing off
+    bool isRunning() const { return writer.joinable(); }
+
+    bool wantsFrame(uint64_t frameNumber) const { return frameNumber % interval == 0; }
+    // Records the copy in the capture pass of the render graph, which has image in TRANSFER_SRC_OPTIMAL
+    void recordCopy(VkCommandBuffer commandBuffer, uint32_t frame, uint64_t frameNumber, VkImage image, VkFormat format, VkExtent2D extent);
+    // Call after the fence of the frame slot signaled, hands its capture to the writer
+    void collect(uint32_t frame);
+
+    // Captured, dropped and written frames plus the CPU time per frame since the last report
+    void printReport();
+    void printSummary() const;
+
+private:
+    struct ReadbackBuffer {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        Allocation allocation;
+        VkDeviceSize capacity = 0;
+        uint64_t frameNumber = 0;
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        VkExtent2D extent = {};
+    };
+
+    void writerLoop();
+    void writeFrame(const ReadbackBuffer &readback) const;
+
+    VkDevice device = VK_NULL_HANDLE;
+    MemoryAllocator *memoryAllocator = nullptr;
+    VkMemoryPropertyFlags memoryProperties = 0;
+    bool coherent = true;
+    std::string directory;
+    CaptureFormat format = CaptureFormat::Png;
+    uint32_t interval = 1;
+
+    std::vector<ReadbackBuffer> buffers;
+    std::vector<uint32_t> recordedBySlot; // buffer copied into by the frame slot, UINT32_MAX if none
+
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<uint32_t> freeBuffers; // guarded by mutex
+    std::deque<uint32_t> writeQueue; // guarded by mutex
+    bool stopping = false;
+
+    // Main thread counters since the last report
+    uint64_t captured = 0;
+    uint64_t dropped = 0;
+    double cpuTimeSum = 0.0; // recordCopy and collect
+    uint32_t framesSinceReport = 0;
+    uint64_t totalCaptured = 0;
+    uint64_t totalDropped = 0;
+    // Writer counters, guarded by mutex
+    uint64_t written = 0;
+    uint64_t bytesWritten = 0;
+    double writeTimeSum = 0.0;
+    uint64_t totalWritten = 0;
+};
@@ -0,0 +1,47 @@
+#include "FrameStages.h"
+
+#include <iostream>
+#include <algorithm>
+
+void FrameStageStats::Times::add(double simulationTime, double queueTime, double renderTime, uint32_t occupancy) {
+    ++frames;
+    simulationSum += simulationTime;
+    queueSum += queueTime;
+    renderSum += renderTime;
+    double totalTime = simulationTime + queueTime + renderTime;
+    totalSum += totalTime;
+    totalMax = std::max(totalMax, totalTime);
+    occupancySum += occupancy;
+    occupancyMax = std::max(occupancyMax, occupancy);
+}
+
+void FrameStageStats::Times::print(uint32_t queueDepth) const {
+    std::cout << "simulate avg: " << simulationSum / frames << " ms | queued avg: " << queueSum / frames << " ms | record and submit avg: " <<
+        renderSum / frames << " ms | total avg: " << totalSum / frames << " ms, max: " << totalMax << " ms | queue occupancy avg: " <<
+        (double)occupancySum / frames << ", max: " << occupancyMax << " of " << queueDepth << std::endl;
+}
+
+void FrameStageStats::record(const FramePacket &packet, std::chrono::high_resolution_clock::time_point popped,
+    std::chrono::high_resolution_clock::time_point submitted) {
+    double queueTime = std::chrono::duration<double, std::milli>(popped - packet.produced).count();
+    double renderTime = std::chrono::duration<double, std::milli>(submitted - popped).count();
+    interval.add(packet.simulationTime, queueTime, renderTime, packet.queueOccupancy);
+    total.add(packet.simulationTime, queueTime, renderTime, packet.queueOccupancy);
+}
+
+void FrameStageStats::printReport(uint32_t queueDepth) {
+    if (interval.frames == 0) {
+        return;
+    }
+    std::cout << "Frame stages | ";
+    interval.print(queueDepth);
+    interval = Times();
+}
+
+void FrameStageStats::printSummary(uint32_t queueDepth) const {
+    if (total.frames == 0) {
+        return;
+    }
+    std::cout << "Frame stages: " << total.frames << " frames | ";
+    total.print(queueDepth);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <vulkan/vulkan.h>
+
+// Everything the main thread hands to the rendering side for one frame. The event callbacks only run on the
+// main thread, their results travel with the packet instead of being shared with the render thread.
+struct FramePacket {
+    uint64_t sequence = 0;
+    bool quit = false; // the window was closed, no frame to render
+    bool resized = false;
+    bool cyclePresentMode = false; // P was pressed
+    VkExtent2D windowExtent = {}; // framebuffer size when the packet was made
+    std::chrono::high_resolution_clock::time_point produced; // simulation step finished
+    double simulationTime = 0.0; // milliseconds the main thread spent on the packet
+    uint32_t queueOccupancy = 0; // packets already waiting when this one was queued
+};
+
+// Latency of every stage a frame packet goes through: simulation on the main thread, waiting in the frame
+// queue, and recording plus submission on the render thread. Together with the queue occupancy this shows
+// which side is the bottleneck: a full queue means the render thread cannot keep up, an empty one that the
+// main thread cannot.
+class FrameStageStats {
+public:
+    void record(const FramePacket &packet, std::chrono::high_resolution_clock::time_point popped,
+        std::chrono::high_resolution_clock::time_point submitted);
+
+    // Averages since the last report
+    void printReport(uint32_t queueDepth);
+    void printSummary(uint32_t queueDepth) const;
+
+private:
+    struct Times {
+        uint64_t frames = 0;
+        double simulationSum = 0.0;
+        double queueSum = 0.0;
+        double renderSum = 0.0;
+        double totalSum = 0.0;
+        double totalMax = 0.0;
+        uint64_t occupancySum = 0;
+        uint32_t occupancyMax = 0;
+
+        void add(double simulationTime, double queueTime, double renderTime, uint32_t occupancy);
+        void print(uint32_t queueDepth) const;
+    };
+
+    Times interval;
+    Times total;
+};
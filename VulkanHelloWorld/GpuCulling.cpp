@@ -0,0 +1,306 @@
+#include "GpuCulling.h"
+
+#include <iostream>
+#include <cstring>
+#include <cstddef>
+#include "VulkanUtils.h"
+
+namespace {
+    const uint32_t amountOfBindings = 6;
+
+    VkBufferCreateInfo bufferInfo(VkDeviceSize size, VkBufferUsageFlags usage) {
+        VkBufferCreateInfo bufferCreateInfo;
+        bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferCreateInfo.pNext = nullptr;
+        bufferCreateInfo.flags = 0;
+        bufferCreateInfo.size = size;
+        bufferCreateInfo.usage = usage;
+        bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        bufferCreateInfo.queueFamilyIndexCount = 0;
+        bufferCreateInfo.pQueueFamilyIndices = nullptr;
+        return bufferCreateInfo;
+    }
+
+    void memoryBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStages, VkAccessFlags srcAccess, VkPipelineStageFlags dstStages, VkAccessFlags dstAccess) {
+        VkMemoryBarrier barrier;
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.pNext = nullptr;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstAccessMask = dstAccess;
+        vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+}
+
+void GpuCulling::init(VkDevice device, VkPhysicalDevice physicalDevice, MemoryAllocator &memoryAllocator, const InstancedBatch &batch,
+    const ShaderCode &shaderCode, VkPipelineCache pipelineCache, uint32_t framesInFlight, bool drawIndirectCount) {
+    this->device = device;
+    this->batch = &batch;
+    // The culling dispatches one dimension of workgroups
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    uint64_t maxCulled = (uint64_t)properties.limits.maxComputeWorkGroupCount[0] * workgroupSize;
+    maxInstances = batch.getInstanceCount();
+    if (maxInstances > maxCulled) {
+        std::cout << "Instance count " << maxInstances << " exceeds the workgroup count limit, culling and drawing " << maxCulled << std::endl;
+        maxInstances = (uint32_t)maxCulled;
+    }
+
+    if (drawIndirectCount) {
+        cmdDrawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCountKHR");
+    }
+
+    createBuffers(memoryAllocator, framesInFlight);
+    createPipeline(shaderCode, pipelineCache);
+    createDescriptorSet();
+
+    for (uint32_t stream = 0; stream < 2; ++stream) {
+        pushConstants.wordsPerInstance[stream] = stream < batch.getStreamCount() ? batch.getStreamStride(stream) / sizeof(uint32_t) : 0;
+    }
+    setFrustum(glm::mat4(1.0f));
+}
+
+void GpuCulling::destroy(MemoryAllocator &memoryAllocator) {
+    vkDestroyPipeline(device, pipeline, nullptr);
+    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+
+    for (uint32_t stream = 0; stream < 2; ++stream) {
+        if (visibleBuffers[stream] != VK_NULL_HANDLE) {
+            memoryAllocator.destroyBuffer(visibleBuffers[stream], visibleAllocations[stream]);
+        }
+    }
+    memoryAllocator.destroyBuffer(indirectBuffer, indirectAllocation);
+    for (size_t i = 0; i < readbackBuffers.size(); ++i) {
+        memoryAllocator.destroyBuffer(readbackBuffers[i], readbackAllocations[i]);
+    }
+    readbackBuffers.clear();
+    readbackAllocations.clear();
+}
+
+void GpuCulling::createBuffers(MemoryAllocator &memoryAllocator, uint32_t framesInFlight) {
+    uint32_t instanceCount = batch->getInstanceCount();
+    for (uint32_t stream = 0; stream < batch->getStreamCount(); ++stream) {
+        VkBufferCreateInfo bufferCreateInfo = bufferInfo((VkDeviceSize)instanceCount * batch->getStreamStride(stream),
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+        memoryAllocator.createBuffer(bufferCreateInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, visibleBuffers[stream], visibleAllocations[stream]);
+    }
+
+    VkBufferCreateInfo indirectCreateInfo = bufferInfo(sizeof(IndirectData), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+    memoryAllocator.createBuffer(indirectCreateInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indirectBuffer, indirectAllocation);
+
+    readbackBuffers.resize(framesInFlight, VK_NULL_HANDLE);
+    readbackAllocations.resize(framesInFlight);
+    pending.assign(framesInFlight, false);
+    tested.assign(framesInFlight, 0);
+    for (uint32_t i = 0; i < framesInFlight; ++i) {
+        VkBufferCreateInfo readbackCreateInfo = bufferInfo(sizeof(IndirectData), VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+        memoryAllocator.createBuffer(readbackCreateInfo, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            readbackBuffers[i], readbackAllocations[i]);
+    }
+}
+
+void GpuCulling::createPipeline(const ShaderCode &shaderCode, VkPipelineCache pipelineCache) {
+    std::vector<VkDescriptorSetLayoutBinding> bindings(amountOfBindings);
+    for (uint32_t i = 0; i < amountOfBindings; ++i) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        bindings[i].pImmutableSamplers = nullptr;
+    }
+
+    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo;
+    descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    descriptorSetLayoutCreateInfo.pNext = nullptr;
+    descriptorSetLayoutCreateInfo.flags = 0;
+    descriptorSetLayoutCreateInfo.bindingCount = amountOfBindings;
+    descriptorSetLayoutCreateInfo.pBindings = bindings.data();
+
+    VkResult result = vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, nullptr, &descriptorSetLayout);
+    ASSERT_VULKAN(result);
+
+    VkPushConstantRange pushConstantRange;
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(PushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo;
+    pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutCreateInfo.pNext = nullptr;
+    pipelineLayoutCreateInfo.flags = 0;
+    pipelineLayoutCreateInfo.setLayoutCount = 1;
+    pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayout;
+    pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+    pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+    result = vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout);
+    ASSERT_VULKAN(result);
+
+    VkShaderModule shaderModule = createShaderModule(device, shaderCode);
+
+    VkComputePipelineCreateInfo pipelineCreateInfo;
+    pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineCreateInfo.pNext = nullptr;
+    pipelineCreateInfo.flags = 0;
+    pipelineCreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineCreateInfo.stage.pNext = nullptr;
+    pipelineCreateInfo.stage.flags = 0;
+    pipelineCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineCreateInfo.stage.module = shaderModule;
+    pipelineCreateInfo.stage.pName = "main";
+    pipelineCreateInfo.stage.pSpecializationInfo = nullptr;
+    pipelineCreateInfo.layout = pipelineLayout;
+    pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+    pipelineCreateInfo.basePipelineIndex = -1;
+
+    result = vkCreateComputePipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline);
+    ASSERT_VULKAN(result);
+
+    // The pipeline keeps what it needs
+    vkDestroyShaderModule(device, shaderModule, nullptr);
+}
+
+void GpuCulling::createDescriptorSet() {
+    VkDescriptorPoolSize poolSize;
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = amountOfBindings;
+
+    VkDescriptorPoolCreateInfo descriptorPoolCreateInfo;
+    descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descriptorPoolCreateInfo.pNext = nullptr;
+    descriptorPoolCreateInfo.flags = 0;
+    descriptorPoolCreateInfo.maxSets = 1;
+    descriptorPoolCreateInfo.poolSizeCount = 1;
+    descriptorPoolCreateInfo.pPoolSizes = &poolSize;
+
+    VkResult result = vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, nullptr, &descriptorPool);
+    ASSERT_VULKAN(result);
+
+    VkDescriptorSetAllocateInfo descriptorSetAllocateInfo;
+    descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descriptorSetAllocateInfo.pNext = nullptr;
+    descriptorSetAllocateInfo.descriptorPool = descriptorPool;
+    descriptorSetAllocateInfo.descriptorSetCount = 1;
+    descriptorSetAllocateInfo.pSetLayouts = &descriptorSetLayout;
+
+    result = vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, &descriptorSet);
+    ASSERT_VULKAN(result);
+
+    // Without a second stream its bindings point at the first one, the shader copies 0 words of it
+    uint32_t secondStream = batch->getStreamCount() > 1 ? 1 : 0;
+    VkBuffer buffers[amountOfBindings] = {
+        batch->getSphereBuffer(),
+        batch->getInstanceBuffer(0), visibleBuffers[0],
+        batch->getInstanceBuffer(secondStream), visibleBuffers[secondStream],
+        indirectBuffer
+    };
+
+    VkDescriptorBufferInfo bufferInfos[amountOfBindings];
+    VkWriteDescriptorSet writes[amountOfBindings];
+    for (uint32_t i = 0; i < amountOfBindings; ++i) {
+        bufferInfos[i].buffer = buffers[i];
+        bufferInfos[i].offset = 0;
+        bufferInfos[i].range = VK_WHOLE_SIZE;
+
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].pNext = nullptr;
+        writes[i].dstSet = descriptorSet;
+        writes[i].dstBinding = i;
+        writes[i].dstArrayElement = 0;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[i].pImageInfo = nullptr;
+        writes[i].pBufferInfo = &bufferInfos[i];
+        writes[i].pTexelBufferView = nullptr;
+    }
+    vkUpdateDescriptorSets(device, amountOfBindings, writes, 0, nullptr);
+}
+
+// Rows of the view projection matrix combined as in Gribb/Hartmann, with Vulkan's 0..1 depth range
+void GpuCulling::setFrustum(const glm::mat4 &viewProjection) {
+    glm::mat4 rows = glm::transpose(viewProjection);
+    glm::vec4 planes[6] = {
+        rows[3] + rows[0], // left
+        rows[3] - rows[0], // right
+        rows[3] + rows[1], // top
+        rows[3] - rows[1], // bottom
+        rows[2],           // near
+        rows[3] - rows[2]  // far
+    };
+    for (int i = 0; i < 6; ++i) {
+        pushConstants.planes[i] = planes[i] / glm::length(glm::vec3(planes[i]));
+    }
+}
+
+void GpuCulling::recordCulling(VkCommandBuffer commandBuffer, uint32_t amountOfInstances) {
+    if (amountOfInstances > maxInstances) {
+        amountOfInstances = maxInstances;
+    }
+    pushConstants.amountOfInstances = amountOfInstances;
+
+    // The previous frame may still draw from or copy the buffers which are written now
+    memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+        VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0);
+
+    IndirectData reset;
+    reset.command.indexCount = 3;
+    reset.command.instanceCount = 0;
+    reset.command.firstIndex = 0;
+    reset.command.vertexOffset = 0;
+    reset.command.firstInstance = 0;
+    reset.drawCount = 0;
+    vkCmdUpdateBuffer(commandBuffer, indirectBuffer, 0, sizeof(reset), &reset);
+
+    memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+    vkCmdDispatch(commandBuffer, (amountOfInstances + workgroupSize - 1) / workgroupSize, 1, 1);
+
+    memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT);
+}
+
+void GpuCulling::recordDraw(VkCommandBuffer commandBuffer) const {
+    batch->bind(commandBuffer, visibleBuffers);
+    if (cmdDrawIndexedIndirectCount != nullptr) {
+        // Skips the draw entirely when everything was culled
+        cmdDrawIndexedIndirectCount(commandBuffer, indirectBuffer, 0, indirectBuffer, offsetof(IndirectData, drawCount), 1, sizeof(IndirectData));
+    } else {
+        vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffer, 0, 1, sizeof(IndirectData));
+    }
+}
+
+void GpuCulling::recordReadback(VkCommandBuffer commandBuffer, uint32_t frame) {
+    VkBufferCopy region;
+    region.srcOffset = 0;
+    region.dstOffset = 0;
+    region.size = sizeof(IndirectData);
+    vkCmdCopyBuffer(commandBuffer, indirectBuffer, readbackBuffers[frame], 1, &region);
+
+    memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+
+    pending[frame] = true;
+    tested[frame] = pushConstants.amountOfInstances;
+}
+
+void GpuCulling::collect(uint32_t frame) {
+    if (!pending[frame]) {
+        return;
+    }
+    IndirectData data;
+    std::memcpy(&data, readbackAllocations[frame].mapped, sizeof(data));
+    lastVisible = data.command.instanceCount;
+    lastTested = tested[frame];
+    pending[frame] = false;
+}
+
+void GpuCulling::printReport() const {
+    std::cout << "GPU culling (last frame): " << lastTested << " instances | visible " << lastVisible <<
+        " | culled " << lastTested - lastVisible << (cmdDrawIndexedIndirectCount != nullptr ? " | indirect count" : " | indirect") << std::endl;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include "MemoryAllocator.h"
+#include "InstancedBatch.h"
+#include "ShaderLoader.h"
+
+// Frustum culling of an instanced batch on the GPU (cull.comp). A compute pass tests the bounding
+// sphere of every instance against the frustum planes and compacts the visible instances into a
+// second set of instance buffers, together with the VkDrawIndexedIndirectCommand which draws them.
+// The CPU records the same handful of commands every frame, no matter how many instances there are.
+//
+// The visible count of every frame is copied into a host visible buffer and read once the fence
+// of the frame signaled, so monitoring never stalls.
+class GpuCulling {
+public:
+    // drawIndirectCount: VK_KHR_draw_indirect_count is enabled on the device
+    void init(VkDevice device, VkPhysicalDevice physicalDevice, MemoryAllocator &memoryAllocator, const InstancedBatch &batch,
+        const ShaderCode &shaderCode, VkPipelineCache pipelineCache, uint32_t framesInFlight, bool drawIndirectCount);
+    void destroy(MemoryAllocator &memoryAllocator);
+
+    // Extracts the six frustum planes, positions are in the space the vertex shader outputs
+    void setFrustum(const glm::mat4 &viewProjection);
+
+    // Outside of a render pass, culls the first amountOfInstances instances, at most as many as one
+    // dimension of workgroups covers
+    void recordCulling(VkCommandBuffer commandBuffer, uint32_t amountOfInstances);
+    // Inside the render pass with the graphics pipeline bound
+    void recordDraw(VkCommandBuffer commandBuffer) const;
+    // After the render pass, copies the counters for collect()
+    void recordReadback(VkCommandBuffer commandBuffer, uint32_t frame);
+
+    // Call after the fence of the frame signaled
+    void collect(uint32_t frame);
+    void printReport() const;
+
+private:
+    struct PushConstants {
+        glm::vec4 planes[6];
+        uint32_t amountOfInstances;
+        uint32_t wordsPerInstance[2];
+    };
+
+    // VkDrawIndexedIndirectCommand followed by the draw count, like the Indirect block in cull.comp
+    struct IndirectData {
+        VkDrawIndexedIndirectCommand command;
+        uint32_t drawCount;
+    };
+
+    static const uint32_t workgroupSize = 64;
+
+    void createBuffers(MemoryAllocator &memoryAllocator, uint32_t framesInFlight);
+    void createPipeline(const ShaderCode &shaderCode, VkPipelineCache pipelineCache);
+    void createDescriptorSet();
+
+    VkDevice device = VK_NULL_HANDLE;
+    const InstancedBatch *batch = nullptr;
+    PFN_vkCmdDrawIndexedIndirectCountKHR cmdDrawIndexedIndirectCount = nullptr;
+    uint32_t maxInstances = 0;
+
+    VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+
+    // Compacted copies of the instance streams, same layout as the originals
+    VkBuffer visibleBuffers[2] = { VK_NULL_HANDLE, VK_NULL_HANDLE };
+    Allocation visibleAllocations[2];
+    VkBuffer indirectBuffer = VK_NULL_HANDLE;
+    Allocation indirectAllocation;
+    std::vector<VkBuffer> readbackBuffers;
+    std::vector<Allocation> readbackAllocations;
+    std::vector<bool> pending;
+    std::vector<uint32_t> tested; // instances culled by the frame waiting for its readback
+
+    PushConstants pushConstants = {};
+    uint32_t lastVisible = 0;
+    uint32_t lastTested = 0;
+};
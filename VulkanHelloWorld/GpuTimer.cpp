@@ -0,0 +1,204 @@
+#include "GpuTimer.h"
+
+#include <iostream>
+#include <algorithm>
+#include "VulkanUtils.h"
+
+namespace {
+    const VkQueryPipelineStatisticFlags statisticFlags =
+        VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+    // Upper bounds of the histogram buckets in milliseconds, the last bucket takes everything above
+    const double bucketLimits[] = { 0.25, 0.5, 1.0, 2.0, 4.0, 8.0, 16.7, 33.3 };
+    const size_t amountOfBuckets = sizeof(bucketLimits) / sizeof(bucketLimits[0]) + 1;
+}
+
+void GpuTimer::init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t queueFamilyIndex, uint32_t framesInFlight, bool pipelineStatistics) {
+    this->device = device;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    timestampPeriod = properties.limits.timestampPeriod;
+
+    uint32_t amountOfQueueFamilies = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &amountOfQueueFamilies, nullptr);
+    std::vector<VkQueueFamilyProperties> familyProperties(amountOfQueueFamilies);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &amountOfQueueFamilies, familyProperties.data());
+
+    uint32_t validBits = familyProperties[queueFamilyIndex].timestampValidBits;
+    timestampsSupported = validBits > 0;
+    timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+    pipelineStatisticsEnabled = pipelineStatistics;
+
+    if (!timestampsSupported) {
+        std::cout << "GPU timer: queue family " << queueFamilyIndex << " does not support timestamps" << std::endl;
+    }
+
+    timestampPools.resize(framesInFlight, VK_NULL_HANDLE);
+    statisticsPools.resize(framesInFlight, VK_NULL_HANDLE);
+    pending.resize(framesInFlight, false);
+    history.reserve(historySize);
+
+    VkQueryPoolCreateInfo queryPoolCreateInfo;
+    queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolCreateInfo.pNext = nullptr;
+    queryPoolCreateInfo.flags = 0;
+
+    for (uint32_t i = 0; i < framesInFlight; ++i) {
+        VkResult result;
+        if (timestampsSupported) {
+            queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            queryPoolCreateInfo.queryCount = 2; // start and end of the frame
+            queryPoolCreateInfo.pipelineStatistics = 0;
+            result = vkCreateQueryPool(device, &queryPoolCreateInfo, nullptr, &timestampPools[i]);
+            ASSERT_VULKAN(result);
+        }
+
+        if (pipelineStatisticsEnabled) {
+            queryPoolCreateInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+            queryPoolCreateInfo.queryCount = 1;
+            queryPoolCreateInfo.pipelineStatistics = statisticFlags;
+            result = vkCreateQueryPool(device, &queryPoolCreateInfo, nullptr, &statisticsPools[i]);
+            ASSERT_VULKAN(result);
+        }
+    }
+}
+
+void GpuTimer::destroy() {
+    for (size_t i = 0; i < timestampPools.size(); ++i) {
+        vkDestroyQueryPool(device, timestampPools[i], nullptr);
+        vkDestroyQueryPool(device, statisticsPools[i], nullptr);
+    }
+    timestampPools.clear();
+    statisticsPools.clear();
+}
+
+void GpuTimer::begin(VkCommandBuffer commandBuffer, uint32_t frame) {
+    if (timestampsSupported) {
+        vkCmdResetQueryPool(commandBuffer, timestampPools[frame], 0, 2);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPools[frame], 0);
+    }
+    if (pipelineStatisticsEnabled) {
+        vkCmdResetQueryPool(commandBuffer, statisticsPools[frame], 0, 1);
+        vkCmdBeginQuery(commandBuffer, statisticsPools[frame], 0, 0);
+    }
+}
+
+void GpuTimer::end(VkCommandBuffer commandBuffer, uint32_t frame) {
+    if (pipelineStatisticsEnabled) {
+        vkCmdEndQuery(commandBuffer, statisticsPools[frame], 0);
+    }
+    if (timestampsSupported) {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPools[frame], 1);
+    }
+    pending[frame] = true;
+}
+
+void GpuTimer::collect(uint32_t frame) {
+    lastTicksValid = false;
+    if (!pending[frame]) {
+        return;
+    }
+    pending[frame] = false;
+
+    // No WAIT flag: the frame fence already signaled, so unavailable results are skipped instead of waited for
+    const VkQueryResultFlags flags = VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT;
+
+    if (timestampsSupported) {
+        uint64_t timestamps[4]; // value and availability of both queries
+        VkResult result = vkGetQueryPoolResults(device, timestampPools[frame], 0, 2, sizeof(timestamps), timestamps, 2 * sizeof(uint64_t), flags);
+        if ((result == VK_SUCCESS || result == VK_NOT_READY) && timestamps[1] != 0 && timestamps[3] != 0) {
+            uint64_t ticks = (timestamps[2] - timestamps[0]) & timestampMask;
+            double milliseconds = ticks * timestampPeriod / 1000000.0;
+
+            if (history.size() < historySize) {
+                history.push_back(milliseconds);
+            } else {
+                history[historyNext] = milliseconds;
+            }
+            historyNext = (historyNext + 1) % historySize;
+            lastTicks[0] = timestamps[0];
+            lastTicks[1] = timestamps[2];
+            lastTicksValid = true;
+        }
+    }
+
+    if (pipelineStatisticsEnabled) {
+        uint64_t statistics[5]; // four counters in bit order followed by the availability
+        VkResult result = vkGetQueryPoolResults(device, statisticsPools[frame], 0, 1, sizeof(statistics), statistics, sizeof(statistics), flags);
+        if ((result == VK_SUCCESS || result == VK_NOT_READY) && statistics[4] != 0) {
+            lastStatistics.vertexInvocations = statistics[0];
+            lastStatistics.clippingInvocations = statistics[1];
+            lastStatistics.clippingPrimitives = statistics[2];
+            lastStatistics.fragmentInvocations = statistics[3];
+        }
+    }
+}
+
+bool GpuTimer::getLastFrameTicks(uint64_t &begin, uint64_t &end) const {
+    begin = lastTicks[0];
+    end = lastTicks[1];
+    return lastTicksValid;
+}
+
+double GpuTimer::averageFrameTime() const {
+    if (history.empty()) {
+        return 0.0;
+    }
+    double sum = 0.0;
+    for (double milliseconds : history) {
+        sum += milliseconds;
+    }
+    return sum / history.size();
+}
+
+void GpuTimer::clearHistory() {
+    history.clear();
+    historyNext = 0;
+}
+
+void GpuTimer::printReport() {
+    if (!history.empty()) {
+        std::vector<double> sorted = history;
+        std::sort(sorted.begin(), sorted.end());
+
+        double sum = 0.0;
+        size_t buckets[amountOfBuckets] = {};
+        for (double milliseconds : sorted) {
+            sum += milliseconds;
+            size_t bucket = 0;
+            while (bucket < amountOfBuckets - 1 && milliseconds >= bucketLimits[bucket]) {
+                ++bucket;
+            }
+            ++buckets[bucket];
+        }
+
+        std::cout << "GPU frame time (last " << sorted.size() << " frames): avg " << sum / sorted.size() <<
+            " ms | p50 " << sorted[sorted.size() / 2] << " ms | p95 " << sorted[sorted.size() * 95 / 100] <<
+            " ms | max " << sorted.back() << " ms" << std::endl;
+
+        std::cout << "GPU frame time histogram:";
+        for (size_t i = 0; i < amountOfBuckets; ++i) {
+            if (i < amountOfBuckets - 1) {
+                std::cout << " <" << bucketLimits[i] << "ms:" << buckets[i];
+            } else {
+                std::cout << " >=" << bucketLimits[i - 1] << "ms:" << buckets[i];
+            }
+        }
+        std::cout << std::endl;
+    }
+
+    if (pipelineStatisticsEnabled) {
+        std::cout << "Pipeline statistics (last frame): vertex invocations " << lastStatistics.vertexInvocations <<
+            " | clipping invocations " << lastStatistics.clippingInvocations <<
+            " | clipping primitives " << lastStatistics.clippingPrimitives <<
+            " | fragment invocations " << lastStatistics.fragmentInvocations << std::endl;
+    }
+}
+
+VkQueryPipelineStatisticFlags GpuTimer::getStatisticFlags() const {
+    return pipelineStatisticsEnabled ? statisticFlags : 0;
+}
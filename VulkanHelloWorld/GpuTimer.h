@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// Measures the GPU time of every frame with one timestamp query pool per frame in flight and
+// optionally collects pipeline statistics. Results are read once the frame fence signaled,
+// so reading them never stalls.
+class GpuTimer {
+public:
+    void init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t queueFamilyIndex, uint32_t framesInFlight, bool pipelineStatistics);
+    void destroy();
+
+    // Both have to be recorded outside of a render pass
+    void begin(VkCommandBuffer commandBuffer, uint32_t frame);
+    void end(VkCommandBuffer commandBuffer, uint32_t frame);
+
+    // Call after the fence of the frame signaled
+    void collect(uint32_t frame);
+    void printReport();
+
+    // Average of the frame times in the history, 0 if nothing was measured yet
+    double averageFrameTime() const;
+    void clearHistory();
+
+    // Raw begin and end ticks of the frame collected last, false if it has none. Only meaningful to compare with
+    // timestamps of other queues of the same device.
+    bool getLastFrameTicks(uint64_t &begin, uint64_t &end) const;
+
+    // Of the last collected frame, 0 without pipeline statistics
+    uint64_t getFragmentInvocations() const { return lastStatistics.fragmentInvocations; }
+
+    // Statistics which are queried inside the render pass, secondary command buffers have to inherit them
+    VkQueryPipelineStatisticFlags getStatisticFlags() const;
+
+private:
+    struct PipelineStatistics {
+        uint64_t vertexInvocations;
+        uint64_t clippingInvocations;
+        uint64_t clippingPrimitives;
+        uint64_t fragmentInvocations;
+    };
+
+    static const size_t historySize = 240;
+
+    VkDevice device = VK_NULL_HANDLE;
+    bool timestampsSupported = false;
+    bool pipelineStatisticsEnabled = false;
+    double timestampPeriod = 1.0; // nanoseconds per tick
+    uint64_t timestampMask = ~0ull;
+
+    std::vector<VkQueryPool> timestampPools;
+    std::vector<VkQueryPool> statisticsPools;
+    std::vector<bool> pending;
+
+    // Rolling window of the last GPU frame times in milliseconds
+    std::vector<double> history;
+    size_t historyNext = 0;
+    uint64_t lastTicks[2] = {};
+    bool lastTicksValid = false;
+    PipelineStatistics lastStatistics = {};
+};
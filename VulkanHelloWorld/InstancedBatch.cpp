@@ -0,0 +1,237 @@
+#include "InstancedBatch.h"
+
+#include <cmath>
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace {
+    struct PackedTransform {
+        float offsetX;
+        float offsetY;
+        float cosScale;
+        float sinScale;
+    };
+
+    struct PackedInstance {
+        PackedTransform transform;
+        uint32_t color; // RGBA8
+    };
+
+    struct FullInstance {
+        glm::mat4 model;
+        glm::vec4 color;
+    };
+
+    // Same triangle as the hard coded one in shader.vert
+    const float trianglePositions[] = { 0.0f, -0.5f, 0.5f, 0.5f, -0.5f, 0.5f };
+    const uint16_t triangleIndices[] = { 0, 1, 2 };
+
+    uint32_t hash(uint32_t value) {
+        value ^= value >> 16;
+        value *= 0x7feb352d;
+        value ^= value >> 15;
+        value *= 0x846ca68b;
+        value ^= value >> 16;
+        return value;
+    }
+
+    VkVertexInputAttributeDescription attribute(uint32_t location, uint32_t binding, VkFormat format, uint32_t offset) {
+        VkVertexInputAttributeDescription description;
+        description.location = location;
+        description.binding = binding;
+        description.format = format;
+        description.offset = offset;
+        return description;
+    }
+
+    VkVertexInputBindingDescription binding(uint32_t index, uint32_t stride, VkVertexInputRate inputRate) {
+        VkVertexInputBindingDescription description;
+        description.binding = index;
+        description.stride = stride;
+        description.inputRate = inputRate;
+        return description;
+    }
+}
+
+void InstancedBatch::init(MemoryAllocator &memoryAllocator, StagingUploader &uploader, uint32_t instanceCount, InstanceLayout layout, InstanceFormat format, bool boundingSpheres) {
+    this->instanceCount = instanceCount;
+    this->drawCount = instanceCount;
+    this->layout = layout;
+    this->format = format;
+
+    createDeviceBuffer(memoryAllocator, sizeof(trianglePositions), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertexBuffer, vertexAllocation);
+    createDeviceBuffer(memoryAllocator, sizeof(triangleIndices), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indexBuffer, indexAllocation);
+    uploader.upload(vertexBuffer, 0, trianglePositions, sizeof(trianglePositions));
+    uploader.upload(indexBuffer, 0, triangleIndices, sizeof(triangleIndices));
+
+    // Square grid covering the whole viewport, one triangle per cell with a random rotation and color
+    uint32_t gridSize = (uint32_t)std::ceil(std::sqrt((double)instanceCount));
+    float cellSize = 2.0f / gridSize;
+
+    std::vector<PackedInstance> packedInstances;
+    std::vector<FullInstance> fullInstances;
+    std::vector<glm::vec4> spheres;
+    if (format == InstanceFormat::Packed) {
+        packedInstances.resize(instanceCount);
+    } else {
+        fullInstances.resize(instanceCount);
+    }
+    if (boundingSpheres) {
+        spheres.resize(instanceCount);
+    }
+    // The triangle corners are at most sqrt(0.5) away from its origin
+    float sphereRadius = std::sqrt(0.5f) * cellSize;
+
+    for (uint32_t i = 0; i < instanceCount; ++i) {
+        float offsetX = -1.0f + (i % gridSize + 0.5f) * cellSize;
+        float offsetY = -1.0f + (i / gridSize + 0.5f) * cellSize;
+        uint32_t random = hash(i);
+        float angle = (random & 0xffff) / 65535.0f * 6.2831853f;
+        uint32_t color = (random >> 8) | 0xff000000;
+
+        if (format == InstanceFormat::Packed) {
+            packedInstances[i].transform = PackedTransform{ offsetX, offsetY, std::cos(angle) * cellSize, std::sin(angle) * cellSize };
+            packedInstances[i].color = color;
+        } else {
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(offsetX, offsetY, 0.0f));
+            model = glm::rotate(model, angle, glm::vec3(0.0f, 0.0f, 1.0f));
+            fullInstances[i].model = glm::scale(model, glm::vec3(cellSize, cellSize, 1.0f));
+            fullInstances[i].color = glm::vec4(color & 0xff, (color >> 8) & 0xff, (color >> 16) & 0xff, 255) / 255.0f;
+        }
+        if (boundingSpheres) {
+            spheres[i] = glm::vec4(offsetX, offsetY, 0.0f, sphereRadius);
+        }
+    }
+
+    // Storage usage lets the culling pass copy the instances
+    VkBufferUsageFlags usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    if (layout == InstanceLayout::AoS) {
+        VkDeviceSize size = (VkDeviceSize)instanceCount * getInstanceSize();
+        createDeviceBuffer(memoryAllocator, size, usage, instanceBuffers[0], instanceAllocations[0]);
+        const void *data = format == InstanceFormat::Packed ? (const void*)packedInstances.data() : (const void*)fullInstances.data();
+        uploadTicket = uploader.upload(instanceBuffers[0], 0, data, size);
+    } else if (format == InstanceFormat::Packed) {
+        std::vector<PackedTransform> transforms(instanceCount);
+        std::vector<uint32_t> colors(instanceCount);
+        for (uint32_t i = 0; i < instanceCount; ++i) {
+            transforms[i] = packedInstances[i].transform;
+            colors[i] = packedInstances[i].color;
+        }
+        createDeviceBuffer(memoryAllocator, transforms.size() * sizeof(PackedTransform), usage, instanceBuffers[0], instanceAllocations[0]);
+        createDeviceBuffer(memoryAllocator, colors.size() * sizeof(uint32_t), usage, instanceBuffers[1], instanceAllocations[1]);
+        uploader.upload(instanceBuffers[0], 0, transforms.data(), transforms.size() * sizeof(PackedTransform));
+        uploadTicket = uploader.upload(instanceBuffers[1], 0, colors.data(), colors.size() * sizeof(uint32_t));
+    } else {
+        std::vector<glm::mat4> models(instanceCount);
+        std::vector<glm::vec4> colors(instanceCount);
+        for (uint32_t i = 0; i < instanceCount; ++i) {
+            models[i] = fullInstances[i].model;
+            colors[i] = fullInstances[i].color;
+        }
+        createDeviceBuffer(memoryAllocator, models.size() * sizeof(glm::mat4), usage, instanceBuffers[0], instanceAllocations[0]);
+        createDeviceBuffer(memoryAllocator, colors.size() * sizeof(glm::vec4), usage, instanceBuffers[1], instanceAllocations[1]);
+        uploader.upload(instanceBuffers[0], 0, models.data(), models.size() * sizeof(glm::mat4));
+        uploadTicket = uploader.upload(instanceBuffers[1], 0, colors.data(), colors.size() * sizeof(glm::vec4));
+    }
+    if (boundingSpheres) {
+        createDeviceBuffer(memoryAllocator, spheres.size() * sizeof(glm::vec4), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, sphereBuffer, sphereAllocation);
+        uploadTicket = uploader.upload(sphereBuffer, 0, spheres.data(), spheres.size() * sizeof(glm::vec4));
+    }
+    uploader.flush();
+}
+
+void InstancedBatch::destroy(MemoryAllocator &memoryAllocator) {
+    memoryAllocator.destroyBuffer(vertexBuffer, vertexAllocation);
+    memoryAllocator.destroyBuffer(indexBuffer, indexAllocation);
+    for (uint32_t i = 0; i < 2; ++i) {
+        if (instanceBuffers[i] != VK_NULL_HANDLE) {
+            memoryAllocator.destroyBuffer(instanceBuffers[i], instanceAllocations[i]);
+        }
+    }
+    if (sphereBuffer != VK_NULL_HANDLE) {
+        memoryAllocator.destroyBuffer(sphereBuffer, sphereAllocation);
+    }
+}
+
+void InstancedBatch::createDeviceBuffer(MemoryAllocator &memoryAllocator, VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer &buffer, Allocation &allocation) {
+    VkBufferCreateInfo bufferCreateInfo;
+    bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferCreateInfo.pNext = nullptr;
+    bufferCreateInfo.flags = 0;
+    bufferCreateInfo.size = size;
+    bufferCreateInfo.usage = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    bufferCreateInfo.queueFamilyIndexCount = 0;
+    bufferCreateInfo.pQueueFamilyIndices = nullptr;
+
+    memoryAllocator.createBuffer(bufferCreateInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, allocation);
+}
+
+const char *InstancedBatch::getVertexShaderFile() const {
+    return format == InstanceFormat::Packed ? "instanced_packed_vert.spv" : "instanced_full_vert.spv";
+}
+
+uint32_t InstancedBatch::getInstanceSize() const {
+    return format == InstanceFormat::Packed ? sizeof(PackedInstance) : sizeof(FullInstance);
+}
+
+uint32_t InstancedBatch::getStreamStride(uint32_t stream) const {
+    if (layout == InstanceLayout::AoS) {
+        return getInstanceSize();
+    }
+    if (format == InstanceFormat::Packed) {
+        return stream == 0 ? sizeof(PackedTransform) : sizeof(uint32_t);
+    }
+    return stream == 0 ? sizeof(glm::mat4) : sizeof(glm::vec4);
+}
+
+void InstancedBatch::getVertexInput(std::vector<VkVertexInputBindingDescription> &bindings, std::vector<VkVertexInputAttributeDescription> &attributes) const {
+    bindings.clear();
+    attributes.clear();
+
+    bindings.push_back(binding(0, 2 * sizeof(float), VK_VERTEX_INPUT_RATE_VERTEX));
+    attributes.push_back(attribute(0, 0, VK_FORMAT_R32G32_SFLOAT, 0));
+
+    // SoA reads the color from binding 2, AoS from behind the transform in binding 1
+    bool soa = layout == InstanceLayout::SoA;
+    uint32_t colorBinding = soa ? 2 : 1;
+
+    if (format == InstanceFormat::Packed) {
+        bindings.push_back(binding(1, soa ? sizeof(PackedTransform) : sizeof(PackedInstance), VK_VERTEX_INPUT_RATE_INSTANCE));
+        attributes.push_back(attribute(1, 1, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(PackedInstance, transform)));
+        attributes.push_back(attribute(2, colorBinding, VK_FORMAT_R8G8B8A8_UNORM, soa ? 0 : offsetof(PackedInstance, color)));
+        if (soa) {
+            bindings.push_back(binding(2, sizeof(uint32_t), VK_VERTEX_INPUT_RATE_INSTANCE));
+        }
+    } else {
+        // A mat4 input takes four locations, one per column
+        bindings.push_back(binding(1, soa ? sizeof(glm::mat4) : sizeof(FullInstance), VK_VERTEX_INPUT_RATE_INSTANCE));
+        for (uint32_t column = 0; column < 4; ++column) {
+            attributes.push_back(attribute(1 + column, 1, VK_FORMAT_R32G32B32A32_SFLOAT, column * sizeof(glm::vec4)));
+        }
+        attributes.push_back(attribute(5, colorBinding, VK_FORMAT_R32G32B32A32_SFLOAT, soa ? 0 : offsetof(FullInstance, color)));
+        if (soa) {
+            bindings.push_back(binding(2, sizeof(glm::vec4), VK_VERTEX_INPUT_RATE_INSTANCE));
+        }
+    }
+}
+
+void InstancedBatch::record(VkCommandBuffer commandBuffer) const {
+    bind(commandBuffer);
+    drawRange(commandBuffer, 0, drawCount);
+}
+
+void InstancedBatch::bind(VkCommandBuffer commandBuffer, const VkBuffer *otherInstanceBuffers) const {
+    const VkBuffer *streams = otherInstanceBuffers != nullptr ? otherInstanceBuffers : instanceBuffers;
+    VkBuffer vertexBuffers[] = { vertexBuffer, streams[0], streams[1] };
+    VkDeviceSize offsets[] = { 0, 0, 0 };
+    uint32_t amountOfBindings = layout == InstanceLayout::SoA ? 3 : 2;
+
+    vkCmdBindVertexBuffers(commandBuffer, 0, amountOfBindings, vertexBuffers, offsets);
+    vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT16);
+}
+
+void InstancedBatch::drawRange(VkCommandBuffer commandBuffer, uint32_t firstInstance, uint32_t count) const {
+    vkCmdDrawIndexed(commandBuffer, 3, count, 0, 0, firstInstance);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "MemoryAllocator.h"
+#include "StagingUploader.h"
+
+// AoS interleaves all per instance attributes in one vertex buffer binding,
+// SoA gives every attribute its own binding
+enum class InstanceLayout {
+    AoS,
+    SoA
+};
+
+// Packed: offset and scaled rotation in one vec4 plus an RGBA8 color (20 bytes per instance)
+// Full: glm::mat4 model matrix plus a float color (80 bytes per instance)
+enum class InstanceFormat {
+    Packed,
+    Full
+};
+
+// A grid of triangle instances drawn with a single vkCmdDrawIndexed. Vertex, index and instance
+// data live in device local buffers which are filled through the staging uploader once.
+// Optionally a storage buffer with one bounding sphere per instance is created for GPU culling.
+class InstancedBatch {
+public:
+    void init(MemoryAllocator &memoryAllocator, StagingUploader &uploader, uint32_t instanceCount, InstanceLayout layout, InstanceFormat format, bool boundingSpheres);
+    void destroy(MemoryAllocator &memoryAllocator);
+
+    const char *getVertexShaderFile() const;
+    const char *getFragmentShaderFile() const { return "instanced_frag.spv"; }
+    void getVertexInput(std::vector<VkVertexInputBindingDescription> &bindings, std::vector<VkVertexInputAttributeDescription> &attributes) const;
+
+    // Draws the first drawCount instances, has to be recorded inside the render pass
+    void record(VkCommandBuffer commandBuffer) const;
+    // Split version of record() for drawing the instances in several ranges. Other buffers with
+    // the same layout can be bound in place of the instance buffers, one per stream.
+    void bind(VkCommandBuffer commandBuffer, const VkBuffer *otherInstanceBuffers = nullptr) const;
+    void drawRange(VkCommandBuffer commandBuffer, uint32_t firstInstance, uint32_t count) const;
+    void setDrawCount(uint32_t count) { drawCount = count < instanceCount ? count : instanceCount; }
+    uint32_t getDrawCount() const { return drawCount; }
+
+    uint32_t getInstanceCount() const { return instanceCount; }
+    uint32_t getInstanceSize() const;
+
+    // AoS has one instance stream, SoA two (transforms and colors)
+    uint32_t getStreamCount() const { return layout == InstanceLayout::SoA ? 2 : 1; }
+    VkBuffer getInstanceBuffer(uint32_t stream) const { return instanceBuffers[stream]; }
+    uint32_t getStreamStride(uint32_t stream) const;
+    // vec4 per instance, xyz: center, w: radius
+    VkBuffer getSphereBuffer() const { return sphereBuffer; }
+    uint64_t getUploadTicket() const { return uploadTicket; }
+
+private:
+    void createDeviceBuffer(MemoryAllocator &memoryAllocator, VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer &buffer, Allocation &allocation);
+
+    uint32_t instanceCount = 0;
+    uint32_t drawCount = 0;
+    InstanceLayout layout = InstanceLayout::AoS;
+    InstanceFormat format = InstanceFormat::Packed;
+
+    VkBuffer vertexBuffer = VK_NULL_HANDLE;
+    Allocation vertexAllocation;
+    VkBuffer indexBuffer = VK_NULL_HANDLE;
+    Allocation indexAllocation;
+    // One buffer for AoS, transforms and colors for SoA
+    VkBuffer instanceBuffers[2] = { VK_NULL_HANDLE, VK_NULL_HANDLE };
+    Allocation instanceAllocations[2];
+    VkBuffer sphereBuffer = VK_NULL_HANDLE;
+    Allocation sphereAllocation;
+    uint64_t uploadTicket = 0;
+};
@@ -0,0 +1,125 @@
+#include "JobScheduler.h"
+
+#include "Profiler.h"
+
+void JobScheduler::start(uint32_t threadCount) {
+    stopping = false;
+    generation = 0;
+
+    // The calling thread is the last worker
+    for (uint32_t i = 0; i <= threadCount; ++i) {
+        queues.push_back(std::unique_ptr<WorkQueue>(new WorkQueue()));
+    }
+    for (uint32_t i = 0; i < threadCount; ++i) {
+        threadNames.push_back("Worker " + std::to_string(i));
+    }
+    for (uint32_t i = 0; i < threadCount; ++i) {
+        threads.push_back(std::thread(&JobScheduler::workerLoop, this, i));
+    }
+}
+
+void JobScheduler::stop() {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    threads.clear();
+    queues.clear();
+    // Names stay alive, the profiler keeps pointers to them until the trace was written
+}
+
+void JobScheduler::run(uint32_t amountOfJobs, const Job &job) {
+    if (amountOfJobs == 0) {
+        return;
+    }
+
+    // Both are published to the workers by the queue mutexes below
+    currentJob = &job;
+    remaining.store(amountOfJobs, std::memory_order_relaxed);
+
+    uint32_t workers = getWorkerCount();
+    for (uint32_t worker = 0; worker < workers; ++worker) {
+        uint32_t begin = (uint32_t)((uint64_t)amountOfJobs * worker / workers);
+        uint32_t end = (uint32_t)((uint64_t)amountOfJobs * (worker + 1) / workers);
+
+        std::lock_guard<std::mutex> lock(queues[worker]->mutex);
+        for (uint32_t index = begin; index < end; ++index) {
+            queues[worker]->indices.push_back(index);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        ++generation;
+    }
+    wake.notify_all();
+
+    uint32_t self = workers - 1;
+    uint32_t index;
+    while (takeJob(self, index)) {
+        execute(self, index);
+    }
+
+    // Jobs taken by other workers may still be running
+    while (remaining.load(std::memory_order_acquire) != 0) {
+        std::this_thread::yield();
+    }
+    currentJob = nullptr;
+}
+
+void JobScheduler::workerLoop(uint32_t worker) {
+    Profiler::setThreadName(threadNames[worker].c_str());
+
+    uint64_t seenGeneration = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            wake.wait(lock, [&]() { return stopping || generation != seenGeneration; });
+            if (stopping) {
+                return;
+            }
+            seenGeneration = generation;
+        }
+
+        uint32_t index;
+        while (takeJob(worker, index)) {
+            execute(worker, index);
+        }
+    }
+}
+
+bool JobScheduler::takeJob(uint32_t worker, uint32_t &index) {
+    {
+        WorkQueue &own = *queues[worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.indices.empty()) {
+            index = own.indices.back();
+            own.indices.pop_back();
+            return true;
+        }
+    }
+
+    // Steal from the opposite end so owner and thief rarely want the same job
+    uint32_t workers = getWorkerCount();
+    for (uint32_t i = 1; i < workers; ++i) {
+        WorkQueue &victim = *queues[(worker + i) % workers];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.indices.empty()) {
+            index = victim.indices.front();
+            victim.indices.pop_front();
+            steals.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobScheduler::execute(uint32_t worker, uint32_t index) {
+    (*currentJob)(worker, index);
+    remaining.fetch_sub(1, std::memory_order_release);
+}
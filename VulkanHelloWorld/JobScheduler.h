@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Runs batches of indexed jobs on a fixed set of worker threads. Every worker owns a deque,
+// run() hands each worker a contiguous block of job indices, a worker takes jobs from the back
+// of its own deque and steals from the front of the others once it ran dry. The calling thread
+// works as the last worker until the batch is done, so a scheduler with 0 threads runs inline.
+class JobScheduler {
+public:
+    // worker is in [0, getWorkerCount()) and unique per thread while a batch runs
+    using Job = std::function<void(uint32_t worker, uint32_t index)>;
+
+    void start(uint32_t threadCount);
+    void stop();
+
+    // Threads plus the calling thread
+    uint32_t getWorkerCount() const { return (uint32_t)queues.size(); }
+    uint64_t getSteals() const { return steals.load(std::memory_order_relaxed); }
+
+    // Runs job for every index in [0, amountOfJobs) and returns once all of them finished.
+    // Only one thread may call run() at a time.
+    void run(uint32_t amountOfJobs, const Job &job);
+
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<uint32_t> indices;
+    };
+
+    void workerLoop(uint32_t worker);
+    bool takeJob(uint32_t worker, uint32_t &index);
+    void execute(uint32_t worker, uint32_t index);
+
+    std::vector<std::thread> threads;
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::vector<std::string> threadNames;
+
+    const Job *currentJob = nullptr;
+    std::atomic<uint32_t> remaining{0};
+    std::atomic<uint64_t> steals{0};
+
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    uint64_t generation = 0;
+    bool stopping = false;
+};
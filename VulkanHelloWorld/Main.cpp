@@ -1,32 +1,280 @@
 #include <iostream>
 #include <vector>
-#include <fstream>
+#include <string>
+#include <limits>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <stdexcept>
+#include <atomic>
+#include <thread>
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
-#define ASSERT_VULKAN(val) if(val != VK_SUCCESS) { __debugbreak();}
+#include <glm/gtc/matrix_transform.hpp>
+#include "VulkanUtils.h"
+#include "PipelineCache.h"
+#include "Profiler.h"
+#include "GpuTimer.h"
+#include "DeviceSelection.h"
+#include "StagingUploader.h"
+#include "MemoryAllocator.h"
+#include "AllocatorBench.h"
+#include "TransformBench.h"
+#include "MeshAsset.h"
+#include "MeshConverter.h"
+#include "MeshBench.h"
+#include "InstancedBatch.h"
+#include "JobScheduler.h"
+#include "ParallelRecorder.h"
+#include "GpuCulling.h"
+#include "SwapchainSupport.h"
+#include "ShaderLoader.h"
+#include "PipelineVariants.h"
+#include "PipelineCompiler.h"
+#include "RenderTargetCache.h"
+#include "RenderGraph.h"
+#include "RenderGraphExecutor.h"
+#include "RenderGraphCheck.h"
+#include "BindlessTable.h"
+#include "TextureStreamer.h"
+#include "ParticleSystem.h"
+#include "FrameCapture.h"
+#include "SpscQueue.h"
+#include "FrameStages.h"
+
 #define SUPPORTS_FEATURE(val) (val == 1) ? "true" : "false";
 
 VkInstance instance;
 VkSurfaceKHR surface;
+VkPhysicalDevice physicalDevice;
 VkDevice device;
-VkSwapchainKHR swapchain;
+VkSwapchainKHR swapchain = VK_NULL_HANDLE;
 VkImageView* imageViews;
-VkFramebuffer* framebuffers;
 VkShaderModule shaderModuleVert, shaderModuleFrag;
 VkPipelineLayout pipelineLayout;
-VkRenderPass renderPass;
+VkRenderPass renderPass; // owned by the renderPassCache
 VkPipeline pipeline;
+RenderPassCache renderPassCache;
+FramebufferCache framebufferCache;
+const uint32_t framebufferCacheCapacity = 16;
+PipelineCache pipelineCache;
+PipelineVariants pipelineVariants;
+uint64_t pipelineKey = 0; // variant of the pipeline in use
+PipelineCompiler pipelineCompiler;
+GpuTimer gpuTimer;
+StagingUploader uploader;
+MemoryAllocator memoryAllocator;
+InstancedBatch instancedBatch;
+JobScheduler jobScheduler;
+ParallelRecorder parallelRecorder;
+GpuCulling gpuCulling;
 VkCommandPool commandPool;
 VkCommandBuffer* commandBuffers;
-VkSemaphore semaphoreImageAvailable, semaphoreRenderingDone;
-VkQueue queue;
+VkSemaphore* semaphoresImageAvailable;
+VkSemaphore* semaphoresRenderingDone;
+VkFence* fencesInFlight;
+VkFence* imagesInFlight; // fence of the frame which is currently rendering into the swapchain image
+QueueFamilies queueFamilies;
+VkQueue queue; // graphics queue
+VkQueue presentQueue;
 uint32_t amountOfImagesInSwapChain = 0;
 GLFWwindow* window;
 
+// Headless mode renders into these device local images instead of a swapchain (--headless)
+bool headless = false;
+const uint32_t amountOfOffscreenImages = 3;
+VkImage* offscreenImages;
+Allocation* offscreenImagesAllocations;
+
+// Stop after this amount of frames, 0 runs until the window is closed (--frames)
+uint32_t maxFrames = 0;
+std::string profileFile; // write a chrome trace of all profiler zones (--profile)
+bool pipelineStatistics = false; // collect pipeline statistics queries every frame (--pipeline-statistics)
+std::string deviceOverride; // index or part of the name of the device to use (--device or VULKAN_DEVICE)
+const uint32_t defaultHeadlessFrames = 1000;
+uint32_t nextOffscreenImage = 0;
+
 const uint32_t WIDTH = 400;
 const uint32_t HEIGHT = 300;
-const VkFormat usedFormat = VK_FORMAT_B8G8R8A8_UNORM;
+VkFormat usedFormat = VK_FORMAT_B8G8R8A8_UNORM; // chosen from the surface formats, the offscreen images keep this one
+VkExtent2D swapchainExtent = { WIDTH, HEIGHT }; // follows the window size
+const std::string pipelineCacheFile = "pipeline_cache.bin";
+ShaderSource shaderSource = ShaderSource::Embedded; // (--shader-source)
+// Specialization constants of instanced.frag (--shading-iterations, --grayscale)
+uint32_t shadingIterations = 0;
+bool grayscale = false;
+bool prebuildVariants = false; // create all instanced.frag permutations at startup (--prebuild-variants)
+
+// Compile the pipeline variants on this many background threads and draw with the fallback until they are ready (--pipeline-threads)
+uint32_t pipelineThreads = 0;
+uint64_t fallbackPipelineKey = 0; // instanced.frag without specialization, created synchronously
+bool usingFallbackPipeline = false;
+uint64_t fallbackFrames = 0;
+std::chrono::high_resolution_clock::time_point pipelineRequested;
+std::chrono::high_resolution_clock::time_point programStart; // for the time to first frame
+const VkDeviceSize stagingRingSize = 32 * 1024 * 1024;
+const VkDeviceSize memoryBlockSize = 64 * 1024 * 1024;
+// Draw a grid of this many triangle instances with one instanced call instead of the single triangle (--instances)
+uint32_t instanceCount = 0;
+InstanceLayout instanceLayout = InstanceLayout::AoS; // (--instance-layout)
+InstanceFormat instanceFormat = InstanceFormat::Packed; // (--instance-format)
+bool instanceSweep = false; // draw 1, 10, 100, ... instances up to instanceCount and print the GPU time of each (--instance-sweep)
+const uint32_t sweepFramesPerStep = 300;
+std::vector<uint32_t> sweepCounts;
+uint32_t sweepStep = 0;
+bool allocatorBench = false; // run the CPU only allocator checks and timings and exit (--allocator-bench)
+bool renderGraphCheck = false; // compile a synthetic frame graph on the CPU, check the result and exit (--render-graph-check)
+bool transformBench = false; // compare the scalar, SIMD and multithreaded transform kernels and exit (--transform-bench)
+std::string meshBenchSource; // compare the mesh file variants of this source and exit (--mesh-bench)
+std::string convertMeshInput; // .obj file or torus-knot (--convert-mesh <input> <output>)
+std::string convertMeshOutput;
+MeshVertexFormat convertMeshFormat = MeshVertexFormat::Quantized; // (--mesh-format)
+
+// Mesh assets
+std::string meshFile; // draw this mesh file instead of the triangle (--mesh)
+MeshAsset meshAsset;
+
+// Record the render pass into secondary command buffers on this many threads, 0 records inline (--record-threads)
+uint32_t recordThreads = 0;
+uint32_t drawCalls = 1; // split the scene into this many draw calls (--draws)
+uint32_t viewportCount = 1; // draw the scene into a grid of this many viewports (--viewports)
+const uint32_t jobsPerWorker = 4; // more jobs than workers so idle workers have something to steal
+std::vector<VkCommandBuffer> secondaryCommandBuffers;
+
+// Stack this many copies of the scene at different depths. They are generated back to front, the worst order for
+// depth testing, and shifted by a few pixels so every layer stays partly visible (--layers)
+uint32_t depthLayers = 1;
+const float layerShift = 3.0f;
+bool sortDraws = false; // sort the draw calls front to back by depth before recording (--sort-draws)
+// One draw call of the scene, an instance range of one layer
+struct SceneDraw {
+    uint32_t range; // of the drawCalls instance ranges
+    uint32_t layer;
+    float depth;
+};
+std::vector<SceneDraw> sceneDraws; // in recording order
+
+// Off draws without depth buffer in submission order. Test tests and writes depth with LESS. PrePass first writes the
+// depth of all draws with a depth-only pipeline and then shades with an EQUAL test, so only visible fragments are shaded (--depth)
+enum class DepthMode { Off, Test, PrePass };
+DepthMode depthMode = DepthMode::Off;
+VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+VkPipeline depthPipeline = VK_NULL_HANDLE; // depth-only pipeline of the pre-pass
+uint64_t depthPipelineKey = 0;
+
+// Cull the instances in a compute pass and draw the visible ones with one indirect draw (--gpu-culling)
+bool gpuCullingEnabled = false;
+float cullRegion = 1.0f; // only keep instances in this centered fraction of the screen, to see the culling at work (--cull-region)
+bool drawIndirectCount = false; // VK_KHR_draw_indirect_count is enabled
+
+// Draw with this many materials from the bindless table, every draw call picks one with a push constant (--materials)
+uint32_t materialCount = 0;
+BindlessTable bindlessTable;
+// Lowered to the update-after-bind limits of the device
+uint32_t bindlessBufferCapacity = 16384;
+uint32_t bindlessImageCapacity = 16384;
+bool physicalDeviceProperties2 = false; // VK_KHR_get_physical_device_properties2 is enabled on the instance
+std::vector<VkBuffer> materialBuffers;
+std::vector<Allocation> materialAllocations;
+std::vector<uint32_t> materialSlots; // buffer slot of every material in the bindless table
+
+// Draw a grid of quads with one streamed texture each from the bindless table. The view zooms in and out, so the
+// screen size and with it the wanted mip level of every texture keeps changing (--textures, --texture-size,
+// --texture-budget, --decode-threads)
+uint32_t textureCount = 0;
+uint32_t textureSize = 1024; // rounded down to a power of two
+uint32_t textureBudgetMiB = 256;
+uint32_t decodeThreads = 2;
+const VkDeviceSize textureUploadPerFrame = 4 * 1024 * 1024; // bytes copied into the textures per frame at most
+const uint32_t zoomPeriod = 600; // frames from the whole grid to the closest view and back
+TextureStreamer textureStreamer;
+struct TexturedQuad {
+    QuadConstants constants; // the texture slot is filled in when recording
+    bool visible;
+};
+std::vector<TexturedQuad> texturedQuads; // placement of every quad this frame
+
+// Simulate particles in a compute shader and draw them as points. With a separate compute queue family the step runs
+// on it while the graphics queue renders the previous result (--particles, --particle-queue)
+uint32_t particleCount = 0;
+bool particlesOnComputeQueue = true; // false records the step into the graphics command buffer
+const float particleTimeStep = 1.0f / 60.0f; // fixed, so the motion does not depend on the frame rate
+ParticleSystem particleSystem;
+
+// Streams synthetic geometry into a device local buffer while rendering (--stream-upload)
+uint32_t streamUploadMiB = 0;
+const VkDeviceSize streamBudgetPerFrame = 8 * 1024 * 1024; // bytes copied into the staging ring per frame at most
+VkBuffer streamBuffer = VK_NULL_HANDLE;
+Allocation streamBufferAllocation;
+std::vector<char> streamSource;
+VkDeviceSize streamQueued = 0;
+uint64_t streamTicket = 0;
+bool streamDone = false;
+std::chrono::high_resolution_clock::time_point streamStart;
+
+// The policy picks the present mode unless a mode is requested, P cycles through the supported modes at runtime (--present-policy, --present-mode)
+PresentPolicy presentPolicy = PresentPolicy::PowerSaving;
+VkPresentModeKHR requestedPresentMode = VK_PRESENT_MODE_MAX_ENUM_KHR;
+VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+bool swapchainDirty = false; // window resized or present mode switched, recreate before the next acquire
+PresentStats presentStats;
+uint64_t frameNumber = 0; // frames submitted so far
+
+// Record and submit on a render thread while the main thread handles events. They exchange frame packets through
+// a lock-free queue with room for frameQueueDepth packets (--render-thread, --frame-queue-depth)
+bool renderThreadEnabled = false;
+uint32_t frameQueueDepth = 2;
+SpscQueue<FramePacket> frameQueue;
+std::atomic<bool> renderFinished(false); // the render side reached --frames or the end of the instance sweep
+FrameStageStats frameStageStats;
+uint64_t packetSequence = 0;
+uint32_t renderedFrames = 0;
+std::chrono::high_resolution_clock::time_point sweepStepStart;
+// Main thread only, collected by the event callbacks until the next packet
+bool pendingResize = false;
+bool pendingPresentModeCycle = false;
+VkExtent2D windowExtent = { WIDTH, HEIGHT }; // framebuffer size of the last packet, used by the render side
+
+// Copy every captureInterval-th frame into readback buffers and write it into this directory on a writer thread
+// (--capture, --capture-every, --capture-format)
+std::string captureDirectory;
+uint32_t captureInterval = 1;
+CaptureFormat captureFormat = CaptureFormat::Png;
+const uint32_t captureQueueDepth = 4; // readback buffers waiting for the writer before frames are dropped
+FrameCapture frameCapture;
+std::vector<VkImage> swapchainImages; // the offscreen images in headless mode
+
+// Frame graph: the scene pass renders into the swapchain image with a transient depth buffer, the capture pass copies
+// the image on capture frames. Both variants are compiled up front and again for every new swapchain.
+RenderGraph frameGraphs[2]; // without and with the capture pass
+CompiledRenderGraph compiledFrameGraphs[2];
+RenderGraphExecutor renderGraphExecutor;
+uint32_t swapchainResource = 0;
+bool dumpRenderGraph = false; // print the compiled frame graphs whenever they are compiled (--dump-render-graph)
+
+// Swapchain resources replaced by recreateSwapchain(). Frames in flight may still render with them,
+// so they are destroyed once those frames are done instead of waiting for the whole device.
+struct RetiredSwapchain {
+    VkSwapchainKHR swapchain;
+    VkImageView* imageViews;
+    uint32_t amountOfImages;
+    std::vector<VkPipeline> pipelines; // empty if the format stayed the same
+    uint64_t retireFrame; // frameNumber when it was replaced
+};
+std::vector<RetiredSwapchain> retiredSwapchains;
+
+// Amount of frames the CPU is allowed to record ahead of the GPU (--frames-in-flight)
+uint32_t framesInFlight = 2;
+uint32_t currentFrame = 0;
+
+// CPU time spent waiting for fences, reported once per second
+double frameWaitTimeSum = 0.0;
+double frameWaitTimeMax = 0.0;
+double recordTimeSum = 0.0;
+uint32_t framesSinceReport = 0;
+std::chrono::high_resolution_clock::time_point lastReport;
 
 
 
@@ -45,6 +293,7 @@ void printStats(const VkPhysicalDevice & device) {
     
     // This value is needed for the queue priorites in the deviceQueueCreateInfo
     std::cout << "DiscreteQueueProperties: " << properties.limits.discreteQueuePriorities << std::endl;
+    std::cout << "Timestamp period:        " << properties.limits.timestampPeriod << " ns" << std::endl;
 
 
     // Load features which are supported by the device
@@ -83,6 +332,13 @@ void printStats(const VkPhysicalDevice & device) {
         std::cout << "Image transfer granularity:  " << width << ", " << height << ", " << depth << std::endl;
     }
 
+    // Without a window there is no surface to query
+    if (surface == VK_NULL_HANDLE) {
+        std::cout << std::endl;
+        delete[] familyProperties;
+        return;
+    }
+
     VkSurfaceCapabilitiesKHR surfaceCapabilities;
     vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &surfaceCapabilities);
     std::cout << std::endl << "Surface capabilities:" << std::endl;
@@ -126,47 +382,189 @@ void printStats(const VkPhysicalDevice & device) {
     delete[] presentModes;
 };
 
-std::vector<char> readFile(const std::string &filename)
+void startGLFW()
 {
-    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    glfwInit();
+    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+    glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
+
+    window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan Hello World", nullptr, nullptr);
 
-    if (file) {
-        size_t fileSize = (size_t)file.tellg();
+    int width = 0;
+    int height = 0;
+    glfwGetFramebufferSize(window, &width, &height);
+    windowExtent = VkExtent2D{ (uint32_t)width, (uint32_t)height };
+
+    // Not every platform reports VK_ERROR_OUT_OF_DATE_KHR after a resize, so the callback marks the swapchain as well.
+    // Both callbacks run on the main thread, the next frame packet carries what they saw to the render side.
+    glfwSetFramebufferSizeCallback(window, [](GLFWwindow*, int, int) {
+        pendingResize = true;
+    });
+    glfwSetKeyCallback(window, [](GLFWwindow*, int key, int, int action, int) {
+        if (key == GLFW_KEY_P && action == GLFW_PRESS && !headless) {
+            pendingPresentModeCycle = true;
+        }
+    });
+}
 
-        std::vector<char> fileBuffer(fileSize);
-        file.seekg(0);
-        file.read(fileBuffer.data(), fileSize);
-        file.close();        
-        return fileBuffer;
-    } else {
-        throw std::runtime_error("Failed to open file '" + filename + "' !");
+// Destination of the upload stream, only the copies touch it since the shaders have no vertex input yet
+void createStreamBuffer() {
+    VkBufferCreateInfo bufferCreateInfo;
+    bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferCreateInfo.pNext = nullptr;
+    bufferCreateInfo.flags = 0;
+    bufferCreateInfo.size = (VkDeviceSize)streamUploadMiB * 1024 * 1024;
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+    bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE; // ownership is transferred by the uploader
+    bufferCreateInfo.queueFamilyIndexCount = 0;
+    bufferCreateInfo.pQueueFamilyIndices = nullptr;
+
+    memoryAllocator.createBuffer(bufferCreateInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, streamBuffer, streamBufferAllocation);
+
+    // 4 MiB of vertex positions which are uploaded over and over until the buffer is full
+    std::vector<float> positions(1024 * 1024);
+    for (size_t i = 0; i < positions.size(); ++i) {
+        positions[i] = (float)((i * 2654435761u) % 2001) / 1000.0f - 1.0f;
     }
+    streamSource.resize(positions.size() * sizeof(float));
+    std::memcpy(streamSource.data(), positions.data(), streamSource.size());
 }
 
-void startGLFW()
-{
-    glfwInit();
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+// Every material is a small host visible buffer with a tint color, registered in the bindless table
+void createMaterials() {
+    PROFILE_ZONE("createMaterials");
+    auto start = std::chrono::high_resolution_clock::now();
+
+    bindlessTable.init(device, bindlessBufferCapacity, bindlessImageCapacity);
+
+    VkBufferCreateInfo bufferCreateInfo;
+    bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferCreateInfo.pNext = nullptr;
+    bufferCreateInfo.flags = 0;
+    bufferCreateInfo.size = sizeof(glm::vec4);
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    bufferCreateInfo.queueFamilyIndexCount = 0;
+    bufferCreateInfo.pQueueFamilyIndices = nullptr;
+
+    materialBuffers.resize(materialCount);
+    materialAllocations.resize(materialCount);
+    for (uint32_t i = 0; i < materialCount; ++i) {
+        memoryAllocator.createBuffer(bufferCreateInfo, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            materialBuffers[i], materialAllocations[i]);
+
+        // Tints around the hue circle, so neighboring draw calls differ
+        float hue = 6.2831853f * (float)i / (float)materialCount;
+        glm::vec4 tint(0.6f + 0.4f * std::cos(hue), 0.6f + 0.4f * std::cos(hue - 2.0943951f), 0.6f + 0.4f * std::cos(hue + 2.0943951f), 1.0f);
+        std::memcpy(materialAllocations[i].mapped, &tint, sizeof(tint));
+
+        uint32_t slot = bindlessTable.addBuffer(materialBuffers[i], 0, sizeof(glm::vec4));
+        if (slot == SlotAllocator::invalidSlot) {
+            throw std::runtime_error("Bindless table is full");
+        }
+        materialSlots.push_back(slot);
+    }
 
-    window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan Hello World", nullptr, nullptr);
+    std::cout << "Materials: " << materialCount << " buffers in the bindless table | " <<
+        std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() << " ms" << std::endl;
 }
 
-void createShaderModule(const std::vector<char> &code, VkShaderModule *shaderModule) {
+void destroyMaterials() {
+    bindlessTable.printStats();
+    for (uint32_t i = 0; i < materialCount; ++i) {
+        bindlessTable.removeBuffer(materialSlots[i]);
+        memoryAllocator.destroyBuffer(materialBuffers[i], materialAllocations[i]);
+    }
+    bindlessTable.destroy();
+}
 
-    VkShaderModuleCreateInfo shaderCreateInfo;
-    shaderCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    shaderCreateInfo.pNext = nullptr;
-    shaderCreateInfo.flags = 0;
-    shaderCreateInfo.codeSize = code.size();
-    shaderCreateInfo.pCode = (uint32_t*)(code.data());
+// The quads sample their textures from the bindless table, the uploads are copied out of the frame ring
+void startTextureStreaming() {
+    bindlessTable.init(device, bindlessBufferCapacity, bindlessImageCapacity);
+    // One frame more than in flight, so the alignment padding never makes a full frame of uploads fail
+    memoryAllocator.createFrameRing(textureUploadPerFrame * (framesInFlight + 1), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, framesInFlight);
+    textureStreamer.start(device, memoryAllocator, bindlessTable, textureCount, textureSize, (VkDeviceSize)textureBudgetMiB * 1024 * 1024,
+        textureUploadPerFrame, decodeThreads, framesInFlight);
+    texturedQuads.resize(textureCount);
+}
 
-    VkResult result= vkCreateShaderModule(device, &shaderCreateInfo, nullptr, shaderModule);
-    ASSERT_VULKAN(result);
+void stopTextureStreaming() {
+    textureStreamer.stop();
+    bindlessTable.printStats();
+    bindlessTable.destroy();
 }
 
-void startVulkan()
+// A square grid of quads over the screen, seen through a zoom between 1x and 16x towards a wandering point, so
+// textures keep growing and shrinking on screen and entering and leaving it
+void updateTexturedQuads() {
+    uint32_t columns = (uint32_t)std::ceil(std::sqrt((double)textureCount));
+    float cell = 2.0f / columns;
+    double phase = 6.283185307179586 * (double)frameNumber / zoomPeriod;
+    float zoom = (float)std::pow(2.0, 2.0 - 2.0 * std::cos(phase));
+    glm::vec2 focus = glm::vec2(0.7f * (float)std::sin(phase * 0.37), 0.7f * (float)std::cos(phase * 0.23)) * (1.0f - 1.0f / zoom);
+    // Clip space is 2 wide, the larger of both pixel extents decides the mip level
+    float pixelsPerUnit = 0.5f * (float)std::max(swapchainExtent.width, swapchainExtent.height);
+
+    for (uint32_t i = 0; i < textureCount; ++i) {
+        glm::vec2 center(-1.0f + (i % columns + 0.5f) * cell, -1.0f + (i / columns + 0.5f) * cell);
+        glm::vec2 position = (center - focus) * zoom;
+        float half = 0.45f * cell * zoom;
+
+        TexturedQuad &quad = texturedQuads[i];
+        quad.visible = std::abs(position.x) - half < 1.0f && std::abs(position.y) - half < 1.0f;
+        quad.constants.offset[0] = position.x - half;
+        quad.constants.offset[1] = position.y - half;
+        quad.constants.scale[0] = 2.0f * half;
+        quad.constants.scale[1] = 2.0f * half;
+        quad.constants.texture = 0;
+        textureStreamer.setScreenSize(i, quad.visible ? 2.0f * half * pixelsPerUnit : 0.0f);
+    }
+}
+
+// Device local color images which take the place of the swapchain images in headless mode
+void createOffscreenImages() {
+    offscreenImages = new VkImage[amountOfOffscreenImages];
+    offscreenImagesAllocations = new Allocation[amountOfOffscreenImages];
+
+    for (uint32_t i = 0; i < amountOfOffscreenImages; ++i) {
+        VkImageCreateInfo imageCreateInfo;
+        imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageCreateInfo.pNext = nullptr;
+        imageCreateInfo.flags = 0;
+        imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageCreateInfo.format = usedFormat;
+        imageCreateInfo.extent = VkExtent3D{ WIDTH, HEIGHT, 1 };
+        imageCreateInfo.mipLevels = 1;
+        imageCreateInfo.arrayLayers = 1;
+        imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageCreateInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | (captureDirectory.empty() ? 0 : VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+        imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageCreateInfo.queueFamilyIndexCount = 0;
+        imageCreateInfo.pQueueFamilyIndices = nullptr;
+        imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        memoryAllocator.createImage(imageCreateInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, offscreenImages[i], offscreenImagesAllocations[i]);
+    }
+}
+
+// The first format of the candidates the device can use as depth attachment, D16 is always supported
+VkFormat chooseDepthFormat() {
+    const VkFormat candidates[] = { VK_FORMAT_D32_SFLOAT, VK_FORMAT_X8_D24_UNORM_PACK32, VK_FORMAT_D16_UNORM };
+    for (VkFormat candidate : candidates) {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, candidate, &properties);
+        if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+            return candidate;
+        }
+    }
+    return VK_FORMAT_D16_UNORM;
+}
+
+void createInstance()
 {
+    PROFILE_ZONE("createInstance");
+
     VkApplicationInfo appInfo;
     appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
     appInfo.pNext = nullptr;
@@ -214,12 +612,31 @@ void startVulkan()
     }
     std::cout << std::endl;
 
-    const std::vector<const char*> validationLayers = {
-        "VK_LAYER_KHRONOS_validation"
-    };
+    // Only enable the validation layer if it is installed, build machines usually only have the driver
+    std::vector<const char*> validationLayers;
+    for (uint32_t i = 0; i < amountOfLayers; ++i) {
+        if (std::string(layers[i].layerName) == "VK_LAYER_KHRONOS_validation") {
+            validationLayers.push_back("VK_LAYER_KHRONOS_validation");
+        }
+    }
 
+    // Headless mode has no surface, so the instance needs none of the surface extensions
     uint32_t amountGLFWExtensions = 0;
-    auto glfwExtensions = glfwGetRequiredInstanceExtensions(&amountGLFWExtensions);
+    const char** glfwExtensions = nullptr;
+    if (!headless) {
+        glfwExtensions = glfwGetRequiredInstanceExtensions(&amountGLFWExtensions);
+    }
+    std::vector<const char*> instanceExtensions(glfwExtensions, glfwExtensions + amountGLFWExtensions);
+
+    // The descriptor indexing features and limits of the bindless table can only be queried with vkGetPhysicalDevice*2KHR
+    if (materialCount > 0 || textureCount > 0) {
+        for (uint32_t i = 0; i < amountOfExtensions; ++i) {
+            if (std::string(extensions[i].extensionName) == VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) {
+                instanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+                physicalDeviceProperties2 = true;
+            }
+        }
+    }
 
     VkInstanceCreateInfo instanceInfo;
     instanceInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -228,18 +645,28 @@ void startVulkan()
     instanceInfo.pApplicationInfo = &appInfo;
     instanceInfo.enabledLayerCount = validationLayers.size();
     instanceInfo.ppEnabledLayerNames = validationLayers.data();
-    instanceInfo.enabledExtensionCount = amountGLFWExtensions;
-    instanceInfo.ppEnabledExtensionNames = glfwExtensions;
+    instanceInfo.enabledExtensionCount = instanceExtensions.size();
+    instanceInfo.ppEnabledExtensionNames = instanceExtensions.data();
 
     result = vkCreateInstance(&instanceInfo, nullptr, &instance);
     ASSERT_VULKAN(result);
 
-    result = glfwCreateWindowSurface(instance, window, nullptr, &surface);
-    ASSERT_VULKAN(result);
+    if (!headless) {
+        result = glfwCreateWindowSurface(instance, window, nullptr, &surface);
+        ASSERT_VULKAN(result);
+    }
+
+    delete[] layers;
+    delete[] extensions;
+}
+
+void createDevice()
+{
+    PROFILE_ZONE("createDevice");
 
     // Load amaount of devices
     uint32_t amountOfPhysicalDevices = 0;
-    result = vkEnumeratePhysicalDevices(instance, &amountOfPhysicalDevices, nullptr);
+    VkResult result = vkEnumeratePhysicalDevices(instance, &amountOfPhysicalDevices, nullptr);
     ASSERT_VULKAN(result);
 
     // Fill array with devices
@@ -254,31 +681,93 @@ void startVulkan()
         printStats(physicalDevices[i]);
     }
 
-    float queuePrios[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    std::vector<const char*> deviceExtensions;
+    if (!headless) {
+        deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    }
+
+    DeviceRequirements requirements;
+    requirements.extensions = deviceExtensions;
+    requirements.surface = surface;
 
-    VkDeviceQueueCreateInfo deviceQueueCreateInfo;
-    deviceQueueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-    deviceQueueCreateInfo.pNext = nullptr;
-    deviceQueueCreateInfo.flags = 0;
+    DeviceCandidate selectedDevice = selectPhysicalDevice(instance, requirements, deviceOverride);
+    physicalDevice = selectedDevice.physicalDevice;
+    queueFamilies = selectedDevice.queueFamilies;
 
-    // These values should be loaded dynamically from the queue families (shown in printStats)
-    deviceQueueCreateInfo.queueFamilyIndex = 0; // TODO choose correct family index
-    deviceQueueCreateInfo.queueCount = 4; // Todo check if amaount is possible 
-    deviceQueueCreateInfo.pQueuePriorities = queuePrios;
+    // Optional, the culling falls back to vkCmdDrawIndexedIndirect without it
+    if (gpuCullingEnabled && supportsDeviceExtension(physicalDevice, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME)) {
+        deviceExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+        drawIndirectCount = true;
+    }
+
+    // One queue of every family we use, graphics/present/compute/transfer may share families
+    float queuePrio = 1.0f;
+    std::vector<VkDeviceQueueCreateInfo> deviceQueueCreateInfos;
+    for (uint32_t family : queueFamilies.uniqueFamilies()) {
+        VkDeviceQueueCreateInfo deviceQueueCreateInfo;
+        deviceQueueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        deviceQueueCreateInfo.pNext = nullptr;
+        deviceQueueCreateInfo.flags = 0;
+        deviceQueueCreateInfo.queueFamilyIndex = family;
+        deviceQueueCreateInfo.queueCount = 1;
+        deviceQueueCreateInfo.pQueuePriorities = &queuePrio;
+        deviceQueueCreateInfos.push_back(deviceQueueCreateInfo);
+    }
 
     // Features to enable on the device
     VkPhysicalDeviceFeatures usedFeatures = {};
 
-    const std::vector<const char*> deviceExtensions = {
-        VK_KHR_SWAPCHAIN_EXTENSION_NAME
-    };
+    if (pipelineStatistics) {
+        VkPhysicalDeviceFeatures supportedFeatures;
+        vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+        if (supportedFeatures.pipelineStatisticsQuery) {
+            usedFeatures.pipelineStatisticsQuery = VK_TRUE;
+        } else {
+            std::cout << "Pipeline statistics queries are not supported by the device" << std::endl;
+            pipelineStatistics = false;
+        }
+    }
+
+    // Statistics queries stay active while the secondary command buffers execute
+    if (pipelineStatistics && recordThreads > 0) {
+        VkPhysicalDeviceFeatures supportedFeatures;
+        vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+        if (supportedFeatures.inheritedQueries) {
+            usedFeatures.inheritedQueries = VK_TRUE;
+        } else {
+            std::cout << "Inherited queries are not supported by the device, pipeline statistics are disabled" << std::endl;
+            usedFeatures.pipelineStatisticsQuery = VK_FALSE;
+            pipelineStatistics = false;
+        }
+    }
+
+    // Optional as well, the instances are drawn with instanced.frag without it
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+    if (materialCount > 0 || textureCount > 0) {
+        if (physicalDeviceProperties2 && supportsDeviceExtension(physicalDevice, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) &&
+            supportsDeviceExtension(physicalDevice, VK_KHR_MAINTENANCE3_EXTENSION_NAME) &&
+            BindlessTable::checkSupport(instance, physicalDevice, usedFeatures, indexingFeatures, bindlessBufferCapacity, bindlessImageCapacity)) {
+            deviceExtensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+            deviceExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+            if (materialCount > bindlessBufferCapacity || textureCount > bindlessImageCapacity / 2) {
+                std::cout << "The bindless table holds " << bindlessBufferCapacity << " buffers and " << bindlessImageCapacity <<
+                    " images on this device, --materials and --textures are lowered to fit" << std::endl;
+                materialCount = std::min(materialCount, bindlessBufferCapacity);
+                textureCount = std::min(textureCount, bindlessImageCapacity / 2);
+            }
+        } else {
+            std::cout << "Descriptor indexing is not supported by the device, --materials and --textures are ignored" << std::endl;
+            materialCount = 0;
+            textureCount = 0;
+        }
+    }
 
     VkDeviceCreateInfo deviceCreateInfo;
     deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-    deviceCreateInfo.pNext = nullptr;
+    deviceCreateInfo.pNext = materialCount > 0 || textureCount > 0 ? &indexingFeatures : nullptr;
     deviceCreateInfo.flags = 0;
-    deviceCreateInfo.queueCreateInfoCount = 1;
-    deviceCreateInfo.pQueueCreateInfos = &deviceQueueCreateInfo; // Enhance if more queue families needed
+    deviceCreateInfo.queueCreateInfoCount = deviceQueueCreateInfos.size();
+    deviceCreateInfo.pQueueCreateInfos = deviceQueueCreateInfos.data();
     deviceCreateInfo.enabledLayerCount = 0;
     deviceCreateInfo.ppEnabledLayerNames = nullptr;
     deviceCreateInfo.enabledExtensionCount = deviceExtensions.size();
@@ -286,48 +775,71 @@ void startVulkan()
     deviceCreateInfo.pEnabledFeatures = &usedFeatures;
 
     // CREATE DEVICE
-    result = vkCreateDevice(physicalDevices[0], &deviceCreateInfo, nullptr, &device); //TODO: pick best device - instead of first device
+    result = vkCreateDevice(physicalDevice, &deviceCreateInfo, nullptr, &device);
     ASSERT_VULKAN(result);
 
-    //CHECK IF DEVICES SUPPORTS SURFACE
-    VkBool32 surfaceSupport = false;
-    result = vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevices[0], 0, surface, &surfaceSupport);
-    ASSERT_VULKAN(result);
+    vkGetDeviceQueue(device, queueFamilies.graphics, 0, &queue);
+    if (!headless) {
+        vkGetDeviceQueue(device, queueFamilies.present, 0, &presentQueue);
+    }
+}
 
-    if (!surfaceSupport) {
-        std::cerr << "Surface not supported!" << std::endl;
-        __debugbreak();
-    }
-
-    // Choose family index correct (look way up)
-    vkGetDeviceQueue(device, 0, 0, &queue);
-
-    VkSwapchainCreateInfoKHR swapchainCreateInfo;
-    swapchainCreateInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-    swapchainCreateInfo.pNext = nullptr;
-    swapchainCreateInfo.flags = 0;
-    swapchainCreateInfo.surface = surface;
-    swapchainCreateInfo.minImageCount = 3; // TODO check dynamically for graphicscard
-    swapchainCreateInfo.imageFormat = usedFormat; // TODO check dynamically for graphicscard
-    swapchainCreateInfo.imageColorSpace = VK_COLORSPACE_SRGB_NONLINEAR_KHR; // TODO check dynamically for graphicscard
-    swapchainCreateInfo.imageExtent = VkExtent2D{WIDTH, HEIGHT};
-    swapchainCreateInfo.imageArrayLayers = 1;
-    swapchainCreateInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-    swapchainCreateInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE; //TODO check
-    swapchainCreateInfo.queueFamilyIndexCount = 0;
-    swapchainCreateInfo.pQueueFamilyIndices = nullptr;
-    swapchainCreateInfo.preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
-    swapchainCreateInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR; // window is not transparent
-    swapchainCreateInfo.presentMode = VK_PRESENT_MODE_FIFO_KHR;
-    swapchainCreateInfo.clipped = VK_TRUE; // clip pixels outside of the image
-    swapchainCreateInfo.oldSwapchain = VK_NULL_HANDLE;
-
-    result = vkCreateSwapchainKHR(device, &swapchainCreateInfo, nullptr, &swapchain);
-
-    vkGetSwapchainImagesKHR(device, swapchain, &amountOfImagesInSwapChain, nullptr);
-    VkImage* swapchainImages = new VkImage[amountOfImagesInSwapChain];
-    result = vkGetSwapchainImagesKHR(device, swapchain, &amountOfImagesInSwapChain, swapchainImages);
-    ASSERT_VULKAN(result);
+void createSwapchain()
+{
+    PROFILE_ZONE("createSwapchain");
+
+    VkResult result;
+    if (headless) {
+        createOffscreenImages();
+        amountOfImagesInSwapChain = amountOfOffscreenImages;
+        swapchainImages.assign(offscreenImages, offscreenImages + amountOfOffscreenImages);
+    } else {
+        SwapchainSettings settings = chooseSwapchainSettings(physicalDevice, surface, presentPolicy, requestedPresentMode, usedFormat,
+            windowExtent);
+        usedFormat = settings.surfaceFormat.format;
+        swapchainExtent = settings.extent;
+        presentMode = settings.presentMode;
+
+        // Frame capture copies out of the swapchain images
+        if (!captureDirectory.empty() && !(settings.supportedUsage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)) {
+            std::cout << "The surface does not support copies from swapchain images, --capture is ignored" << std::endl;
+            captureDirectory.clear();
+        }
+
+        VkSwapchainCreateInfoKHR swapchainCreateInfo;
+        swapchainCreateInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+        swapchainCreateInfo.pNext = nullptr;
+        swapchainCreateInfo.flags = 0;
+        swapchainCreateInfo.surface = surface;
+        swapchainCreateInfo.minImageCount = settings.minImageCount;
+        swapchainCreateInfo.imageFormat = settings.surfaceFormat.format;
+        swapchainCreateInfo.imageColorSpace = settings.surfaceFormat.colorSpace;
+        swapchainCreateInfo.imageExtent = settings.extent;
+        swapchainCreateInfo.imageArrayLayers = 1;
+        swapchainCreateInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | (captureDirectory.empty() ? 0 : VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+        // Rendering and presenting from different families would need an ownership transfer for exclusive images
+        uint32_t swapchainFamilies[] = { queueFamilies.graphics, queueFamilies.present };
+        bool sharedImages = queueFamilies.graphics != queueFamilies.present;
+        swapchainCreateInfo.imageSharingMode = sharedImages ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+        swapchainCreateInfo.queueFamilyIndexCount = sharedImages ? 2 : 0;
+        swapchainCreateInfo.pQueueFamilyIndices = sharedImages ? swapchainFamilies : nullptr;
+        swapchainCreateInfo.preTransform = settings.preTransform;
+        swapchainCreateInfo.compositeAlpha = settings.compositeAlpha; // window is not transparent
+        swapchainCreateInfo.presentMode = settings.presentMode;
+        swapchainCreateInfo.clipped = VK_TRUE; // clip pixels outside of the image
+        swapchainCreateInfo.oldSwapchain = swapchain; // lets the driver reuse resources of the old one, VK_NULL_HANDLE the first time
+
+        result = vkCreateSwapchainKHR(device, &swapchainCreateInfo, nullptr, &swapchain);
+        ASSERT_VULKAN(result);
+
+        vkGetSwapchainImagesKHR(device, swapchain, &amountOfImagesInSwapChain, nullptr);
+        swapchainImages.resize(amountOfImagesInSwapChain);
+        result = vkGetSwapchainImagesKHR(device, swapchain, &amountOfImagesInSwapChain, swapchainImages.data());
+        ASSERT_VULKAN(result);
+
+        std::cout << "Swapchain: " << swapchainExtent.width << "x" << swapchainExtent.height << " | " << amountOfImagesInSwapChain <<
+            " images | " << presentModeName(presentMode) << std::endl;
+    }
 
     imageViews = new VkImageView[amountOfImagesInSwapChain];
 
@@ -339,7 +851,7 @@ void startVulkan()
         imageViewCreateInfo.flags = 0;
         imageViewCreateInfo.image = swapchainImages[i];
         imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-        imageViewCreateInfo.format = usedFormat; // TODO check if valid
+        imageViewCreateInfo.format = usedFormat;
         imageViewCreateInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
         imageViewCreateInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
         imageViewCreateInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
@@ -353,368 +865,1192 @@ void startVulkan()
         result = vkCreateImageView(device, &imageViewCreateInfo, nullptr, &imageViews[i]);
         ASSERT_VULKAN(result);
     }
+}
+
+const char *vertexShaderFile() {
+    if (particleCount > 0) {
+        return "particles_vert.spv";
+    }
+    if (textureCount > 0) {
+        return "textured_vert.spv";
+    }
+    if (!meshFile.empty()) {
+        return "mesh_vert.spv";
+    }
+    return instanceCount > 0 ? instancedBatch.getVertexShaderFile() : "vert.spv";
+}
 
-    // shaders
+const char *fragmentShaderFile() {
+    if (textureCount > 0) {
+        return "textured_frag.spv";
+    }
+    if (instanceCount == 0) {
+        return meshFile.empty() && particleCount == 0 ? "frag.spv" : "instanced_frag.spv";
+    }
+    return materialCount > 0 ? "instanced_bindless_frag.spv" : instancedBatch.getFragmentShaderFile();
+}
 
-    auto shaderCodeVert = readFile("vert.spv");
-    auto shaderCodeFrag = readFile("frag.spv");
+void createShaderModules()
+{
+    PROFILE_ZONE("createShaderModules");
 
-    std::cout << "Shadersizes: " << std::endl;
-    std::cout << "Vertex: " << shaderCodeVert.size() << std::endl;
-    std::cout << "Fragement:" << shaderCodeFrag.size() << std::endl;
-    
-    createShaderModule(shaderCodeVert, &shaderModuleVert);
-    createShaderModule(shaderCodeFrag, &shaderModuleFrag);
-
-    VkPipelineShaderStageCreateInfo shaderStageCreateInfoVert;
-    shaderStageCreateInfoVert.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    shaderStageCreateInfoVert.pNext = nullptr;
-    shaderStageCreateInfoVert.flags = 0;
-    shaderStageCreateInfoVert.stage = VK_SHADER_STAGE_VERTEX_BIT;
-    shaderStageCreateInfoVert.module = shaderModuleVert;
-    shaderStageCreateInfoVert.pName = "main";
-    shaderStageCreateInfoVert.pSpecializationInfo = nullptr;
-
-    VkPipelineShaderStageCreateInfo shaderStageCreateInfoFrag;
-    shaderStageCreateInfoFrag.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    shaderStageCreateInfoFrag.pNext = nullptr;
-    shaderStageCreateInfoFrag.flags = 0;
-    shaderStageCreateInfoFrag.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    shaderStageCreateInfoFrag.module = shaderModuleFrag;
-    shaderStageCreateInfoFrag.pName = "main";
-    shaderStageCreateInfoFrag.pSpecializationInfo = nullptr;
-
-    VkPipelineShaderStageCreateInfo shaderStages[] = { shaderStageCreateInfoVert, shaderStageCreateInfoFrag};
-
-
-    /*
-    * PIPELINE
-    */
-
-    // fixed functions
-    VkPipelineVertexInputStateCreateInfo vertexInputCreateInfo;
-    vertexInputCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputCreateInfo.pNext = nullptr;
-    vertexInputCreateInfo.flags = 0;
-    vertexInputCreateInfo.vertexBindingDescriptionCount = 0;
-    vertexInputCreateInfo.pVertexBindingDescriptions = nullptr;
-    vertexInputCreateInfo.vertexAttributeDescriptionCount = 0;
-    vertexInputCreateInfo.pVertexAttributeDescriptions = nullptr;
-
-    VkPipelineInputAssemblyStateCreateInfo inputAssemblyCreateInfo;
-    inputAssemblyCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    inputAssemblyCreateInfo.pNext = nullptr;
-    inputAssemblyCreateInfo.flags = 0 ;
-    inputAssemblyCreateInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-    inputAssemblyCreateInfo.primitiveRestartEnable = VK_FALSE;
-
-    // Viewport + Scissor
-    VkViewport viewport;
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = WIDTH;
-    viewport.height = HEIGHT;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
+    ShaderCode shaderCodeVert = loadShader(vertexShaderFile(), shaderSource);
+    ShaderCode shaderCodeFrag = loadShader(fragmentShaderFile(), shaderSource);
 
-    VkRect2D scissor;
-    scissor.offset = { 0, 0};
-    scissor.extent = { WIDTH, HEIGHT };
-
-    VkPipelineViewportStateCreateInfo viewportStateCreateInfo;
-    viewportStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-    viewportStateCreateInfo.pNext = nullptr;
-    viewportStateCreateInfo.flags = 0;
-    viewportStateCreateInfo.viewportCount = 1;
-    viewportStateCreateInfo.pViewports = &viewport;
-    viewportStateCreateInfo.scissorCount = 1;
-    viewportStateCreateInfo.pScissors = &scissor;
-
-    // Rasterization
-    VkPipelineRasterizationStateCreateInfo rasterizationCreateInfo;
-    rasterizationCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-    rasterizationCreateInfo.pNext = nullptr;
-    rasterizationCreateInfo.flags = 0;
-    rasterizationCreateInfo.depthClampEnable = VK_FALSE;
-    rasterizationCreateInfo.rasterizerDiscardEnable = VK_FALSE;
-    rasterizationCreateInfo.rasterizerDiscardEnable = VK_FALSE;
-    rasterizationCreateInfo.polygonMode = VK_POLYGON_MODE_FILL;
-    rasterizationCreateInfo.cullMode = VK_CULL_MODE_BACK_BIT;
-    rasterizationCreateInfo.frontFace = VK_FRONT_FACE_CLOCKWISE;
-    rasterizationCreateInfo.depthBiasEnable = VK_FALSE;
-    rasterizationCreateInfo.depthBiasConstantFactor = 0.0f;
-    rasterizationCreateInfo.depthBiasClamp = 0.0f;
-    rasterizationCreateInfo.depthBiasSlopeFactor = 0.0f;
-    rasterizationCreateInfo.lineWidth = 1.0f;
-
-    // Multisampling
-    VkPipelineMultisampleStateCreateInfo multisampleCreateInfo;
-    multisampleCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-    multisampleCreateInfo.pNext = nullptr;
-    multisampleCreateInfo.flags = 0;
-    multisampleCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-    multisampleCreateInfo.sampleShadingEnable = VK_FALSE;
-    multisampleCreateInfo.minSampleShading = 1.0f;
-    multisampleCreateInfo.pSampleMask = nullptr;
-    multisampleCreateInfo.alphaToCoverageEnable = VK_FALSE;
-    multisampleCreateInfo.alphaToOneEnable = VK_FALSE;
-
-    // Blending
-    VkPipelineColorBlendAttachmentState colorBlendAttachment;
-    colorBlendAttachment.blendEnable = VK_TRUE;
-    colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-    colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-    colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
-    colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-    colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-    colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
-    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-
-    VkPipelineColorBlendStateCreateInfo colorBlendCreateInfo;
-    colorBlendCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-    colorBlendCreateInfo.pNext = nullptr;
-    colorBlendCreateInfo.flags = 0;
-    colorBlendCreateInfo.logicOpEnable = VK_FALSE;
-    colorBlendCreateInfo.logicOp = VK_LOGIC_OP_NO_OP;
-    colorBlendCreateInfo.attachmentCount = 1;
-    colorBlendCreateInfo.pAttachments = &colorBlendAttachment;
-    colorBlendCreateInfo.blendConstants[0] = 0.0f;
-    colorBlendCreateInfo.blendConstants[1] = 0.0f;
-    colorBlendCreateInfo.blendConstants[2] = 0.0f;
-    colorBlendCreateInfo.blendConstants[3] = 0.0f;
+    shaderModuleVert = createShaderModule(device, shaderCodeVert);
+    shaderModuleFrag = createShaderModule(device, shaderCodeFrag);
+    pipelineVariants.registerShader(vertexShaderFile(), shaderModuleVert);
+    pipelineVariants.registerShader(fragmentShaderFile(), shaderModuleFrag);
+}
+
+void createPipelineLayout()
+{
+    PROFILE_ZONE("createPipelineLayout");
+
+    // With materials the bindless table is set 0 and the draw constants are pushed per draw, textured quads push
+    // their placement and texture instead
+    bool bindless = materialCount > 0 || textureCount > 0;
+    VkDescriptorSetLayout setLayout = bindlessTable.getSetLayout();
+    VkPushConstantRange pushConstantRange;
+    pushConstantRange.stageFlags = textureCount > 0 ? VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT : VK_SHADER_STAGE_FRAGMENT_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = textureCount > 0 ? sizeof(QuadConstants) : sizeof(DrawConstants);
 
     VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo;
     pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     pipelineLayoutCreateInfo.pNext = nullptr;
     pipelineLayoutCreateInfo.flags = 0;
-    pipelineLayoutCreateInfo.setLayoutCount = 0;
-    pipelineLayoutCreateInfo.pSetLayouts = nullptr;
-    pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
-    pipelineLayoutCreateInfo.pPushConstantRanges = nullptr;
+    pipelineLayoutCreateInfo.setLayoutCount = bindless ? 1 : 0;
+    pipelineLayoutCreateInfo.pSetLayouts = bindless ? &setLayout : nullptr;
+    pipelineLayoutCreateInfo.pushConstantRangeCount = bindless ? 1 : 0;
+    pipelineLayoutCreateInfo.pPushConstantRanges = bindless ? &pushConstantRange : nullptr;
 
-    result = vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout);
+    VkResult result = vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout);
     ASSERT_VULKAN(result);
+}
 
-    VkAttachmentDescription attachmentDescription;
-    attachmentDescription.flags = 0;
-    attachmentDescription.format = usedFormat;
-    attachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
-    attachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    attachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    attachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    attachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    attachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    attachmentDescription.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-    VkAttachmentReference attachmentReference;
-    attachmentReference.attachment = 0; // "index in the attachment array"
-    attachmentReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-    VkSubpassDescription subPassDescription;
-    subPassDescription.flags = 0;
-    subPassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    subPassDescription.inputAttachmentCount = 0;
-    subPassDescription.pInputAttachments = nullptr;
-    subPassDescription.colorAttachmentCount = 1;
-    subPassDescription.pColorAttachments = &attachmentReference;
-    subPassDescription.pResolveAttachments = nullptr;
-    subPassDescription.pDepthStencilAttachment = nullptr;
-    subPassDescription.preserveAttachmentCount = 0;
-    subPassDescription.pPreserveAttachments = nullptr;
-
-    VkSubpassDependency subPassDependency;
-    subPassDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-    subPassDependency.dstSubpass = 0;
-    subPassDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    subPassDependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    subPassDependency.srcAccessMask = 0;
-    subPassDependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-    subPassDependency.dependencyFlags = 0;
-
-    VkRenderPassCreateInfo renderPassCreateInfo;
-    renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderPassCreateInfo.pNext = nullptr;
-    renderPassCreateInfo.flags = 0;
-    renderPassCreateInfo.attachmentCount = 1;
-    renderPassCreateInfo.pAttachments = &attachmentDescription;
-    renderPassCreateInfo.subpassCount = 1;
-    renderPassCreateInfo.pSubpasses = &subPassDescription;
-    renderPassCreateInfo.dependencyCount = 1;
-    renderPassCreateInfo.pDependencies = &subPassDependency;
-
-    result = vkCreateRenderPass(device, &renderPassCreateInfo, nullptr, &renderPass);
-    ASSERT_VULKAN(result);
 
-    VkGraphicsPipelineCreateInfo pipelineCreateInfo;
-    pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineCreateInfo.pNext = nullptr;
-    pipelineCreateInfo.flags = 0;
-    pipelineCreateInfo.stageCount = 2;
-    pipelineCreateInfo.pStages = shaderStages;
-    pipelineCreateInfo.pVertexInputState = &vertexInputCreateInfo;
-    pipelineCreateInfo.pInputAssemblyState = &inputAssemblyCreateInfo;
-    pipelineCreateInfo.pTessellationState = nullptr;
-    pipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
-    pipelineCreateInfo.pRasterizationState = &rasterizationCreateInfo;
-    pipelineCreateInfo.pMultisampleState = &multisampleCreateInfo;
-    pipelineCreateInfo.pDepthStencilState = nullptr;
-    pipelineCreateInfo.pColorBlendState = &colorBlendCreateInfo;
-    pipelineCreateInfo.pDynamicState = nullptr;
-    pipelineCreateInfo.layout = pipelineLayout;
-    pipelineCreateInfo.renderPass = renderPass;
-    pipelineCreateInfo.subpass = 0; // because this is the index of last element
-    pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
-    pipelineCreateInfo.basePipelineIndex = -1;
-
-    result = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &pipeline);
-    ASSERT_VULKAN(result);
+// Fits the bounding box of the mesh into the viewport, keeping its aspect, with z in [0.05, 0.95]. The mesh files
+// are counter-clockwise seen from outside.
+void describeMeshInput(PipelineVariantDesc &desc) {
+    meshAsset.getVertexInput(desc.vertexBindings, desc.vertexAttributes);
+    glm::vec3 extent = meshAsset.getBoundsExtent();
+    float fit = 0.9f / std::max(extent.x, std::max(extent.y, extent.z));
+    glm::vec3 clipScale(fit, fit, 0.5f * fit);
+    glm::vec3 scale = meshAsset.getPositionScale() * clipScale;
+    glm::vec3 offset = (meshAsset.getPositionOffset() - meshAsset.getBoundsCenter()) * clipScale + glm::vec3(0.0f, 0.0f, 0.5f);
+    for (uint32_t axis = 0; axis < 3; ++axis) {
+        desc.vertexConstants.setFloat(axis, scale[axis]);
+        desc.vertexConstants.setFloat(3 + axis, offset[axis]);
+    }
+    desc.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+}
 
-    framebuffers = new VkFramebuffer[amountOfImagesInSwapChain]();
-
-    for (size_t i = 0; i < amountOfImagesInSwapChain; ++i) {
-        VkFramebufferCreateInfo frameBufferCreateInfo;
-        frameBufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO ;
-        frameBufferCreateInfo.pNext = nullptr;
-        frameBufferCreateInfo.flags = 0;
-        frameBufferCreateInfo.renderPass = renderPass;
-        frameBufferCreateInfo.attachmentCount = 1;
-        frameBufferCreateInfo.pAttachments = &(imageViews[i]) ;
-        frameBufferCreateInfo.width = WIDTH;
-        frameBufferCreateInfo.height = HEIGHT;
-        frameBufferCreateInfo.layers = 1;
-
-        result = vkCreateFramebuffer(device, &frameBufferCreateInfo, nullptr, &(framebuffers[i]));
-        ASSERT_VULKAN(result);
+// The specialization constants only exist in instanced.frag, the triangle shaders ignore them
+PipelineVariantDesc describePipeline(uint32_t iterations, bool gray) {
+    PipelineVariantDesc desc;
+    desc.vertexShader = vertexShaderFile();
+    desc.fragmentShader = fragmentShaderFile();
+    desc.fragmentConstants.setUint(0, iterations);
+    desc.fragmentConstants.setBool(1, gray);
+    // The single triangle takes its positions from the shader, the instanced batch from vertex buffers
+    if (instanceCount > 0) {
+        instancedBatch.getVertexInput(desc.vertexBindings, desc.vertexAttributes);
+    }
+    if (!meshFile.empty()) {
+        describeMeshInput(desc);
+    }
+    if (particleCount > 0) {
+        particleSystem.getVertexInput(desc.vertexBindings, desc.vertexAttributes);
+        desc.topology = VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+        desc.cullMode = VK_CULL_MODE_NONE;
+    }
+    desc.colorFormat = usedFormat;
+    if (depthMode != DepthMode::Off) {
+        desc.depthFormat = depthFormat;
+        desc.depthTest = true;
+        // After the pre-pass the depth buffer already holds the front-most depth, only those fragments pass
+        desc.depthWrite = depthMode == DepthMode::Test;
+        desc.depthCompare = depthMode == DepthMode::Test ? VK_COMPARE_OP_LESS : VK_COMPARE_OP_EQUAL;
+    }
+    return desc;
+}
+
+// Same vertex stage as the shading pipeline. Every vertex shader declares gl_Position invariant, so both pipelines
+// produce the same depth for EQUAL to pass
+PipelineVariantDesc describeDepthPipeline() {
+    PipelineVariantDesc desc = describePipeline(0, false);
+    desc.fragmentShader.clear();
+    desc.fragmentConstants = SpecializationConstants();
+    desc.depthWrite = true;
+    desc.depthCompare = VK_COMPARE_OP_LESS;
+    return desc;
+}
+
+void createPipeline()
+{
+    PROFILE_ZONE("createPipeline");
+
+    // With background compilation only the fallback is created right away, so the first frame never waits
+    PipelineCompiler *compiler = nullptr;
+    // Never compiled in the background, it is the same for every variant
+    if (depthMode == DepthMode::PrePass) {
+        depthPipelineKey = pipelineVariants.request(describeDepthPipeline());
+    }
+    if (pipelineThreads > 0) {
+        fallbackPipelineKey = pipelineVariants.request(describePipeline(0, false));
+        double milliseconds = pipelineVariants.createPending(pipelineLayout, renderPass);
+        if (milliseconds > 0.0) {
+            pipelineCache.reportCreationTime(milliseconds);
+        }
+        compiler = &pipelineCompiler;
+    }
+
+    pipelineKey = pipelineVariants.request(describePipeline(shadingIterations, grayscale));
+    // All permutations of instanced.frag, created in the same call as the one in use
+    if (prebuildVariants) {
+        for (uint32_t iterations : { 0u, 16u, 64u, 256u }) {
+            for (bool gray : { false, true }) {
+                pipelineVariants.request(describePipeline(iterations, gray));
+            }
+        }
+    }
+
+    double milliseconds = pipelineVariants.createPending(pipelineLayout, renderPass, compiler);
+    if (milliseconds > 0.0) {
+        pipelineCache.reportCreationTime(milliseconds);
     }
 
+    depthPipeline = pipelineVariants.get(depthPipelineKey);
+    pipeline = pipelineVariants.get(pipelineKey);
+    usingFallbackPipeline = pipeline == VK_NULL_HANDLE;
+    if (usingFallbackPipeline) {
+        pipeline = pipelineVariants.get(fallbackPipelineKey);
+        pipelineRequested = std::chrono::high_resolution_clock::now();
+        fallbackFrames = 0;
+    }
+}
+
+// Switches from the fallback to the real variant once the background compilation finished
+void updatePipeline() {
+    if (!usingFallbackPipeline) {
+        return;
+    }
+    VkPipeline ready = pipelineVariants.get(pipelineKey);
+    if (ready == VK_NULL_HANDLE) {
+        ++fallbackFrames;
+        return;
+    }
+
+    pipeline = ready;
+    usingFallbackPipeline = false;
+    double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - pipelineRequested).count();
+    std::cout << "Pipeline variant " << std::hex << pipelineKey << std::dec << " ready after " << milliseconds << " ms, " << fallbackFrames <<
+        " frames were drawn with the fallback" << std::endl;
+}
+
+// Layer 0 is the farthest. Every draw call of a layer gets the depth of the layer through the viewport depth range,
+// so the shaders stay the same.
+void buildSceneDraws() {
+    sceneDraws.clear();
+    for (uint32_t layer = 0; layer < depthLayers; ++layer) {
+        for (uint32_t range = 0; range < drawCalls; ++range) {
+            SceneDraw draw;
+            draw.range = range;
+            draw.layer = layer;
+            draw.depth = 1.0f - (layer + 1.0f) / (depthLayers + 1.0f);
+            sceneDraws.push_back(draw);
+        }
+    }
+
+    // The scene is static, so the order is only computed once. Stable, so equal depths keep their order.
+    if (sortDraws) {
+        auto start = std::chrono::high_resolution_clock::now();
+        std::stable_sort(sceneDraws.begin(), sceneDraws.end(), [](const SceneDraw &a, const SceneDraw &b) { return a.depth < b.depth; });
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        std::cout << "Sorted " << sceneDraws.size() << " draw calls front to back in " << milliseconds << " ms" << std::endl;
+    }
+}
+
+void createCommandBuffers()
+{
+    PROFILE_ZONE("createCommandBuffers");
+
     VkCommandPoolCreateInfo commandPoolCreateInfo;
     commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
     commandPoolCreateInfo.pNext = nullptr;
-    commandPoolCreateInfo.flags = 0;
-    commandPoolCreateInfo.queueFamilyIndex = 0; // Get correct queue with VK_QUEUE_GRAPHICS_BIT enabled - this is the index
+    commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT; // command buffers are re-recorded every frame
+    commandPoolCreateInfo.queueFamilyIndex = queueFamilies.graphics;
 
-    result = vkCreateCommandPool(device, &commandPoolCreateInfo, nullptr, &commandPool);
+    VkResult result = vkCreateCommandPool(device, &commandPoolCreateInfo, nullptr, &commandPool);
     ASSERT_VULKAN(result);
 
+    // One command buffer per frame in flight, recorded for the acquired image in drawFrame()
     VkCommandBufferAllocateInfo commandBufferAllocateInfo;
     commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
     commandBufferAllocateInfo.pNext = nullptr;
     commandBufferAllocateInfo.commandPool = commandPool;
     commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    commandBufferAllocateInfo.commandBufferCount = amountOfImagesInSwapChain;
+    commandBufferAllocateInfo.commandBufferCount = framesInFlight;
 
-    commandBuffers = new VkCommandBuffer[amountOfImagesInSwapChain]();
+    commandBuffers = new VkCommandBuffer[framesInFlight]();
     result = vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, commandBuffers);
     ASSERT_VULKAN(result);
+}
+
+void createSyncObjects()
+{
+    PROFILE_ZONE("createSyncObjects");
+
+    VkResult result;
+
+    VkSemaphoreCreateInfo semaphoreCreateInfo;
+    semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreCreateInfo.pNext = nullptr;
+    semaphoreCreateInfo.flags = 0;
+
+    // Created signaled so the first wait of every frame returns immediately
+    VkFenceCreateInfo fenceCreateInfo;
+    fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fenceCreateInfo.pNext = nullptr;
+    fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+    semaphoresImageAvailable = new VkSemaphore[framesInFlight];
+    semaphoresRenderingDone = new VkSemaphore[framesInFlight];
+    fencesInFlight = new VkFence[framesInFlight];
+
+    for (uint32_t i = 0; i < framesInFlight; ++i) {
+        result = vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphoresImageAvailable[i]);
+        ASSERT_VULKAN(result);
+        result = vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphoresRenderingDone[i]);
+        ASSERT_VULKAN(result);
+        result = vkCreateFence(device, &fenceCreateInfo, nullptr, &fencesInFlight[i]);
+        ASSERT_VULKAN(result);
+    }
+
+    imagesInFlight = new VkFence[amountOfImagesInSwapChain]();
+}
+
+// Defined with the other recording functions, draws the scene into the render pass of the graph
+void recordScene(VkCommandBuffer commandBuffer, const PassContext &context);
+
+void buildFrameGraph(RenderGraph &graph, bool capture) {
+    graph = RenderGraph();
+
+    ImageDesc colorDesc;
+    colorDesc.format = usedFormat;
+    colorDesc.extent = swapchainExtent;
+    // The first barrier waits in the stage the acquire semaphore is waited for, the content is discarded
+    ResourceState initial;
+    initial.stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    ResourceState final;
+    final.stages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+    final.layout = headless ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    swapchainResource = graph.importImage("swapchain", colorDesc, initial, final, true);
+
+    // The depth pre-pass stays in the same render pass as the shading, it has no store and load in between
+    uint32_t scene = graph.addPass("scene", PassType::Raster, recordScene);
+    VkClearValue clearColor;
+    clearColor.color = { 0.0f, 0.0f, 0.0f, 1.0f };
+    graph.clear(scene, swapchainResource, ResourceAccess::ColorAttachment, clearColor);
+    if (depthMode != DepthMode::Off) {
+        ImageDesc depthDesc;
+        depthDesc.format = depthFormat;
+        depthDesc.extent = swapchainExtent;
+        uint32_t depth = graph.createImage("depth", depthDesc);
+        VkClearValue clearDepth;
+        clearDepth.depthStencil = { 1.0f, 0 };
+        graph.clear(scene, depth, ResourceAccess::DepthAttachment, clearDepth);
+    }
+    if (recordThreads > 0) {
+        graph.setSecondaryContents(scene);
+    }
+
+    if (capture) {
+        uint32_t pass = graph.addPass("capture", PassType::Transfer, [](VkCommandBuffer commandBuffer, const PassContext &) {
+            frameCapture.recordCopy(commandBuffer, currentFrame, frameNumber, renderGraphExecutor.getImage(swapchainResource), usedFormat, swapchainExtent);
+        });
+        graph.use(pass, swapchainResource, ResourceAccess::TransferRead);
+        graph.setSideEffects(pass);
+    }
+}
+
+// Needs the swapchain, the depth format and the capture settings
+void compileFrameGraphs() {
+    PROFILE_ZONE("compileFrameGraphs");
+
+    uint32_t variants = captureDirectory.empty() ? 1 : 2;
+    for (uint32_t capture = 0; capture < variants; ++capture) {
+        buildFrameGraph(frameGraphs[capture], capture == 1);
+        renderGraphExecutor.compile(frameGraphs[capture], compiledFrameGraphs[capture]);
+        if (dumpRenderGraph) {
+            frameGraphs[capture].dump(compiledFrameGraphs[capture], std::cout);
+        }
+    }
+    // The scene pass is never culled. Its render pass only depends on the formats, so resizes find the same one
+    // in the cache and the pipelines stay compatible.
+    renderPass = renderGraphExecutor.getRenderPass(compiledFrameGraphs[0].passes[0]);
+}
+
+void destroyRetiredSwapchain(RetiredSwapchain &retired) {
+    for (uint32_t i = 0; i < retired.amountOfImages; ++i) {
+        framebufferCache.releaseImageView(retired.imageViews[i]);
+        vkDestroyImageView(device, retired.imageViews[i], nullptr);
+    }
+    delete[] retired.imageViews;
+    for (VkPipeline pipeline : retired.pipelines) {
+        vkDestroyPipeline(device, pipeline, nullptr);
+    }
+    vkDestroySwapchainKHR(device, retired.swapchain, nullptr);
+}
+
+// Call after waiting for the fence of the current frame slot. Once every slot was waited for since a swapchain
+// was retired, no submitted frame uses it anymore.
+void releaseRetiredSwapchains() {
+    auto done = [](const RetiredSwapchain &retired) {
+        return frameNumber + 1 >= retired.retireFrame + framesInFlight;
+    };
+    for (RetiredSwapchain &retired : retiredSwapchains) {
+        if (done(retired)) {
+            destroyRetiredSwapchain(retired);
+        }
+    }
+    retiredSwapchains.erase(std::remove_if(retiredSwapchains.begin(), retiredSwapchains.end(), done), retiredSwapchains.end());
+}
+
+// Replaces the swapchain after a resize, an out of date swapchain or a present mode switch. Only the
+// resources which depend on the swapchain are created again and the old ones are retired, the frames
+// in flight keep rendering.
+void recreateSwapchain() {
+    PROFILE_ZONE("recreateSwapchain");
+
+    // A minimized window has no area to present to. The main thread waits for it to be restored before it
+    // sends the next packet, so this only happens if the window was minimized right after a packet was made.
+    if (windowExtent.width == 0 || windowExtent.height == 0) {
+        return;
+    }
+    swapchainDirty = false;
+
+    RetiredSwapchain retired;
+    retired.swapchain = swapchain;
+    retired.imageViews = imageViews;
+    retired.amountOfImages = amountOfImagesInSwapChain;
+    retired.retireFrame = frameNumber;
+
+    // Viewport and scissor are dynamic, only a new format needs other pipelines. The framebuffers of
+    // the new image views are created by the cache when they are first used, the depth buffers of the new
+    // extent by the render graph executor.
+    VkFormat oldFormat = usedFormat;
+    createSwapchain();
+    compileFrameGraphs();
+
+    if (usedFormat != oldFormat) {
+        // The fallback may be the same variant, it is only handed out once
+        for (uint64_t key : { pipelineKey, fallbackPipelineKey, depthPipelineKey }) {
+            VkPipeline removed = pipelineVariants.remove(key);
+            if (removed != VK_NULL_HANDLE) {
+                retired.pipelines.push_back(removed);
+            }
+        }
+        createPipeline();
+    }
+    retiredSwapchains.push_back(retired);
+
+    // The fences of the old images do not matter for the new ones
+    delete[] imagesInFlight;
+    imagesInFlight = new VkFence[amountOfImagesInSwapChain]();
+}
+
+void startVulkan()
+{
+    PROFILE_ZONE("startVulkan");
+
+    createInstance();
+    createDevice();
+    memoryAllocator.init(device, physicalDevice, memoryBlockSize);
+    uploader.init(device, physicalDevice, queueFamilies.transfer, queueFamilies.graphics, stagingRingSize);
+    std::cout << "Staging uploader: " << stagingRingSize / (1024 * 1024) << " MiB ring on queue family " << queueFamilies.transfer <<
+        (uploader.ownershipTransfer() ? " with ownership transfer" : "") << std::endl;
+    if (instanceCount > 0) {
+        instancedBatch.init(memoryAllocator, uploader, instanceCount, instanceLayout, instanceFormat, gpuCullingEnabled);
+        // The first frame records the acquire barriers, so the data has to be there before it
+        uploader.wait(instancedBatch.getUploadTicket());
+        std::cout << "Instanced batch: " << instanceCount << " instances | " << (instanceLayout == InstanceLayout::AoS ? "AoS" : "SoA") <<
+            " | " << instancedBatch.getInstanceSize() << " bytes per instance" << std::endl;
+    }
+    if (!meshFile.empty()) {
+        meshAsset.load(meshFile);
+        auto uploadStart = std::chrono::high_resolution_clock::now();
+        uploader.wait(meshAsset.upload(memoryAllocator, uploader));
+        double uploadTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - uploadStart).count();
+        std::cout << "Mesh " << meshFile << ": " << meshAsset.getTriangleCount() << " triangles in " << meshAsset.getChunkCount() << " chunks | " <<
+            meshAsset.getVertexStride() << " bytes per vertex, " << meshAsset.getIndexSize() * 8 << " bit indices | " << meshAsset.getFileSize() <<
+            " bytes | map + validate " << meshAsset.getLoadTime() << " ms | upload " << uploadTime << " ms" << std::endl;
+    }
+    if (depthMode != DepthMode::Off) {
+        depthFormat = chooseDepthFormat();
+        std::cout << "Depth buffer: format " << depthFormat << (depthMode == DepthMode::PrePass ? " | depth pre-pass" : " | depth test") << std::endl;
+    }
+    createSwapchain();
+    if (!captureDirectory.empty()) {
+        if (FrameCapture::supportsFormat(usedFormat)) {
+            frameCapture.start(device, physicalDevice, memoryAllocator, framesInFlight, captureQueueDepth, captureDirectory, captureFormat, captureInterval);
+        } else {
+            std::cout << "Frame capture does not support the swapchain format " << usedFormat << ", --capture is ignored" << std::endl;
+            captureDirectory.clear();
+        }
+    }
+    pipelineCache.load(device, physicalDevice, pipelineCacheFile);
+    pipelineVariants.init(device, pipelineCache.getHandle());
+    if (pipelineThreads > 0) {
+        pipelineCompiler.start(device, pipelineCache.getHandle(), pipelineThreads);
+    }
+    createShaderModules();
+    if (materialCount > 0) {
+        createMaterials();
+    }
+    if (textureCount > 0) {
+        startTextureStreaming();
+    }
+    createPipelineLayout();
+    renderPassCache.init(device);
+    framebufferCache.init(device, framebufferCacheCapacity, framesInFlight);
+    renderGraphExecutor.init(device, memoryAllocator, renderPassCache, framebufferCache, framesInFlight);
+    compileFrameGraphs();
+    createPipeline();
+    buildSceneDraws();
+    if (gpuCullingEnabled) {
+        gpuCulling.init(device, physicalDevice, memoryAllocator, instancedBatch, loadShader("cull_comp.spv", shaderSource), pipelineCache.getHandle(), framesInFlight, drawIndirectCount);
+        gpuCulling.setFrustum(glm::scale(glm::mat4(1.0f), glm::vec3(1.0f / cullRegion, 1.0f / cullRegion, 1.0f)));
+        std::cout << "GPU culling: " << (drawIndirectCount ? "vkCmdDrawIndexedIndirectCountKHR" : "vkCmdDrawIndexedIndirect") <<
+            " | cull region " << cullRegion << std::endl;
+    }
+    if (particleCount > 0) {
+        uint32_t particleFamily = particlesOnComputeQueue ? queueFamilies.compute : queueFamilies.graphics;
+        particleSystem.init(device, physicalDevice, memoryAllocator, loadShader("particles_comp.spv", shaderSource), pipelineCache.getHandle(),
+            particleCount, queueFamilies.graphics, particleFamily, framesInFlight);
+        std::cout << "Particles: " << particleCount << " | " << (particleSystem.isAsync() ? "async compute" : "graphics queue") <<
+            (particlesOnComputeQueue && !queueFamilies.hasAsyncCompute() ? " (no separate compute queue family)" : "") << std::endl;
+    }
+    createCommandBuffers();
+    createSyncObjects();
+
+    gpuTimer.init(device, physicalDevice, queueFamilies.graphics, framesInFlight, pipelineStatistics);
+
+    if (recordThreads > 0) {
+        jobScheduler.start(recordThreads - 1); // the main thread records as well
+        parallelRecorder.init(device, queueFamilies.graphics, jobScheduler.getWorkerCount(), framesInFlight);
+        std::cout << "Parallel recording: " << jobScheduler.getWorkerCount() << " threads | " << sceneDraws.size() << " draw calls" << std::endl;
+    }
+
+    if (streamUploadMiB > 0) {
+        createStreamBuffer();
+    }
+    memoryAllocator.printStats();
+}
+
+// Sets viewport and scissor to one cell of a grid with viewportCount cells over the whole image. The triangle and
+// instanced vertex shaders output z = 0, so they end up at the depth of the layer. Meshes spread their z over the
+// range up to the next layer behind it.
+void setViewport(VkCommandBuffer commandBuffer, uint32_t cell, const SceneDraw &draw) {
+    uint32_t columns = (uint32_t)std::ceil(std::sqrt((double)viewportCount));
+    uint32_t rows = (viewportCount + columns - 1) / columns;
+    uint32_t column = cell % columns;
+    uint32_t row = cell / columns;
+
+    VkRect2D scissor;
+    scissor.offset.x = (int32_t)(swapchainExtent.width * column / columns);
+    scissor.offset.y = (int32_t)(swapchainExtent.height * row / rows);
+    scissor.extent.width = swapchainExtent.width * (column + 1) / columns - (uint32_t)scissor.offset.x;
+    scissor.extent.height = swapchainExtent.height * (row + 1) / rows - (uint32_t)scissor.offset.y;
+
+    VkViewport viewport;
+    viewport.x = (float)scissor.offset.x + draw.layer * layerShift;
+    viewport.y = (float)scissor.offset.y + draw.layer * layerShift;
+    viewport.width = (float)scissor.extent.width;
+    viewport.height = (float)scissor.extent.height;
+    viewport.minDepth = draw.depth;
+    viewport.maxDepth = draw.depth + 1.0f / (depthLayers + 1.0f);
+
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
+
+// The material of a draw call, the only per-draw state besides the instance range
+void pushDrawConstants(VkCommandBuffer commandBuffer, uint32_t draw) {
+    DrawConstants constants;
+    constants.material = materialSlots[draw % materialCount];
+    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(constants), &constants);
+}
+
+// One draw per quad on screen, quads whose texture has no resident mip tail yet are left out
+void recordTexturedQuads(VkCommandBuffer commandBuffer) {
+    for (uint32_t i = 0; i < textureCount; ++i) {
+        uint32_t slot = textureStreamer.getSlot(i);
+        if (!texturedQuads[i].visible || slot == SlotAllocator::invalidSlot) {
+            continue;
+        }
+        QuadConstants constants = texturedQuads[i].constants;
+        constants.texture = slot;
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(constants), &constants);
+        vkCmdDraw(commandBuffer, 6, 1, 0, 0);
+    }
+}
+
+// The depth-only pass of --depth prepass comes first
+uint32_t getPassCount() {
+    return depthMode == DepthMode::PrePass ? 2 : 1;
+}
+
+VkPipeline getPassPipeline(uint32_t pass) {
+    return pass + 1 < getPassCount() ? depthPipeline : pipeline;
+}
+
+// Records the scene draws [firstDraw, endDraw) into every viewport, each range covers an equal share of the instances.
+// Dynamic state is not inherited by secondary command buffers, so every call sets the viewport itself.
+void recordDraws(VkCommandBuffer commandBuffer, VkPipeline passPipeline, uint32_t firstDraw, uint32_t endDraw) {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, passPipeline);
+    if (materialCount > 0 || textureCount > 0) {
+        bindlessTable.bind(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout);
+    }
+
+    for (uint32_t cell = 0; cell < viewportCount; ++cell) {
+        if (instanceCount > 0 && !gpuCullingEnabled) {
+            instancedBatch.bind(commandBuffer);
+        }
+        for (uint32_t i = firstDraw; i < endDraw; ++i) {
+            const SceneDraw &draw = sceneDraws[i];
+            setViewport(commandBuffer, cell, draw);
+
+            if (gpuCullingEnabled) {
+                if (materialCount > 0) {
+                    pushDrawConstants(commandBuffer, 0);
+                }
+                gpuCulling.recordDraw(commandBuffer);
+            } else if (instanceCount > 0) {
+                uint64_t amountOfInstances = instancedBatch.getDrawCount();
+                uint32_t begin = (uint32_t)(amountOfInstances * draw.range / drawCalls);
+                uint32_t end = (uint32_t)(amountOfInstances * (draw.range + 1) / drawCalls);
+                if (end > begin) {
+                    if (materialCount > 0) {
+                        pushDrawConstants(commandBuffer, draw.range);
+                    }
+                    instancedBatch.drawRange(commandBuffer, begin, end - begin);
+                }
+            } else if (particleCount > 0) {
+                particleSystem.recordDraw(commandBuffer);
+            } else if (textureCount > 0) {
+                recordTexturedQuads(commandBuffer);
+            } else if (!meshFile.empty()) {
+                meshAsset.record(commandBuffer);
+            } else {
+                vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+            }
+        }
+    }
+}
+
+// Every job records a contiguous range of the draw calls of one pass into its own secondary command buffer.
+// They are executed in job order, so the result does not depend on which worker took which job, and the
+// depth-only pass is complete before the first shaded draw.
+void recordSecondaries(VkCommandBuffer commandBuffer, VkFramebuffer framebuffer) {
+    VkCommandBufferInheritanceInfo inheritanceInfo;
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.pNext = nullptr;
+    inheritanceInfo.renderPass = renderPass;
+    inheritanceInfo.subpass = 0;
+    inheritanceInfo.framebuffer = framebuffer;
+    inheritanceInfo.occlusionQueryEnable = VK_FALSE;
+    inheritanceInfo.queryFlags = 0;
+    inheritanceInfo.pipelineStatistics = gpuTimer.getStatisticFlags();
+
+    uint32_t amountOfDraws = (uint32_t)sceneDraws.size();
+    uint32_t jobsPerPass = std::min(amountOfDraws, jobScheduler.getWorkerCount() * jobsPerWorker);
+    uint32_t amountOfJobs = jobsPerPass * getPassCount();
+    secondaryCommandBuffers.resize(amountOfJobs);
+
+    jobScheduler.run(amountOfJobs, [&](uint32_t worker, uint32_t job) {
+        PROFILE_ZONE("recordSecondary");
+        VkCommandBuffer secondary = parallelRecorder.beginSecondary(worker, inheritanceInfo);
+        uint32_t pass = job / jobsPerPass;
+        uint32_t passJob = job % jobsPerPass;
+        recordDraws(secondary, getPassPipeline(pass), (uint32_t)((uint64_t)amountOfDraws * passJob / jobsPerPass),
+            (uint32_t)((uint64_t)amountOfDraws * (passJob + 1) / jobsPerPass));
+        VkResult result = vkEndCommandBuffer(secondary);
+        ASSERT_VULKAN(result);
+        secondaryCommandBuffers[job] = secondary;
+    });
+
+    vkCmdExecuteCommands(commandBuffer, amountOfJobs, secondaryCommandBuffers.data());
+}
+
+void recordScene(VkCommandBuffer commandBuffer, const PassContext &context) {
+    if (recordThreads > 0) {
+        recordSecondaries(commandBuffer, context.framebuffer);
+        return;
+    }
+    for (uint32_t pass = 0; pass < getPassCount(); ++pass) {
+        recordDraws(commandBuffer, getPassPipeline(pass), 0, (uint32_t)sceneDraws.size());
+    }
+}
+
+void recordCommandBuffer(uint32_t frame, uint32_t imageIndex) {
+    PROFILE_ZONE("recordCommandBuffer");
+    VkCommandBuffer commandBuffer = commandBuffers[frame];
 
     VkCommandBufferBeginInfo commandBufferBeginInfo;
     commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     commandBufferBeginInfo.pNext = nullptr;
-    commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+    commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
     commandBufferBeginInfo.pInheritanceInfo = nullptr;
 
-    for (size_t i = 0; i < amountOfImagesInSwapChain; ++i) {
-        result = vkBeginCommandBuffer(commandBuffers[i], &commandBufferBeginInfo);
-        ASSERT_VULKAN(result);
+    VkResult result = vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
+    ASSERT_VULKAN(result);
 
-        VkRenderPassBeginInfo renderPassBeginInfo;
-        renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassBeginInfo.pNext = nullptr;
-        renderPassBeginInfo.renderPass = renderPass;
-        renderPassBeginInfo.framebuffer = framebuffers[i];
-        renderPassBeginInfo.renderArea.offset = {0, 0};
-        renderPassBeginInfo.renderArea.extent= {WIDTH, HEIGHT};
-        VkClearValue clearValue = { 0.0f, 0.0f, 0.0f, 1.0f };
-        renderPassBeginInfo.clearValueCount = 1;
-        renderPassBeginInfo.pClearValues = &clearValue;
+    uploader.recordAcquireBarriers(commandBuffer);
 
-        vkCmdBeginRenderPass(commandBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    // The swapchain image is the only imported resource, the depth buffer is a transient of the frame slot
+    renderGraphExecutor.bindImage(swapchainResource, swapchainImages[imageIndex], imageViews[imageIndex]);
+    uint32_t variant = !captureDirectory.empty() && frameCapture.wantsFrame(frameNumber) ? 1 : 0;
 
-        vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    gpuTimer.begin(commandBuffer, frame);
 
-        vkCmdDraw(commandBuffers[i], 3, 1, 0, 0);
+    // Inside the timed range as well, the uploads and mip copies are part of the GPU frame time
+    if (textureCount > 0) {
+        textureStreamer.recordUploads(commandBuffer, frame);
+    }
 
-        vkCmdEndRenderPass(commandBuffers[i]);
+    if (gpuCullingEnabled) {
+        gpuCulling.recordCulling(commandBuffer, instancedBatch.getDrawCount());
+    }
+    if (particleCount > 0 && !particleSystem.isAsync()) {
+        particleSystem.recordStep(commandBuffer);
+    }
 
-        result = vkEndCommandBuffer(commandBuffers[i]);
-        ASSERT_VULKAN(result);
+    // Inside the timed range, the GPU frame time includes the capture copy
+    renderGraphExecutor.execute(commandBuffer, frameGraphs[variant], compiledFrameGraphs[variant], frame, frameNumber);
+
+    if (gpuCullingEnabled) {
+        gpuCulling.recordReadback(commandBuffer, frame);
     }
 
-    VkSemaphoreCreateInfo semaphoreCreateInfo;
-    semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-    semaphoreCreateInfo.pNext = nullptr;
-    semaphoreCreateInfo.flags = 0;
+    gpuTimer.end(commandBuffer, frame);
 
-    result = vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphoreImageAvailable);
-    ASSERT_VULKAN(result);
-    result = vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphoreRenderingDone);
+    result = vkEndCommandBuffer(commandBuffer);
     ASSERT_VULKAN(result);
+}
 
-    delete[] swapchainImages;
-    delete[] layers;
-    delete[] extensions;
+void reportFrameStats(double waitTime) {
+    frameWaitTimeSum += waitTime;
+    frameWaitTimeMax = std::max(frameWaitTimeMax, waitTime);
+    ++framesSinceReport;
+
+    auto now = std::chrono::high_resolution_clock::now();
+    if (std::chrono::duration<double>(now - lastReport).count() < 1.0) {
+        return;
+    }
+
+    std::cout << "Frames in flight: " << framesInFlight << " | FPS: " << framesSinceReport <<
+        " | CPU wait avg: " << frameWaitTimeSum / framesSinceReport << " ms" <<
+        " | CPU wait max: " << frameWaitTimeMax << " ms" <<
+        " | CPU record avg: " << recordTimeSum / framesSinceReport << " ms" << std::endl;
+    gpuTimer.printReport();
+    // Fragments shaded per pixel, the depth-only pass has no fragment shader and does not count
+    if (pipelineStatistics) {
+        double pixels = (double)swapchainExtent.width * swapchainExtent.height;
+        std::cout << "Overdraw (last frame): " << gpuTimer.getFragmentInvocations() / pixels << " fragment shader invocations per pixel" << std::endl;
+    }
+    if (gpuCullingEnabled) {
+        gpuCulling.printReport();
+    }
+    if (!headless) {
+        presentStats.printReport(presentMode);
+    }
+    if (pipelineThreads > 0) {
+        pipelineCompiler.printReport();
+    }
+    if (!captureDirectory.empty()) {
+        frameCapture.printReport();
+    }
+    if (textureCount > 0) {
+        textureStreamer.printReport();
+    }
+    if (particleCount > 0) {
+        particleSystem.printReport();
+    }
+    if (renderThreadEnabled) {
+        frameStageStats.printReport(frameQueueDepth);
+    }
+
+    frameWaitTimeSum = 0.0;
+    frameWaitTimeMax = 0.0;
+    recordTimeSum = 0.0;
+    framesSinceReport = 0;
+    lastReport = now;
+}
+
+// Queues the next part of the upload stream without ever waiting for the transfer queue
+void streamGeometry() {
+    PROFILE_ZONE("streamGeometry");
+    VkDeviceSize streamSize = (VkDeviceSize)streamUploadMiB * 1024 * 1024;
+
+    if (streamQueued == 0) {
+        streamStart = std::chrono::high_resolution_clock::now();
+    }
+
+    VkDeviceSize budget = streamBudgetPerFrame;
+    while (budget > 0 && streamQueued < streamSize) {
+        VkDeviceSize sourceOffset = streamQueued % streamSource.size();
+        VkDeviceSize size = std::min({ budget, streamSize - streamQueued, (VkDeviceSize)streamSource.size() - sourceOffset });
+
+        VkDeviceSize queued = uploader.tryUpload(streamBuffer, streamQueued, streamSource.data() + sourceOffset, size, streamTicket);
+        if (queued == 0) {
+            break; // ring full, continue next frame
+        }
+        streamQueued += queued;
+        budget -= queued;
+    }
+}
+
+void reportStreamStats() {
+    if (streamDone || streamQueued < (VkDeviceSize)streamUploadMiB * 1024 * 1024 || !uploader.isComplete(streamTicket)) {
+        return;
+    }
+    streamDone = true;
+
+    double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - streamStart).count();
+    std::cout << "Streamed " << streamUploadMiB << " MiB in " << seconds << " s (" << streamUploadMiB / seconds << " MiB/s) | " <<
+        uploader.getBatchesSubmitted() << " batches | " << uploader.getStalls() << " stalls" << std::endl;
 }
 
 void drawFrame() {
+    PROFILE_ZONE("drawFrame");
+    auto waitStart = std::chrono::high_resolution_clock::now();
+
+    // Wait until the GPU is done with the resources of this frame slot
+    VkResult result;
+    {
+        PROFILE_ZONE("waitForFrameFence");
+        result = vkWaitForFences(device, 1, &fencesInFlight[currentFrame], VK_TRUE, std::numeric_limits<uint64_t>::max());
+        ASSERT_VULKAN(result);
+    }
+
+    double waitTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - waitStart).count();
+    releaseRetiredSwapchains();
+
     uint32_t imageIndex;
-    VkResult result = vkAcquireNextImageKHR(device, swapchain, std::numeric_limits<uint64_t>::max(), semaphoreImageAvailable, VK_NULL_HANDLE, &imageIndex);
-    ASSERT_VULKAN(result);
+    auto acquireStart = std::chrono::high_resolution_clock::now();
+    double acquireTime = 0.0;
+    if (headless) {
+        // Offscreen images are used round robin
+        imageIndex = nextOffscreenImage;
+        nextOffscreenImage = (nextOffscreenImage + 1) % amountOfImagesInSwapChain;
+    } else {
+        PROFILE_ZONE("acquire");
+        if (swapchainDirty) {
+            recreateSwapchain();
+        }
+        acquireStart = std::chrono::high_resolution_clock::now();
+        result = vkAcquireNextImageKHR(device, swapchain, std::numeric_limits<uint64_t>::max(), semaphoresImageAvailable[currentFrame], VK_NULL_HANDLE, &imageIndex);
+        if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+            // Nothing was acquired and the semaphore stays unsignaled, try again next frame with the new swapchain
+            recreateSwapchain();
+            return;
+        }
+        // SUBOPTIMAL still acquired an image, it is rendered and presented before the swapchain is recreated
+        if (result != VK_SUBOPTIMAL_KHR) {
+            ASSERT_VULKAN(result);
+        }
+        acquireTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - acquireStart).count();
+    }
+
+    // With more frames in flight than swapchain images an older frame may still render into this image
+    if (imagesInFlight[imageIndex] != VK_NULL_HANDLE) {
+        PROFILE_ZONE("waitForImageFence");
+        waitStart = std::chrono::high_resolution_clock::now();
+        result = vkWaitForFences(device, 1, &imagesInFlight[imageIndex], VK_TRUE, std::numeric_limits<uint64_t>::max());
+        ASSERT_VULKAN(result);
+        waitTime += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - waitStart).count();
+    }
+    imagesInFlight[imageIndex] = fencesInFlight[currentFrame];
+
+    // The fence signaled, so the queries and transient memory of this frame slot are free again
+    gpuTimer.collect(currentFrame);
+    if (gpuCullingEnabled) {
+        gpuCulling.collect(currentFrame);
+    }
+    if (!captureDirectory.empty()) {
+        frameCapture.collect(currentFrame);
+    }
+    if (particleCount > 0) {
+        uint64_t graphicsBegin = 0;
+        uint64_t graphicsEnd = 0;
+        bool graphicsTicksValid = gpuTimer.getLastFrameTicks(graphicsBegin, graphicsEnd);
+        particleSystem.beginFrame(currentFrame, particleTimeStep, graphicsTicksValid, graphicsBegin, graphicsEnd);
+    }
+    memoryAllocator.beginFrame(currentFrame);
+    if (recordThreads > 0) {
+        parallelRecorder.beginFrame(currentFrame);
+    }
+    if (textureCount > 0) {
+        updateTexturedQuads();
+        textureStreamer.update(currentFrame, frameNumber);
+    }
+
+    reportFrameStats(waitTime);
+
+    uploader.poll();
+    if (streamUploadMiB > 0) {
+        streamGeometry();
+    }
+    uploader.flush();
+    updatePipeline();
+
+    auto recordStart = std::chrono::high_resolution_clock::now();
+    recordCommandBuffer(currentFrame, imageIndex);
+    recordTimeSum += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - recordStart).count();
+    reportStreamStats();
+
+    // Nothing to acquire or present without a swapchain. Async particles add the step the frame draws and the
+    // semaphore the next step waits for before it overwrites the drawn positions.
+    VkSemaphore waitSemaphores[2];
+    VkPipelineStageFlags waitStageMask[2];
+    VkSemaphore signalSemaphores[2];
+    uint32_t waitCount = 0;
+    uint32_t signalCount = 0;
+    if (!headless) {
+        waitSemaphores[waitCount] = semaphoresImageAvailable[currentFrame];
+        waitStageMask[waitCount++] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        signalSemaphores[signalCount++] = semaphoresRenderingDone[currentFrame];
+    }
+    if (particleCount > 0 && particleSystem.isAsync()) {
+        particleSystem.submitStep();
+        if (particleSystem.getWaitSemaphore() != VK_NULL_HANDLE) {
+            waitSemaphores[waitCount] = particleSystem.getWaitSemaphore();
+            waitStageMask[waitCount++] = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+        }
+        signalSemaphores[signalCount++] = particleSystem.getSignalSemaphore();
+    }
 
     VkSubmitInfo submitInfo;
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
     submitInfo.pNext = nullptr;
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = &semaphoreImageAvailable;   
-    VkPipelineStageFlags waitStageMask[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+    submitInfo.waitSemaphoreCount = waitCount;
+    submitInfo.pWaitSemaphores = waitSemaphores;
     submitInfo.pWaitDstStageMask = waitStageMask;
     submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &(commandBuffers[imageIndex]);
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = &semaphoreRenderingDone;
+    submitInfo.pCommandBuffers = &(commandBuffers[currentFrame]);
+    submitInfo.signalSemaphoreCount = signalCount;
+    submitInfo.pSignalSemaphores = signalSemaphores;
 
-    result = vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+    result = vkResetFences(device, 1, &fencesInFlight[currentFrame]);
     ASSERT_VULKAN(result);
 
-    VkPresentInfoKHR presentInfo;
-    presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-    presentInfo.pNext = nullptr;
-    presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = &semaphoreRenderingDone;
-    presentInfo.swapchainCount = 1;
-    presentInfo.pSwapchains = &swapchain;
-    presentInfo.pImageIndices = &imageIndex;
-    presentInfo.pResults = nullptr;
-
-    result = vkQueuePresentKHR(queue, &presentInfo);
+    {
+        PROFILE_ZONE("submit");
+        result = vkQueueSubmit(queue, 1, &submitInfo, fencesInFlight[currentFrame]);
+        ASSERT_VULKAN(result);
+    }
+
+    if (!headless) {
+        PROFILE_ZONE("present");
+        VkPresentInfoKHR presentInfo;
+        presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+        presentInfo.pNext = nullptr;
+        presentInfo.waitSemaphoreCount = 1;
+        presentInfo.pWaitSemaphores = &semaphoresRenderingDone[currentFrame];
+        presentInfo.swapchainCount = 1;
+        presentInfo.pSwapchains = &swapchain;
+        presentInfo.pImageIndices = &imageIndex;
+        presentInfo.pResults = nullptr;
+
+        result = vkQueuePresentKHR(presentQueue, &presentInfo);
+        if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+            swapchainDirty = true;
+        } else {
+            ASSERT_VULKAN(result);
+        }
+        presentStats.record(presentMode, acquireTime,
+            std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - acquireStart).count());
+    }
+
+    if (frameNumber == 0) {
+        std::cout << "Time to first frame: " <<
+            std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - programStart).count() << " ms" << std::endl;
+    }
+    ++frameNumber;
+    currentFrame = (currentFrame + 1) % framesInFlight;
+}
+
+void startInstanceSweep() {
+    for (uint32_t count = 1; count < instanceCount; count *= 10) {
+        sweepCounts.push_back(count);
+    }
+    sweepCounts.push_back(instanceCount);
+    sweepStep = 0;
+    instancedBatch.setDrawCount(sweepCounts[0]);
+}
+
+// Prints the result of the current sweep step and switches to the next instance count, false after the last step.
+// The GPU time is the average of the last frames of the step, so the frames in flight with the old count hardly count.
+bool advanceInstanceSweep(double stepSeconds) {
+    uint32_t count = sweepCounts[sweepStep];
+    double gpuTime = gpuTimer.averageFrameTime();
+    std::cout << "Instance sweep: " << count << " instances | GPU " << gpuTime << " ms | CPU " << stepSeconds * 1000.0 / sweepFramesPerStep <<
+        " ms per frame | " << (gpuTime > 0.0 ? count / gpuTime / 1000.0 : 0.0) << " M triangles/sec" << std::endl;
+
+    if (++sweepStep == sweepCounts.size()) {
+        return false;
+    }
+    instancedBatch.setDrawCount(sweepCounts[sweepStep]);
+    gpuTimer.clearHistory();
+    return true;
+}
+
+// Main thread. A minimized window has no area to present to, so no frames are made until it is restored.
+void waitWhileMinimized() {
+    int width = 0;
+    int height = 0;
+    glfwGetFramebufferSize(window, &width, &height);
+    while ((width == 0 || height == 0) && !glfwWindowShouldClose(window)) {
+        glfwWaitEvents();
+        glfwGetFramebufferSize(window, &width, &height);
+    }
+}
+
+// Main thread. The simulation step of a frame, it hands the events since the last packet to the render side.
+FramePacket simulateFrame() {
+    PROFILE_ZONE("simulateFrame");
+    auto start = std::chrono::high_resolution_clock::now();
+
+    FramePacket packet;
+    packet.sequence = packetSequence++;
+    packet.windowExtent = VkExtent2D{ WIDTH, HEIGHT };
+    if (!headless) {
+        packet.quit = glfwWindowShouldClose(window);
+        packet.resized = pendingResize;
+        packet.cyclePresentMode = pendingPresentModeCycle;
+        int width = 0;
+        int height = 0;
+        glfwGetFramebufferSize(window, &width, &height);
+        packet.windowExtent = VkExtent2D{ (uint32_t)width, (uint32_t)height };
+    }
+    pendingResize = false;
+    pendingPresentModeCycle = false;
+
+    packet.produced = std::chrono::high_resolution_clock::now();
+    packet.simulationTime = std::chrono::duration<double, std::milli>(packet.produced - start).count();
+    return packet;
+}
+
+// Render side. Applies the events of the packet and draws the frame, false once --frames or the instance sweep is done.
+bool renderFrame(const FramePacket &packet) {
+    auto popped = std::chrono::high_resolution_clock::now();
+    if (packet.cyclePresentMode) {
+        requestedPresentMode = nextPresentMode(physicalDevice, surface, presentMode);
+        swapchainDirty = true;
+    }
+    if (packet.resized) {
+        swapchainDirty = true;
+    }
+    windowExtent = packet.windowExtent;
+
+    drawFrame();
+    ++renderedFrames;
+    frameStageStats.record(packet, popped, std::chrono::high_resolution_clock::now());
+
+    if (instanceSweep && renderedFrames % sweepFramesPerStep == 0) {
+        auto now = std::chrono::high_resolution_clock::now();
+        if (!advanceInstanceSweep(std::chrono::duration<double>(now - sweepStepStart).count())) {
+            return false;
+        }
+        sweepStepStart = now;
+    }
+    return maxFrames == 0 || renderedFrames < maxFrames;
+}
+
+// Yields first and sleeps once the wait gets longer, so a waiting thread does not burn a whole core
+void backoff(uint32_t &spins) {
+    if (++spins < 64) {
+        std::this_thread::yield();
+    } else {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+}
+
+// Render thread. Runs until the quit packet or until the render side is done.
+void renderLoop() {
+    Profiler::setThreadName("Render");
+    FramePacket packet;
+    uint32_t spins = 0;
+    while (true) {
+        if (!frameQueue.tryPop(packet)) {
+            backoff(spins);
+            continue;
+        }
+        spins = 0;
+        PROFILE_ZONE("frame");
+        if (packet.quit || !renderFrame(packet)) {
+            break;
+        }
+    }
+    renderFinished.store(true, std::memory_order_release);
+}
+
+// Main thread with --render-thread. Events are handled while the queue is full and while the render thread
+// waits in vkAcquireNextImageKHR, a slow event callback only delays the next packet.
+void runRenderThread() {
+    frameQueue.init(frameQueueDepth);
+    renderFinished.store(false);
+    std::thread renderThread(renderLoop);
+
+    bool quitSent = false;
+    uint32_t spins = 0;
+    while (!renderFinished.load(std::memory_order_acquire)) {
+        bool full = frameQueue.size() == frameQueue.getCapacity();
+        if (!headless) {
+            PROFILE_ZONE("glfwPollEvents");
+            if (full || quitSent) {
+                glfwWaitEventsTimeout(0.001);
+            } else {
+                glfwPollEvents();
+            }
+            waitWhileMinimized();
+        } else if (full) {
+            backoff(spins);
+        }
+        if (full || quitSent) {
+            continue;
+        }
+        spins = 0;
+
+        // Only this thread pushes, so the slot seen above is still free
+        FramePacket packet = simulateFrame();
+        packet.queueOccupancy = frameQueue.size();
+        frameQueue.tryPush(packet);
+        quitSent = packet.quit;
+    }
+    renderThread.join();
+}
+
+// Waits for the fences of all frames in flight and for the presents queued by them, afterwards nothing submitted by
+// drawFrame() is in use anymore. The uploader and the other modules wait for their own submissions when they are
+// destroyed, so the device does not have to go idle.
+void finishFrames() {
+    PROFILE_ZONE("finishFrames");
+    VkResult result = vkWaitForFences(device, framesInFlight, fencesInFlight, VK_TRUE, std::numeric_limits<uint64_t>::max());
     ASSERT_VULKAN(result);
+    if (!headless) {
+        result = vkQueueWaitIdle(presentQueue); // the presents wait on the rendering done semaphores
+        ASSERT_VULKAN(result);
+    }
 }
 
 void gameLoop()
 {
-    while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
-        drawFrame();
+    auto startTime = std::chrono::high_resolution_clock::now();
+    lastReport = startTime;
+    renderedFrames = 0;
+
+    if (instanceSweep) {
+        startInstanceSweep();
+    }
+    sweepStepStart = startTime;
+
+    if (renderThreadEnabled) {
+        runRenderThread();
+    } else {
+        while (true) {
+            PROFILE_ZONE("frame");
+            if (!headless) {
+                PROFILE_ZONE("glfwPollEvents");
+                glfwPollEvents();
+                waitWhileMinimized();
+            }
+            FramePacket packet = simulateFrame();
+            if (packet.quit || !renderFrame(packet)) {
+                break;
+            }
+        }
+    }
+
+    // Include the frames still in flight so the result is the sustained throughput
+    finishFrames();
+
+    double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+    std::cout << "Rendered " << renderedFrames << " frames in " << seconds << " s (" << renderedFrames / seconds << " frames/sec)" << std::endl;
+    if (!headless) {
+        presentStats.printSummary();
+    }
+    if (renderThreadEnabled) {
+        frameStageStats.printSummary(frameQueueDepth);
     }
 }
 
 void shutdownVulkan()
 {
-    vkDeviceWaitIdle(device);
+    // Nothing is submitted anymore, only the frames still in flight have to be waited for
+    finishFrames();
 
-    vkDestroySemaphore(device, semaphoreImageAvailable, nullptr);
-    vkDestroySemaphore(device, semaphoreRenderingDone, nullptr);
+    if (pipelineThreads > 0) {
+        pipelineCompiler.stop();
+    }
+    if (frameCapture.isRunning()) {
+        frameCapture.stop();
+    }
+    pipelineCache.save();
+    pipelineCache.destroy();
+    gpuTimer.destroy();
+    if (recordThreads > 0) {
+        jobScheduler.stop();
+        parallelRecorder.destroy();
+    }
+    if (gpuCullingEnabled) {
+        gpuCulling.destroy(memoryAllocator);
+    }
+    if (particleCount > 0) {
+        particleSystem.destroy(memoryAllocator);
+    }
+    if (instanceCount > 0) {
+        instancedBatch.destroy(memoryAllocator);
+    }
+    meshAsset.destroy(memoryAllocator);
+    uploader.destroy();
+    if (streamBuffer != VK_NULL_HANDLE) {
+        memoryAllocator.destroyBuffer(streamBuffer, streamBufferAllocation);
+    }
+    if (materialCount > 0) {
+        destroyMaterials();
+    }
+    if (textureCount > 0) {
+        stopTextureStreaming();
+    }
 
-    vkFreeCommandBuffers(device, commandPool, amountOfImagesInSwapChain, commandBuffers);
+    for (uint32_t i = 0; i < framesInFlight; ++i) {
+        vkDestroySemaphore(device, semaphoresImageAvailable[i], nullptr);
+        vkDestroySemaphore(device, semaphoresRenderingDone[i], nullptr);
+        vkDestroyFence(device, fencesInFlight[i], nullptr);
+    }
+    delete[] semaphoresImageAvailable;
+    delete[] semaphoresRenderingDone;
+    delete[] fencesInFlight;
+    delete[] imagesInFlight;
+
+    vkFreeCommandBuffers(device, commandPool, framesInFlight, commandBuffers);
     delete[] commandBuffers;
 
     vkDestroyCommandPool(device, commandPool, nullptr);
-    for (size_t i = 0; i < amountOfImagesInSwapChain; ++i) {
-        vkDestroyFramebuffer(device, framebuffers[i], nullptr);
+    for (RetiredSwapchain &retired : retiredSwapchains) {
+        destroyRetiredSwapchain(retired);
     }
-    delete[] framebuffers;
+    renderGraphExecutor.printStats();
+    renderGraphExecutor.destroy();
+    framebufferCache.printStats();
+    framebufferCache.destroy();
 
-    vkDestroyPipeline(device, pipeline, nullptr);
-    vkDestroyRenderPass(device, renderPass, nullptr);
+    pipelineVariants.destroy();
+    renderPassCache.printStats();
+    renderPassCache.destroy();
 
     // Destroy after all tasks done
     for (uint32_t i = 0; i < amountOfImagesInSwapChain; ++i) {
@@ -724,9 +2060,22 @@ void shutdownVulkan()
     vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
     vkDestroyShaderModule(device, shaderModuleVert, nullptr);
     vkDestroyShaderModule(device, shaderModuleFrag, nullptr);
-    vkDestroySwapchainKHR(device, swapchain, nullptr);
+
+    if (headless) {
+        for (uint32_t i = 0; i < amountOfOffscreenImages; ++i) {
+            memoryAllocator.destroyImage(offscreenImages[i], offscreenImagesAllocations[i]);
+        }
+        delete[] offscreenImages;
+        delete[] offscreenImagesAllocations;
+    } else {
+        vkDestroySwapchainKHR(device, swapchain, nullptr);
+    }
+
+    memoryAllocator.destroy();
     vkDestroyDevice(device, nullptr);
-    vkDestroySurfaceKHR(instance, surface, nullptr);
+    if (!headless) {
+        vkDestroySurfaceKHR(instance, surface, nullptr);
+    }
     vkDestroyInstance(instance, nullptr);
 }
 
@@ -735,13 +2084,198 @@ void shutdownGLFW()
     glfwDestroyWindow(window);
 }
 
-int main() {
+void parseArguments(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+
+        if (argument == "--frames-in-flight" && i + 1 < argc) {
+            framesInFlight = std::max(1, std::stoi(argv[++i]));
+        } else if (argument == "--headless") {
+            headless = true;
+        } else if (argument == "--render-thread") {
+            renderThreadEnabled = true;
+        } else if (argument == "--frame-queue-depth" && i + 1 < argc) {
+            frameQueueDepth = std::max(1, std::stoi(argv[++i]));
+        } else if (argument == "--frames" && i + 1 < argc) {
+            maxFrames = std::max(0, std::stoi(argv[++i]));
+        } else if (argument == "--device" && i + 1 < argc) {
+            deviceOverride = argv[++i];
+        } else if (argument == "--instances" && i + 1 < argc) {
+            instanceCount = std::max(0, std::stoi(argv[++i]));
+        } else if (argument == "--instance-layout" && i + 1 < argc) {
+            instanceLayout = std::string(argv[++i]) == "soa" ? InstanceLayout::SoA : InstanceLayout::AoS;
+        } else if (argument == "--instance-format" && i + 1 < argc) {
+            instanceFormat = std::string(argv[++i]) == "full" ? InstanceFormat::Full : InstanceFormat::Packed;
+        } else if (argument == "--instance-sweep") {
+            instanceSweep = true;
+        } else if (argument == "--record-threads" && i + 1 < argc) {
+            recordThreads = std::max(0, std::stoi(argv[++i]));
+        } else if (argument == "--draws" && i + 1 < argc) {
+            drawCalls = std::max(1, std::stoi(argv[++i]));
+        } else if (argument == "--viewports" && i + 1 < argc) {
+            viewportCount = std::max(1, std::stoi(argv[++i]));
+        } else if (argument == "--materials" && i + 1 < argc) {
+            materialCount = std::min(bindlessBufferCapacity, (uint32_t)std::max(0, std::stoi(argv[++i])));
+        } else if (argument == "--particles" && i + 1 < argc) {
+            particleCount = std::max(0, std::stoi(argv[++i]));
+        } else if (argument == "--particle-queue" && i + 1 < argc) {
+            particlesOnComputeQueue = std::string(argv[++i]) != "graphics";
+        } else if (argument == "--textures" && i + 1 < argc) {
+            // Every texture takes a second slot while its residency changes
+            textureCount = std::min(bindlessImageCapacity / 2, (uint32_t)std::max(0, std::stoi(argv[++i])));
+        } else if (argument == "--texture-size" && i + 1 < argc) {
+            textureSize = 1u << (uint32_t)std::log2(std::max(1, std::stoi(argv[++i])));
+        } else if (argument == "--texture-budget" && i + 1 < argc) {
+            textureBudgetMiB = std::max(0, std::stoi(argv[++i]));
+        } else if (argument == "--decode-threads" && i + 1 < argc) {
+            decodeThreads = std::max(1, std::stoi(argv[++i]));
+        } else if (argument == "--layers" && i + 1 < argc) {
+            depthLayers = std::max(1, std::stoi(argv[++i]));
+        } else if (argument == "--sort-draws") {
+            sortDraws = true;
+        } else if (argument == "--depth" && i + 1 < argc) {
+            std::string mode = argv[++i];
+            if (mode == "off") {
+                depthMode = DepthMode::Off;
+            } else if (mode == "test") {
+                depthMode = DepthMode::Test;
+            } else if (mode == "prepass") {
+                depthMode = DepthMode::PrePass;
+            } else {
+                std::cerr << "Unknown depth mode '" << mode << "'" << std::endl;
+            }
+        } else if (argument == "--gpu-culling") {
+            gpuCullingEnabled = true;
+        } else if (argument == "--cull-region" && i + 1 < argc) {
+            cullRegion = std::max(0.01f, std::stof(argv[++i]));
+        } else if (argument == "--allocator-bench") {
+            allocatorBench = true;
+        } else if (argument == "--render-graph-check") {
+            renderGraphCheck = true;
+        } else if (argument == "--dump-render-graph") {
+            dumpRenderGraph = true;
+        } else if (argument == "--transform-bench") {
+            transformBench = true;
+        } else if (argument == "--mesh" && i + 1 < argc) {
+            meshFile = argv[++i];
+        } else if (argument == "--convert-mesh" && i + 2 < argc) {
+            convertMeshInput = argv[++i];
+            convertMeshOutput = argv[++i];
+        } else if (argument == "--mesh-format" && i + 1 < argc) {
+            convertMeshFormat = std::string(argv[++i]) == "float" ? MeshVertexFormat::Float : MeshVertexFormat::Quantized;
+        } else if (argument == "--mesh-bench" && i + 1 < argc) {
+            meshBenchSource = argv[++i];
+        } else if (argument == "--stream-upload" && i + 1 < argc) {
+            streamUploadMiB = std::max(0, std::stoi(argv[++i]));
+        } else if (argument == "--present-policy" && i + 1 < argc) {
+            if (!parsePresentPolicy(argv[++i], presentPolicy)) {
+                std::cerr << "Unknown present policy '" << argv[i] << "'" << std::endl;
+            }
+        } else if (argument == "--present-mode" && i + 1 < argc) {
+            if (!parsePresentMode(argv[++i], requestedPresentMode)) {
+                std::cerr << "Unknown present mode '" << argv[i] << "'" << std::endl;
+            }
+        } else if (argument == "--shader-source" && i + 1 < argc) {
+            shaderSource = std::string(argv[++i]) == "file" ? ShaderSource::Mapped : ShaderSource::Embedded;
+        } else if (argument == "--shading-iterations" && i + 1 < argc) {
+            shadingIterations = std::max(0, std::stoi(argv[++i]));
+        } else if (argument == "--grayscale") {
+            grayscale = true;
+        } else if (argument == "--prebuild-variants") {
+            prebuildVariants = true;
+        } else if (argument == "--pipeline-threads" && i + 1 < argc) {
+            pipelineThreads = std::max(0, std::stoi(argv[++i]));
+        } else if (argument == "--capture" && i + 1 < argc) {
+            captureDirectory = argv[++i];
+        } else if (argument == "--capture-every" && i + 1 < argc) {
+            captureInterval = std::max(1, std::stoi(argv[++i]));
+        } else if (argument == "--capture-format" && i + 1 < argc) {
+            captureFormat = std::string(argv[++i]) == "raw" ? CaptureFormat::Raw : CaptureFormat::Png;
+        } else if (argument == "--pipeline-statistics") {
+            pipelineStatistics = true;
+        } else if (argument == "--profile" && i + 1 < argc) {
+            profileFile = argv[++i];
+            Profiler::enable();
+        } else {
+            std::cerr << "Unknown argument '" << argument << "'" << std::endl;
+        }
+    }
+
+    if (particleCount > 0 && (textureCount > 0 || instanceCount > 0 || instanceSweep || gpuCullingEnabled || materialCount > 0 || !meshFile.empty() || drawCalls > 1)) {
+        std::cout << "--particles draws the particles only, ignoring the texture, instance, culling, material, mesh and --draws options" << std::endl;
+        textureCount = 0;
+        instanceCount = 0;
+        instanceSweep = false;
+        gpuCullingEnabled = false;
+        materialCount = 0;
+        meshFile.clear();
+        drawCalls = 1;
+    }
+    if (textureCount > 0 && (instanceCount > 0 || instanceSweep || gpuCullingEnabled || materialCount > 0 || !meshFile.empty() || drawCalls > 1)) {
+        std::cout << "--textures draws one quad per texture, ignoring the instance, culling, material, mesh and --draws options" << std::endl;
+        instanceCount = 0;
+        instanceSweep = false;
+        gpuCullingEnabled = false;
+        materialCount = 0;
+        meshFile.clear();
+        drawCalls = 1;
+    }
+    if (!meshFile.empty() && (instanceCount > 0 || instanceSweep || gpuCullingEnabled || materialCount > 0 || drawCalls > 1)) {
+        std::cout << "--mesh draws one call per chunk, ignoring the instance, culling, material and --draws options" << std::endl;
+        instanceCount = 0;
+        instanceSweep = false;
+        gpuCullingEnabled = false;
+        materialCount = 0;
+        drawCalls = 1;
+    }
+    if (gpuCullingEnabled && (recordThreads > 0 || drawCalls > 1)) {
+        std::cout << "--gpu-culling draws with a single indirect call, ignoring --record-threads and --draws" << std::endl;
+        recordThreads = 0;
+        drawCalls = 1;
+    }
+    if ((instanceSweep || gpuCullingEnabled || materialCount > 0) && instanceCount == 0) {
+        instanceCount = 1000000;
+    }
+    if (headless && maxFrames == 0 && !instanceSweep) {
+        maxFrames = defaultHeadlessFrames;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    programStart = std::chrono::high_resolution_clock::now();
 
-    startGLFW();
+    parseArguments(argc, argv);
+    if (allocatorBench) {
+        return runAllocatorBench() ? 0 : 1;
+    }
+    if (transformBench) {
+        return runTransformBench() ? 0 : 1;
+    }
+    if (renderGraphCheck) {
+        return runRenderGraphCheck() ? 0 : 1;
+    }
+    if (!meshBenchSource.empty()) {
+        return runMeshBench(meshBenchSource) ? 0 : 1;
+    }
+    if (!convertMeshInput.empty()) {
+        return convertMesh(convertMeshInput, convertMeshOutput, convertMeshFormat) ? 0 : 1;
+    }
+    Profiler::setThreadName("Main");
+    if (!headless) {
+        startGLFW();
+    }
     startVulkan();
     gameLoop();
     shutdownVulkan();
-    shutdownGLFW();
+    if (!headless) {
+        shutdownGLFW();
+    }
+
+    if (Profiler::isEnabled()) {
+        Profiler::writeChromeTrace(profileFile);
+        Profiler::printSummary();
+    }
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,108 @@
+#include "MappedFile.h"
+
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(MappedFile &&other) noexcept {
+    *this = std::move(other);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+    if (this != &other) {
+        close();
+        mapping = other.mapping;
+        size = other.size;
+        other.mapping = nullptr;
+        other.size = 0;
+#ifdef _WIN32
+        fileHandle = other.fileHandle;
+        mappingHandle = other.mappingHandle;
+        other.fileHandle = nullptr;
+        other.mappingHandle = nullptr;
+#endif
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+void MappedFile::open(const std::string &file) {
+    close();
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(file.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Failed to open file '" + file + "' !");
+    }
+    fileHandle = handle;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(handle, &fileSize) || fileSize.QuadPart == 0) {
+        close();
+        throw std::runtime_error("Failed to get the size of '" + file + "' !");
+    }
+
+    mappingHandle = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mappingHandle != nullptr) {
+        mapping = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    }
+    if (mapping == nullptr) {
+        close();
+        throw std::runtime_error("Failed to map file '" + file + "' !");
+    }
+    size = (size_t)fileSize.QuadPart;
+#else
+    int fileDescriptor = ::open(file.c_str(), O_RDONLY);
+    if (fileDescriptor < 0) {
+        throw std::runtime_error("Failed to open file '" + file + "' !");
+    }
+    struct stat fileStat;
+    if (fstat(fileDescriptor, &fileStat) != 0 || fileStat.st_size == 0) {
+        ::close(fileDescriptor);
+        throw std::runtime_error("Failed to get the size of '" + file + "' !");
+    }
+
+    void *view = mmap(nullptr, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+    ::close(fileDescriptor); // the mapping keeps the file alive
+    if (view == MAP_FAILED) {
+        throw std::runtime_error("Failed to map file '" + file + "' !");
+    }
+    madvise(view, (size_t)fileStat.st_size, MADV_SEQUENTIAL);
+    mapping = view;
+    size = (size_t)fileStat.st_size;
+#endif
+}
+
+void MappedFile::close() {
+#ifdef _WIN32
+    if (mapping != nullptr) {
+        UnmapViewOfFile(mapping);
+    }
+    if (mappingHandle != nullptr) {
+        CloseHandle(mappingHandle);
+    }
+    if (fileHandle != nullptr) {
+        CloseHandle(fileHandle);
+    }
+    fileHandle = nullptr;
+    mappingHandle = nullptr;
+#else
+    if (mapping != nullptr) {
+        munmap(mapping, size);
+    }
+#endif
+    mapping = nullptr;
+    size = 0;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Read-only mapping of a whole file. Pages are read by the OS on first access, nothing is copied
+// into the process heap. Shared by the shader loader and the mesh loader.
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile &operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+    ~MappedFile();
+
+    // Hints sequential access to the OS. Throws std::runtime_error if the file can not be opened, is empty or can not be mapped.
+    void open(const std::string &file);
+    void close();
+
+    bool isOpen() const { return mapping != nullptr; }
+    const void *getData() const { return mapping; }
+    size_t getSize() const { return size; }
+
+private:
+    void *mapping = nullptr; // start of the mapped view
+    size_t size = 0;
+#ifdef _WIN32
+    void *fileHandle = nullptr;
+    void *mappingHandle = nullptr;
+#endif
+};
@@ -0,0 +1,301 @@
+#include "MemoryAllocator.h"
+
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include "VulkanUtils.h"
+
+namespace {
+    VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    double toMiB(VkDeviceSize bytes) {
+        return bytes / (1024.0 * 1024.0);
+    }
+}
+
+void MemoryAllocator::init(VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize blockSize) {
+    this->device = device;
+    this->blockSize = blockSize;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    limits = properties.limits;
+
+    pools.resize(memoryProperties.memoryTypeCount * 2);
+    for (uint32_t i = 0; i < pools.size(); ++i) {
+        pools[i].memoryType = i / 2;
+        pools[i].kind = i % 2 == 0 ? ResourceKind::Linear : ResourceKind::Optimal;
+    }
+}
+
+void MemoryAllocator::destroy() {
+    if (frameRingBuffer != VK_NULL_HANDLE) {
+        destroyBuffer(frameRingBuffer, frameRingAllocation);
+    }
+
+    if (allocationCount > 0) {
+        std::cerr << "Memory allocator: " << allocationCount << " allocations were not freed" << std::endl;
+    }
+
+    for (Pool &pool : pools) {
+        for (auto &block : pool.blocks) {
+            if (block) {
+                freeDeviceMemory(block->memory, pool.memoryType, block->tlsf.getCapacity());
+            }
+        }
+        pool.blocks.clear();
+    }
+}
+
+uint32_t MemoryAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i) {
+        if ((typeFilter & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+
+    throw std::runtime_error("Failed to find a suitable memory type!");
+}
+
+bool MemoryAllocator::isHostVisible(uint32_t memoryType) const {
+    return (memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+}
+
+VkDeviceMemory MemoryAllocator::allocateDeviceMemory(VkDeviceSize size, uint32_t memoryType, void **mapped) {
+    VkMemoryAllocateInfo memoryAllocateInfo;
+    memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    memoryAllocateInfo.pNext = nullptr;
+    memoryAllocateInfo.allocationSize = size;
+    memoryAllocateInfo.memoryTypeIndex = memoryType;
+
+    VkDeviceMemory memory;
+    VkResult result = vkAllocateMemory(device, &memoryAllocateInfo, nullptr, &memory);
+    ASSERT_VULKAN(result);
+
+    ++deviceMemoryCount;
+    reservedPerHeap[memoryProperties.memoryTypes[memoryType].heapIndex] += size;
+    if (deviceMemoryCount > limits.maxMemoryAllocationCount) {
+        std::cerr << "Memory allocator: " << deviceMemoryCount << " device memory allocations exceed maxMemoryAllocationCount " <<
+            limits.maxMemoryAllocationCount << std::endl;
+    }
+
+    *mapped = nullptr;
+    if (isHostVisible(memoryType)) {
+        result = vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, mapped);
+        ASSERT_VULKAN(result);
+    }
+    return memory;
+}
+
+void MemoryAllocator::freeDeviceMemory(VkDeviceMemory memory, uint32_t memoryType, VkDeviceSize size) {
+    // Freeing implicitly unmaps the memory
+    vkFreeMemory(device, memory, nullptr);
+    --deviceMemoryCount;
+    reservedPerHeap[memoryProperties.memoryTypes[memoryType].heapIndex] -= size;
+}
+
+Allocation MemoryAllocator::allocate(const VkMemoryRequirements &memoryRequirements, VkMemoryPropertyFlags properties, ResourceKind kind) {
+    Allocation allocation;
+    allocation.memoryType = findMemoryType(memoryRequirements.memoryTypeBits, properties);
+    const VkMemoryType &memoryType = memoryProperties.memoryTypes[allocation.memoryType];
+
+    VkDeviceSize size = memoryRequirements.size;
+    VkDeviceSize alignment = std::max<VkDeviceSize>(memoryRequirements.alignment, 1);
+    // Flushes of non coherent memory work on whole atoms, so neighbours must not share one
+    if ((memoryType.propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(memoryType.propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+        alignment = std::max(alignment, limits.nonCoherentAtomSize);
+        size = alignUp(size, limits.nonCoherentAtomSize);
+    }
+    allocation.size = size;
+
+    // Small heaps (e.g. the 256 MiB BAR heap) get smaller blocks so one block does not take all of it
+    VkDeviceSize heapBlockSize = std::min(blockSize, memoryProperties.memoryHeaps[memoryType.heapIndex].size / 8);
+
+    if (size > heapBlockSize / 2) {
+        allocation.memory = allocateDeviceMemory(size, allocation.memoryType, &allocation.mapped);
+        allocation.offset = 0;
+        allocation.block = UINT32_MAX;
+        ++dedicatedCount;
+    } else {
+        bool separateKinds = limits.bufferImageGranularity > 1;
+        allocation.pool = allocation.memoryType * 2 + (separateKinds && kind == ResourceKind::Optimal ? 1 : 0);
+        Pool &pool = pools[allocation.pool];
+
+        uint32_t handle = TlsfAllocator::invalidHandle;
+        uint32_t blockIndex = 0;
+        for (; blockIndex < pool.blocks.size(); ++blockIndex) {
+            if (pool.blocks[blockIndex]) {
+                handle = pool.blocks[blockIndex]->tlsf.allocate(size, alignment, allocation.offset);
+                if (handle != TlsfAllocator::invalidHandle) {
+                    break;
+                }
+            }
+        }
+
+        if (handle == TlsfAllocator::invalidHandle) {
+            // Reuse the slot of a freed block so the indices of other allocations stay valid
+            blockIndex = 0;
+            while (blockIndex < pool.blocks.size() && pool.blocks[blockIndex]) {
+                ++blockIndex;
+            }
+            if (blockIndex == pool.blocks.size()) {
+                pool.blocks.emplace_back();
+            }
+
+            std::unique_ptr<Block> block(new Block());
+            block->memory = allocateDeviceMemory(heapBlockSize, allocation.memoryType, &block->mapped);
+            block->tlsf.init(heapBlockSize);
+            handle = block->tlsf.allocate(size, alignment, allocation.offset);
+            pool.blocks[blockIndex] = std::move(block);
+        }
+
+        Block &block = *pool.blocks[blockIndex];
+        allocation.memory = block.memory;
+        allocation.mapped = block.mapped != nullptr ? static_cast<char*>(block.mapped) + allocation.offset : nullptr;
+        allocation.block = blockIndex;
+        allocation.handle = handle;
+    }
+
+    usedPerHeap[memoryType.heapIndex] += size;
+    ++allocationCount;
+    return allocation;
+}
+
+void MemoryAllocator::free(Allocation &allocation) {
+    if (allocation.memory == VK_NULL_HANDLE) {
+        return;
+    }
+
+    usedPerHeap[memoryProperties.memoryTypes[allocation.memoryType].heapIndex] -= allocation.size;
+    --allocationCount;
+
+    if (allocation.block == UINT32_MAX) {
+        freeDeviceMemory(allocation.memory, allocation.memoryType, allocation.size);
+        --dedicatedCount;
+    } else {
+        Pool &pool = pools[allocation.pool];
+        std::unique_ptr<Block> &block = pool.blocks[allocation.block];
+        block->tlsf.free(allocation.handle);
+
+        // Keep one empty block per pool around so alternating allocate/free does not hit the driver
+        if (block->tlsf.isEmpty()) {
+            size_t amountOfBlocks = std::count_if(pool.blocks.begin(), pool.blocks.end(), [](const std::unique_ptr<Block> &b) { return b != nullptr; });
+            if (amountOfBlocks > 1) {
+                freeDeviceMemory(block->memory, pool.memoryType, block->tlsf.getCapacity());
+                block.reset();
+            }
+        }
+    }
+
+    allocation = Allocation();
+}
+
+void MemoryAllocator::createBuffer(const VkBufferCreateInfo &bufferCreateInfo, VkMemoryPropertyFlags properties, VkBuffer &buffer, Allocation &allocation) {
+    VkResult result = vkCreateBuffer(device, &bufferCreateInfo, nullptr, &buffer);
+    ASSERT_VULKAN(result);
+
+    VkMemoryRequirements memoryRequirements;
+    vkGetBufferMemoryRequirements(device, buffer, &memoryRequirements);
+    allocation = allocate(memoryRequirements, properties, ResourceKind::Linear);
+
+    result = vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset);
+    ASSERT_VULKAN(result);
+}
+
+void MemoryAllocator::destroyBuffer(VkBuffer &buffer, Allocation &allocation) {
+    vkDestroyBuffer(device, buffer, nullptr);
+    free(allocation);
+    buffer = VK_NULL_HANDLE;
+}
+
+void MemoryAllocator::createImage(const VkImageCreateInfo &imageCreateInfo, VkMemoryPropertyFlags properties, VkImage &image, Allocation &allocation) {
+    VkResult result = vkCreateImage(device, &imageCreateInfo, nullptr, &image);
+    ASSERT_VULKAN(result);
+
+    VkMemoryRequirements memoryRequirements;
+    vkGetImageMemoryRequirements(device, image, &memoryRequirements);
+    ResourceKind kind = imageCreateInfo.tiling == VK_IMAGE_TILING_OPTIMAL ? ResourceKind::Optimal : ResourceKind::Linear;
+    allocation = allocate(memoryRequirements, properties, kind);
+
+    result = vkBindImageMemory(device, image, allocation.memory, allocation.offset);
+    ASSERT_VULKAN(result);
+}
+
+void MemoryAllocator::destroyImage(VkImage &image, Allocation &allocation) {
+    vkDestroyImage(device, image, nullptr);
+    free(allocation);
+    image = VK_NULL_HANDLE;
+}
+
+void MemoryAllocator::createFrameRing(VkDeviceSize size, VkBufferUsageFlags usage, uint32_t framesInFlight) {
+    VkBufferCreateInfo bufferCreateInfo;
+    bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferCreateInfo.pNext = nullptr;
+    bufferCreateInfo.flags = 0;
+    bufferCreateInfo.size = size;
+    bufferCreateInfo.usage = usage;
+    bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    bufferCreateInfo.queueFamilyIndexCount = 0;
+    bufferCreateInfo.pQueueFamilyIndices = nullptr;
+
+    createBuffer(bufferCreateInfo, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, frameRingBuffer, frameRingAllocation);
+    frameRing.init(size);
+    frameEnds.assign(framesInFlight, 0);
+    recordingFrame = UINT32_MAX;
+}
+
+void MemoryAllocator::beginFrame(uint32_t frame) {
+    if (frameRingBuffer == VK_NULL_HANDLE) {
+        return;
+    }
+    if (recordingFrame != UINT32_MAX) {
+        frameEnds[recordingFrame] = frameRing.getHead();
+    }
+    // Frames finish in order, so everything up to the end of this slot's last frame is free again
+    frameRing.release(frameEnds[frame]);
+    recordingFrame = frame;
+}
+
+bool MemoryAllocator::allocateTransient(VkDeviceSize size, VkDeviceSize alignment, TransientAllocation &allocation) {
+    VkDeviceSize offset;
+    if (frameRingBuffer == VK_NULL_HANDLE || !frameRing.allocate(size, alignment, offset)) {
+        return false;
+    }
+    allocation.buffer = frameRingBuffer;
+    allocation.offset = offset;
+    allocation.mapped = static_cast<char*>(frameRingAllocation.mapped) + offset;
+    return true;
+}
+
+void MemoryAllocator::printStats() const {
+    std::cout << "Device memory: " << deviceMemoryCount << " vkAllocateMemory calls (limit " << limits.maxMemoryAllocationCount << ") | " <<
+        allocationCount << " allocations | " << dedicatedCount << " dedicated" << std::endl;
+
+    for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; ++i) {
+        if (reservedPerHeap[i] == 0) {
+            continue;
+        }
+        bool deviceLocal = (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+        std::cout << "  Heap " << i << (deviceLocal ? " (device local)" : "") << ": used " << toMiB(usedPerHeap[i]) <<
+            " MiB | reserved " << toMiB(reservedPerHeap[i]) << " MiB | size " << toMiB(memoryProperties.memoryHeaps[i].size) << " MiB" << std::endl;
+    }
+
+    for (const Pool &pool : pools) {
+        for (size_t i = 0; i < pool.blocks.size(); ++i) {
+            if (!pool.blocks[i]) {
+                continue;
+            }
+            const TlsfAllocator &tlsf = pool.blocks[i]->tlsf;
+            VkDeviceSize freeBytes = tlsf.getCapacity() - tlsf.getUsed();
+            // Share of the free bytes which is not part of the largest free range
+            double fragmentation = freeBytes > 0 ? 1.0 - (double)tlsf.largestFreeRange() / freeBytes : 0.0;
+
+            std::cout << "  Memory type " << pool.memoryType << (pool.kind == ResourceKind::Optimal ? " optimal" : " linear") <<
+                " block " << i << ": " << tlsf.getAllocationCount() << " allocations | used " << toMiB(tlsf.getUsed()) <<
+                " / " << toMiB(tlsf.getCapacity()) << " MiB | fragmentation " << fragmentation * 100.0 << " %" << std::endl;
+        }
+    }
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "TlsfAllocator.h"
+#include "RingAllocator.h"
+
+// Buffers and linear images vs. optimal tiling images. They are kept in separate blocks
+// when bufferImageGranularity is larger than 1, so neighbours never have to be padded.
+enum class ResourceKind {
+    Linear,
+    Optimal
+};
+
+struct Allocation {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    void *mapped = nullptr; // host visible memory stays mapped for its whole lifetime
+    uint32_t memoryType = 0;
+    uint32_t pool = 0;
+    uint32_t block = UINT32_MAX; // UINT32_MAX for dedicated allocations
+    uint32_t handle = 0;
+};
+
+// Transient range of the frame ring buffer, valid until the frame slot is used again
+struct TransientAllocation {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    void *mapped = nullptr;
+};
+
+// Sub-allocates device memory from large blocks per memory type with TlsfAllocator, so the
+// amount of vkAllocateMemory calls stays far below maxMemoryAllocationCount. Resources larger
+// than half a block get a dedicated allocation. Per frame data comes from a host visible ring
+// which is released frame by frame.
+class MemoryAllocator {
+public:
+    void init(VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize blockSize);
+    void destroy();
+
+    Allocation allocate(const VkMemoryRequirements &memoryRequirements, VkMemoryPropertyFlags properties, ResourceKind kind);
+    void free(Allocation &allocation);
+
+    void createBuffer(const VkBufferCreateInfo &bufferCreateInfo, VkMemoryPropertyFlags properties, VkBuffer &buffer, Allocation &allocation);
+    void destroyBuffer(VkBuffer &buffer, Allocation &allocation);
+    void createImage(const VkImageCreateInfo &imageCreateInfo, VkMemoryPropertyFlags properties, VkImage &image, Allocation &allocation);
+    void destroyImage(VkImage &image, Allocation &allocation);
+
+    void createFrameRing(VkDeviceSize size, VkBufferUsageFlags usage, uint32_t framesInFlight);
+    // Call after the fence of the frame signaled, drops what the frame allocated the last time
+    void beginFrame(uint32_t frame);
+    bool allocateTransient(VkDeviceSize size, VkDeviceSize alignment, TransientAllocation &allocation);
+
+    // Bytes used/reserved per heap, allocation counts and fragmentation of the blocks
+    void printStats() const;
+
+private:
+    struct Block {
+        VkDeviceMemory memory;
+        void *mapped;
+        TlsfAllocator tlsf;
+    };
+
+    struct Pool {
+        uint32_t memoryType;
+        ResourceKind kind;
+        std::vector<std::unique_ptr<Block>> blocks; // nullptr for freed blocks, allocations keep their index
+    };
+
+    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+    VkDeviceMemory allocateDeviceMemory(VkDeviceSize size, uint32_t memoryType, void **mapped);
+    void freeDeviceMemory(VkDeviceMemory memory, uint32_t memoryType, VkDeviceSize size);
+    bool isHostVisible(uint32_t memoryType) const;
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties memoryProperties = {};
+    VkPhysicalDeviceLimits limits = {};
+    VkDeviceSize blockSize = 0;
+    std::vector<Pool> pools; // two per memory type, see ResourceKind
+
+    uint32_t deviceMemoryCount = 0;
+    uint32_t dedicatedCount = 0;
+    uint32_t allocationCount = 0;
+    VkDeviceSize reservedPerHeap[VK_MAX_MEMORY_HEAPS] = {};
+    VkDeviceSize usedPerHeap[VK_MAX_MEMORY_HEAPS] = {};
+
+    VkBuffer frameRingBuffer = VK_NULL_HANDLE;
+    Allocation frameRingAllocation;
+    RingAllocator frameRing;
+    std::vector<VkDeviceSize> frameEnds;
+    uint32_t recordingFrame = UINT32_MAX;
+};
@@ -0,0 +1,144 @@
+#include "MeshAsset.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+    bool isAligned(uint64_t value) {
+        return value % meshChunkAlignment == 0;
+    }
+}
+
+// Everything the copies and draws rely on is checked, the index values themselves are trusted like the
+// contents of a SPIR-V module
+void MeshAsset::load(const std::string &file) {
+    auto start = std::chrono::high_resolution_clock::now();
+    name = file;
+    this->file.open(file);
+    fileSize = this->file.getSize();
+    const char *data = static_cast<const char*>(this->file.getData());
+
+    if (fileSize < sizeof(MeshFileHeader)) {
+        throw std::runtime_error("'" + file + "' is too small for a mesh file");
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (header.magic != meshFileMagic) {
+        throw std::runtime_error("'" + file + "' is no mesh file");
+    }
+    if (header.version != meshFileVersion) {
+        throw std::runtime_error("'" + file + "' has version " + std::to_string(header.version) + ", convert it again");
+    }
+    bool quantized = header.vertexFormat == (uint32_t)MeshVertexFormat::Quantized;
+    bool floats = header.vertexFormat == (uint32_t)MeshVertexFormat::Float;
+    if ((!quantized && !floats) || header.vertexStride != (quantized ? sizeof(QuantizedVertex) : sizeof(FloatVertex)) ||
+        header.indexSize != (quantized ? sizeof(uint16_t) : sizeof(uint32_t))) {
+        throw std::runtime_error("'" + file + "' has an unknown vertex format");
+    }
+
+    uint64_t vertexBytes = (uint64_t)header.vertexCount * header.vertexStride;
+    uint64_t indexBytes = (uint64_t)header.indexCount * header.indexSize;
+    uint64_t chunkTableEnd = sizeof(MeshFileHeader) + (uint64_t)header.chunkCount * sizeof(MeshChunk);
+    if (header.chunkCount == 0 || chunkTableEnd > header.vertexDataOffset || header.vertexDataOffset + vertexBytes > header.indexDataOffset ||
+        header.indexDataOffset + indexBytes > fileSize || !isAligned(header.vertexDataOffset) || !isAligned(header.indexDataOffset)) {
+        throw std::runtime_error("'" + file + "' is truncated or has overlapping sections");
+    }
+
+    chunks.resize(header.chunkCount);
+    std::memcpy(chunks.data(), data + sizeof(MeshFileHeader), chunks.size() * sizeof(MeshChunk));
+    for (const MeshChunk &chunk : chunks) {
+        if ((uint64_t)chunk.firstVertex + chunk.vertexCount > header.vertexCount || (uint64_t)chunk.firstIndex + chunk.indexCount > header.indexCount ||
+            chunk.indexCount % 3 != 0 || chunk.vertexCount > meshMaxChunkVertices || !isAligned((uint64_t)chunk.firstVertex * header.vertexStride) ||
+            !isAligned((uint64_t)chunk.firstIndex * header.indexSize)) {
+            throw std::runtime_error("'" + file + "' has an invalid chunk");
+        }
+    }
+
+    loadTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+uint64_t MeshAsset::upload(MemoryAllocator &memoryAllocator, StagingUploader &uploader) {
+    createDeviceBuffer(memoryAllocator, (VkDeviceSize)header.vertexCount * header.vertexStride, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertexBuffer, vertexAllocation);
+    createDeviceBuffer(memoryAllocator, (VkDeviceSize)header.indexCount * header.indexSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indexBuffer, indexAllocation);
+
+    // Chunk by chunk, so the padding between them is not copied. Source and destination offsets are the same.
+    const char *vertices = static_cast<const char*>(file.getData()) + header.vertexDataOffset;
+    const char *indices = static_cast<const char*>(file.getData()) + header.indexDataOffset;
+    uint64_t ticket = 0;
+    for (const MeshChunk &chunk : chunks) {
+        VkDeviceSize vertexOffset = (VkDeviceSize)chunk.firstVertex * header.vertexStride;
+        VkDeviceSize indexOffset = (VkDeviceSize)chunk.firstIndex * header.indexSize;
+        uploader.upload(vertexBuffer, vertexOffset, vertices + vertexOffset, (VkDeviceSize)chunk.vertexCount * header.vertexStride);
+        ticket = uploader.upload(indexBuffer, indexOffset, indices + indexOffset, (VkDeviceSize)chunk.indexCount * header.indexSize);
+    }
+    uploader.flush();
+    file.close();
+    return ticket;
+}
+
+void MeshAsset::destroy(MemoryAllocator &memoryAllocator) {
+    if (vertexBuffer != VK_NULL_HANDLE) {
+        memoryAllocator.destroyBuffer(vertexBuffer, vertexAllocation);
+        memoryAllocator.destroyBuffer(indexBuffer, indexAllocation);
+    }
+    file.close();
+}
+
+void MeshAsset::createDeviceBuffer(MemoryAllocator &memoryAllocator, VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer &buffer, Allocation &allocation) {
+    VkBufferCreateInfo bufferCreateInfo;
+    bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferCreateInfo.pNext = nullptr;
+    bufferCreateInfo.flags = 0;
+    bufferCreateInfo.size = size;
+    bufferCreateInfo.usage = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    bufferCreateInfo.queueFamilyIndexCount = 0;
+    bufferCreateInfo.pQueueFamilyIndices = nullptr;
+
+    memoryAllocator.createBuffer(bufferCreateInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, allocation);
+}
+
+// Both formats feed the same vec3 inputs of mesh.vert, the snorm formats are converted by the vertex fetch
+void MeshAsset::getVertexInput(std::vector<VkVertexInputBindingDescription> &bindings, std::vector<VkVertexInputAttributeDescription> &attributes) const {
+    bindings.clear();
+    attributes.clear();
+
+    VkVertexInputBindingDescription binding;
+    binding.binding = 0;
+    binding.stride = header.vertexStride;
+    binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    bindings.push_back(binding);
+
+    bool quantized = getVertexFormat() == MeshVertexFormat::Quantized;
+    VkVertexInputAttributeDescription position;
+    position.location = 0;
+    position.binding = 0;
+    position.format = quantized ? VK_FORMAT_R16G16B16A16_SNORM : VK_FORMAT_R32G32B32_SFLOAT;
+    position.offset = quantized ? offsetof(QuantizedVertex, position) : offsetof(FloatVertex, position);
+    attributes.push_back(position);
+
+    VkVertexInputAttributeDescription normal;
+    normal.location = 1;
+    normal.binding = 0;
+    normal.format = quantized ? VK_FORMAT_R8G8B8A8_SNORM : VK_FORMAT_R32G32B32_SFLOAT;
+    normal.offset = quantized ? offsetof(QuantizedVertex, normal) : offsetof(FloatVertex, normal);
+    attributes.push_back(normal);
+}
+
+glm::vec3 MeshAsset::getPositionScale() const {
+    return getVertexFormat() == MeshVertexFormat::Quantized ? getBoundsExtent() : glm::vec3(1.0f);
+}
+
+glm::vec3 MeshAsset::getPositionOffset() const {
+    return getVertexFormat() == MeshVertexFormat::Quantized ? getBoundsCenter() : glm::vec3(0.0f);
+}
+
+void MeshAsset::record(VkCommandBuffer commandBuffer) const {
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &offset);
+    vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, header.indexSize == sizeof(uint16_t) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32);
+    for (const MeshChunk &chunk : chunks) {
+        vkCmdDrawIndexed(commandBuffer, chunk.indexCount, 1, chunk.firstIndex, (int32_t)chunk.firstVertex, 0);
+    }
+}
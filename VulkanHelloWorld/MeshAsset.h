@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include "MappedFile.h"
+#include "MeshFormat.h"
+#include "MemoryAllocator.h"
+#include "StagingUploader.h"
+
+// A mesh file (MeshFormat.h) drawn from device local buffers. load() maps the file and checks the header and chunk
+// table, upload() hands every chunk straight from the mapping to the staging uploader, so the file contents are never
+// copied into the heap, and unmaps the file. Every chunk is one vkCmdDrawIndexed with its first vertex as vertex offset.
+class MeshAsset {
+public:
+    // Throws std::runtime_error if the file can not be mapped or is no valid mesh file
+    void load(const std::string &file);
+    // The uploader copies into its ring right away, so the mapping is released before this returns
+    uint64_t upload(MemoryAllocator &memoryAllocator, StagingUploader &uploader);
+    void destroy(MemoryAllocator &memoryAllocator);
+
+    void getVertexInput(std::vector<VkVertexInputBindingDescription> &bindings, std::vector<VkVertexInputAttributeDescription> &attributes) const;
+    // Object space position = positionOffset + positionScale * vertex position
+    glm::vec3 getPositionScale() const;
+    glm::vec3 getPositionOffset() const;
+    glm::vec3 getBoundsCenter() const { return glm::vec3(header.boundsCenter[0], header.boundsCenter[1], header.boundsCenter[2]); }
+    glm::vec3 getBoundsExtent() const { return glm::vec3(header.boundsExtent[0], header.boundsExtent[1], header.boundsExtent[2]); }
+
+    // Has to be recorded inside the render pass
+    void record(VkCommandBuffer commandBuffer) const;
+
+    MeshVertexFormat getVertexFormat() const { return (MeshVertexFormat)header.vertexFormat; }
+    uint32_t getVertexStride() const { return header.vertexStride; }
+    uint32_t getIndexSize() const { return header.indexSize; }
+    uint32_t getChunkCount() const { return header.chunkCount; }
+    uint32_t getTriangleCount() const { return header.triangleCount; }
+    uint32_t getVertexCount() const { return header.vertexCount; }
+    const std::string &getName() const { return name; }
+    uint64_t getFileSize() const { return fileSize; }
+    double getLoadTime() const { return loadTime; } // ms, mapping and validation
+
+private:
+    void createDeviceBuffer(MemoryAllocator &memoryAllocator, VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer &buffer, Allocation &allocation);
+
+    std::string name;
+    MappedFile file;
+    MeshFileHeader header = {};
+    std::vector<MeshChunk> chunks; // copied, they are needed for drawing after the file was released
+    uint64_t fileSize = 0;
+    double loadTime = 0.0;
+
+    VkBuffer vertexBuffer = VK_NULL_HANDLE;
+    Allocation vertexAllocation;
+    VkBuffer indexBuffer = VK_NULL_HANDLE;
+    Allocation indexAllocation;
+};
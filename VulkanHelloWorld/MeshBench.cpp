@@ -0,0 +1,204 @@
+#include "MeshBench.h"
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <filesystem>
+#include <glm/gtc/packing.hpp>
+#include "MappedFile.h"
+#include "MeshAsset.h"
+#include "MeshConverter.h"
+
+namespace {
+    const uint32_t loadRepeats = 20; // the page cache is warm after the first, all runs are averaged
+    const uint32_t cacheSize = 16;
+    volatile uint64_t checksumSink = 0; // keeps the reads from being optimized away
+
+    struct Variant {
+        const char *name;
+        MeshVertexFormat format;
+        bool optimized;
+    };
+
+    const Variant variants[] = {
+        { "float, source order", MeshVertexFormat::Float, false },
+        { "float, optimized order", MeshVertexFormat::Float, true },
+        { "quantized, optimized order", MeshVertexFormat::Quantized, true },
+    };
+
+    // Triangles with their smallest index first, so rotations of the same triangle compare equal
+    std::vector<std::array<uint32_t, 3>> canonicalTriangles(const std::vector<uint32_t> &indices) {
+        std::vector<std::array<uint32_t, 3>> triangles;
+        triangles.reserve(indices.size() / 3);
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            uint32_t rotation = indices[i] <= indices[i + 1] && indices[i] <= indices[i + 2] ? 0 : (indices[i + 1] <= indices[i + 2] ? 1 : 2);
+            triangles.push_back({ indices[i + rotation], indices[i + (rotation + 1) % 3], indices[i + (rotation + 2) % 3] });
+        }
+        std::sort(triangles.begin(), triangles.end());
+        return triangles;
+    }
+
+    // Decodes every index of every chunk and compares the position it references with the source
+    bool decodesToSource(const std::string &file, const SourceMesh &mesh) {
+        MappedFile mapped;
+        mapped.open(file);
+        const char *data = static_cast<const char*>(mapped.getData());
+        MeshFileHeader header;
+        std::memcpy(&header, data, sizeof(header));
+        glm::vec3 center(header.boundsCenter[0], header.boundsCenter[1], header.boundsCenter[2]);
+        glm::vec3 extent(header.boundsExtent[0], header.boundsExtent[1], header.boundsExtent[2]);
+        float tolerance = header.vertexFormat == (uint32_t)MeshVertexFormat::Quantized ? std::max(extent.x, std::max(extent.y, extent.z)) * 1e-4f : 0.0f;
+
+        size_t sourceIndex = 0;
+        for (uint32_t chunkIndex = 0; chunkIndex < header.chunkCount; ++chunkIndex) {
+            MeshChunk chunk;
+            std::memcpy(&chunk, data + sizeof(MeshFileHeader) + chunkIndex * sizeof(MeshChunk), sizeof(chunk));
+            for (uint32_t i = 0; i < chunk.indexCount; ++i, ++sourceIndex) {
+                uint32_t local = 0;
+                std::memcpy(&local, data + header.indexDataOffset + (uint64_t)(chunk.firstIndex + i) * header.indexSize, header.indexSize);
+                if (local >= chunk.vertexCount || sourceIndex >= mesh.indices.size()) {
+                    return false;
+                }
+                const char *vertex = data + header.vertexDataOffset + (uint64_t)(chunk.firstVertex + local) * header.vertexStride;
+                glm::vec3 position;
+                if (header.vertexFormat == (uint32_t)MeshVertexFormat::Quantized) {
+                    QuantizedVertex quantized;
+                    std::memcpy(&quantized, vertex, sizeof(quantized));
+                    uint64_t packed;
+                    std::memcpy(&packed, quantized.position, sizeof(packed));
+                    position = center + extent * glm::vec3(glm::unpackSnorm4x16(packed));
+                } else {
+                    FloatVertex full;
+                    std::memcpy(&full, vertex, sizeof(full));
+                    position = glm::vec3(full.position[0], full.position[1], full.position[2]);
+                }
+                if (glm::length(position - mesh.positions[mesh.indices[sourceIndex]]) > tolerance) {
+                    return false;
+                }
+            }
+        }
+        return sourceIndex == mesh.indices.size();
+    }
+
+    // What the upload reads: every byte of the file through the mapping, or copied into the heap first
+    double measureMappedRead(const std::string &file) {
+        uint64_t checksum = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (uint32_t i = 0; i < loadRepeats; ++i) {
+            MappedFile mapped;
+            mapped.open(file);
+            const char *data = static_cast<const char*>(mapped.getData());
+            for (size_t offset = 0; offset + sizeof(uint64_t) <= mapped.getSize(); offset += sizeof(uint64_t)) {
+                uint64_t word;
+                std::memcpy(&word, data + offset, sizeof(word));
+                checksum += word;
+            }
+        }
+        checksumSink = checksum;
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / loadRepeats;
+    }
+
+    double measureStreamRead(const std::string &file) {
+        uint64_t checksum = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (uint32_t i = 0; i < loadRepeats; ++i) {
+            std::ifstream stream(file, std::ios::binary | std::ios::ate);
+            std::vector<char> data((size_t)stream.tellg());
+            stream.seekg(0);
+            stream.read(data.data(), (std::streamsize)data.size());
+            for (size_t offset = 0; offset + sizeof(uint64_t) <= data.size(); offset += sizeof(uint64_t)) {
+                uint64_t word;
+                std::memcpy(&word, data.data() + offset, sizeof(word));
+                checksum += word;
+            }
+        }
+        checksumSink = checksum;
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / loadRepeats;
+    }
+
+    double measureValidation(const std::string &file) {
+        double sum = 0.0;
+        for (uint32_t i = 0; i < loadRepeats; ++i) {
+            MeshAsset asset;
+            asset.load(file);
+            sum += asset.getLoadTime();
+        }
+        return sum / loadRepeats;
+    }
+}
+
+bool runMeshBench(const std::string &source) {
+    SourceMesh sourceMesh;
+    try {
+        sourceMesh = source == "torus-knot" ? generateTorusKnot(4096, 64) : loadObj(source);
+    } catch (const std::exception &exception) {
+        std::cerr << "Mesh bench: " << exception.what() << std::endl;
+        return false;
+    }
+    uint32_t vertexCount = (uint32_t)sourceMesh.positions.size();
+    uint64_t triangleCount = sourceMesh.indices.size() / 3;
+    std::cout << "Mesh bench: " << source << " | " << triangleCount << " triangles | " << vertexCount << " vertices | FIFO " << cacheSize <<
+        " vertex cache | warm page cache, " << loadRepeats << " loads per file" << std::endl;
+
+    SourceMesh optimizedMesh = sourceMesh;
+    auto start = std::chrono::high_resolution_clock::now();
+    optimizeVertexCache(optimizedMesh);
+    uint32_t clusterCount = optimizeOverdraw(optimizedMesh, 1.05f);
+    double optimizeTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    bool sameTriangles = canonicalTriangles(sourceMesh.indices) == canonicalTriangles(optimizedMesh.indices);
+    std::cout << "Reordered in " << optimizeTime << " ms into " << clusterCount << " overdraw clusters" <<
+        (sameTriangles ? "" : " | FAILED, the triangles differ from the source") << std::endl;
+
+    bool passed = sameTriangles;
+    double baselineBytes = 0.0;
+    double baselineRead = 0.0;
+    std::filesystem::path directory = std::filesystem::temp_directory_path();
+    for (const Variant &variant : variants) {
+        const SourceMesh &mesh = variant.optimized ? optimizedMesh : sourceMesh;
+        std::string file = (directory / (std::string("mesh_bench_") + std::to_string(&variant - variants) + ".mesh")).string();
+        MeshFileStats stats;
+        try {
+            stats = writeMeshFile(file, mesh, variant.format);
+        } catch (const std::exception &exception) {
+            std::cerr << "Mesh bench: " << exception.what() << std::endl;
+            return false;
+        }
+
+        double validation = measureValidation(file);
+        double mappedRead = measureMappedRead(file);
+        double streamRead = measureStreamRead(file);
+        bool decoded = decodesToSource(file, mesh);
+        passed = passed && decoded;
+        std::remove(file.c_str());
+
+        // Every vertex shader invocation fetches its vertex once, every triangle its three indices
+        double acmr = computeAcmr(mesh.indices, vertexCount, cacheSize);
+        uint32_t stride = variant.format == MeshVertexFormat::Quantized ? sizeof(QuantizedVertex) : sizeof(FloatVertex);
+        uint32_t indexSize = variant.format == MeshVertexFormat::Quantized ? sizeof(uint16_t) : sizeof(uint32_t);
+        double vertexBytes = acmr * triangleCount * stride;
+        double indexBytes = 3.0 * triangleCount * indexSize;
+        if (baselineBytes == 0.0) {
+            baselineBytes = vertexBytes + indexBytes;
+            baselineRead = mappedRead;
+        }
+
+        std::cout << "- " << variant.name << ": " << stats.fileSize / 1024 << " KiB in " << stats.chunkCount << " chunks, " << stride <<
+            " bytes per vertex | map + validate " << validation << " ms | map + read " << mappedRead << " ms (" << baselineRead / mappedRead <<
+            "x), ifstream + read " << streamRead << " ms" << std::endl;
+        std::cout << "  ACMR " << acmr << " | per draw: " << vertexBytes / (1024 * 1024) << " MiB vertices + " << indexBytes / (1024 * 1024) <<
+            " MiB indices, " << (vertexBytes + indexBytes) / triangleCount << " bytes per triangle (" <<
+            baselineBytes / (vertexBytes + indexBytes) << "x)";
+        if (variant.format == MeshVertexFormat::Quantized) {
+            std::cout << " | max error: position " << stats.maxPositionError << " of the extent, normal " << stats.maxNormalError << " degrees";
+        }
+        std::cout << (decoded ? "" : " | FAILED to decode to the source") << std::endl;
+    }
+
+    std::cout << (passed ? "Mesh bench passed" : "Mesh bench FAILED") << std::endl;
+    return passed;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <string>
+
+// CPU only comparison of the mesh file variants for one source mesh ("torus-knot" or an .obj file): the float
+// baseline in source order, float with optimized order and quantized with optimized order. Prints file size, load
+// time, the simulated vertex cache misses and the resulting vertex bandwidth per draw. Returns false if the
+// reordering lost triangles or a file does not decode back to the source within the quantization error.
+bool runMeshBench(const std::string &source);
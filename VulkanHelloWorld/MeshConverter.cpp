@@ -0,0 +1,553 @@
+#include "MeshConverter.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+#include <glm/gtc/packing.hpp>
+
+namespace {
+    // Scoring constants from Forsyth's article
+    const uint32_t forsythCacheSize = 32;
+    const float cacheDecayPower = 1.5f;
+    const float lastTriangleScore = 0.75f;
+    const float valenceBoostScale = 2.0f;
+    const float valenceBoostPower = 0.5f;
+
+    // FIFO size used to judge the cluster cut points and for the reported miss ratios
+    const uint32_t simulatedCacheSize = 16;
+    const float pi = 3.14159265f;
+
+    float vertexScore(int32_t cachePosition, uint32_t remainingTriangles) {
+        if (remainingTriangles == 0) {
+            return -1.0f;
+        }
+        float score = 0.0f;
+        if (cachePosition >= 0) {
+            // The vertices of the last triangle score a bit lower, otherwise strips would be favoured over fans
+            if (cachePosition < 3) {
+                score = lastTriangleScore;
+            } else {
+                score = std::pow(1.0f - (cachePosition - 3) / (float)(forsythCacheSize - 3), cacheDecayPower);
+            }
+        }
+        // Vertices with few triangles left are finished first, so they leave the cache for good
+        return score + valenceBoostScale * std::pow((float)remainingTriangles, -valenceBoostPower);
+    }
+
+    uint32_t alignUp(uint32_t value, uint32_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    // OBJ indices start at 1, negative ones count back from the last element
+    int32_t resolveObjIndex(const std::string &token, size_t count, const std::string &file, const std::string &line) {
+        int32_t index;
+        try {
+            index = std::stoi(token);
+        } catch (const std::logic_error &) { // not a number or out of range
+            throw std::runtime_error("'" + file + "' has an invalid index in '" + line + "'");
+        }
+        return index < 0 ? (int32_t)count + index : index - 1;
+    }
+
+    glm::vec3 torusKnot(float t) {
+        float radius = 2.0f + std::cos(3.0f * t);
+        return glm::vec3(radius * std::cos(2.0f * t), radius * std::sin(2.0f * t), -std::sin(3.0f * t));
+    }
+
+    glm::vec3 faceNormal(const SourceMesh &mesh, size_t triangle) {
+        const glm::vec3 &a = mesh.positions[mesh.indices[triangle * 3]];
+        const glm::vec3 &b = mesh.positions[mesh.indices[triangle * 3 + 1]];
+        const glm::vec3 &c = mesh.positions[mesh.indices[triangle * 3 + 2]];
+        return glm::cross(b - a, c - a); // length is twice the area
+    }
+
+    glm::vec3 faceCenter(const SourceMesh &mesh, size_t triangle) {
+        return (mesh.positions[mesh.indices[triangle * 3]] + mesh.positions[mesh.indices[triangle * 3 + 1]] +
+            mesh.positions[mesh.indices[triangle * 3 + 2]]) / 3.0f;
+    }
+}
+
+SourceMesh loadObj(const std::string &file) {
+    std::ifstream stream(file);
+    if (!stream) {
+        throw std::runtime_error("Failed to open file '" + file + "' !");
+    }
+
+    std::vector<glm::vec3> objPositions;
+    std::vector<glm::vec3> objNormals;
+    SourceMesh mesh;
+    std::unordered_map<uint64_t, uint32_t> vertexByPair; // position index << 32 | normal index
+    std::vector<int32_t> positionOfVertex; // for the vertices without normal
+    std::vector<bool> needsNormal;
+
+    std::string line;
+    std::vector<uint32_t> polygon;
+    while (std::getline(stream, line)) {
+        std::istringstream tokens(line);
+        std::string type;
+        tokens >> type;
+        if (type == "v") {
+            glm::vec3 position;
+            tokens >> position.x >> position.y >> position.z;
+            objPositions.push_back(position);
+        } else if (type == "vn") {
+            glm::vec3 normal;
+            tokens >> normal.x >> normal.y >> normal.z;
+            objNormals.push_back(normal);
+        } else if (type == "f") {
+            polygon.clear();
+            std::string corner;
+            while (tokens >> corner) {
+                // v, v/vt, v//vn or v/vt/vn, texture coordinates are dropped
+                size_t firstSlash = corner.find('/');
+                size_t lastSlash = corner.rfind('/');
+                int32_t position = resolveObjIndex(corner.substr(0, firstSlash), objPositions.size(), file, line);
+                int32_t normal = -1;
+                bool hasNormal = firstSlash != std::string::npos && lastSlash != firstSlash && lastSlash + 1 < corner.size();
+                if (hasNormal) {
+                    normal = resolveObjIndex(corner.substr(lastSlash + 1), objNormals.size(), file, line);
+                }
+                if (position < 0 || position >= (int32_t)objPositions.size() ||
+                    (hasNormal && (normal < 0 || normal >= (int32_t)objNormals.size()))) {
+                    throw std::runtime_error("'" + file + "' references a missing vertex in '" + line + "'");
+                }
+
+                uint64_t key = (uint64_t)position << 32 | (uint32_t)normal;
+                auto found = vertexByPair.find(key);
+                if (found == vertexByPair.end()) {
+                    found = vertexByPair.emplace(key, (uint32_t)mesh.positions.size()).first;
+                    mesh.positions.push_back(objPositions[position]);
+                    mesh.normals.push_back(normal >= 0 ? objNormals[normal] : glm::vec3(0.0f));
+                    positionOfVertex.push_back(position);
+                    needsNormal.push_back(normal < 0);
+                }
+                polygon.push_back(found->second);
+            }
+            for (size_t i = 2; i < polygon.size(); ++i) {
+                mesh.indices.push_back(polygon[0]);
+                mesh.indices.push_back(polygon[i - 1]);
+                mesh.indices.push_back(polygon[i]);
+            }
+        }
+    }
+    if (mesh.indices.empty()) {
+        throw std::runtime_error("'" + file + "' contains no faces");
+    }
+
+    // Area weighted face normals, summed per OBJ position so hard edges in the source do not split them
+    if (std::find(needsNormal.begin(), needsNormal.end(), true) != needsNormal.end()) {
+        std::vector<glm::vec3> accumulated(objPositions.size(), glm::vec3(0.0f));
+        for (size_t triangle = 0; triangle < mesh.indices.size() / 3; ++triangle) {
+            glm::vec3 normal = faceNormal(mesh, triangle);
+            for (uint32_t corner = 0; corner < 3; ++corner) {
+                accumulated[positionOfVertex[mesh.indices[triangle * 3 + corner]]] += normal;
+            }
+        }
+        for (size_t vertex = 0; vertex < mesh.positions.size(); ++vertex) {
+            if (needsNormal[vertex]) {
+                mesh.normals[vertex] = accumulated[positionOfVertex[vertex]];
+            }
+        }
+    }
+    for (glm::vec3 &normal : mesh.normals) {
+        float length = glm::length(normal);
+        normal = length > 0.0f ? normal / length : glm::vec3(0.0f, 0.0f, 1.0f);
+    }
+    return mesh;
+}
+
+SourceMesh generateTorusKnot(uint32_t segments, uint32_t sides) {
+    const float tubeRadius = 0.4f;
+    SourceMesh mesh;
+    mesh.positions.reserve(segments * sides);
+    mesh.normals.reserve(segments * sides);
+
+    for (uint32_t segment = 0; segment < segments; ++segment) {
+        float t = 2.0f * pi * segment / segments;
+        glm::vec3 center = torusKnot(t);
+        glm::vec3 ahead = torusKnot(t + 0.01f);
+        // Frame along the curve, N roughly points away from the center of the knot
+        glm::vec3 tangent = ahead - center;
+        glm::vec3 binormal = glm::normalize(glm::cross(tangent, ahead + center));
+        glm::vec3 normal = glm::normalize(glm::cross(binormal, tangent));
+        for (uint32_t side = 0; side < sides; ++side) {
+            float angle = 2.0f * pi * side / sides;
+            glm::vec3 direction = std::cos(angle) * normal + std::sin(angle) * binormal;
+            mesh.positions.push_back(center + tubeRadius * direction);
+            mesh.normals.push_back(direction);
+        }
+    }
+
+    // Counter-clockwise seen from outside
+    mesh.indices.reserve(segments * sides * 6);
+    for (uint32_t segment = 0; segment < segments; ++segment) {
+        uint32_t nextSegment = (segment + 1) % segments;
+        for (uint32_t side = 0; side < sides; ++side) {
+            uint32_t nextSide = (side + 1) % sides;
+            uint32_t a = segment * sides + side;
+            uint32_t b = nextSegment * sides + side;
+            uint32_t c = nextSegment * sides + nextSide;
+            uint32_t d = segment * sides + nextSide;
+            mesh.indices.insert(mesh.indices.end(), { a, c, b, a, d, c });
+        }
+    }
+    return mesh;
+}
+
+void optimizeVertexCache(SourceMesh &mesh) {
+    uint32_t vertexCount = (uint32_t)mesh.positions.size();
+    uint32_t triangleCount = (uint32_t)(mesh.indices.size() / 3);
+
+    // Triangles of every vertex, the ones not emitted yet are kept at the front of its range
+    std::vector<uint32_t> remaining(vertexCount, 0);
+    for (uint32_t index : mesh.indices) {
+        ++remaining[index];
+    }
+    std::vector<uint32_t> firstTriangle(vertexCount + 1, 0);
+    for (uint32_t vertex = 0; vertex < vertexCount; ++vertex) {
+        firstTriangle[vertex + 1] = firstTriangle[vertex] + remaining[vertex];
+    }
+    std::vector<uint32_t> adjacency(mesh.indices.size());
+    std::vector<uint32_t> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+    for (uint32_t triangle = 0; triangle < triangleCount; ++triangle) {
+        for (uint32_t corner = 0; corner < 3; ++corner) {
+            adjacency[fill[mesh.indices[triangle * 3 + corner]]++] = triangle;
+        }
+    }
+
+    std::vector<int32_t> cachePosition(vertexCount, -1);
+    std::vector<float> score(vertexCount);
+    for (uint32_t vertex = 0; vertex < vertexCount; ++vertex) {
+        score[vertex] = vertexScore(-1, remaining[vertex]);
+    }
+    std::vector<float> triangleScore(triangleCount);
+    for (uint32_t triangle = 0; triangle < triangleCount; ++triangle) {
+        triangleScore[triangle] = score[mesh.indices[triangle * 3]] + score[mesh.indices[triangle * 3 + 1]] + score[mesh.indices[triangle * 3 + 2]];
+    }
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> newCache;
+    std::vector<uint32_t> result;
+    result.reserve(mesh.indices.size());
+    uint32_t nextUnemitted = 0;
+    int64_t best = -1;
+
+    while (result.size() < mesh.indices.size()) {
+        // Nothing in the cache has triangles left, continue with the next one in input order
+        if (best < 0) {
+            while (emitted[nextUnemitted]) {
+                ++nextUnemitted;
+            }
+            best = nextUnemitted;
+        }
+
+        const uint32_t *corners = &mesh.indices[best * 3];
+        emitted[best] = true;
+        newCache.clear();
+        for (uint32_t corner = 0; corner < 3; ++corner) {
+            uint32_t vertex = corners[corner];
+            result.push_back(vertex);
+            uint32_t *begin = &adjacency[firstTriangle[vertex]];
+            uint32_t *end = begin + remaining[vertex];
+            uint32_t *position = std::find(begin, end, (uint32_t)best);
+            if (position != end) {
+                std::swap(*position, *(end - 1));
+                --remaining[vertex];
+            }
+            if (std::find(newCache.begin(), newCache.end(), vertex) == newCache.end()) {
+                newCache.push_back(vertex);
+            }
+        }
+        // LRU: the emitted vertices move to the front, the oldest fall out
+        for (uint32_t vertex : cache) {
+            if (std::find(newCache.begin(), newCache.end(), vertex) == newCache.end()) {
+                newCache.push_back(vertex);
+            }
+        }
+        for (size_t i = forsythCacheSize; i < newCache.size(); ++i) {
+            cachePosition[newCache[i]] = -1;
+            score[newCache[i]] = vertexScore(-1, remaining[newCache[i]]);
+        }
+        newCache.resize(std::min<size_t>(newCache.size(), forsythCacheSize));
+        for (uint32_t i = 0; i < newCache.size(); ++i) {
+            cachePosition[newCache[i]] = (int32_t)i;
+            score[newCache[i]] = vertexScore((int32_t)i, remaining[newCache[i]]);
+        }
+        cache.swap(newCache);
+
+        // Only triangles touching the cache changed their score
+        best = -1;
+        float bestScore = -1.0f;
+        for (uint32_t vertex : cache) {
+            for (uint32_t i = 0; i < remaining[vertex]; ++i) {
+                uint32_t triangle = adjacency[firstTriangle[vertex] + i];
+                const uint32_t *triangleCorners = &mesh.indices[triangle * 3];
+                triangleScore[triangle] = score[triangleCorners[0]] + score[triangleCorners[1]] + score[triangleCorners[2]];
+                if (triangleScore[triangle] > bestScore) {
+                    bestScore = triangleScore[triangle];
+                    best = triangle;
+                }
+            }
+        }
+    }
+    mesh.indices.swap(result);
+}
+
+uint32_t optimizeOverdraw(SourceMesh &mesh, float threshold) {
+    uint32_t triangleCount = (uint32_t)(mesh.indices.size() / 3);
+    double meshAcmr = computeAcmr(mesh.indices, (uint32_t)mesh.positions.size(), simulatedCacheSize);
+
+    // Every cluster starts with a cold cache, since any other cluster may come before it after sorting
+    std::vector<uint32_t> clusterStarts;
+    std::vector<uint32_t> insertedAt(mesh.positions.size(), 0);
+    uint32_t insertions = 0;
+    uint32_t clusterStart = 0;
+    uint32_t misses = 0;
+    for (uint32_t triangle = 0; triangle < triangleCount; ++triangle) {
+        if (triangle == clusterStart) {
+            clusterStarts.push_back(clusterStart);
+            insertions += simulatedCacheSize + 1;
+            misses = 0;
+        }
+        for (uint32_t corner = 0; corner < 3; ++corner) {
+            uint32_t vertex = mesh.indices[triangle * 3 + corner];
+            if (insertions - insertedAt[vertex] > simulatedCacheSize) {
+                insertedAt[vertex] = insertions++;
+                ++misses;
+            }
+        }
+        if (misses <= threshold * meshAcmr * (triangle + 1 - clusterStart)) {
+            clusterStart = triangle + 1;
+        }
+    }
+    clusterStarts.push_back(triangleCount);
+
+    // Area weighted centers and normals
+    glm::vec3 meshCenter(0.0f);
+    float meshArea = 0.0f;
+    for (uint32_t triangle = 0; triangle < triangleCount; ++triangle) {
+        float area = glm::length(faceNormal(mesh, triangle));
+        meshCenter += faceCenter(mesh, triangle) * area;
+        meshArea += area;
+    }
+    meshCenter /= std::max(meshArea, 1e-20f);
+
+    size_t clusterCount = clusterStarts.size() - 1;
+    std::vector<float> clusterKeys(clusterCount);
+    for (size_t cluster = 0; cluster < clusterCount; ++cluster) {
+        glm::vec3 center(0.0f);
+        glm::vec3 normal(0.0f);
+        float area = 0.0f;
+        for (uint32_t triangle = clusterStarts[cluster]; triangle < clusterStarts[cluster + 1]; ++triangle) {
+            glm::vec3 triangleNormal = faceNormal(mesh, triangle);
+            float triangleArea = glm::length(triangleNormal);
+            center += faceCenter(mesh, triangle) * triangleArea;
+            normal += triangleNormal;
+            area += triangleArea;
+        }
+        center /= std::max(area, 1e-20f);
+        float normalLength = glm::length(normal);
+        clusterKeys[cluster] = normalLength > 0.0f ? glm::dot(center - meshCenter, normal / normalLength) : 0.0f;
+    }
+
+    std::vector<uint32_t> order(clusterCount);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return clusterKeys[a] > clusterKeys[b]; });
+
+    std::vector<uint32_t> result;
+    result.reserve(mesh.indices.size());
+    for (uint32_t cluster : order) {
+        result.insert(result.end(), mesh.indices.begin() + clusterStarts[cluster] * 3, mesh.indices.begin() + clusterStarts[cluster + 1] * 3);
+    }
+    mesh.indices.swap(result);
+    return (uint32_t)clusterCount;
+}
+
+double computeAcmr(const std::vector<uint32_t> &indices, uint32_t vertexCount, uint32_t cacheSize) {
+    if (indices.empty()) {
+        return 0.0;
+    }
+    // A vertex is cached if fewer than cacheSize vertices were inserted after it
+    std::vector<uint32_t> insertedAt(vertexCount, 0);
+    uint32_t insertions = cacheSize + 1;
+    uint64_t misses = 0;
+    for (uint32_t vertex : indices) {
+        if (insertions - insertedAt[vertex] > cacheSize) {
+            insertedAt[vertex] = insertions++;
+            ++misses;
+        }
+    }
+    return (double)misses / (indices.size() / 3);
+}
+
+MeshFileStats writeMeshFile(const std::string &file, const SourceMesh &mesh, MeshVertexFormat format) {
+    if (mesh.indices.empty() || mesh.indices.size() % 3 != 0 || mesh.normals.size() != mesh.positions.size()) {
+        throw std::runtime_error("Mesh for '" + file + "' is no indexed triangle list");
+    }
+    uint32_t vertexCount = (uint32_t)mesh.positions.size();
+    bool quantized = format == MeshVertexFormat::Quantized;
+    uint32_t stride = quantized ? sizeof(QuantizedVertex) : sizeof(FloatVertex);
+    uint32_t indexSize = quantized ? sizeof(uint16_t) : sizeof(uint32_t);
+    // Smallest vertex and index counts which are whole multiples of the alignment in bytes
+    uint32_t vertexAlignment = meshChunkAlignment / std::gcd(stride, meshChunkAlignment);
+    uint32_t indexAlignment = meshChunkAlignment / indexSize;
+
+    glm::vec3 boundsMin = mesh.positions[0];
+    glm::vec3 boundsMax = mesh.positions[0];
+    for (const glm::vec3 &position : mesh.positions) {
+        boundsMin = glm::min(boundsMin, position);
+        boundsMax = glm::max(boundsMax, position);
+    }
+    glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    glm::vec3 extent = glm::max((boundsMax - boundsMin) * 0.5f, glm::vec3(1e-20f));
+
+    // Source vertex of every slot in the vertex section, UINT32_MAX for padding
+    std::vector<uint32_t> vertexSlots;
+    std::vector<uint32_t> chunkIndices;
+    std::vector<MeshChunk> chunks;
+    std::vector<uint32_t> chunkOfVertex(vertexCount, UINT32_MAX);
+    std::vector<uint32_t> localIndex(vertexCount);
+
+    MeshChunk chunk = {};
+    for (size_t triangle = 0; triangle < mesh.indices.size() / 3; ++triangle) {
+        const uint32_t *corners = &mesh.indices[triangle * 3];
+        uint32_t chunkId = (uint32_t)chunks.size();
+        uint32_t newVertices = 0;
+        for (uint32_t corner = 0; corner < 3; ++corner) {
+            bool repeated = (corner > 0 && corners[corner] == corners[0]) || (corner > 1 && corners[corner] == corners[1]);
+            if (chunkOfVertex[corners[corner]] != chunkId && !repeated) {
+                ++newVertices;
+            }
+        }
+        if (chunk.vertexCount + newVertices > meshMaxChunkVertices) {
+            chunks.push_back(chunk);
+            ++chunkId;
+            chunk = {};
+        }
+        if (chunk.indexCount == 0) {
+            chunk.firstVertex = alignUp((uint32_t)vertexSlots.size(), vertexAlignment);
+            chunk.firstIndex = alignUp((uint32_t)chunkIndices.size(), indexAlignment);
+            vertexSlots.resize(chunk.firstVertex, UINT32_MAX);
+            chunkIndices.resize(chunk.firstIndex, 0);
+        }
+        for (uint32_t corner = 0; corner < 3; ++corner) {
+            uint32_t vertex = corners[corner];
+            if (chunkOfVertex[vertex] != chunkId) {
+                chunkOfVertex[vertex] = chunkId;
+                localIndex[vertex] = chunk.vertexCount++;
+                vertexSlots.push_back(vertex);
+            }
+            chunkIndices.push_back(localIndex[vertex]);
+            ++chunk.indexCount;
+        }
+    }
+    chunks.push_back(chunk);
+
+    MeshFileHeader header = {};
+    header.magic = meshFileMagic;
+    header.version = meshFileVersion;
+    header.vertexFormat = (uint32_t)format;
+    header.vertexStride = stride;
+    header.indexSize = indexSize;
+    header.chunkCount = (uint32_t)chunks.size();
+    header.vertexCount = (uint32_t)vertexSlots.size();
+    header.indexCount = (uint32_t)chunkIndices.size();
+    header.vertexDataOffset = alignUp(sizeof(MeshFileHeader) + (uint32_t)(chunks.size() * sizeof(MeshChunk)), meshChunkAlignment);
+    header.indexDataOffset = header.vertexDataOffset + alignUp(header.vertexCount * stride, meshChunkAlignment);
+    for (int axis = 0; axis < 3; ++axis) {
+        header.boundsCenter[axis] = center[axis];
+        header.boundsExtent[axis] = extent[axis];
+    }
+    header.triangleCount = (uint32_t)(mesh.indices.size() / 3);
+    header.sourceVertexCount = vertexCount;
+
+    MeshFileStats stats;
+    stats.chunkCount = header.chunkCount;
+    stats.vertexCount = header.vertexCount;
+    stats.fileSize = header.indexDataOffset + (uint64_t)header.indexCount * indexSize;
+
+    std::vector<char> data(stats.fileSize, 0);
+    std::memcpy(data.data(), &header, sizeof(header));
+    std::memcpy(data.data() + sizeof(header), chunks.data(), chunks.size() * sizeof(MeshChunk));
+
+    float largestExtent = std::max(extent.x, std::max(extent.y, extent.z));
+    char *vertices = data.data() + header.vertexDataOffset;
+    for (size_t slot = 0; slot < vertexSlots.size(); ++slot) {
+        if (vertexSlots[slot] == UINT32_MAX) {
+            continue;
+        }
+        const glm::vec3 &position = mesh.positions[vertexSlots[slot]];
+        const glm::vec3 &normal = mesh.normals[vertexSlots[slot]];
+        if (quantized) {
+            QuantizedVertex vertex;
+            uint64_t packedPosition = glm::packSnorm4x16(glm::vec4((position - center) / extent, 0.0f));
+            std::memcpy(vertex.position, &packedPosition, sizeof(vertex.position));
+            vertex.normal = glm::packSnorm4x8(glm::vec4(normal, 0.0f));
+            std::memcpy(vertices + slot * stride, &vertex, sizeof(vertex));
+
+            glm::vec3 decodedPosition = center + extent * glm::vec3(glm::unpackSnorm4x16(packedPosition));
+            glm::vec3 decodedNormal = glm::normalize(glm::vec3(glm::unpackSnorm4x8(vertex.normal)));
+            stats.maxPositionError = std::max(stats.maxPositionError, glm::length(decodedPosition - position) / largestExtent);
+            float cosine = glm::clamp(glm::dot(decodedNormal, normal), -1.0f, 1.0f);
+            stats.maxNormalError = std::max(stats.maxNormalError, std::acos(cosine) * 180.0f / pi);
+        } else {
+            FloatVertex vertex = { { position.x, position.y, position.z }, { normal.x, normal.y, normal.z } };
+            std::memcpy(vertices + slot * stride, &vertex, sizeof(vertex));
+        }
+    }
+
+    char *indices = data.data() + header.indexDataOffset;
+    for (size_t i = 0; i < chunkIndices.size(); ++i) {
+        if (quantized) {
+            uint16_t index = (uint16_t)chunkIndices[i];
+            std::memcpy(indices + i * indexSize, &index, indexSize);
+        } else {
+            std::memcpy(indices + i * indexSize, &chunkIndices[i], indexSize);
+        }
+    }
+
+    std::ofstream stream(file, std::ios::binary | std::ios::trunc);
+    stream.write(data.data(), (std::streamsize)data.size());
+    if (!stream) {
+        throw std::runtime_error("Failed to write '" + file + "' !");
+    }
+    return stats;
+}
+
+bool convertMesh(const std::string &input, const std::string &output, MeshVertexFormat format) {
+    try {
+        auto start = std::chrono::high_resolution_clock::now();
+        SourceMesh mesh = input == "torus-knot" ? generateTorusKnot(4096, 64) : loadObj(input);
+        uint32_t vertexCount = (uint32_t)mesh.positions.size();
+        double acmrBefore = computeAcmr(mesh.indices, vertexCount, simulatedCacheSize);
+
+        optimizeVertexCache(mesh);
+        double acmrCache = computeAcmr(mesh.indices, vertexCount, simulatedCacheSize);
+        uint32_t clusterCount = optimizeOverdraw(mesh, 1.05f);
+        double acmrAfter = computeAcmr(mesh.indices, vertexCount, simulatedCacheSize);
+
+        MeshFileStats stats = writeMeshFile(output, mesh, format);
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+        std::cout << "Converted " << input << " to " << output << " in " << milliseconds << " ms | " << mesh.indices.size() / 3 << " triangles | " <<
+            stats.vertexCount << " vertices in " << stats.chunkCount << " chunks | " << stats.fileSize << " bytes" << std::endl;
+        std::cout << "ACMR (FIFO " << simulatedCacheSize << "): " << acmrBefore << " as loaded | " << acmrCache << " vertex cache optimized | " <<
+            acmrAfter << " after sorting " << clusterCount << " overdraw clusters" << std::endl;
+        if (format == MeshVertexFormat::Quantized) {
+            std::cout << "Quantization error: position " << stats.maxPositionError << " of the extent | normal " << stats.maxNormalError <<
+                " degrees" << std::endl;
+        }
+    } catch (const std::exception &exception) {
+        std::cerr << "Mesh conversion failed: " << exception.what() << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "MeshFormat.h"
+
+// Indexed triangle list as it comes from the source, one normal per vertex
+struct SourceMesh {
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<uint32_t> indices;
+};
+
+// Wavefront OBJ with v, vn and f lines, polygons are split into fans. Vertices are shared by their position/normal
+// pair, faces without normals get the normalized sum of the adjacent face normals. Throws std::runtime_error.
+SourceMesh loadObj(const std::string &file);
+// Tube around a (2, 3) torus knot, which covers itself several times from any direction
+SourceMesh generateTorusKnot(uint32_t segments, uint32_t sides);
+
+// Tom Forsyth's linear-speed vertex cache optimization: greedily emits the triangle whose vertices score highest,
+// favouring vertices in a simulated 32 entry LRU cache and vertices with few remaining triangles.
+void optimizeVertexCache(SourceMesh &mesh);
+// Cuts the cache optimized order into clusters wherever the cache miss ratio so far stays within threshold of the
+// whole mesh, then draws clusters facing away from the center first (Sander et al., "Fast Triangle Reordering for
+// Vertex Locality and Reduced Overdraw"). Outer surfaces then occlude inner ones from most directions. Returns the
+// amount of clusters.
+uint32_t optimizeOverdraw(SourceMesh &mesh, float threshold);
+// Average cache miss ratio: vertex shader invocations per triangle with a FIFO post-transform cache, 0.5 is ideal for
+// large grids and 3 the worst case
+double computeAcmr(const std::vector<uint32_t> &indices, uint32_t vertexCount, uint32_t cacheSize);
+
+struct MeshFileStats {
+    uint32_t chunkCount = 0;
+    uint32_t vertexCount = 0; // after duplicating the vertices shared by several chunks
+    uint64_t fileSize = 0;
+    float maxPositionError = 0.0f; // relative to the largest extent of the bounding box
+    float maxNormalError = 0.0f; // degrees
+};
+
+// Splits the triangles into chunks of at most meshMaxChunkVertices vertices in their current order, numbers the
+// vertices of every chunk by first use so the vertex fetches follow the index buffer, and writes the file.
+// Throws std::runtime_error.
+MeshFileStats writeMeshFile(const std::string &file, const SourceMesh &mesh, MeshVertexFormat format);
+
+// --convert-mesh: input is an .obj file or "torus-knot". Prints the statistics, false on error.
+bool convertMesh(const std::string &input, const std::string &output, MeshVertexFormat format);
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+
+// Binary mesh files, written offline by the converter (MeshConverter.h) and mapped at runtime by MeshAsset.
+// Little endian and read in place from the mapping, so the structs have no implicit padding:
+//
+//   MeshFileHeader | MeshChunk[chunkCount] | vertex section | index section
+//
+// Both sections are copied to the GPU as they are, at the same offsets. A chunk is a range of triangles whose
+// indices are relative to its first vertex, so 16 bit indices are enough for meshes of any size. Every chunk
+// starts on a meshChunkAlignment boundary in both sections and can be copied straight from the mapping.
+
+const uint32_t meshFileMagic = 0x4853454D; // "MESH"
+const uint32_t meshFileVersion = 1;
+const uint32_t meshChunkAlignment = 256; // bytes, also the alignment of both sections in the file
+const uint32_t meshMaxChunkVertices = 65536;
+
+// Quantized: QuantizedVertex with 16 bit indices, 12 bytes per vertex
+// Float: FloatVertex with 32 bit indices, 24 bytes per vertex, the uncompressed baseline
+enum class MeshVertexFormat : uint32_t { Float = 0, Quantized = 1 };
+
+// Position as snorm16 relative to the bounding box (glm::packSnorm4x16), which spends all bits on the extent of
+// the mesh unlike half floats. Normal as snorm8 (glm::packSnorm4x8). The w components are 0.
+struct QuantizedVertex {
+    uint16_t position[4];
+    uint32_t normal;
+};
+static_assert(sizeof(QuantizedVertex) == 12, "QuantizedVertex has padding");
+
+struct FloatVertex {
+    float position[3];
+    float normal[3];
+};
+static_assert(sizeof(FloatVertex) == 24, "FloatVertex has padding");
+
+struct MeshFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertexFormat; // MeshVertexFormat
+    uint32_t vertexStride; // bytes
+    uint32_t indexSize; // bytes, 2 or 4
+    uint32_t chunkCount;
+    uint32_t vertexCount; // size of the vertex section in vertices, including the padding between chunks
+    uint32_t indexCount; // size of the index section in indices, including the padding between chunks
+    uint64_t vertexDataOffset; // from the start of the file
+    uint64_t indexDataOffset;
+    // Object space position = boundsCenter + boundsExtent * quantized position, unused for Float
+    float boundsCenter[3];
+    float boundsExtent[3];
+    uint32_t triangleCount;
+    uint32_t sourceVertexCount; // before vertices shared by several chunks were duplicated
+};
+static_assert(sizeof(MeshFileHeader) == 80, "MeshFileHeader has padding");
+
+struct MeshChunk {
+    uint32_t firstVertex; // in the vertex section, the indices of the chunk are relative to it
+    uint32_t vertexCount;
+    uint32_t firstIndex; // in the index section
+    uint32_t indexCount;
+};
+static_assert(sizeof(MeshChunk) == 16, "MeshChunk has padding");
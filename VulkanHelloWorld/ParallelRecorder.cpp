@@ -0,0 +1,79 @@
+#include "ParallelRecorder.h"
+
+#include "VulkanUtils.h"
+
+void ParallelRecorder::init(VkDevice device, uint32_t queueFamilyIndex, uint32_t workerCount, uint32_t framesInFlight) {
+    this->device = device;
+    this->workerCount = workerCount;
+    pools.resize(workerCount * framesInFlight);
+
+    for (WorkerPool &pool : pools) {
+        // No RESET_COMMAND_BUFFER flag, the buffers are only ever reset together with their pool
+        VkCommandPoolCreateInfo commandPoolCreateInfo;
+        commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        commandPoolCreateInfo.pNext = nullptr;
+        commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        commandPoolCreateInfo.queueFamilyIndex = queueFamilyIndex;
+
+        VkResult result = vkCreateCommandPool(device, &commandPoolCreateInfo, nullptr, &pool.commandPool);
+        ASSERT_VULKAN(result);
+    }
+}
+
+void ParallelRecorder::destroy() {
+    for (WorkerPool &pool : pools) {
+        // Destroying the pool frees its command buffers
+        vkDestroyCommandPool(device, pool.commandPool, nullptr);
+    }
+    pools.clear();
+}
+
+void ParallelRecorder::beginFrame(uint32_t frame) {
+    currentFrame = frame;
+    for (uint32_t worker = 0; worker < workerCount; ++worker) {
+        WorkerPool &pool = pools[frame * workerCount + worker];
+        if (pool.used == 0) {
+            continue;
+        }
+        VkResult result = vkResetCommandPool(device, pool.commandPool, 0);
+        ASSERT_VULKAN(result);
+        pool.used = 0;
+    }
+}
+
+VkCommandBuffer ParallelRecorder::beginSecondary(uint32_t worker, const VkCommandBufferInheritanceInfo &inheritanceInfo) {
+    WorkerPool &pool = pools[currentFrame * workerCount + worker];
+
+    if (pool.used == pool.commandBuffers.size()) {
+        VkCommandBufferAllocateInfo commandBufferAllocateInfo;
+        commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        commandBufferAllocateInfo.pNext = nullptr;
+        commandBufferAllocateInfo.commandPool = pool.commandPool;
+        commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        commandBufferAllocateInfo.commandBufferCount = 1;
+
+        VkCommandBuffer commandBuffer;
+        VkResult result = vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, &commandBuffer);
+        ASSERT_VULKAN(result);
+        pool.commandBuffers.push_back(commandBuffer);
+    }
+    VkCommandBuffer commandBuffer = pool.commandBuffers[pool.used++];
+
+    VkCommandBufferBeginInfo commandBufferBeginInfo;
+    commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    commandBufferBeginInfo.pNext = nullptr;
+    commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    commandBufferBeginInfo.pInheritanceInfo = &inheritanceInfo;
+
+    VkResult result = vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
+    ASSERT_VULKAN(result);
+    return commandBuffer;
+}
+
+uint32_t ParallelRecorder::getRecordedCount() const {
+    uint32_t count = 0;
+    for (uint32_t worker = 0; worker < workerCount; ++worker) {
+        count += pools[currentFrame * workerCount + worker].used;
+    }
+    return count;
+}
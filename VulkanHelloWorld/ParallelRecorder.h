@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// Hands out secondary command buffers for recording on several threads. Every worker gets one
+// command pool per frame in flight, so a worker only ever touches its own pool and no locks
+// are needed. Pools are reset as a whole once the fence of their frame signaled, the command
+// buffers allocated from them are kept and reused by the following frames.
+class ParallelRecorder {
+public:
+    void init(VkDevice device, uint32_t queueFamilyIndex, uint32_t workerCount, uint32_t framesInFlight);
+    void destroy();
+
+    // Resets all pools of the frame, call after its fence signaled and before any beginSecondary()
+    void beginFrame(uint32_t frame);
+
+    // Next unused secondary command buffer of the worker, already begun with the inheritance info
+    VkCommandBuffer beginSecondary(uint32_t worker, const VkCommandBufferInheritanceInfo &inheritanceInfo);
+
+    // Command buffers handed out since the last beginFrame(), summed over all workers
+    uint32_t getRecordedCount() const;
+
+private:
+    struct WorkerPool {
+        VkCommandPool commandPool = VK_NULL_HANDLE;
+        std::vector<VkCommandBuffer> commandBuffers;
+        uint32_t used = 0;
+    };
+
+    VkDevice device = VK_NULL_HANDLE;
+    uint32_t workerCount = 0;
+    uint32_t currentFrame = 0;
+    // Indexed by frame * workerCount + worker
+    std::vector<WorkerPool> pools;
+};
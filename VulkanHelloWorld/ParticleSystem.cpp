@@ -0,0 +1,566 @@
+#include "ParticleSystem.h"
+
+#include <iostream>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <algorithm>
+#include "VulkanUtils.h"
+
+namespace {
+    const float initialRadius = 0.8f;
+    const float initialSwirl = 0.3f; // tangential speed at the edge of the disc
+
+    VkBufferCreateInfo bufferInfo(VkDeviceSize size, VkBufferUsageFlags usage, bool concurrent, const uint32_t *queueFamilies) {
+        VkBufferCreateInfo bufferCreateInfo;
+        bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferCreateInfo.pNext = nullptr;
+        bufferCreateInfo.flags = 0;
+        bufferCreateInfo.size = size;
+        bufferCreateInfo.usage = usage;
+        bufferCreateInfo.sharingMode = concurrent ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+        bufferCreateInfo.queueFamilyIndexCount = concurrent ? 2 : 0;
+        bufferCreateInfo.pQueueFamilyIndices = concurrent ? queueFamilies : nullptr;
+        return bufferCreateInfo;
+    }
+
+    void memoryBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStages, VkAccessFlags srcAccess, VkPipelineStageFlags dstStages, VkAccessFlags dstAccess) {
+        VkMemoryBarrier barrier;
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.pNext = nullptr;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstAccessMask = dstAccess;
+        vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+}
+
+void ParticleSystem::init(VkDevice device, VkPhysicalDevice physicalDevice, MemoryAllocator &memoryAllocator, const ShaderCode &shaderCode,
+    VkPipelineCache pipelineCache, uint32_t particleCount, uint32_t graphicsFamily, uint32_t computeFamily, uint32_t framesInFlight) {
+    this->device = device;
+    // The step dispatches one dimension of workgroups
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    uint64_t maxParticles = (uint64_t)properties.limits.maxComputeWorkGroupCount[0] * workgroupSize;
+    if (particleCount > maxParticles) {
+        std::cout << "Particle count " << particleCount << " exceeds the workgroup count limit, using " << maxParticles << std::endl;
+        particleCount = (uint32_t)maxParticles;
+    }
+    this->particleCount = particleCount;
+    async = computeFamily != graphicsFamily;
+    queueFamilies[0] = graphicsFamily;
+    queueFamilies[1] = computeFamily;
+    vkGetDeviceQueue(device, computeFamily, 0, &computeQueue);
+    pushConstants.amountOfParticles = particleCount;
+
+    createBuffers(memoryAllocator);
+    createPipeline(shaderCode, pipelineCache);
+    createDescriptorSets();
+    createFrameResources(physicalDevice, framesInFlight);
+    uploadInitialState(memoryAllocator);
+}
+
+void ParticleSystem::destroy(MemoryAllocator &memoryAllocator) {
+    if (!fences.empty()) {
+        VkResult result = vkWaitForFences(device, (uint32_t)fences.size(), fences.data(), VK_TRUE, std::numeric_limits<uint64_t>::max());
+        ASSERT_VULKAN(result);
+    }
+    printSummary();
+
+    for (size_t i = 0; i < fences.size(); ++i) {
+        vkDestroyFence(device, fences[i], nullptr);
+        vkDestroySemaphore(device, stepDone[i], nullptr);
+        vkDestroySemaphore(device, drawDone[i], nullptr);
+    }
+    for (VkQueryPool pool : timestampPools) {
+        vkDestroyQueryPool(device, pool, nullptr);
+    }
+    fences.clear();
+    stepDone.clear();
+    drawDone.clear();
+    timestampPools.clear();
+    // Destroying the pool frees its command buffers
+    vkDestroyCommandPool(device, commandPool, nullptr);
+    commandBuffers.clear();
+
+    vkDestroyPipeline(device, pipeline, nullptr);
+    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+
+    for (uint32_t i = 0; i < 2; ++i) {
+        memoryAllocator.destroyBuffer(positionBuffers[i], positionAllocations[i]);
+    }
+    memoryAllocator.destroyBuffer(velocityBuffer, velocityAllocation);
+}
+
+void ParticleSystem::createBuffers(MemoryAllocator &memoryAllocator) {
+    VkDeviceSize size = (VkDeviceSize)particleCount * sizeof(glm::vec2);
+    for (uint32_t i = 0; i < 2; ++i) {
+        VkBufferCreateInfo positionCreateInfo = bufferInfo(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT, async, queueFamilies);
+        memoryAllocator.createBuffer(positionCreateInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, positionBuffers[i], positionAllocations[i]);
+    }
+    // Only the compute queue touches the velocities
+    VkBufferCreateInfo velocityCreateInfo = bufferInfo(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, false, nullptr);
+    memoryAllocator.createBuffer(velocityCreateInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, velocityBuffer, velocityAllocation);
+}
+
+// A disc of particles swirling around its center. Copied on the compute queue once at startup, the fence wait
+// makes the data available before the first frame.
+void ParticleSystem::uploadInitialState(MemoryAllocator &memoryAllocator) {
+    VkDeviceSize size = (VkDeviceSize)particleCount * sizeof(glm::vec2);
+    VkBuffer stagingBuffer;
+    Allocation stagingAllocation;
+    VkBufferCreateInfo stagingCreateInfo = bufferInfo(2 * size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, false, nullptr);
+    memoryAllocator.createBuffer(stagingCreateInfo, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        stagingBuffer, stagingAllocation);
+
+    glm::vec2 *positions = static_cast<glm::vec2*>(stagingAllocation.mapped);
+    glm::vec2 *velocities = positions + particleCount;
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (uint32_t i = 0; i < particleCount; ++i) {
+        float radius = initialRadius * std::sqrt(unit(random)); // uniform over the area
+        float angle = 6.2831853f * unit(random);
+        glm::vec2 direction(std::cos(angle), std::sin(angle));
+        positions[i] = radius * direction;
+        velocities[i] = initialSwirl * radius / initialRadius * glm::vec2(-direction.y, direction.x);
+    }
+
+    VkCommandBufferAllocateInfo commandBufferAllocateInfo;
+    commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    commandBufferAllocateInfo.pNext = nullptr;
+    commandBufferAllocateInfo.commandPool = commandPool;
+    commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    commandBufferAllocateInfo.commandBufferCount = 1;
+
+    VkCommandBuffer commandBuffer;
+    VkResult result = vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, &commandBuffer);
+    ASSERT_VULKAN(result);
+
+    VkCommandBufferBeginInfo commandBufferBeginInfo;
+    commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    commandBufferBeginInfo.pNext = nullptr;
+    commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    commandBufferBeginInfo.pInheritanceInfo = nullptr;
+
+    result = vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
+    ASSERT_VULKAN(result);
+
+    VkBufferCopy region;
+    region.srcOffset = 0;
+    region.dstOffset = 0;
+    region.size = size;
+    vkCmdCopyBuffer(commandBuffer, stagingBuffer, positionBuffers[0], 1, &region);
+    region.srcOffset = size;
+    vkCmdCopyBuffer(commandBuffer, stagingBuffer, velocityBuffer, 1, &region);
+
+    result = vkEndCommandBuffer(commandBuffer);
+    ASSERT_VULKAN(result);
+
+    VkFenceCreateInfo fenceCreateInfo;
+    fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fenceCreateInfo.pNext = nullptr;
+    fenceCreateInfo.flags = 0;
+
+    VkFence fence;
+    result = vkCreateFence(device, &fenceCreateInfo, nullptr, &fence);
+    ASSERT_VULKAN(result);
+
+    VkSubmitInfo submitInfo;
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = nullptr;
+    submitInfo.waitSemaphoreCount = 0;
+    submitInfo.pWaitSemaphores = nullptr;
+    submitInfo.pWaitDstStageMask = nullptr;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    submitInfo.signalSemaphoreCount = 0;
+    submitInfo.pSignalSemaphores = nullptr;
+
+    result = vkQueueSubmit(computeQueue, 1, &submitInfo, fence);
+    ASSERT_VULKAN(result);
+    result = vkWaitForFences(device, 1, &fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+    ASSERT_VULKAN(result);
+
+    vkDestroyFence(device, fence, nullptr);
+    vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+    memoryAllocator.destroyBuffer(stagingBuffer, stagingAllocation);
+}
+
+void ParticleSystem::createPipeline(const ShaderCode &shaderCode, VkPipelineCache pipelineCache) {
+    VkDescriptorSetLayoutBinding bindings[amountOfBindings];
+    for (uint32_t i = 0; i < amountOfBindings; ++i) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        bindings[i].pImmutableSamplers = nullptr;
+    }
+
+    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo;
+    descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    descriptorSetLayoutCreateInfo.pNext = nullptr;
+    descriptorSetLayoutCreateInfo.flags = 0;
+    descriptorSetLayoutCreateInfo.bindingCount = amountOfBindings;
+    descriptorSetLayoutCreateInfo.pBindings = bindings;
+
+    VkResult result = vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, nullptr, &descriptorSetLayout);
+    ASSERT_VULKAN(result);
+
+    VkPushConstantRange pushConstantRange;
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(PushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo;
+    pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutCreateInfo.pNext = nullptr;
+    pipelineLayoutCreateInfo.flags = 0;
+    pipelineLayoutCreateInfo.setLayoutCount = 1;
+    pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayout;
+    pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+    pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+    result = vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout);
+    ASSERT_VULKAN(result);
+
+    VkShaderModule shaderModule = createShaderModule(device, shaderCode);
+
+    VkComputePipelineCreateInfo pipelineCreateInfo;
+    pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineCreateInfo.pNext = nullptr;
+    pipelineCreateInfo.flags = 0;
+    pipelineCreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineCreateInfo.stage.pNext = nullptr;
+    pipelineCreateInfo.stage.flags = 0;
+    pipelineCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineCreateInfo.stage.module = shaderModule;
+    pipelineCreateInfo.stage.pName = "main";
+    pipelineCreateInfo.stage.pSpecializationInfo = nullptr;
+    pipelineCreateInfo.layout = pipelineLayout;
+    pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+    pipelineCreateInfo.basePipelineIndex = -1;
+
+    result = vkCreateComputePipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline);
+    ASSERT_VULKAN(result);
+
+    // The pipeline keeps what it needs
+    vkDestroyShaderModule(device, shaderModule, nullptr);
+}
+
+// One set per direction, so a step only binds the set of the positions it reads
+void ParticleSystem::createDescriptorSets() {
+    VkDescriptorPoolSize poolSize;
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = 2 * amountOfBindings;
+
+    VkDescriptorPoolCreateInfo descriptorPoolCreateInfo;
+    descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descriptorPoolCreateInfo.pNext = nullptr;
+    descriptorPoolCreateInfo.flags = 0;
+    descriptorPoolCreateInfo.maxSets = 2;
+    descriptorPoolCreateInfo.poolSizeCount = 1;
+    descriptorPoolCreateInfo.pPoolSizes = &poolSize;
+
+    VkResult result = vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, nullptr, &descriptorPool);
+    ASSERT_VULKAN(result);
+
+    VkDescriptorSetLayout setLayouts[2] = { descriptorSetLayout, descriptorSetLayout };
+    VkDescriptorSetAllocateInfo descriptorSetAllocateInfo;
+    descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descriptorSetAllocateInfo.pNext = nullptr;
+    descriptorSetAllocateInfo.descriptorPool = descriptorPool;
+    descriptorSetAllocateInfo.descriptorSetCount = 2;
+    descriptorSetAllocateInfo.pSetLayouts = setLayouts;
+
+    result = vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, descriptorSets);
+    ASSERT_VULKAN(result);
+
+    VkDescriptorBufferInfo bufferInfos[2 * amountOfBindings];
+    VkWriteDescriptorSet writes[2 * amountOfBindings];
+    for (uint32_t set = 0; set < 2; ++set) {
+        VkBuffer buffers[amountOfBindings] = { positionBuffers[set], positionBuffers[1 - set], velocityBuffer };
+        for (uint32_t binding = 0; binding < amountOfBindings; ++binding) {
+            uint32_t i = set * amountOfBindings + binding;
+            bufferInfos[i].buffer = buffers[binding];
+            bufferInfos[i].offset = 0;
+            bufferInfos[i].range = VK_WHOLE_SIZE;
+
+            writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[i].pNext = nullptr;
+            writes[i].dstSet = descriptorSets[set];
+            writes[i].dstBinding = binding;
+            writes[i].dstArrayElement = 0;
+            writes[i].descriptorCount = 1;
+            writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[i].pImageInfo = nullptr;
+            writes[i].pBufferInfo = &bufferInfos[i];
+            writes[i].pTexelBufferView = nullptr;
+        }
+    }
+    vkUpdateDescriptorSets(device, 2 * amountOfBindings, writes, 0, nullptr);
+}
+
+void ParticleSystem::createFrameResources(VkPhysicalDevice physicalDevice, uint32_t framesInFlight) {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    timestampPeriod = properties.limits.timestampPeriod;
+
+    uint32_t amountOfQueueFamilies = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &amountOfQueueFamilies, nullptr);
+    std::vector<VkQueueFamilyProperties> familyProperties(amountOfQueueFamilies);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &amountOfQueueFamilies, familyProperties.data());
+
+    uint32_t validBits = familyProperties[queueFamilies[1]].timestampValidBits;
+    timestampsSupported = validBits > 0;
+    timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+    VkCommandPoolCreateInfo commandPoolCreateInfo;
+    commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    commandPoolCreateInfo.pNext = nullptr;
+    commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    commandPoolCreateInfo.queueFamilyIndex = queueFamilies[1];
+
+    VkResult result = vkCreateCommandPool(device, &commandPoolCreateInfo, nullptr, &commandPool);
+    ASSERT_VULKAN(result);
+
+    pending.assign(framesInFlight, false);
+    if (timestampsSupported) {
+        timestampPools.resize(framesInFlight, VK_NULL_HANDLE);
+        for (uint32_t i = 0; i < framesInFlight; ++i) {
+            VkQueryPoolCreateInfo queryPoolCreateInfo;
+            queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            queryPoolCreateInfo.pNext = nullptr;
+            queryPoolCreateInfo.flags = 0;
+            queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            queryPoolCreateInfo.queryCount = 2;
+            queryPoolCreateInfo.pipelineStatistics = 0;
+            result = vkCreateQueryPool(device, &queryPoolCreateInfo, nullptr, &timestampPools[i]);
+            ASSERT_VULKAN(result);
+        }
+    }
+
+    if (!async) {
+        return;
+    }
+
+    commandBuffers.resize(framesInFlight);
+    VkCommandBufferAllocateInfo commandBufferAllocateInfo;
+    commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    commandBufferAllocateInfo.pNext = nullptr;
+    commandBufferAllocateInfo.commandPool = commandPool;
+    commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    commandBufferAllocateInfo.commandBufferCount = framesInFlight;
+
+    result = vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, commandBuffers.data());
+    ASSERT_VULKAN(result);
+
+    VkSemaphoreCreateInfo semaphoreCreateInfo;
+    semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreCreateInfo.pNext = nullptr;
+    semaphoreCreateInfo.flags = 0;
+
+    VkFenceCreateInfo fenceCreateInfo;
+    fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fenceCreateInfo.pNext = nullptr;
+    fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+    fences.resize(framesInFlight);
+    stepDone.resize(framesInFlight);
+    drawDone.resize(framesInFlight);
+    for (uint32_t i = 0; i < framesInFlight; ++i) {
+        result = vkCreateFence(device, &fenceCreateInfo, nullptr, &fences[i]);
+        ASSERT_VULKAN(result);
+        result = vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &stepDone[i]);
+        ASSERT_VULKAN(result);
+        result = vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &drawDone[i]);
+        ASSERT_VULKAN(result);
+    }
+}
+
+void ParticleSystem::beginFrame(uint32_t frame, float deltaTime, bool graphicsTicksValid, uint64_t graphicsBegin, uint64_t graphicsEnd) {
+    if (recordingFrame != UINT32_MAX) {
+        previousFrame = recordingFrame;
+        ++step;
+    }
+    recordingFrame = frame;
+
+    // The step of the slot usually finished long before the graphics frame of the slot did
+    if (async) {
+        VkResult result = vkWaitForFences(device, 1, &fences[frame], VK_TRUE, std::numeric_limits<uint64_t>::max());
+        ASSERT_VULKAN(result);
+    }
+    collect(frame, graphicsTicksValid, graphicsBegin, graphicsEnd);
+
+    // The attractor moves along a Lissajous curve, so the swarm keeps changing shape
+    float time = step * deltaTime;
+    pushConstants.attractor = glm::vec2(0.6f * std::sin(0.7f * time), 0.6f * std::sin(1.1f * time));
+    pushConstants.deltaTime = deltaTime;
+}
+
+void ParticleSystem::recordDispatch(VkCommandBuffer commandBuffer) {
+    if (timestampsSupported) {
+        vkCmdResetQueryPool(commandBuffer, timestampPools[recordingFrame], 0, 2);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPools[recordingFrame], 0);
+    }
+
+    if (async) {
+        // The previous step on this queue wrote the velocities and the positions read now. The previous graphics
+        // frame reading the positions written now is covered by the semaphore.
+        memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    } else {
+        // Additionally the draw of this frame reads what the previous step wrote, and the previous frame may still
+        // draw the positions written now
+        memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+            VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+    }
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSets[step % 2], 0, nullptr);
+    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+    vkCmdDispatch(commandBuffer, (particleCount + workgroupSize - 1) / workgroupSize, 1, 1);
+
+    if (timestampsSupported) {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPools[recordingFrame], 1);
+    }
+    pending[recordingFrame] = true;
+}
+
+void ParticleSystem::recordStep(VkCommandBuffer commandBuffer) {
+    recordDispatch(commandBuffer);
+}
+
+void ParticleSystem::recordDraw(VkCommandBuffer commandBuffer) const {
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &positionBuffers[step % 2], &offset);
+    vkCmdDraw(commandBuffer, particleCount, 1, 0, 0);
+}
+
+void ParticleSystem::submitStep() {
+    VkCommandBuffer commandBuffer = commandBuffers[recordingFrame];
+
+    VkCommandBufferBeginInfo commandBufferBeginInfo;
+    commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    commandBufferBeginInfo.pNext = nullptr;
+    commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    commandBufferBeginInfo.pInheritanceInfo = nullptr;
+
+    VkResult result = vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
+    ASSERT_VULKAN(result);
+    recordDispatch(commandBuffer);
+    result = vkEndCommandBuffer(commandBuffer);
+    ASSERT_VULKAN(result);
+
+    // The first step has no graphics frame before it. The begin timestamp is written at TOP_OF_PIPE, which a wait
+    // at COMPUTE_SHADER would not hold back, so the whole step waits.
+    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    VkSubmitInfo submitInfo;
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = nullptr;
+    submitInfo.waitSemaphoreCount = previousFrame != UINT32_MAX ? 1 : 0;
+    submitInfo.pWaitSemaphores = previousFrame != UINT32_MAX ? &drawDone[previousFrame] : nullptr;
+    submitInfo.pWaitDstStageMask = &waitStage;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &stepDone[recordingFrame];
+
+    result = vkResetFences(device, 1, &fences[recordingFrame]);
+    ASSERT_VULKAN(result);
+    result = vkQueueSubmit(computeQueue, 1, &submitInfo, fences[recordingFrame]);
+    ASSERT_VULKAN(result);
+}
+
+VkSemaphore ParticleSystem::getWaitSemaphore() const {
+    return async && previousFrame != UINT32_MAX ? stepDone[previousFrame] : VK_NULL_HANDLE;
+}
+
+VkSemaphore ParticleSystem::getSignalSemaphore() const {
+    return async ? drawDone[recordingFrame] : VK_NULL_HANDLE;
+}
+
+void ParticleSystem::getVertexInput(std::vector<VkVertexInputBindingDescription> &bindings, std::vector<VkVertexInputAttributeDescription> &attributes) const {
+    VkVertexInputBindingDescription binding;
+    binding.binding = 0;
+    binding.stride = sizeof(glm::vec2);
+    binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    bindings.push_back(binding);
+
+    VkVertexInputAttributeDescription attribute;
+    attribute.location = 0;
+    attribute.binding = 0;
+    attribute.format = VK_FORMAT_R32G32_SFLOAT;
+    attribute.offset = 0;
+    attributes.push_back(attribute);
+}
+
+// Timestamps of different queues are only compared with each other. Vulkan 1.0 does not promise a common time
+// domain for them, but the queues of one device count the same clock in practice.
+void ParticleSystem::collect(uint32_t frame, bool graphicsTicksValid, uint64_t graphicsBegin, uint64_t graphicsEnd) {
+    if (!pending[frame]) {
+        return;
+    }
+    pending[frame] = false;
+
+    uint64_t timestamps[4]; // value and availability of both queries
+    VkResult result = vkGetQueryPoolResults(device, timestampPools[frame], 0, 2, sizeof(timestamps), timestamps, 2 * sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if ((result != VK_SUCCESS && result != VK_NOT_READY) || timestamps[1] == 0 || timestamps[3] == 0) {
+        return;
+    }
+
+    double simulationTime = ((timestamps[2] - timestamps[0]) & timestampMask) * timestampPeriod / 1000000.0;
+    ++measuredSteps;
+    simulationTimeSum += simulationTime;
+    ++totalMeasuredSteps;
+    totalSimulationTime += simulationTime;
+
+    if (async && graphicsTicksValid) {
+        uint64_t overlapBegin = std::max(timestamps[0], graphicsBegin);
+        uint64_t overlapEnd = std::min(timestamps[2], graphicsEnd);
+        double overlapTime = overlapEnd > overlapBegin ? (overlapEnd - overlapBegin) * timestampPeriod / 1000000.0 : 0.0;
+        ++overlapSteps;
+        overlapTimeSum += overlapTime;
+        overlapSimulationSum += simulationTime;
+        totalOverlapTime += overlapTime;
+        totalOverlapSimulation += simulationTime;
+    }
+}
+
+void ParticleSystem::printReport() {
+    std::cout << "Particles: " << particleCount << " | step on the ";
+    if (async) {
+        std::cout << "compute queue (family " << queueFamilies[1] << ")";
+    } else {
+        std::cout << "graphics queue";
+    }
+    std::cout << " | simulation avg " << (measuredSteps > 0 ? simulationTimeSum / measuredSteps : 0.0) << " ms";
+    if (!timestampsSupported) {
+        std::cout << " | no timestamps on the queue family";
+    } else if (!async) {
+        std::cout << " | serialized with the frame";
+    } else if (overlapSteps > 0) {
+        std::cout << " | " << (overlapSimulationSum > 0.0 ? 100.0 * overlapTimeSum / overlapSimulationSum : 0.0) <<
+            "% overlapped with rendering, " << overlapTimeSum / overlapSteps << " ms per frame";
+    }
+    std::cout << std::endl;
+
+    measuredSteps = 0;
+    simulationTimeSum = 0.0;
+    overlapSteps = 0;
+    overlapTimeSum = 0.0;
+    overlapSimulationSum = 0.0;
+}
+
+void ParticleSystem::printSummary() const {
+    std::cout << "Particles: " << particleCount << " on the " << (async ? "compute" : "graphics") << " queue | " << totalMeasuredSteps <<
+        " steps measured, avg " << (totalMeasuredSteps > 0 ? totalSimulationTime / totalMeasuredSteps : 0.0) << " ms";
+    if (async && totalOverlapSimulation > 0.0) {
+        std::cout << " | " << 100.0 * totalOverlapTime / totalOverlapSimulation << "% overlapped with rendering";
+    }
+    std::cout << std::endl;
+}
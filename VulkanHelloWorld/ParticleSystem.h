@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include "MemoryAllocator.h"
+#include "ShaderLoader.h"
+
+// Particles integrated by a compute shader (particles.comp) and drawn as points straight from the position buffer.
+// Positions and velocities are separate storage buffers, and the positions are double buffered: the step of frame N
+// reads the positions frame N draws and writes the ones frame N + 1 draws, so simulation and rendering of
+// neighbouring frames never touch the same buffer.
+//
+// With a separate compute queue family the step of frame N is submitted on that queue and runs while the graphics
+// queue renders frame N. Two semaphores per frame slot order them: the graphics submit of frame N waits for the step
+// of frame N - 1 at the vertex input stage and signals its own one, which the step of frame N + 1 waits for before it
+// overwrites the positions frame N drew. The buffers are shared concurrently by both families, so no ownership
+// transfers are needed. Without a compute family the step is recorded into the graphics command buffer in front of
+// the render pass instead.
+//
+// The step is timed with timestamps on its queue. Compared with the graphics frame of the same slot this gives the
+// share of the simulation that ran while the graphics queue was busy.
+class ParticleSystem {
+public:
+    // computeFamily == graphicsFamily simulates on the graphics queue
+    void init(VkDevice device, VkPhysicalDevice physicalDevice, MemoryAllocator &memoryAllocator, const ShaderCode &shaderCode,
+        VkPipelineCache pipelineCache, uint32_t particleCount, uint32_t graphicsFamily, uint32_t computeFamily, uint32_t framesInFlight);
+    // Waits for the steps still running on the compute queue
+    void destroy(MemoryAllocator &memoryAllocator);
+
+    // Call after the fence of the frame signaled and after gpuTimer.collect(), every frame from here on is submitted
+    void beginFrame(uint32_t frame, float deltaTime, bool graphicsTicksValid, uint64_t graphicsBegin, uint64_t graphicsEnd);
+
+    // Graphics queue only: outside of a render pass, records the step of the frame
+    void recordStep(VkCommandBuffer commandBuffer);
+    // Inside the render pass with the particle pipeline bound
+    void recordDraw(VkCommandBuffer commandBuffer) const;
+
+    // Compute queue only: submits the step of the frame, call before the graphics submit
+    void submitStep();
+    // The graphics submit of the frame waits for getWaitSemaphore() at the vertex input stage and signals
+    // getSignalSemaphore(). VK_NULL_HANDLE if there is nothing to wait for or signal.
+    VkSemaphore getWaitSemaphore() const;
+    VkSemaphore getSignalSemaphore() const;
+
+    bool isAsync() const { return async; }
+    void getVertexInput(std::vector<VkVertexInputBindingDescription> &bindings, std::vector<VkVertexInputAttributeDescription> &attributes) const;
+
+    void printReport();
+    void printSummary() const;
+
+private:
+    struct PushConstants {
+        glm::vec2 attractor;
+        float deltaTime;
+        uint32_t amountOfParticles;
+    };
+
+    static const uint32_t workgroupSize = 256;
+    static const uint32_t amountOfBindings = 3;
+
+    void createBuffers(MemoryAllocator &memoryAllocator);
+    void uploadInitialState(MemoryAllocator &memoryAllocator);
+    void createPipeline(const ShaderCode &shaderCode, VkPipelineCache pipelineCache);
+    void createDescriptorSets();
+    void createFrameResources(VkPhysicalDevice physicalDevice, uint32_t framesInFlight);
+    void recordDispatch(VkCommandBuffer commandBuffer);
+    void collect(uint32_t frame, bool graphicsTicksValid, uint64_t graphicsBegin, uint64_t graphicsEnd);
+
+    VkDevice device = VK_NULL_HANDLE;
+    uint32_t particleCount = 0;
+    bool async = false;
+    uint32_t queueFamilies[2] = {};
+    VkQueue computeQueue = VK_NULL_HANDLE;
+
+    VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet descriptorSets[2] = { VK_NULL_HANDLE, VK_NULL_HANDLE }; // step reading positions 0 and 1
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+
+    VkBuffer positionBuffers[2] = { VK_NULL_HANDLE, VK_NULL_HANDLE };
+    Allocation positionAllocations[2];
+    VkBuffer velocityBuffer = VK_NULL_HANDLE;
+    Allocation velocityAllocation;
+
+    // Per frame slot, the command buffers, fences and semaphores are only used with the compute queue
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    std::vector<VkCommandBuffer> commandBuffers;
+    std::vector<VkFence> fences; // of the steps, signaled while the slot is free
+    std::vector<VkSemaphore> stepDone;
+    std::vector<VkSemaphore> drawDone;
+    std::vector<VkQueryPool> timestampPools; // begin and end of the step
+    std::vector<bool> pending;
+
+    bool timestampsSupported = false;
+    double timestampPeriod = 1.0; // nanoseconds per tick
+    uint64_t timestampMask = ~0ull;
+
+    uint64_t step = 0; // the frame being recorded reads positions step % 2
+    uint32_t recordingFrame = UINT32_MAX;
+    uint32_t previousFrame = UINT32_MAX; // slot of the last submitted frame, UINT32_MAX before the first
+    PushConstants pushConstants = {};
+
+    // Since the last report, steps without graphics timestamps count towards the simulation time only
+    uint64_t measuredSteps = 0;
+    double simulationTimeSum = 0.0;
+    uint64_t overlapSteps = 0;
+    double overlapTimeSum = 0.0;
+    double overlapSimulationSum = 0.0; // simulation time of the steps in overlapSteps
+    uint64_t totalMeasuredSteps = 0;
+    double totalSimulationTime = 0.0;
+    double totalOverlapTime = 0.0;
+    double totalOverlapSimulation = 0.0;
+};
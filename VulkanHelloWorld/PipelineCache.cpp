@@ -0,0 +1,181 @@
+#include "PipelineCache.h"
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <cstring>
+#include "VulkanUtils.h"
+
+namespace {
+    const uint32_t cacheFileMagic = 0x43505648; // "HVPC"
+    const uint32_t cacheFileVersion = 1;
+
+    // Layout of the header the driver puts in front of its own data (VK_PIPELINE_CACHE_HEADER_VERSION_ONE)
+    struct VulkanCacheHeader {
+        uint32_t headerSize;
+        uint32_t headerVersion;
+        uint32_t vendorID;
+        uint32_t deviceID;
+        uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+    };
+}
+
+void PipelineCache::load(VkDevice device, VkPhysicalDevice physicalDevice, const std::string &filename) {
+    this->device = device;
+    this->filename = filename;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    std::string rejectReason;
+    hit = readCacheFile(rejectReason);
+    if (!hit) {
+        std::cout << "Pipeline cache: no usable data in '" << filename << "' (" << rejectReason << ")" << std::endl;
+        initialData.clear();
+    }
+
+    VkPipelineCacheCreateInfo pipelineCacheCreateInfo;
+    pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    pipelineCacheCreateInfo.pNext = nullptr;
+    pipelineCacheCreateInfo.flags = 0;
+    pipelineCacheCreateInfo.initialDataSize = initialData.size();
+    pipelineCacheCreateInfo.pInitialData = initialData.empty() ? nullptr : initialData.data();
+
+    VkResult result = vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache);
+    ASSERT_VULKAN(result);
+
+    // The driver copied the data, no need to keep it around
+    initialData.clear();
+    initialData.shrink_to_fit();
+}
+
+bool PipelineCache::readCacheFile(std::string &rejectReason) {
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    if (!file) {
+        rejectReason = "file not found";
+        return false;
+    }
+
+    size_t fileSize = (size_t)file.tellg();
+    if (fileSize < sizeof(FileHeader)) {
+        rejectReason = "file too small";
+        return false;
+    }
+
+    FileHeader header;
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+    if (header.magic != cacheFileMagic || header.version != cacheFileVersion) {
+        rejectReason = "unknown file format";
+        return false;
+    }
+    if (header.vendorID != properties.vendorID || header.deviceID != properties.deviceID) {
+        rejectReason = "created for another device";
+        return false;
+    }
+    if (header.driverVersion != properties.driverVersion) {
+        rejectReason = "created by another driver version";
+        return false;
+    }
+    if (std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+        rejectReason = "pipeline cache UUID changed";
+        return false;
+    }
+    if (header.dataSize != fileSize - sizeof(FileHeader) || header.dataSize < sizeof(VulkanCacheHeader)) {
+        rejectReason = "truncated data";
+        return false;
+    }
+
+    initialData.resize((size_t)header.dataSize);
+    file.read(initialData.data(), initialData.size());
+    if (!file || hashData(initialData.data(), initialData.size()) != header.dataHash) {
+        rejectReason = "corrupt data";
+        return false;
+    }
+
+    // The driver validates its own header too, but checking it here lets us report why it was rejected
+    VulkanCacheHeader vulkanHeader;
+    std::memcpy(&vulkanHeader, initialData.data(), sizeof(vulkanHeader));
+    if (vulkanHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+        vulkanHeader.vendorID != properties.vendorID ||
+        vulkanHeader.deviceID != properties.deviceID ||
+        std::memcmp(vulkanHeader.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+        rejectReason = "driver header does not match the device";
+        return false;
+    }
+
+    coldCreationTime = header.coldCreationTime;
+    return true;
+}
+
+void PipelineCache::reportCreationTime(double milliseconds) {
+    if (hit) {
+        std::cout << "Pipeline cache hit: pipelines created in " << milliseconds << " ms, saved " <<
+            coldCreationTime - milliseconds << " ms compared to " << coldCreationTime << " ms without cache" << std::endl;
+    } else if (coldCreationTime == 0.0) {
+        // Only the first creation of the run starts from an empty cache, later ones (recreateSwapchain) are warm
+        coldCreationTime = milliseconds;
+        std::cout << "Pipeline cache miss: pipelines created in " << milliseconds << " ms" << std::endl;
+    } else {
+        std::cout << "Pipelines recreated in " << milliseconds << " ms" << std::endl;
+    }
+}
+
+void PipelineCache::save() {
+    size_t dataSize = 0;
+    VkResult result = vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr);
+    ASSERT_VULKAN(result);
+
+    std::vector<char> data(dataSize);
+    result = vkGetPipelineCacheData(device, pipelineCache, &dataSize, data.data());
+    ASSERT_VULKAN(result);
+    data.resize(dataSize);
+
+    FileHeader header;
+    header.magic = cacheFileMagic;
+    header.version = cacheFileVersion;
+    header.vendorID = properties.vendorID;
+    header.deviceID = properties.deviceID;
+    header.driverVersion = properties.driverVersion;
+    std::memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+    header.dataSize = data.size();
+    header.dataHash = hashData(data.data(), data.size());
+    header.coldCreationTime = coldCreationTime;
+
+    // Write to a temporary file first so a crash never leaves a half written cache behind
+    std::string temporaryFilename = filename + ".tmp";
+    {
+        std::ofstream file(temporaryFilename, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(data.data(), data.size());
+        file.flush();
+        if (!file) {
+            std::cerr << "Pipeline cache: failed to write '" << temporaryFilename << "'" << std::endl;
+            return;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporaryFilename, filename, error);
+    if (error) {
+        std::cerr << "Pipeline cache: failed to replace '" << filename << "': " << error.message() << std::endl;
+        std::filesystem::remove(temporaryFilename, error);
+        return;
+    }
+
+    std::cout << "Pipeline cache: wrote " << data.size() << " bytes to '" << filename << "'" << std::endl;
+}
+
+void PipelineCache::destroy() {
+    vkDestroyPipelineCache(device, pipelineCache, nullptr);
+    pipelineCache = VK_NULL_HANDLE;
+}
+
+// FNV-1a, only used to detect truncated or damaged files
+uint64_t PipelineCache::hashData(const char *data, size_t size) {
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= (uint8_t)data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// VkPipelineCache which is loaded from disk at startup and written back at shutdown.
+// The file starts with our own header so blobs from another device, driver or a
+// broken write are rejected instead of being handed to the driver.
+class PipelineCache {
+public:
+    void load(VkDevice device, VkPhysicalDevice physicalDevice, const std::string &filename);
+    void save();
+    void destroy();
+
+    // Logs hit/miss and the time saved compared to the creation time measured without cache data. On a miss
+    // only the first call of the run is kept as that creation time
+    void reportCreationTime(double milliseconds);
+
+    VkPipelineCache getHandle() const { return pipelineCache; }
+
+private:
+    struct FileHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t vendorID;
+        uint32_t deviceID;
+        uint32_t driverVersion;
+        uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+        uint64_t dataSize;
+        uint64_t dataHash;
+        double coldCreationTime; // pipeline creation time in ms when the cache was empty
+    };
+
+    bool readCacheFile(std::string &rejectReason);
+    static uint64_t hashData(const char *data, size_t size);
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties properties = {};
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+    std::string filename;
+
+    std::vector<char> initialData;
+    bool hit = false;
+    double coldCreationTime = 0.0;
+};
@@ -0,0 +1,122 @@
+#include "PipelineCompiler.h"
+
+#include <iostream>
+#include <algorithm>
+#include "VulkanUtils.h"
+#include "Profiler.h"
+
+void PipelineCompiler::start(VkDevice device, VkPipelineCache pipelineCache, uint32_t threadCount) {
+    this->device = device;
+    this->pipelineCache = pipelineCache;
+    stopping = false;
+
+    for (uint32_t i = 0; i < threadCount; ++i) {
+        threadNames.push_back("Pipeline compiler " + std::to_string(i));
+    }
+    for (uint32_t i = 0; i < threadCount; ++i) {
+        threads.push_back(std::thread(&PipelineCompiler::workerLoop, this, i));
+    }
+}
+
+void PipelineCompiler::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    threads.clear();
+    // Names stay alive, the profiler keeps pointers to them until the trace was written
+}
+
+std::shared_future<VkPipeline> PipelineCompiler::submit(const PipelineVariantDesc &desc, VkShaderModule vertexShader, VkShaderModule fragmentShader,
+    VkPipelineLayout layout, VkRenderPass renderPass) {
+    std::unique_ptr<Job> job(new Job());
+    job->desc = desc;
+    job->vertexShader = vertexShader;
+    job->fragmentShader = fragmentShader;
+    job->layout = layout;
+    job->renderPass = renderPass;
+    job->submitTime = std::chrono::high_resolution_clock::now();
+    std::shared_future<VkPipeline> future = job->promise.get_future().share();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(std::move(job));
+        maxQueueDepth = std::max(maxQueueDepth, (uint32_t)queue.size() + compiling);
+    }
+    wake.notify_one();
+    return future;
+}
+
+uint32_t PipelineCompiler::getQueueDepth() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return (uint32_t)queue.size() + compiling;
+}
+
+void PipelineCompiler::printReport() {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t queueDepth = (uint32_t)queue.size() + compiling;
+    if (compiled == 0 && maxQueueDepth == 0) {
+        return;
+    }
+
+    std::cout << "Pipeline compiler: " << threads.size() << " threads | queue depth " << queueDepth << " (max " << maxQueueDepth << ")" <<
+        " | compiled " << compiled << " (" << totalCompiled << " total)";
+    if (compiled > 0) {
+        std::cout << " | compile avg: " << compileTimeSum / compiled << " ms | max: " << compileTimeMax << " ms" <<
+            " | queued avg: " << queueTimeSum / compiled << " ms";
+    }
+    std::cout << std::endl;
+
+    maxQueueDepth = queueDepth;
+    compiled = 0;
+    compileTimeSum = 0.0;
+    compileTimeMax = 0.0;
+    queueTimeSum = 0.0;
+}
+
+void PipelineCompiler::workerLoop(uint32_t worker) {
+    Profiler::setThreadName(threadNames[worker].c_str());
+
+    while (true) {
+        std::unique_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this]() { return stopping || !queue.empty(); });
+            if (queue.empty()) {
+                return; // stopping and nothing left to compile
+            }
+            job = std::move(queue.front());
+            queue.pop_front();
+            ++compiling;
+        }
+
+        PROFILE_ZONE("compilePipeline");
+        auto start = std::chrono::high_resolution_clock::now();
+
+        PipelineCreateState state;
+        VkGraphicsPipelineCreateInfo pipelineCreateInfo;
+        fillPipelineCreateInfo(job->desc, job->vertexShader, job->fragmentShader, job->layout, job->renderPass, state, pipelineCreateInfo);
+
+        VkPipeline pipeline;
+        VkResult result = vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline);
+        ASSERT_VULKAN(result);
+
+        auto end = std::chrono::high_resolution_clock::now();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --compiling;
+            ++compiled;
+            ++totalCompiled;
+            double compileTime = std::chrono::duration<double, std::milli>(end - start).count();
+            compileTimeSum += compileTime;
+            compileTimeMax = std::max(compileTimeMax, compileTime);
+            queueTimeSum += std::chrono::duration<double, std::milli>(start - job->submitTime).count();
+        }
+        job->promise.set_value(pipeline);
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "PipelineVariants.h"
+
+// Creates graphics pipelines on background threads. submit() returns right away with a future, a worker
+// fills the create info from the description and calls vkCreateGraphicsPipelines for it alone. The
+// VkPipelineCache is internally synchronized, so all workers share one.
+class PipelineCompiler {
+public:
+    void start(VkDevice device, VkPipelineCache pipelineCache, uint32_t threadCount);
+    // Compiles everything still queued before the threads exit, the pipelines belong to the holders of the futures
+    void stop();
+
+    // The shader modules, layout and render pass have to stay alive until the future is ready
+    std::shared_future<VkPipeline> submit(const PipelineVariantDesc &desc, VkShaderModule vertexShader, VkShaderModule fragmentShader,
+        VkPipelineLayout layout, VkRenderPass renderPass);
+
+    uint32_t getThreadCount() const { return (uint32_t)threads.size(); }
+    // Queued plus currently compiling
+    uint32_t getQueueDepth() const;
+    // Compile times and queue depth since the last report, prints nothing while the compiler is idle
+    void printReport();
+
+private:
+    struct Job {
+        PipelineVariantDesc desc;
+        VkShaderModule vertexShader;
+        VkShaderModule fragmentShader;
+        VkPipelineLayout layout;
+        VkRenderPass renderPass;
+        std::promise<VkPipeline> promise;
+        std::chrono::high_resolution_clock::time_point submitTime;
+    };
+
+    void workerLoop(uint32_t worker);
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+    std::vector<std::thread> threads;
+    std::vector<std::string> threadNames;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<std::unique_ptr<Job>> queue;
+    uint32_t compiling = 0;
+    bool stopping = false;
+
+    // Since the last report, guarded by mutex
+    uint32_t maxQueueDepth = 0;
+    uint64_t compiled = 0;
+    double compileTimeSum = 0.0;
+    double compileTimeMax = 0.0;
+    double queueTimeSum = 0.0; // submit until a worker picked the job up
+    uint64_t totalCompiled = 0;
+};
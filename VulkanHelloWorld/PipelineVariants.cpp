@@ -0,0 +1,383 @@
+#include "PipelineVariants.h"
+
+#include <iostream>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+#include "VulkanUtils.h"
+#include "PipelineCompiler.h"
+
+namespace {
+    const uint64_t fnvOffsetBasis = 14695981039346656037ull;
+    const uint64_t fnvPrime = 1099511628211ull;
+
+    class Hasher {
+    public:
+        void add(const void *data, size_t size) {
+            const unsigned char *bytes = static_cast<const unsigned char*>(data);
+            for (size_t i = 0; i < size; ++i) {
+                value = (value ^ bytes[i]) * fnvPrime;
+            }
+        }
+        void add(uint32_t word) { add(&word, sizeof(word)); }
+        // Length first, so "ab" + "c" and "a" + "bc" differ
+        void add(const std::string &text) {
+            add((uint32_t)text.size());
+            add(text.data(), text.size());
+        }
+        void add(const SpecializationConstants &constants) {
+            add((uint32_t)constants.getValues().size());
+            for (const auto &entry : constants.getValues()) {
+                add(entry.first);
+                add(entry.second);
+            }
+        }
+
+        uint64_t get() const { return value; }
+
+    private:
+        uint64_t value = fnvOffsetBasis;
+    };
+
+    bool equalBindings(const std::vector<VkVertexInputBindingDescription> &a, const std::vector<VkVertexInputBindingDescription> &b) {
+        if (a.size() != b.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < a.size(); ++i) {
+            if (a[i].binding != b[i].binding || a[i].stride != b[i].stride || a[i].inputRate != b[i].inputRate) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool equalAttributes(const std::vector<VkVertexInputAttributeDescription> &a, const std::vector<VkVertexInputAttributeDescription> &b) {
+        if (a.size() != b.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < a.size(); ++i) {
+            if (a[i].location != b[i].location || a[i].binding != b[i].binding || a[i].format != b[i].format || a[i].offset != b[i].offset) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const VkSpecializationInfo *fillSpecializationInfo(const SpecializationConstants &constants, std::vector<VkSpecializationMapEntry> &mapEntries,
+        std::vector<uint32_t> &constantData, VkSpecializationInfo &specializationInfo) {
+        if (constants.empty()) {
+            return nullptr;
+        }
+        for (const auto &entry : constants.getValues()) {
+            VkSpecializationMapEntry mapEntry;
+            mapEntry.constantID = entry.first;
+            mapEntry.offset = (uint32_t)(constantData.size() * sizeof(uint32_t));
+            mapEntry.size = sizeof(uint32_t);
+            mapEntries.push_back(mapEntry);
+            constantData.push_back(entry.second);
+        }
+        specializationInfo.mapEntryCount = (uint32_t)mapEntries.size();
+        specializationInfo.pMapEntries = mapEntries.data();
+        specializationInfo.dataSize = constantData.size() * sizeof(uint32_t);
+        specializationInfo.pData = constantData.data();
+        return &specializationInfo;
+    }
+}
+
+void SpecializationConstants::setFloat(uint32_t constantId, float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    values[constantId] = bits;
+}
+
+uint64_t PipelineVariantDesc::hash() const {
+    Hasher hasher;
+    hasher.add(vertexShader);
+    hasher.add(fragmentShader);
+    hasher.add(vertexConstants);
+    hasher.add(fragmentConstants);
+    hasher.add((uint32_t)vertexBindings.size());
+    for (const VkVertexInputBindingDescription &binding : vertexBindings) {
+        hasher.add(binding.binding);
+        hasher.add(binding.stride);
+        hasher.add((uint32_t)binding.inputRate);
+    }
+    hasher.add((uint32_t)vertexAttributes.size());
+    for (const VkVertexInputAttributeDescription &attribute : vertexAttributes) {
+        hasher.add(attribute.location);
+        hasher.add(attribute.binding);
+        hasher.add((uint32_t)attribute.format);
+        hasher.add(attribute.offset);
+    }
+    hasher.add((uint32_t)topology);
+    hasher.add((uint32_t)polygonMode);
+    hasher.add((uint32_t)cullMode);
+    hasher.add((uint32_t)frontFace);
+    hasher.add(blendEnable ? 1u : 0u);
+    hasher.add((uint32_t)colorFormat);
+    hasher.add((uint32_t)depthFormat);
+    hasher.add(depthTest ? 1u : 0u);
+    hasher.add(depthWrite ? 1u : 0u);
+    hasher.add((uint32_t)depthCompare);
+    return hasher.get();
+}
+
+bool PipelineVariantDesc::operator==(const PipelineVariantDesc &other) const {
+    return vertexShader == other.vertexShader && fragmentShader == other.fragmentShader &&
+        vertexConstants.getValues() == other.vertexConstants.getValues() && fragmentConstants.getValues() == other.fragmentConstants.getValues() &&
+        equalBindings(vertexBindings, other.vertexBindings) && equalAttributes(vertexAttributes, other.vertexAttributes) &&
+        topology == other.topology && polygonMode == other.polygonMode && cullMode == other.cullMode && frontFace == other.frontFace &&
+        blendEnable == other.blendEnable && colorFormat == other.colorFormat && depthFormat == other.depthFormat &&
+        depthTest == other.depthTest && depthWrite == other.depthWrite && depthCompare == other.depthCompare;
+}
+
+void fillPipelineCreateInfo(const PipelineVariantDesc &desc, VkShaderModule vertexShader, VkShaderModule fragmentShader, VkPipelineLayout layout,
+    VkRenderPass renderPass, PipelineCreateState &state, VkGraphicsPipelineCreateInfo &pipelineCreateInfo) {
+    const VkShaderModule modules[2] = { vertexShader, fragmentShader };
+    const SpecializationConstants *constants[2] = { &desc.vertexConstants, &desc.fragmentConstants };
+    const VkShaderStageFlagBits stages[2] = { VK_SHADER_STAGE_VERTEX_BIT, VK_SHADER_STAGE_FRAGMENT_BIT };
+    for (int stage = 0; stage < 2; ++stage) {
+        state.shaderStages[stage].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        state.shaderStages[stage].pNext = nullptr;
+        state.shaderStages[stage].flags = 0;
+        state.shaderStages[stage].stage = stages[stage];
+        state.shaderStages[stage].module = modules[stage];
+        state.shaderStages[stage].pName = "main";
+        state.shaderStages[stage].pSpecializationInfo = fillSpecializationInfo(*constants[stage], state.mapEntries[stage],
+            state.constantData[stage], state.specializationInfos[stage]);
+    }
+
+    state.vertexInputCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    state.vertexInputCreateInfo.pNext = nullptr;
+    state.vertexInputCreateInfo.flags = 0;
+    state.vertexInputCreateInfo.vertexBindingDescriptionCount = (uint32_t)desc.vertexBindings.size();
+    state.vertexInputCreateInfo.pVertexBindingDescriptions = desc.vertexBindings.data();
+    state.vertexInputCreateInfo.vertexAttributeDescriptionCount = (uint32_t)desc.vertexAttributes.size();
+    state.vertexInputCreateInfo.pVertexAttributeDescriptions = desc.vertexAttributes.data();
+
+    state.inputAssemblyCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    state.inputAssemblyCreateInfo.pNext = nullptr;
+    state.inputAssemblyCreateInfo.flags = 0;
+    state.inputAssemblyCreateInfo.topology = desc.topology;
+    state.inputAssemblyCreateInfo.primitiveRestartEnable = VK_FALSE;
+
+    // Viewport and scissor are set while recording, so a resize does not need new pipelines
+    state.viewportStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    state.viewportStateCreateInfo.pNext = nullptr;
+    state.viewportStateCreateInfo.flags = 0;
+    state.viewportStateCreateInfo.viewportCount = 1;
+    state.viewportStateCreateInfo.pViewports = nullptr;
+    state.viewportStateCreateInfo.scissorCount = 1;
+    state.viewportStateCreateInfo.pScissors = nullptr;
+
+    state.rasterizationCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    state.rasterizationCreateInfo.pNext = nullptr;
+    state.rasterizationCreateInfo.flags = 0;
+    state.rasterizationCreateInfo.depthClampEnable = VK_FALSE;
+    state.rasterizationCreateInfo.rasterizerDiscardEnable = VK_FALSE;
+    state.rasterizationCreateInfo.polygonMode = desc.polygonMode;
+    state.rasterizationCreateInfo.cullMode = desc.cullMode;
+    state.rasterizationCreateInfo.frontFace = desc.frontFace;
+    state.rasterizationCreateInfo.depthBiasEnable = VK_FALSE;
+    state.rasterizationCreateInfo.depthBiasConstantFactor = 0.0f;
+    state.rasterizationCreateInfo.depthBiasClamp = 0.0f;
+    state.rasterizationCreateInfo.depthBiasSlopeFactor = 0.0f;
+    state.rasterizationCreateInfo.lineWidth = 1.0f;
+
+    state.multisampleCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    state.multisampleCreateInfo.pNext = nullptr;
+    state.multisampleCreateInfo.flags = 0;
+    state.multisampleCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    state.multisampleCreateInfo.sampleShadingEnable = VK_FALSE;
+    state.multisampleCreateInfo.minSampleShading = 1.0f;
+    state.multisampleCreateInfo.pSampleMask = nullptr;
+    state.multisampleCreateInfo.alphaToCoverageEnable = VK_FALSE;
+    state.multisampleCreateInfo.alphaToOneEnable = VK_FALSE;
+
+    state.colorBlendAttachment.blendEnable = desc.blendEnable ? VK_TRUE : VK_FALSE;
+    state.colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    state.colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    state.colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+    state.colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    state.colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    state.colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+    state.colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    // Without fragment shader the color outputs are undefined, depth-only pipelines must not write them
+    if (fragmentShader == VK_NULL_HANDLE) {
+        state.colorBlendAttachment.blendEnable = VK_FALSE;
+        state.colorBlendAttachment.colorWriteMask = 0;
+    }
+
+    state.colorBlendCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    state.colorBlendCreateInfo.pNext = nullptr;
+    state.colorBlendCreateInfo.flags = 0;
+    state.colorBlendCreateInfo.logicOpEnable = VK_FALSE;
+    state.colorBlendCreateInfo.logicOp = VK_LOGIC_OP_NO_OP;
+    state.colorBlendCreateInfo.attachmentCount = 1;
+    state.colorBlendCreateInfo.pAttachments = &state.colorBlendAttachment;
+    state.colorBlendCreateInfo.blendConstants[0] = 0.0f;
+    state.colorBlendCreateInfo.blendConstants[1] = 0.0f;
+    state.colorBlendCreateInfo.blendConstants[2] = 0.0f;
+    state.colorBlendCreateInfo.blendConstants[3] = 0.0f;
+
+    state.depthStencilCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    state.depthStencilCreateInfo.pNext = nullptr;
+    state.depthStencilCreateInfo.flags = 0;
+    state.depthStencilCreateInfo.depthTestEnable = desc.depthTest ? VK_TRUE : VK_FALSE;
+    state.depthStencilCreateInfo.depthWriteEnable = desc.depthWrite ? VK_TRUE : VK_FALSE;
+    state.depthStencilCreateInfo.depthCompareOp = desc.depthCompare;
+    state.depthStencilCreateInfo.depthBoundsTestEnable = VK_FALSE;
+    state.depthStencilCreateInfo.stencilTestEnable = VK_FALSE;
+    state.depthStencilCreateInfo.front = {};
+    state.depthStencilCreateInfo.back = {};
+    state.depthStencilCreateInfo.minDepthBounds = 0.0f;
+    state.depthStencilCreateInfo.maxDepthBounds = 1.0f;
+
+    state.dynamicStates[0] = VK_DYNAMIC_STATE_VIEWPORT;
+    state.dynamicStates[1] = VK_DYNAMIC_STATE_SCISSOR;
+
+    state.dynamicStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    state.dynamicStateCreateInfo.pNext = nullptr;
+    state.dynamicStateCreateInfo.flags = 0;
+    state.dynamicStateCreateInfo.dynamicStateCount = 2;
+    state.dynamicStateCreateInfo.pDynamicStates = state.dynamicStates;
+
+    pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineCreateInfo.pNext = nullptr;
+    pipelineCreateInfo.flags = 0;
+    pipelineCreateInfo.stageCount = fragmentShader != VK_NULL_HANDLE ? 2 : 1;
+    pipelineCreateInfo.pStages = state.shaderStages;
+    pipelineCreateInfo.pVertexInputState = &state.vertexInputCreateInfo;
+    pipelineCreateInfo.pInputAssemblyState = &state.inputAssemblyCreateInfo;
+    pipelineCreateInfo.pTessellationState = nullptr;
+    pipelineCreateInfo.pViewportState = &state.viewportStateCreateInfo;
+    pipelineCreateInfo.pRasterizationState = &state.rasterizationCreateInfo;
+    pipelineCreateInfo.pMultisampleState = &state.multisampleCreateInfo;
+    pipelineCreateInfo.pDepthStencilState = desc.depthFormat != VK_FORMAT_UNDEFINED ? &state.depthStencilCreateInfo : nullptr;
+    pipelineCreateInfo.pColorBlendState = &state.colorBlendCreateInfo;
+    pipelineCreateInfo.pDynamicState = &state.dynamicStateCreateInfo;
+    pipelineCreateInfo.layout = layout;
+    pipelineCreateInfo.renderPass = renderPass;
+    pipelineCreateInfo.subpass = 0;
+    pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+    pipelineCreateInfo.basePipelineIndex = -1;
+}
+
+void PipelineVariants::init(VkDevice device, VkPipelineCache pipelineCache) {
+    this->device = device;
+    this->pipelineCache = pipelineCache;
+}
+
+void PipelineVariants::destroy() {
+    for (auto &entry : variants) {
+        if (entry.second.compiling.valid()) {
+            entry.second.pipeline = entry.second.compiling.get();
+        }
+        if (entry.second.pipeline != VK_NULL_HANDLE) {
+            vkDestroyPipeline(device, entry.second.pipeline, nullptr);
+        }
+    }
+    variants.clear();
+    pending.clear();
+    shaders.clear();
+}
+
+void PipelineVariants::registerShader(const std::string &name, VkShaderModule shaderModule) {
+    shaders[name] = shaderModule;
+}
+
+VkShaderModule PipelineVariants::findShader(const std::string &name) const {
+    if (name.empty()) {
+        return VK_NULL_HANDLE; // no stage
+    }
+    auto shader = shaders.find(name);
+    if (shader == shaders.end()) {
+        throw std::runtime_error("Pipeline variant uses the unregistered shader '" + name + "'");
+    }
+    return shader->second;
+}
+
+uint64_t PipelineVariants::request(const PipelineVariantDesc &desc) {
+    uint64_t key = desc.hash();
+    auto existing = variants.find(key);
+    if (existing != variants.end()) {
+        if (!(existing->second.desc == desc)) {
+            throw std::runtime_error("Pipeline variant hash collision on " + std::to_string(key));
+        }
+        ++duplicateRequests;
+        return key;
+    }
+
+    Variant variant;
+    variant.desc = desc;
+    variants.emplace(key, variant);
+    pending.push_back(key);
+    return key;
+}
+
+double PipelineVariants::createPending(VkPipelineLayout layout, VkRenderPass renderPass, PipelineCompiler *compiler) {
+    if (pending.empty()) {
+        return 0.0;
+    }
+
+    if (compiler != nullptr) {
+        for (uint64_t key : pending) {
+            Variant &variant = variants[key];
+            variant.compiling = compiler->submit(variant.desc, findShader(variant.desc.vertexShader), findShader(variant.desc.fragmentShader),
+                layout, renderPass);
+        }
+        std::cout << "Pipeline variants: " << pending.size() << " queued for background compilation | " << variants.size() << " variants | " <<
+            duplicateRequests << " duplicate requests" << std::endl;
+        pending.clear();
+        return 0.0;
+    }
+
+    std::vector<PipelineCreateState> states(pending.size());
+    std::vector<VkGraphicsPipelineCreateInfo> pipelineCreateInfos(pending.size());
+
+    for (size_t i = 0; i < pending.size(); ++i) {
+        const PipelineVariantDesc &desc = variants[pending[i]].desc;
+        fillPipelineCreateInfo(desc, findShader(desc.vertexShader), findShader(desc.fragmentShader), layout, renderPass, states[i],
+            pipelineCreateInfos[i]);
+    }
+
+    std::vector<VkPipeline> pipelines(pending.size());
+    auto start = std::chrono::high_resolution_clock::now();
+    VkResult result = vkCreateGraphicsPipelines(device, pipelineCache, (uint32_t)pipelineCreateInfos.size(), pipelineCreateInfos.data(),
+        nullptr, pipelines.data());
+    ASSERT_VULKAN(result);
+    double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    for (size_t i = 0; i < pending.size(); ++i) {
+        variants[pending[i]].pipeline = pipelines[i];
+    }
+    std::cout << "Pipeline variants: " << pending.size() << " created in one call | " << milliseconds << " ms | " << variants.size() <<
+        " variants | " << duplicateRequests << " duplicate requests" << std::endl;
+    pending.clear();
+    return milliseconds;
+}
+
+VkPipeline PipelineVariants::get(uint64_t key) {
+    auto variant = variants.find(key);
+    if (variant == variants.end()) {
+        return VK_NULL_HANDLE;
+    }
+    std::shared_future<VkPipeline> &compiling = variant->second.compiling;
+    if (compiling.valid() && compiling.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+        variant->second.pipeline = compiling.get();
+        compiling = std::shared_future<VkPipeline>();
+    }
+    return variant->second.pipeline;
+}
+
+VkPipeline PipelineVariants::remove(uint64_t key) {
+    auto variant = variants.find(key);
+    if (variant == variants.end()) {
+        return VK_NULL_HANDLE;
+    }
+    VkPipeline pipeline = variant->second.compiling.valid() ? variant->second.compiling.get() : variant->second.pipeline;
+    variants.erase(variant);
+    pending.erase(std::remove(pending.begin(), pending.end(), key), pending.end());
+    return pipeline;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <future>
+#include <vulkan/vulkan.h>
+
+// Values of the specialization constants of one shader stage by constant_id. All constants in our
+// shaders are 32 bit, bools are stored as VkBool32.
+class SpecializationConstants {
+public:
+    void setUint(uint32_t constantId, uint32_t value) { values[constantId] = value; }
+    void setFloat(uint32_t constantId, float value);
+    void setBool(uint32_t constantId, bool value) { values[constantId] = value ? VK_TRUE : VK_FALSE; }
+
+    bool empty() const { return values.empty(); }
+    const std::map<uint32_t, uint32_t> &getValues() const { return values; }
+
+private:
+    std::map<uint32_t, uint32_t> values; // ordered, so equal sets hash equally
+};
+
+// Everything a graphics pipeline variant is made of. Shaders are referenced by name and the render pass by its
+// color format, so the hash is the same in every run and can be logged or stored.
+struct PipelineVariantDesc {
+    std::string vertexShader;
+    std::string fragmentShader; // empty for depth-only pipelines, which write no color
+    SpecializationConstants vertexConstants;
+    SpecializationConstants fragmentConstants;
+
+    std::vector<VkVertexInputBindingDescription> vertexBindings;
+    std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+    VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL;
+    VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+    VkFrontFace frontFace = VK_FRONT_FACE_CLOCKWISE;
+    bool blendEnable = true;
+    VkFormat colorFormat = VK_FORMAT_UNDEFINED; // of the render pass
+    VkFormat depthFormat = VK_FORMAT_UNDEFINED; // of the render pass, VK_FORMAT_UNDEFINED without depth buffer
+    bool depthTest = false;
+    bool depthWrite = false;
+    VkCompareOp depthCompare = VK_COMPARE_OP_LESS;
+
+    // FNV-1a over all fields
+    uint64_t hash() const;
+    bool operator==(const PipelineVariantDesc &other) const;
+};
+
+// The create info of a variant points into this, so it has to stay put until vkCreateGraphicsPipelines returned
+struct PipelineCreateState {
+    std::vector<VkSpecializationMapEntry> mapEntries[2];
+    std::vector<uint32_t> constantData[2];
+    VkSpecializationInfo specializationInfos[2];
+    VkPipelineShaderStageCreateInfo shaderStages[2];
+    VkPipelineVertexInputStateCreateInfo vertexInputCreateInfo;
+    VkPipelineInputAssemblyStateCreateInfo inputAssemblyCreateInfo;
+    VkPipelineViewportStateCreateInfo viewportStateCreateInfo;
+    VkPipelineRasterizationStateCreateInfo rasterizationCreateInfo;
+    VkPipelineMultisampleStateCreateInfo multisampleCreateInfo;
+    VkPipelineColorBlendAttachmentState colorBlendAttachment;
+    VkPipelineColorBlendStateCreateInfo colorBlendCreateInfo;
+    VkPipelineDepthStencilStateCreateInfo depthStencilCreateInfo;
+    VkDynamicState dynamicStates[2];
+    VkPipelineDynamicStateCreateInfo dynamicStateCreateInfo;
+};
+
+// desc has to outlive the create info as well, the vertex input points into it
+void fillPipelineCreateInfo(const PipelineVariantDesc &desc, VkShaderModule vertexShader, VkShaderModule fragmentShader, VkPipelineLayout layout,
+    VkRenderPass renderPass, PipelineCreateState &state, VkGraphicsPipelineCreateInfo &pipelineCreateInfo);
+
+class PipelineCompiler;
+
+// Graphics pipeline permutations built from a handful of shader modules and specialization constants instead
+// of one .spv per variation. Requests are deduplicated by the hash of their description and everything requested
+// since the last createPending() is created with a single vkCreateGraphicsPipelines call, or handed to the
+// background compiler.
+class PipelineVariants {
+public:
+    void init(VkDevice device, VkPipelineCache pipelineCache);
+    void destroy();
+
+    void registerShader(const std::string &name, VkShaderModule shaderModule);
+
+    // Returns the key of the variant, identical descriptions share one pipeline
+    uint64_t request(const PipelineVariantDesc &desc);
+    // Returns the milliseconds of the vkCreateGraphicsPipelines call, 0 if nothing was pending. With a compiler
+    // the variants are queued there instead and the call returns 0 right away.
+    double createPending(VkPipelineLayout layout, VkRenderPass renderPass, PipelineCompiler *compiler = nullptr);
+
+    // VK_NULL_HANDLE until the variant was created, never waits for the compiler
+    VkPipeline get(uint64_t key);
+    // Forgets the variant and hands its pipeline to the caller, for pipelines which may still be in use.
+    // Waits if the variant is still compiling.
+    VkPipeline remove(uint64_t key);
+
+    size_t getVariantCount() const { return variants.size(); }
+    uint64_t getDuplicateRequests() const { return duplicateRequests; }
+
+private:
+    VkShaderModule findShader(const std::string &name) const;
+
+    struct Variant {
+        PipelineVariantDesc desc;
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        std::shared_future<VkPipeline> compiling; // valid while the background compiler owns it
+    };
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+    std::unordered_map<std::string, VkShaderModule> shaders;
+    std::unordered_map<uint64_t, Variant> variants;
+    std::vector<uint64_t> pending;
+    uint64_t duplicateRequests = 0;
+};
@@ -0,0 +1,158 @@
+#include "Profiler.h"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <chrono>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+namespace {
+    struct Event {
+        const char *name;
+        int64_t start;
+        int64_t end;
+    };
+
+    struct ThreadBuffer {
+        uint32_t threadId;
+        const char *threadName;
+        std::vector<Event> events;
+    };
+
+    const size_t eventsPerThread = 1 << 16;
+    const auto profilerStart = std::chrono::steady_clock::now();
+
+    // Only touched once per thread when it records its first zone and at export time.
+    // The buffers stay alive after their thread exits so its zones still end up in the trace.
+    std::mutex registryMutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> registry;
+
+    thread_local ThreadBuffer *localBuffer = nullptr;
+
+    ThreadBuffer *registerThread() {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        registry.push_back(std::make_unique<ThreadBuffer>());
+        ThreadBuffer *buffer = registry.back().get();
+        buffer->threadId = (uint32_t)registry.size();
+        buffer->threadName = nullptr;
+        buffer->events.reserve(eventsPerThread);
+        return buffer;
+    }
+
+    void writeEscaped(std::ostream &out, const char *text) {
+        for (; *text; ++text) {
+            if (*text == '"' || *text == '\\') {
+                out << '\\';
+            }
+            out << *text;
+        }
+    }
+
+    double percentile(const std::vector<int64_t> &sorted, double p) {
+        size_t index = std::min(sorted.size() - 1, (size_t)(p * (sorted.size() - 1) + 0.5));
+        return sorted[index] / 1000000.0;
+    }
+}
+
+std::atomic<bool> Profiler::enabled(false);
+
+void Profiler::enable() {
+    enabled.store(true, std::memory_order_relaxed);
+}
+
+int64_t Profiler::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - profilerStart).count();
+}
+
+void Profiler::record(const char *name, int64_t start, int64_t end) {
+    if (localBuffer == nullptr) {
+        localBuffer = registerThread();
+    }
+    localBuffer->events.push_back(Event{ name, start, end });
+}
+
+void Profiler::setThreadName(const char *name) {
+    if (localBuffer == nullptr) {
+        localBuffer = registerThread();
+    }
+    localBuffer->threadName = name;
+}
+
+void Profiler::writeChromeTrace(const std::string &filename) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+
+    std::ofstream file(filename, std::ios::trunc);
+    if (!file) {
+        std::cerr << "Profiler: failed to open '" << filename << "'" << std::endl;
+        return;
+    }
+
+    // Chrome trace event format, load it in chrome://tracing or https://ui.perfetto.dev
+    file << std::fixed << std::setprecision(3);
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    bool first = true;
+    size_t amountOfEvents = 0;
+    for (const auto &buffer : registry) {
+        if (buffer->threadName != nullptr) {
+            file << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadId << ",\"args\":{\"name\":\"";
+            writeEscaped(file, buffer->threadName);
+            file << "\"}}";
+            first = false;
+        }
+
+        for (const Event &event : buffer->events) {
+            file << (first ? "" : ",") << "\n{\"name\":\"";
+            writeEscaped(file, event.name);
+            file << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId <<
+                ",\"ts\":" << event.start / 1000.0 << ",\"dur\":" << (event.end - event.start) / 1000.0 << "}";
+            first = false;
+        }
+        amountOfEvents += buffer->events.size();
+    }
+
+    file << "\n]}\n";
+    std::cout << "Profiler: wrote " << amountOfEvents << " zones to '" << filename << "'" << std::endl;
+}
+
+void Profiler::printSummary() {
+    std::lock_guard<std::mutex> lock(registryMutex);
+
+    std::map<std::string, std::vector<int64_t>> durations;
+    for (const auto &buffer : registry) {
+        for (const Event &event : buffer->events) {
+            durations[event.name].push_back(event.end - event.start);
+        }
+    }
+
+    auto flags = std::cout.flags();
+    auto precision = std::cout.precision();
+
+    std::cout << std::endl << std::left << std::setw(28) << "Zone" << std::right <<
+        std::setw(10) << "Count" << std::setw(14) << "Total ms" << std::setw(12) << "p50 ms" <<
+        std::setw(12) << "p95 ms" << std::setw(12) << "p99 ms" << std::endl;
+
+    std::cout << std::fixed << std::setprecision(3);
+    for (auto &zone : durations) {
+        std::vector<int64_t> &values = zone.second;
+        std::sort(values.begin(), values.end());
+
+        int64_t total = 0;
+        for (int64_t value : values) {
+            total += value;
+        }
+
+        std::cout << std::left << std::setw(28) << zone.first << std::right <<
+            std::setw(10) << values.size() << std::setw(14) << total / 1000000.0 <<
+            std::setw(12) << percentile(values, 0.50) << std::setw(12) << percentile(values, 0.95) <<
+            std::setw(12) << percentile(values, 0.99) << std::endl;
+    }
+    std::cout << std::endl;
+
+    std::cout.flags(flags);
+    std::cout.precision(precision);
+}
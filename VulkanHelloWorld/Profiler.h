@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Low overhead CPU zone profiler. Every thread appends its zones to its own event buffer,
+// so recording takes no locks. Nothing is recorded until enable() is called (--profile).
+namespace Profiler {
+    extern std::atomic<bool> enabled;
+
+    inline bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+    void enable();
+    // Nanoseconds since the profiler was loaded
+    int64_t now();
+    // name has to outlive the profiler, zones use string literals
+    void record(const char *name, int64_t start, int64_t end);
+    void setThreadName(const char *name);
+
+    // Only call these once all threads stopped recording
+    void writeChromeTrace(const std::string &filename);
+    void printSummary();
+}
+
+class ProfileZone {
+public:
+    explicit ProfileZone(const char *name) : name(name), start(Profiler::isEnabled() ? Profiler::now() : -1) {}
+    ~ProfileZone() {
+        if (start >= 0) {
+            Profiler::record(name, start, Profiler::now());
+        }
+    }
+
+    ProfileZone(const ProfileZone &) = delete;
+    ProfileZone &operator=(const ProfileZone &) = delete;
+
+private:
+    const char *name;
+    int64_t start;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
@@ -0,0 +1,697 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <stdexcept>
+
+namespace {
+    struct AccessInfo {
+        VkPipelineStageFlags stages;
+        VkAccessFlags access;
+        VkImageLayout layout;
+        VkImageUsageFlags imageUsage; // 0 if images cannot be used like this
+        VkBufferUsageFlags bufferUsage; // 0 if buffers cannot be used like this
+        bool write;
+        bool attachment;
+    };
+
+    const VkAccessFlags writeAccess = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+        VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+    const VkPipelineStageFlags depthStages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+
+    AccessInfo describeAccess(ResourceAccess access) {
+        switch (access) {
+        case ResourceAccess::ColorAttachment:
+            return { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, 0, true, true };
+        case ResourceAccess::DepthAttachment:
+            return { depthStages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 0, true, true };
+        case ResourceAccess::DepthRead:
+            return { depthStages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+                VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 0, false, true };
+        case ResourceAccess::SampledRead:
+            return { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                VK_IMAGE_USAGE_SAMPLED_BIT, 0, false, false };
+        case ResourceAccess::UniformRead:
+            return { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_UNIFORM_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED,
+                0, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, false, false };
+        case ResourceAccess::StorageRead:
+            return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL,
+                VK_IMAGE_USAGE_STORAGE_BIT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, false, false };
+        case ResourceAccess::StorageWrite:
+            return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL,
+                VK_IMAGE_USAGE_STORAGE_BIT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, true, false };
+        case ResourceAccess::TransferRead:
+            return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, false, false };
+        case ResourceAccess::TransferWrite:
+            return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_BUFFER_USAGE_TRANSFER_DST_BIT, true, false };
+        case ResourceAccess::VertexRead:
+            return { VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED,
+                0, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, false, false };
+        case ResourceAccess::IndirectRead:
+        default:
+            return { VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED,
+                0, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, false, false };
+        }
+    }
+
+    VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    bool lifetimesOverlap(const CompiledResource &a, const CompiledResource &b) {
+        return a.firstPass <= b.lastPass && b.firstPass <= a.lastPass;
+    }
+
+    // Where the resource stands while the passes are walked in order
+    struct Tracked {
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkPipelineStageFlags writeStages = 0; // of the last write or layout transition, 0 if there was none
+        VkAccessFlags writeAccess = 0;
+        VkPipelineStageFlags readStages = 0; // since the last write
+        VkPipelineStageFlags visibleStages = 0; // the last write is visible to these stages and accesses
+        VkAccessFlags visibleAccess = 0;
+        bool written = false; // the content is defined
+        bool touched = false;
+    };
+
+    const char *layoutName(VkImageLayout layout) {
+        switch (layout) {
+        case VK_IMAGE_LAYOUT_UNDEFINED: return "UNDEFINED";
+        case VK_IMAGE_LAYOUT_GENERAL: return "GENERAL";
+        case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL: return "COLOR_ATTACHMENT_OPTIMAL";
+        case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL: return "DEPTH_STENCIL_ATTACHMENT_OPTIMAL";
+        case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL: return "DEPTH_STENCIL_READ_ONLY_OPTIMAL";
+        case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL: return "SHADER_READ_ONLY_OPTIMAL";
+        case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL: return "TRANSFER_SRC_OPTIMAL";
+        case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL: return "TRANSFER_DST_OPTIMAL";
+        case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR: return "PRESENT_SRC_KHR";
+        default: return "OTHER";
+        }
+    }
+
+    struct FlagName {
+        uint32_t flag;
+        const char *name;
+    };
+
+    const FlagName stageNames[] = {
+        { VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, "TOP_OF_PIPE" },
+        { VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, "DRAW_INDIRECT" },
+        { VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, "VERTEX_INPUT" },
+        { VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, "VERTEX_SHADER" },
+        { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, "FRAGMENT_SHADER" },
+        { VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT, "EARLY_FRAGMENT_TESTS" },
+        { VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, "LATE_FRAGMENT_TESTS" },
+        { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, "COLOR_ATTACHMENT_OUTPUT" },
+        { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, "COMPUTE_SHADER" },
+        { VK_PIPELINE_STAGE_TRANSFER_BIT, "TRANSFER" },
+        { VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, "BOTTOM_OF_PIPE" },
+        { VK_PIPELINE_STAGE_HOST_BIT, "HOST" },
+        { VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, "ALL_COMMANDS" }
+    };
+
+    const FlagName accessNames[] = {
+        { VK_ACCESS_INDIRECT_COMMAND_READ_BIT, "INDIRECT_COMMAND_READ" },
+        { VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, "VERTEX_ATTRIBUTE_READ" },
+        { VK_ACCESS_UNIFORM_READ_BIT, "UNIFORM_READ" },
+        { VK_ACCESS_SHADER_READ_BIT, "SHADER_READ" },
+        { VK_ACCESS_SHADER_WRITE_BIT, "SHADER_WRITE" },
+        { VK_ACCESS_COLOR_ATTACHMENT_READ_BIT, "COLOR_ATTACHMENT_READ" },
+        { VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, "COLOR_ATTACHMENT_WRITE" },
+        { VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT, "DEPTH_STENCIL_ATTACHMENT_READ" },
+        { VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, "DEPTH_STENCIL_ATTACHMENT_WRITE" },
+        { VK_ACCESS_TRANSFER_READ_BIT, "TRANSFER_READ" },
+        { VK_ACCESS_TRANSFER_WRITE_BIT, "TRANSFER_WRITE" },
+        { VK_ACCESS_HOST_READ_BIT, "HOST_READ" },
+        { VK_ACCESS_HOST_WRITE_BIT, "HOST_WRITE" }
+    };
+
+    template<size_t count>
+    std::string flagNames(uint32_t flags, const FlagName (&names)[count], const char *none) {
+        std::string result;
+        for (const FlagName &name : names) {
+            if (flags & name.flag) {
+                result += result.empty() ? "" : "|";
+                result += name.name;
+            }
+        }
+        return result.empty() ? none : result;
+    }
+
+    double toMiB(VkDeviceSize bytes) {
+        return bytes / (1024.0 * 1024.0);
+    }
+}
+
+uint32_t RenderGraph::addResource(const std::string &name, bool image) {
+    Resource resource;
+    resource.name = name;
+    resource.image = image;
+    resources.push_back(resource);
+    return (uint32_t)resources.size() - 1;
+}
+
+uint32_t RenderGraph::createImage(const std::string &name, const ImageDesc &desc) {
+    uint32_t resource = addResource(name, true);
+    resources[resource].imageDesc = desc;
+    return resource;
+}
+
+uint32_t RenderGraph::createBuffer(const std::string &name, VkDeviceSize size) {
+    uint32_t resource = addResource(name, false);
+    resources[resource].bufferSize = size;
+    return resource;
+}
+
+uint32_t RenderGraph::importImage(const std::string &name, const ImageDesc &desc, const ResourceState &initial, const ResourceState &final,
+    bool output) {
+    uint32_t resource = createImage(name, desc);
+    resources[resource].imported = true;
+    resources[resource].output = output;
+    resources[resource].initial = initial;
+    resources[resource].final = final;
+    return resource;
+}
+
+uint32_t RenderGraph::importBuffer(const std::string &name, VkDeviceSize size, const ResourceState &initial, const ResourceState &final,
+    bool output) {
+    uint32_t resource = createBuffer(name, size);
+    resources[resource].imported = true;
+    resources[resource].output = output;
+    resources[resource].initial = initial;
+    resources[resource].final = final;
+    return resource;
+}
+
+uint32_t RenderGraph::addPass(const std::string &name, PassType type, RecordPass record) {
+    Pass pass;
+    pass.name = name;
+    pass.type = type;
+    pass.record = record;
+    passes.push_back(pass);
+    return (uint32_t)passes.size() - 1;
+}
+
+void RenderGraph::use(uint32_t pass, uint32_t resource, ResourceAccess access) {
+    VkClearValue clearValue = {};
+    addUse(pass, resource, access, false, clearValue);
+}
+
+void RenderGraph::clear(uint32_t pass, uint32_t resource, ResourceAccess access, const VkClearValue &clearValue) {
+    if (access != ResourceAccess::ColorAttachment && access != ResourceAccess::DepthAttachment) {
+        throw std::runtime_error("Pass '" + passes[pass].name + "' clears '" + resources[resource].name + "', which it does not write as attachment");
+    }
+    addUse(pass, resource, access, true, clearValue);
+}
+
+void RenderGraph::addUse(uint32_t pass, uint32_t resource, ResourceAccess access, bool cleared, const VkClearValue &clearValue) {
+    Pass &target = passes[pass];
+    AccessInfo info = describeAccess(access);
+    if ((resources[resource].image ? info.imageUsage : info.bufferUsage) == 0) {
+        throw std::runtime_error("Pass '" + target.name + "' uses '" + resources[resource].name + "' in a way only " +
+            (resources[resource].image ? "buffers" : "images") + " can be used");
+    }
+    if (info.attachment && target.type != PassType::Raster) {
+        throw std::runtime_error("Pass '" + target.name + "' is no raster pass but uses '" + resources[resource].name + "' as attachment");
+    }
+    for (const Use &existing : target.uses) {
+        if (existing.resource == resource) {
+            throw std::runtime_error("Pass '" + target.name + "' uses '" + resources[resource].name + "' twice");
+        }
+    }
+
+    Use use;
+    use.resource = resource;
+    use.access = access;
+    use.cleared = cleared;
+    use.clearValue = clearValue;
+    target.uses.push_back(use);
+}
+
+bool RenderGraph::isDepthFormat(VkFormat format) {
+    return format == VK_FORMAT_D16_UNORM || format == VK_FORMAT_X8_D24_UNORM_PACK32 || format == VK_FORMAT_D32_SFLOAT ||
+        format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+}
+
+MemoryFootprint RenderGraph::estimateFootprint(const ImageDesc &desc) {
+    VkDeviceSize texelSize = 4;
+    switch (desc.format) {
+    case VK_FORMAT_R8_UNORM:
+        texelSize = 1;
+        break;
+    case VK_FORMAT_D16_UNORM:
+    case VK_FORMAT_R16_SFLOAT:
+        texelSize = 2;
+        break;
+    case VK_FORMAT_R16G16B16A16_SFLOAT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+        texelSize = 8;
+        break;
+    case VK_FORMAT_R32G32B32A32_SFLOAT:
+        texelSize = 16;
+        break;
+    default:
+        break;
+    }
+    MemoryFootprint footprint;
+    footprint.alignment = 64 * 1024;
+    footprint.size = alignUp((VkDeviceSize)desc.extent.width * desc.extent.height * texelSize, footprint.alignment);
+    return footprint;
+}
+
+VkImageUsageFlags RenderGraph::getImageUsage(uint32_t resource) const {
+    VkImageUsageFlags usage = 0;
+    for (const Pass &pass : passes) {
+        for (const Use &use : pass.uses) {
+            if (use.resource == resource) {
+                usage |= describeAccess(use.access).imageUsage;
+            }
+        }
+    }
+    return usage;
+}
+
+VkBufferUsageFlags RenderGraph::getBufferUsage(uint32_t resource) const {
+    VkBufferUsageFlags usage = 0;
+    for (const Pass &pass : passes) {
+        for (const Use &use : pass.uses) {
+            if (use.resource == resource) {
+                usage |= describeAccess(use.access).bufferUsage;
+            }
+        }
+    }
+    return usage;
+}
+
+// Walks the passes backwards from the outputs. A pass is needed if it has side effects or writes something a later
+// needed pass reads. Clears end the dependency on earlier writers, every other write keeps the content of before.
+void RenderGraph::cull(std::vector<bool> &alive) const {
+    std::vector<bool> needed(resources.size());
+    for (size_t i = 0; i < resources.size(); ++i) {
+        needed[i] = resources[i].output;
+    }
+
+    alive.assign(passes.size(), false);
+    for (size_t p = passes.size(); p-- > 0;) {
+        const Pass &pass = passes[p];
+        bool isAlive = pass.sideEffects;
+        for (const Use &use : pass.uses) {
+            isAlive = isAlive || (describeAccess(use.access).write && needed[use.resource]);
+        }
+        if (!isAlive) {
+            continue;
+        }
+        alive[p] = true;
+        for (const Use &use : pass.uses) {
+            if (use.cleared) {
+                needed[use.resource] = false;
+            } else if (!describeAccess(use.access).write) {
+                needed[use.resource] = true;
+            }
+        }
+    }
+}
+
+void RenderGraph::compile(CompiledRenderGraph &compiled) const {
+    compiled = CompiledRenderGraph();
+    compiled.resources.resize(resources.size());
+
+    std::vector<bool> alive;
+    cull(alive);
+    for (uint32_t p = 0; p < passes.size(); ++p) {
+        if (!alive[p]) {
+            compiled.culledPasses.push_back(p);
+            continue;
+        }
+        CompiledPass compiledPass;
+        compiledPass.pass = p;
+        compiledPass.contents = passes[p].contents;
+        uint32_t index = (uint32_t)compiled.passes.size();
+        for (const Use &use : passes[p].uses) {
+            CompiledResource &resource = compiled.resources[use.resource];
+            resource.used = true;
+            resource.imageUsage |= describeAccess(use.access).imageUsage;
+            resource.bufferUsage |= describeAccess(use.access).bufferUsage;
+            resource.firstPass = std::min(resource.firstPass, index);
+            resource.lastPass = std::max(resource.lastPass, index);
+        }
+        compiled.passes.push_back(compiledPass);
+    }
+
+    placeTransients(compiled);
+    placeBarriers(compiled);
+}
+
+// Largest first, each at the lowest offset where it overlaps no resource of the heap alive at the same time.
+// Transient resources are only used within the frame and get a heap per frame slot, so lifetimes never span
+// frames.
+void RenderGraph::placeTransients(CompiledRenderGraph &compiled) const {
+    std::vector<uint32_t> order;
+    for (uint32_t r = 0; r < resources.size(); ++r) {
+        if (resources[r].imported || !compiled.resources[r].used) {
+            continue;
+        }
+        if (resources[r].footprint.size == 0) {
+            throw std::runtime_error("Transient resource '" + resources[r].name + "' has no memory footprint");
+        }
+        order.push_back(r);
+        compiled.transientBytes += resources[r].footprint.size;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return resources[a].footprint.size > resources[b].footprint.size;
+    });
+
+    std::vector<std::vector<uint32_t>> placed; // per heap
+    for (uint32_t r : order) {
+        const MemoryFootprint &footprint = resources[r].footprint;
+        CompiledResource &resource = compiled.resources[r];
+
+        uint32_t heap = 0;
+        while (heap < compiled.heaps.size() && (compiled.heaps[heap].images != resources[r].image ||
+            (compiled.heaps[heap].memoryTypeBits & footprint.memoryTypeBits) == 0)) {
+            ++heap;
+        }
+        if (heap == compiled.heaps.size()) {
+            TransientHeap newHeap;
+            newHeap.images = resources[r].image;
+            compiled.heaps.push_back(newHeap);
+            placed.emplace_back();
+        }
+
+        // The candidates are the start of the heap and the ends of the resources alive at the same time
+        std::vector<VkDeviceSize> candidates = { 0 };
+        for (uint32_t other : placed[heap]) {
+            if (lifetimesOverlap(resource, compiled.resources[other])) {
+                candidates.push_back(alignUp(compiled.resources[other].offset + resources[other].footprint.size, footprint.alignment));
+            }
+        }
+        std::sort(candidates.begin(), candidates.end());
+        for (VkDeviceSize candidate : candidates) {
+            bool free = true;
+            for (uint32_t other : placed[heap]) {
+                const CompiledResource &placedResource = compiled.resources[other];
+                if (lifetimesOverlap(resource, placedResource) && candidate < placedResource.offset + resources[other].footprint.size &&
+                    placedResource.offset < candidate + footprint.size) {
+                    free = false;
+                    break;
+                }
+            }
+            if (free) {
+                resource.offset = candidate;
+                break;
+            }
+        }
+
+        TransientHeap &target = compiled.heaps[heap];
+        resource.heap = heap;
+        target.size = std::max(target.size, resource.offset + footprint.size);
+        target.alignment = std::max(target.alignment, footprint.alignment);
+        target.memoryTypeBits &= footprint.memoryTypeBits;
+        placed[heap].push_back(r);
+    }
+
+    // Earlier users of the same memory, the first use of a resource has to wait for them
+    for (size_t heap = 0; heap < placed.size(); ++heap) {
+        compiled.heapBytes += compiled.heaps[heap].size;
+        for (uint32_t r : placed[heap]) {
+            CompiledResource &resource = compiled.resources[r];
+            for (uint32_t other : placed[heap]) {
+                const CompiledResource &otherResource = compiled.resources[other];
+                if (otherResource.lastPass < resource.firstPass && resource.offset < otherResource.offset + resources[other].footprint.size &&
+                    otherResource.offset < resource.offset + resources[r].footprint.size) {
+                    resource.aliases.push_back(other);
+                }
+            }
+        }
+    }
+}
+
+// Walks the surviving passes in order and tracks every resource. A pass needs a barrier for a resource if the layout
+// changes, after a write (unless an earlier barrier already made the write visible to the same stages) and for a
+// write after reads, which only needs an execution dependency. The first use of aliased memory waits for the
+// previous users.
+void RenderGraph::placeBarriers(CompiledRenderGraph &compiled) const {
+    std::vector<Tracked> tracked(resources.size());
+    for (size_t r = 0; r < resources.size(); ++r) {
+        if (resources[r].imported) {
+            const ResourceState &initial = resources[r].initial;
+            tracked[r].layout = initial.layout;
+            tracked[r].writeStages = initial.stages;
+            tracked[r].writeAccess = initial.access & writeAccess;
+            tracked[r].written = !resources[r].image || initial.layout != VK_IMAGE_LAYOUT_UNDEFINED;
+            tracked[r].touched = true;
+        }
+    }
+
+    for (uint32_t index = 0; index < compiled.passes.size(); ++index) {
+        CompiledPass &compiledPass = compiled.passes[index];
+        const Pass &pass = passes[compiledPass.pass];
+
+        std::vector<bool> writtenBefore(resources.size());
+        for (const Use &use : pass.uses) {
+            writtenBefore[use.resource] = tracked[use.resource].written;
+        }
+
+        for (const Use &use : pass.uses) {
+            AccessInfo info = describeAccess(use.access);
+            Tracked &state = tracked[use.resource];
+            bool image = resources[use.resource].image;
+
+            GraphBarrier barrier;
+            barrier.resource = use.resource;
+            barrier.before.stages = 0;
+            barrier.before.access = 0;
+            barrier.before.layout = state.layout;
+            barrier.after.stages = info.stages;
+            barrier.after.access = info.access;
+            barrier.after.layout = image ? info.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+            barrier.aliasing = false;
+            bool needed = false;
+            bool transition = false;
+
+            if (!info.write && !state.written && !use.cleared) {
+                throw std::runtime_error("Pass '" + pass.name + "' reads '" + resources[use.resource].name + "' before anything wrote it");
+            }
+
+            if (!state.touched) {
+                // Nothing to keep, the image starts UNDEFINED. Earlier users of the memory have to be done with it.
+                for (uint32_t alias : compiled.resources[use.resource].aliases) {
+                    barrier.before.stages |= tracked[alias].writeStages | tracked[alias].readStages;
+                    barrier.before.access |= tracked[alias].writeAccess;
+                    barrier.aliasing = true;
+                }
+                needed = barrier.aliasing || image;
+                transition = image;
+            } else if (image && state.layout != info.layout) {
+                barrier.before.stages = state.writeStages | state.readStages;
+                barrier.before.access = state.writeAccess;
+                needed = true;
+                transition = true;
+            } else if (state.writeStages != 0 && info.write) {
+                barrier.before.stages = state.writeStages | state.readStages;
+                barrier.before.access = state.writeAccess;
+                needed = true;
+            } else if (state.writeStages != 0 && ((state.visibleStages & info.stages) != info.stages ||
+                (state.visibleAccess & info.access) != info.access)) {
+                barrier.before.stages = state.writeStages;
+                barrier.before.access = state.writeAccess;
+                needed = true;
+            } else if (info.write && state.readStages != 0) {
+                barrier.before.stages = state.readStages; // execution dependency only, reads have nothing to make available
+                needed = true;
+            }
+
+            if (needed) {
+                if (barrier.before.stages == 0) {
+                    barrier.before.stages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+                }
+                // Skip pure execution dependencies on TOP_OF_PIPE, they order nothing
+                if (transition || barrier.aliasing || barrier.before.stages != VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT || barrier.before.access != 0) {
+                    compiledPass.barriers.push_back(barrier);
+                }
+            }
+
+            if (info.write) {
+                state.writeStages = info.stages;
+                state.writeAccess = info.access & writeAccess;
+                state.readStages = 0;
+                state.visibleStages = 0;
+                state.visibleAccess = 0;
+                state.written = true;
+            } else {
+                if (transition) {
+                    // The transition made the writes available, later barriers chain onto it and only add visibility
+                    state.writeStages = info.stages;
+                    state.writeAccess = 0;
+                    state.visibleStages = 0;
+                    state.visibleAccess = 0;
+                }
+                if (needed) {
+                    state.visibleStages |= info.stages;
+                    state.visibleAccess |= info.access;
+                }
+                state.readStages |= info.stages;
+            }
+            if (image) {
+                state.layout = info.layout;
+            }
+            state.touched = true;
+        }
+
+        if (pass.type == PassType::Raster) {
+            describeRenderPass(compiled, index, writtenBefore);
+        }
+    }
+
+    for (uint32_t r = 0; r < resources.size(); ++r) {
+        if (!resources[r].imported) {
+            continue;
+        }
+        const ResourceState &final = resources[r].final;
+        const Tracked &state = tracked[r];
+        bool transition = resources[r].image && state.layout != final.layout && final.layout != VK_IMAGE_LAYOUT_UNDEFINED;
+        bool visible = state.writeAccess == 0 || final.access == 0 ||
+            ((state.visibleStages & final.stages) == final.stages && (state.visibleAccess & final.access) == final.access);
+        if (!transition && visible) {
+            continue;
+        }
+        GraphBarrier barrier;
+        barrier.resource = r;
+        barrier.before.stages = state.writeStages | state.readStages;
+        barrier.before.access = state.writeAccess;
+        barrier.before.layout = state.layout;
+        barrier.after = final;
+        barrier.after.layout = transition ? final.layout : state.layout;
+        barrier.aliasing = false;
+        if (barrier.before.stages == 0) {
+            barrier.before.stages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        }
+        compiled.finalBarriers.push_back(barrier);
+    }
+}
+
+// Load what an earlier pass wrote, clear if asked to and otherwise start from nothing. Store what a later pass or
+// the owner of an imported image still needs.
+void RenderGraph::describeRenderPass(CompiledRenderGraph &compiled, uint32_t index, const std::vector<bool> &writtenBefore) const {
+    CompiledPass &compiledPass = compiled.passes[index];
+    const Pass &pass = passes[compiledPass.pass];
+    bool hasDepth = false;
+    CompiledAttachment depthAttachment;
+
+    for (const Use &use : pass.uses) {
+        AccessInfo info = describeAccess(use.access);
+        if (!info.attachment) {
+            continue;
+        }
+        const Resource &resource = resources[use.resource];
+        if (compiledPass.extent.width == 0) {
+            compiledPass.extent = resource.imageDesc.extent;
+        } else if (compiledPass.extent.width != resource.imageDesc.extent.width || compiledPass.extent.height != resource.imageDesc.extent.height) {
+            throw std::runtime_error("The attachments of pass '" + pass.name + "' differ in size");
+        }
+
+        AttachmentDesc attachment;
+        attachment.format = resource.imageDesc.format;
+        attachment.loadOp = use.cleared ? VK_ATTACHMENT_LOAD_OP_CLEAR : writtenBefore[use.resource] ? VK_ATTACHMENT_LOAD_OP_LOAD :
+            VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachment.storeOp = resource.imported || compiled.resources[use.resource].lastPass > index ? VK_ATTACHMENT_STORE_OP_STORE :
+            VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachment.initialLayout = info.layout;
+        attachment.finalLayout = info.layout;
+        attachment.readOnly = use.access == ResourceAccess::DepthRead;
+
+        CompiledAttachment compiledAttachment;
+        compiledAttachment.resource = use.resource;
+        compiledAttachment.clearValue = use.clearValue;
+        if (use.access == ResourceAccess::ColorAttachment) {
+            compiledPass.renderPass.colorAttachments.push_back(attachment);
+            compiledPass.attachments.push_back(compiledAttachment);
+        } else if (hasDepth) {
+            throw std::runtime_error("Pass '" + pass.name + "' has more than one depth attachment");
+        } else {
+            compiledPass.renderPass.depthAttachment = attachment;
+            depthAttachment = compiledAttachment;
+            hasDepth = true;
+        }
+    }
+    if (compiledPass.extent.width == 0) {
+        throw std::runtime_error("Raster pass '" + pass.name + "' has no attachments");
+    }
+    // The cache lists the depth attachment after the colors
+    if (hasDepth) {
+        compiledPass.attachments.push_back(depthAttachment);
+    }
+}
+
+void RenderGraph::dump(const CompiledRenderGraph &compiled, std::ostream &out) const {
+    auto printBarrier = [&](const GraphBarrier &barrier) {
+        out << "    " << resources[barrier.resource].name << ": ";
+        if (resources[barrier.resource].image) {
+            out << layoutName(barrier.before.layout) << " -> " << layoutName(barrier.after.layout) << " | ";
+        }
+        out << flagNames(barrier.before.stages, stageNames, "NONE") << " (" << flagNames(barrier.before.access, accessNames, "0") << ") -> " <<
+            flagNames(barrier.after.stages, stageNames, "NONE") << " (" << flagNames(barrier.after.access, accessNames, "0") << ")";
+        if (barrier.aliasing) {
+            out << " | aliases";
+            for (uint32_t alias : compiled.resources[barrier.resource].aliases) {
+                out << " " << resources[alias].name;
+            }
+        }
+        out << std::endl;
+    };
+
+    out << "Render graph: " << compiled.passes.size() << " of " << passes.size() << " passes";
+    if (!compiled.culledPasses.empty()) {
+        out << " | culled:";
+        for (uint32_t pass : compiled.culledPasses) {
+            out << " " << passes[pass].name;
+        }
+    }
+    out << std::endl;
+
+    const char *typeNames[] = { "raster", "compute", "transfer" };
+    for (uint32_t index = 0; index < compiled.passes.size(); ++index) {
+        const CompiledPass &compiledPass = compiled.passes[index];
+        const Pass &pass = passes[compiledPass.pass];
+        out << "Pass " << index << " '" << pass.name << "' (" << typeNames[(int)pass.type];
+        if (pass.type == PassType::Raster) {
+            out << ", " << compiledPass.extent.width << "x" << compiledPass.extent.height;
+        }
+        out << ")" << (compiledPass.barriers.empty() ? ", no barriers" : "") << std::endl;
+        for (const GraphBarrier &barrier : compiledPass.barriers) {
+            printBarrier(barrier);
+        }
+        for (size_t i = 0; i < compiledPass.attachments.size(); ++i) {
+            bool depth = i == compiledPass.renderPass.colorAttachments.size();
+            const AttachmentDesc &attachment = depth ? compiledPass.renderPass.depthAttachment : compiledPass.renderPass.colorAttachments[i];
+            out << "    attachment " << resources[compiledPass.attachments[i].resource].name << ": " <<
+                (attachment.loadOp == VK_ATTACHMENT_LOAD_OP_CLEAR ? "clear" : attachment.loadOp == VK_ATTACHMENT_LOAD_OP_LOAD ? "load" : "don't care") <<
+                ", " << (attachment.storeOp == VK_ATTACHMENT_STORE_OP_STORE ? "store" : "don't store") << std::endl;
+        }
+    }
+    if (!compiled.finalBarriers.empty()) {
+        out << "End of frame" << std::endl;
+        for (const GraphBarrier &barrier : compiled.finalBarriers) {
+            printBarrier(barrier);
+        }
+    }
+
+    out << std::fixed << std::setprecision(1);
+    for (size_t heap = 0; heap < compiled.heaps.size(); ++heap) {
+        out << "Heap " << heap << " (" << (compiled.heaps[heap].images ? "images" : "buffers") << "): " << toMiB(compiled.heaps[heap].size) << " MiB" << std::endl;
+        for (uint32_t r = 0; r < resources.size(); ++r) {
+            const CompiledResource &resource = compiled.resources[r];
+            if (resource.heap == heap) {
+                out << "    " << resources[r].name << ": " << toMiB(resource.offset) << " - " << toMiB(resource.offset + resources[r].footprint.size) <<
+                    " MiB, passes " << resource.firstPass << " - " << resource.lastPass << std::endl;
+            }
+        }
+    }
+    out << "Transient memory: " << toMiB(compiled.transientBytes) << " MiB without aliasing, " << toMiB(compiled.heapBytes) << " MiB with it, " <<
+        toMiB(compiled.transientBytes - compiled.heapBytes) << " MiB saved" << std::endl;
+    out << std::defaultfloat;
+}
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "RenderTargetCache.h"
+
+// How a pass uses a resource. Decides the pipeline stages, access mask, image layout and usage flags, the
+// attachment and storage/transfer writes are writes, everything else reads.
+enum class ResourceAccess {
+    ColorAttachment,
+    DepthAttachment, // depth test and write
+    DepthRead, // depth test without writes, DEPTH_STENCIL_READ_ONLY_OPTIMAL
+    SampledRead, // fragment shader, images only
+    UniformRead, // fragment shader, buffers only
+    StorageRead, // compute shader
+    StorageWrite, // compute shader
+    TransferRead,
+    TransferWrite,
+    VertexRead, // buffers only
+    IndirectRead // buffers only
+};
+
+enum class PassType {
+    Raster, // gets a render pass with its color and depth attachments
+    Compute,
+    Transfer
+};
+
+struct ImageDesc {
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    VkExtent2D extent = { 0, 0 };
+};
+
+// Pipeline stages, access and layout of a resource at a point in the frame. Buffers ignore the layout.
+struct ResourceState {
+    VkPipelineStageFlags stages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    VkAccessFlags access = 0;
+    VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+};
+
+// What a transient resource needs from a heap, from vkGet*MemoryRequirements on the device
+struct MemoryFootprint {
+    VkDeviceSize size = 0;
+    VkDeviceSize alignment = 1;
+    uint32_t memoryTypeBits = ~0u;
+};
+
+// Render pass and framebuffer of a raster pass while it is recorded, null for the other passes
+struct PassContext {
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    VkFramebuffer framebuffer = VK_NULL_HANDLE;
+};
+
+typedef std::function<void(VkCommandBuffer commandBuffer, const PassContext &context)> RecordPass;
+
+// One barrier of a compiled pass. Images get an image memory barrier, buffers are folded into one global memory
+// barrier per pass.
+struct GraphBarrier {
+    uint32_t resource;
+    ResourceState before;
+    ResourceState after;
+    bool aliasing; // first use of memory another resource used earlier in the frame
+};
+
+struct CompiledAttachment {
+    uint32_t resource;
+    VkClearValue clearValue;
+};
+
+struct CompiledPass {
+    uint32_t pass; // index in the graph
+    std::vector<GraphBarrier> barriers; // recorded in front of the pass
+    // Raster passes only, the attachments are in their access layout for the whole pass, so the render pass
+    // does no layout transitions and needs no external dependencies
+    RenderPassDesc renderPass;
+    std::vector<CompiledAttachment> attachments; // colors in declaration order, then depth
+    VkExtent2D extent = { 0, 0 };
+    VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE;
+};
+
+// Transient resources with a memory type in common share a heap. Resources whose lifetimes do not overlap may be
+// placed at the same offset.
+struct TransientHeap {
+    bool images; // buffers and optimal images never share a heap, so bufferImageGranularity does not matter
+    VkDeviceSize size = 0;
+    VkDeviceSize alignment = 1;
+    uint32_t memoryTypeBits = ~0u;
+};
+
+struct CompiledResource {
+    bool used = false; // by a pass which survived culling
+    VkImageUsageFlags imageUsage = 0;
+    VkBufferUsageFlags bufferUsage = 0;
+    // Transient resources only
+    uint32_t heap = UINT32_MAX;
+    VkDeviceSize offset = 0;
+    uint32_t firstPass = UINT32_MAX; // index in CompiledRenderGraph::passes
+    uint32_t lastPass = 0;
+    std::vector<uint32_t> aliases; // resources which used overlapping memory before this one
+};
+
+struct CompiledRenderGraph {
+    std::vector<CompiledPass> passes; // in execution order
+    std::vector<uint32_t> culledPasses;
+    std::vector<CompiledResource> resources; // by resource index of the graph
+    std::vector<TransientHeap> heaps;
+    std::vector<GraphBarrier> finalBarriers; // imported resources into their final state
+    VkDeviceSize transientBytes = 0; // every used transient resource in its own memory
+    VkDeviceSize heapBytes = 0; // after aliasing
+};
+
+// Frame graph: passes declare what they read and write, compile() orders nothing (passes run in the order they
+// were added) but derives everything else. Passes which contribute nothing to an output or a side effect are
+// culled, barriers and layout transitions are placed in front of the first pass which needs them and merged per
+// pass, and transient resources whose lifetimes do not overlap are packed into shared heaps.
+//
+// The compiler makes no Vulkan calls, it only needs the memory footprint of every transient resource, which the
+// executor queries from the device. Invalid graphs throw std::runtime_error.
+class RenderGraph {
+public:
+    // Lives only within the frame, its content is undefined before the first write
+    uint32_t createImage(const std::string &name, const ImageDesc &desc);
+    uint32_t createBuffer(const std::string &name, VkDeviceSize size);
+    // Owned outside the graph, in initial when the frame starts and left in final. Outputs keep their writers
+    // from being culled.
+    uint32_t importImage(const std::string &name, const ImageDesc &desc, const ResourceState &initial, const ResourceState &final, bool output);
+    uint32_t importBuffer(const std::string &name, VkDeviceSize size, const ResourceState &initial, const ResourceState &final, bool output);
+
+    uint32_t addPass(const std::string &name, PassType type, RecordPass record);
+    void use(uint32_t pass, uint32_t resource, ResourceAccess access);
+    // An attachment write which starts with a clear instead of the previous content
+    void clear(uint32_t pass, uint32_t resource, ResourceAccess access, const VkClearValue &clearValue);
+    // Writes something outside the graph, such as a readback buffer, and is never culled
+    void setSideEffects(uint32_t pass) { passes[pass].sideEffects = true; }
+    // The pass records secondary command buffers into its render pass
+    void setSecondaryContents(uint32_t pass) { passes[pass].contents = VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS; }
+
+    void setFootprint(uint32_t resource, const MemoryFootprint &footprint) { resources[resource].footprint = footprint; }
+    // Width * height * texel size, 64 KiB aligned, for compiling without a device
+    static MemoryFootprint estimateFootprint(const ImageDesc &desc);
+    static bool isDepthFormat(VkFormat format);
+
+    // Usage flags of every access the resource has in the graph, the executor creates the transient resources with them
+    VkImageUsageFlags getImageUsage(uint32_t resource) const;
+    VkBufferUsageFlags getBufferUsage(uint32_t resource) const;
+
+    void compile(CompiledRenderGraph &compiled) const;
+    // Passes, barriers, attachments, culled passes and the heaps with what aliasing saved
+    void dump(const CompiledRenderGraph &compiled, std::ostream &out) const;
+
+    uint32_t getResourceCount() const { return (uint32_t)resources.size(); }
+    uint32_t getPassCount() const { return (uint32_t)passes.size(); }
+    const std::string &getResourceName(uint32_t resource) const { return resources[resource].name; }
+    const std::string &getPassName(uint32_t pass) const { return passes[pass].name; }
+    bool isImage(uint32_t resource) const { return resources[resource].image; }
+    bool isImported(uint32_t resource) const { return resources[resource].imported; }
+    const ImageDesc &getImageDesc(uint32_t resource) const { return resources[resource].imageDesc; }
+    VkDeviceSize getBufferSize(uint32_t resource) const { return resources[resource].bufferSize; }
+    void record(uint32_t pass, VkCommandBuffer commandBuffer, const PassContext &context) const { passes[pass].record(commandBuffer, context); }
+
+private:
+    struct Resource {
+        std::string name;
+        bool image;
+        bool imported = false;
+        bool output = false;
+        ImageDesc imageDesc;
+        VkDeviceSize bufferSize = 0;
+        ResourceState initial;
+        ResourceState final;
+        MemoryFootprint footprint;
+    };
+
+    struct Use {
+        uint32_t resource;
+        ResourceAccess access;
+        bool cleared;
+        VkClearValue clearValue;
+    };
+
+    struct Pass {
+        std::string name;
+        PassType type;
+        RecordPass record;
+        std::vector<Use> uses;
+        bool sideEffects = false;
+        VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE;
+    };
+
+    uint32_t addResource(const std::string &name, bool image);
+    void addUse(uint32_t pass, uint32_t resource, ResourceAccess access, bool cleared, const VkClearValue &clearValue);
+    void cull(std::vector<bool> &alive) const;
+    void placeTransients(CompiledRenderGraph &compiled) const;
+    void placeBarriers(CompiledRenderGraph &compiled) const;
+    void describeRenderPass(CompiledRenderGraph &compiled, uint32_t index, const std::vector<bool> &writtenBefore) const;
+
+    std::vector<Resource> resources;
+    std::vector<Pass> passes;
+};
@@ -0,0 +1,540 @@
+#include "RenderGraphCheck.h"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <functional>
+#include <stdexcept>
+#include "RenderGraph.h"
+
+namespace {
+    const VkExtent2D fullExtent = { 1920, 1080 };
+
+    bool fail(const char *test, const std::string &message) {
+        std::cout << test << ": FAILED - " << message << std::endl;
+        return false;
+    }
+
+    // Written down again instead of asking the compiler, so the checks do not share its mistakes
+    VkPipelineStageFlags stagesOf(ResourceAccess access) {
+        switch (access) {
+        case ResourceAccess::ColorAttachment: return VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        case ResourceAccess::DepthAttachment:
+        case ResourceAccess::DepthRead: return VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        case ResourceAccess::SampledRead:
+        case ResourceAccess::UniformRead: return VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        case ResourceAccess::StorageRead:
+        case ResourceAccess::StorageWrite: return VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        case ResourceAccess::TransferRead:
+        case ResourceAccess::TransferWrite: return VK_PIPELINE_STAGE_TRANSFER_BIT;
+        case ResourceAccess::VertexRead: return VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+        default: return VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+        }
+    }
+
+    VkAccessFlags accessOf(ResourceAccess access) {
+        switch (access) {
+        case ResourceAccess::ColorAttachment: return VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        case ResourceAccess::DepthAttachment: return VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        case ResourceAccess::DepthRead: return VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+        case ResourceAccess::SampledRead:
+        case ResourceAccess::StorageRead: return VK_ACCESS_SHADER_READ_BIT;
+        case ResourceAccess::UniformRead: return VK_ACCESS_UNIFORM_READ_BIT;
+        case ResourceAccess::StorageWrite: return VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        case ResourceAccess::TransferRead: return VK_ACCESS_TRANSFER_READ_BIT;
+        case ResourceAccess::TransferWrite: return VK_ACCESS_TRANSFER_WRITE_BIT;
+        case ResourceAccess::VertexRead: return VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+        default: return VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+        }
+    }
+
+    const VkAccessFlags writeBits = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+        VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    VkImageLayout layoutOf(ResourceAccess access) {
+        switch (access) {
+        case ResourceAccess::ColorAttachment: return VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        case ResourceAccess::DepthAttachment: return VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        case ResourceAccess::DepthRead: return VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+        case ResourceAccess::SampledRead: return VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        case ResourceAccess::StorageRead:
+        case ResourceAccess::StorageWrite: return VK_IMAGE_LAYOUT_GENERAL;
+        case ResourceAccess::TransferRead: return VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        case ResourceAccess::TransferWrite: return VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        default: return VK_IMAGE_LAYOUT_UNDEFINED;
+        }
+    }
+
+    bool isWrite(ResourceAccess access) {
+        return access == ResourceAccess::ColorAttachment || access == ResourceAccess::DepthAttachment || access == ResourceAccess::StorageWrite ||
+            access == ResourceAccess::TransferWrite;
+    }
+
+    struct Declared {
+        uint32_t pass;
+        uint32_t resource;
+        ResourceAccess access;
+    };
+
+    // Deferred frame: depth pre-pass, G-buffer, lighting, a bloom chain, luminance histogram, tonemap into the
+    // swapchain image and a readback copy. The debug overlay and its blur feed nothing and have to be culled.
+    struct SyntheticFrame {
+        RenderGraph graph;
+        std::vector<Declared> uses; // every use, to check the compiled graph against
+        std::vector<MemoryFootprint> footprints; // by resource, zero for imported ones
+        std::vector<uint32_t> expectedCulled;
+        uint32_t swapchain = 0;
+
+        uint32_t image(const std::string &name, VkFormat format, uint32_t divisor) {
+            ImageDesc desc;
+            desc.format = format;
+            desc.extent = { fullExtent.width / divisor, fullExtent.height / divisor };
+            uint32_t resource = graph.createImage(name, desc);
+            footprints.resize(resource + 1);
+            footprints[resource] = RenderGraph::estimateFootprint(desc);
+            graph.setFootprint(resource, footprints[resource]);
+            return resource;
+        }
+
+        uint32_t buffer(const std::string &name, VkDeviceSize size) {
+            uint32_t resource = graph.createBuffer(name, size);
+            footprints.resize(resource + 1);
+            footprints[resource].size = size;
+            footprints[resource].alignment = 256;
+            graph.setFootprint(resource, footprints[resource]);
+            return resource;
+        }
+
+        uint32_t pass(const std::string &name, PassType type) {
+            return graph.addPass(name, type, [](VkCommandBuffer, const PassContext &) {});
+        }
+
+        void use(uint32_t pass, uint32_t resource, ResourceAccess access) {
+            graph.use(pass, resource, access);
+            uses.push_back({ pass, resource, access });
+        }
+
+        void clear(uint32_t pass, uint32_t resource, ResourceAccess access) {
+            VkClearValue clearValue = {};
+            graph.clear(pass, resource, access, clearValue);
+            uses.push_back({ pass, resource, access });
+        }
+    };
+
+    void buildFrame(SyntheticFrame &frame) {
+        ImageDesc swapchainDesc;
+        swapchainDesc.format = VK_FORMAT_B8G8R8A8_UNORM;
+        swapchainDesc.extent = fullExtent;
+        ResourceState acquired;
+        acquired.stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        ResourceState presented;
+        presented.stages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+        presented.layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        uint32_t swapchain = frame.graph.importImage("swapchain", swapchainDesc, acquired, presented, true);
+        frame.swapchain = swapchain;
+        ResourceState hostRead;
+        hostRead.stages = VK_PIPELINE_STAGE_HOST_BIT;
+        hostRead.access = VK_ACCESS_HOST_READ_BIT;
+        uint32_t readback = frame.graph.importBuffer("readback", (VkDeviceSize)fullExtent.width * fullExtent.height * 4, ResourceState(), hostRead, true);
+        frame.footprints.resize(readback + 1);
+
+        uint32_t depth = frame.image("depth", VK_FORMAT_D32_SFLOAT, 1);
+        uint32_t albedo = frame.image("albedo", VK_FORMAT_R8G8B8A8_UNORM, 1);
+        uint32_t normal = frame.image("normal", VK_FORMAT_R16G16B16A16_SFLOAT, 1);
+        uint32_t hdr = frame.image("hdr", VK_FORMAT_R16G16B16A16_SFLOAT, 1);
+        uint32_t bloomHalf = frame.image("bloom 1/2", VK_FORMAT_R16G16B16A16_SFLOAT, 2);
+        uint32_t bloomQuarter = frame.image("bloom 1/4", VK_FORMAT_R16G16B16A16_SFLOAT, 4);
+        uint32_t bloomEighth = frame.image("bloom 1/8", VK_FORMAT_R16G16B16A16_SFLOAT, 8);
+        uint32_t bloom = frame.image("bloom", VK_FORMAT_R16G16B16A16_SFLOAT, 2);
+        uint32_t histogram = frame.buffer("histogram", 256 * 4);
+        uint32_t debug = frame.image("debug", VK_FORMAT_R8G8B8A8_UNORM, 1);
+        uint32_t debugBlur = frame.image("debug blur", VK_FORMAT_R8G8B8A8_UNORM, 1);
+
+        uint32_t prePass = frame.pass("depth pre-pass", PassType::Raster);
+        frame.clear(prePass, depth, ResourceAccess::DepthAttachment);
+
+        uint32_t gbuffer = frame.pass("gbuffer", PassType::Raster);
+        frame.clear(gbuffer, albedo, ResourceAccess::ColorAttachment);
+        frame.clear(gbuffer, normal, ResourceAccess::ColorAttachment);
+        frame.use(gbuffer, depth, ResourceAccess::DepthRead);
+
+        uint32_t debugPass = frame.pass("debug overlay", PassType::Raster);
+        frame.clear(debugPass, debug, ResourceAccess::ColorAttachment);
+        frame.use(debugPass, normal, ResourceAccess::SampledRead);
+        uint32_t debugBlurPass = frame.pass("debug blur", PassType::Compute);
+        frame.use(debugBlurPass, debug, ResourceAccess::StorageRead);
+        frame.use(debugBlurPass, debugBlur, ResourceAccess::StorageWrite);
+        frame.expectedCulled = { debugPass, debugBlurPass };
+
+        uint32_t lighting = frame.pass("lighting", PassType::Raster);
+        frame.clear(lighting, hdr, ResourceAccess::ColorAttachment);
+        frame.use(lighting, albedo, ResourceAccess::SampledRead);
+        frame.use(lighting, normal, ResourceAccess::SampledRead);
+        frame.use(lighting, depth, ResourceAccess::SampledRead);
+
+        uint32_t down1 = frame.pass("bloom down 1/2", PassType::Compute);
+        frame.use(down1, hdr, ResourceAccess::StorageRead);
+        frame.use(down1, bloomHalf, ResourceAccess::StorageWrite);
+        uint32_t down2 = frame.pass("bloom down 1/4", PassType::Compute);
+        frame.use(down2, bloomHalf, ResourceAccess::StorageRead);
+        frame.use(down2, bloomQuarter, ResourceAccess::StorageWrite);
+        uint32_t down3 = frame.pass("bloom down 1/8", PassType::Compute);
+        frame.use(down3, bloomQuarter, ResourceAccess::StorageRead);
+        frame.use(down3, bloomEighth, ResourceAccess::StorageWrite);
+        uint32_t up = frame.pass("bloom up", PassType::Raster);
+        frame.clear(up, bloom, ResourceAccess::ColorAttachment);
+        frame.use(up, bloomHalf, ResourceAccess::SampledRead);
+        frame.use(up, bloomEighth, ResourceAccess::SampledRead);
+
+        uint32_t luminance = frame.pass("luminance", PassType::Compute);
+        frame.use(luminance, hdr, ResourceAccess::StorageRead);
+        frame.use(luminance, histogram, ResourceAccess::StorageWrite);
+
+        uint32_t tonemap = frame.pass("tonemap", PassType::Raster);
+        frame.clear(tonemap, swapchain, ResourceAccess::ColorAttachment);
+        frame.use(tonemap, hdr, ResourceAccess::SampledRead);
+        frame.use(tonemap, bloom, ResourceAccess::SampledRead);
+        frame.use(tonemap, histogram, ResourceAccess::UniformRead);
+
+        uint32_t copy = frame.pass("readback", PassType::Transfer);
+        frame.use(copy, swapchain, ResourceAccess::TransferRead);
+        frame.use(copy, readback, ResourceAccess::TransferWrite);
+    }
+
+    bool checkCulling(const SyntheticFrame &frame, const CompiledRenderGraph &compiled) {
+        const char *test = "Culling";
+        if (compiled.culledPasses != frame.expectedCulled) {
+            return fail(test, std::to_string(compiled.culledPasses.size()) + " passes culled instead of the debug passes");
+        }
+        for (uint32_t r = 0; r < frame.graph.getResourceCount(); ++r) {
+            bool usedByLivePass = false;
+            for (const CompiledPass &compiledPass : compiled.passes) {
+                for (const Declared &use : frame.uses) {
+                    usedByLivePass = usedByLivePass || (use.pass == compiledPass.pass && use.resource == r);
+                }
+            }
+            if (compiled.resources[r].used != usedByLivePass) {
+                return fail(test, "'" + frame.graph.getResourceName(r) + "' used " + std::to_string(compiled.resources[r].used) + " instead of " +
+                    std::to_string(usedByLivePass));
+            }
+        }
+        std::cout << test << ": passed | " << compiled.passes.size() << " of " << frame.graph.getPassCount() << " passes kept" << std::endl;
+        return true;
+    }
+
+    // Resources alive at the same time never share memory, everything fits and is aligned
+    bool checkPlacement(const SyntheticFrame &frame, const CompiledRenderGraph &compiled) {
+        const char *test = "Transient placement";
+        const RenderGraph &graph = frame.graph;
+        for (uint32_t a = 0; a < graph.getResourceCount(); ++a) {
+            const CompiledResource &first = compiled.resources[a];
+            if (graph.isImported(a) || !first.used) {
+                continue;
+            }
+            const MemoryFootprint &footprint = frame.footprints[a];
+            if (first.heap >= compiled.heaps.size() || compiled.heaps[first.heap].images != graph.isImage(a)) {
+                return fail(test, "'" + graph.getResourceName(a) + "' is in the wrong heap");
+            }
+            if (first.offset % footprint.alignment != 0 || first.offset + footprint.size > compiled.heaps[first.heap].size) {
+                return fail(test, "'" + graph.getResourceName(a) + "' is misaligned or outside its heap");
+            }
+            for (uint32_t b = a + 1; b < graph.getResourceCount(); ++b) {
+                const CompiledResource &second = compiled.resources[b];
+                if (graph.isImported(b) || !second.used || second.heap != first.heap) {
+                    continue;
+                }
+                bool lifetimes = first.firstPass <= second.lastPass && second.firstPass <= first.lastPass;
+                bool memory = first.offset < second.offset + frame.footprints[b].size && second.offset < first.offset + footprint.size;
+                if (lifetimes && memory) {
+                    return fail(test, "'" + graph.getResourceName(a) + "' and '" + graph.getResourceName(b) + "' overlap while both are alive");
+                }
+            }
+        }
+        if (compiled.heapBytes >= compiled.transientBytes) {
+            return fail(test, "aliasing saved no memory");
+        }
+        std::cout << std::fixed << std::setprecision(1) << test << ": passed | " << compiled.heaps.size() << " heaps | " << compiled.transientBytes / (1024.0 * 1024.0) << " MiB -> " <<
+            compiled.heapBytes / (1024.0 * 1024.0) << " MiB" << std::endl;
+        return true;
+    }
+
+    // Replays the barriers: every image is in the layout of each use, the render passes start and end in it, every
+    // read after a write and every write after a read or write is ordered by a barrier chain, and memory reused from
+    // another resource waits for the earlier user
+    bool checkBarriers(const SyntheticFrame &frame, const CompiledRenderGraph &compiled) {
+        const char *test = "Layouts and barriers";
+        const RenderGraph &graph = frame.graph;
+
+        struct Replay {
+            VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+            bool written = false;
+            VkPipelineStageFlags writeChain = 0; // the last write and the stages chained after it
+            VkPipelineStageFlags writeCovered = 0; // stages ordered after the last write
+            VkAccessFlags writeAccess = 0; // of the last write, still to be made available
+            bool available = false;
+            VkAccessFlags visibleAccess = 0; // the last write or layout transition is visible to these
+            VkPipelineStageFlags reads = 0; // since the last write
+            VkPipelineStageFlags readCovered = 0;
+            bool touched = false;
+        };
+        std::vector<Replay> replay(graph.getResourceCount());
+        for (uint32_t r = 0; r < graph.getResourceCount(); ++r) {
+            replay[r].written = graph.isImported(r);
+        }
+
+        auto applyBarrier = [&](const GraphBarrier &barrier, const std::string &where) -> bool {
+            Replay &state = replay[barrier.resource];
+            if (graph.isImage(barrier.resource) && state.touched && barrier.before.layout != state.layout) {
+                return fail(test, where + ": barrier of '" + graph.getResourceName(barrier.resource) + "' starts from the wrong layout");
+            }
+            bool transition = graph.isImage(barrier.resource) && barrier.before.layout != barrier.after.layout;
+            if (graph.isImage(barrier.resource)) {
+                state.layout = barrier.after.layout;
+            }
+            if (barrier.before.stages & state.writeChain) {
+                state.writeCovered |= barrier.after.stages;
+                state.writeChain |= barrier.after.stages;
+                if ((barrier.before.access & state.writeAccess) == state.writeAccess) {
+                    state.available = true;
+                }
+                if (state.available) {
+                    state.visibleAccess |= barrier.after.access;
+                }
+            }
+            if (transition) {
+                // The transition is a write of its own, made available by the barrier and visible to its accesses
+                if (state.writeChain != 0 && !state.available) {
+                    return fail(test, where + ": '" + graph.getResourceName(barrier.resource) + "' changes its layout before the last write is available");
+                }
+                state.writeChain = barrier.after.stages;
+                state.writeCovered = barrier.after.stages;
+                state.writeAccess = 0;
+                state.available = true;
+                state.visibleAccess = barrier.after.access;
+            }
+            if (state.reads != 0 && (barrier.before.stages & state.reads) == state.reads) {
+                state.readCovered |= barrier.after.stages;
+            }
+            return true;
+        };
+
+        for (const CompiledPass &compiledPass : compiled.passes) {
+            const std::string &name = graph.getPassName(compiledPass.pass);
+            for (const GraphBarrier &barrier : compiledPass.barriers) {
+                if (!applyBarrier(barrier, name)) {
+                    return false;
+                }
+            }
+
+            for (const Declared &use : frame.uses) {
+                if (use.pass != compiledPass.pass) {
+                    continue;
+                }
+                Replay &state = replay[use.resource];
+                const std::string &resourceName = graph.getResourceName(use.resource);
+                VkPipelineStageFlags stages = stagesOf(use.access);
+                VkAccessFlags access = accessOf(use.access);
+
+                if (graph.isImage(use.resource) && state.layout != layoutOf(use.access)) {
+                    return fail(test, name + ": '" + resourceName + "' is not in the layout of its use");
+                }
+                if (!state.touched && !graph.isImported(use.resource)) {
+                    // Memory shared with a resource used earlier in the frame: the barrier has to wait for its last
+                    // write, directly or through a barrier chained after it, and for the reads since
+                    for (uint32_t alias : compiled.resources[use.resource].aliases) {
+                        const Replay &earlier = replay[alias];
+                        bool waited = false;
+                        for (const GraphBarrier &barrier : compiledPass.barriers) {
+                            bool afterWrite = earlier.writeChain == 0 || (barrier.before.stages & earlier.writeChain) != 0;
+                            bool afterReads = (barrier.before.stages & earlier.reads) == earlier.reads ||
+                                (barrier.before.stages & earlier.readCovered) != 0;
+                            waited = waited || (barrier.resource == use.resource && barrier.aliasing && afterWrite && afterReads);
+                        }
+                        if (!waited) {
+                            return fail(test, name + ": '" + resourceName + "' reuses the memory of '" + graph.getResourceName(alias) + "' without waiting");
+                        }
+                    }
+                }
+                if (state.writeChain != 0 && (stages & ~state.writeCovered) != 0) {
+                    return fail(test, name + ": '" + resourceName + "' is accessed after a write without a barrier");
+                }
+                if (state.writeChain != 0 && (access & ~state.visibleAccess) != 0) {
+                    return fail(test, name + ": the last write of '" + resourceName + "' is not visible to the access of its use");
+                }
+                if (isWrite(use.access) && state.reads != 0 && (stages & ~state.readCovered) != 0) {
+                    return fail(test, name + ": '" + resourceName + "' is written after a read without a barrier");
+                }
+
+                if (isWrite(use.access)) {
+                    state.writeChain = stages;
+                    state.writeCovered = 0;
+                    state.writeAccess = access & writeBits;
+                    state.available = false;
+                    state.visibleAccess = 0;
+                    state.reads = 0;
+                    state.readCovered = 0;
+                    state.written = true;
+                } else {
+                    state.reads |= stages;
+                }
+                state.touched = true;
+            }
+
+            // The attachments stay in their layout, the render pass itself transitions nothing
+            if (!compiledPass.attachments.empty()) {
+                const RenderPassDesc &desc = compiledPass.renderPass;
+                for (size_t i = 0; i < compiledPass.attachments.size(); ++i) {
+                    uint32_t resource = compiledPass.attachments[i].resource;
+                    const AttachmentDesc &attachment = i < desc.colorAttachments.size() ? desc.colorAttachments[i] : desc.depthAttachment;
+                    if (attachment.initialLayout != replay[resource].layout || attachment.finalLayout != replay[resource].layout) {
+                        return fail(test, name + ": attachment '" + graph.getResourceName(resource) + "' changes its layout in the render pass");
+                    }
+                    bool needed = graph.isImported(resource) || compiled.resources[resource].lastPass > (uint32_t)(&compiledPass - compiled.passes.data());
+                    if ((attachment.storeOp == VK_ATTACHMENT_STORE_OP_STORE) != needed) {
+                        return fail(test, name + ": attachment '" + graph.getResourceName(resource) + "' has the wrong store op");
+                    }
+                }
+            }
+        }
+
+        for (const GraphBarrier &barrier : compiled.finalBarriers) {
+            if (!applyBarrier(barrier, "end of frame")) {
+                return false;
+            }
+        }
+        if (replay[frame.swapchain].layout != VK_IMAGE_LAYOUT_PRESENT_SRC_KHR) {
+            return fail(test, "the swapchain image does not end in PRESENT_SRC_KHR");
+        }
+
+        size_t barrierCount = compiled.finalBarriers.size();
+        for (const CompiledPass &compiledPass : compiled.passes) {
+            barrierCount += compiledPass.barriers.size();
+        }
+        std::cout << test << ": passed | " << barrierCount << " barriers" << std::endl;
+        return true;
+    }
+
+    bool expectThrow(const char *test, const char *what, const std::function<void()> &build) {
+        try {
+            build();
+        } catch (const std::runtime_error &error) {
+            std::cout << test << ": " << what << " rejected (" << error.what() << ")" << std::endl;
+            return true;
+        }
+        return fail(test, std::string(what) + " was accepted");
+    }
+
+    bool checkInvalidGraphs() {
+        const char *test = "Invalid graphs";
+        ImageDesc desc;
+        desc.format = VK_FORMAT_R8G8B8A8_UNORM;
+        desc.extent = fullExtent;
+        ImageDesc depthDesc;
+        depthDesc.format = VK_FORMAT_D32_SFLOAT;
+        depthDesc.extent = fullExtent;
+        ResourceState present;
+        present.layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        auto noRecord = [](VkCommandBuffer, const PassContext &) {};
+
+        bool passed = expectThrow(test, "read before write", [&]() {
+            RenderGraph graph;
+            uint32_t output = graph.importImage("output", desc, ResourceState(), present, true);
+            uint32_t image = graph.createImage("image", desc);
+            graph.setFootprint(image, RenderGraph::estimateFootprint(desc));
+            uint32_t pass = graph.addPass("pass", PassType::Raster, noRecord);
+            graph.use(pass, output, ResourceAccess::ColorAttachment);
+            graph.use(pass, image, ResourceAccess::SampledRead);
+            CompiledRenderGraph compiled;
+            graph.compile(compiled);
+        });
+        passed = expectThrow(test, "attachment in a compute pass", [&]() {
+            RenderGraph graph;
+            uint32_t image = graph.createImage("image", desc);
+            graph.use(graph.addPass("pass", PassType::Compute, noRecord), image, ResourceAccess::ColorAttachment);
+        }) && passed;
+        passed = expectThrow(test, "vertex read of an image", [&]() {
+            RenderGraph graph;
+            uint32_t image = graph.createImage("image", desc);
+            graph.use(graph.addPass("pass", PassType::Raster, noRecord), image, ResourceAccess::VertexRead);
+        }) && passed;
+        passed = expectThrow(test, "two depth attachments", [&]() {
+            RenderGraph graph;
+            uint32_t output = graph.importImage("output", desc, ResourceState(), present, true);
+            uint32_t first = graph.createImage("first", depthDesc);
+            uint32_t second = graph.createImage("second", depthDesc);
+            graph.setFootprint(first, RenderGraph::estimateFootprint(depthDesc));
+            graph.setFootprint(second, RenderGraph::estimateFootprint(depthDesc));
+            uint32_t pass = graph.addPass("pass", PassType::Raster, noRecord);
+            VkClearValue clearValue = {};
+            graph.clear(pass, output, ResourceAccess::ColorAttachment, clearValue);
+            graph.clear(pass, first, ResourceAccess::DepthAttachment, clearValue);
+            graph.clear(pass, second, ResourceAccess::DepthAttachment, clearValue);
+            CompiledRenderGraph compiled;
+            graph.compile(compiled);
+        }) && passed;
+        passed = expectThrow(test, "attachments of different sizes", [&]() {
+            RenderGraph graph;
+            uint32_t output = graph.importImage("output", desc, ResourceState(), present, true);
+            ImageDesc smallDepth = depthDesc;
+            smallDepth.extent.width /= 2;
+            uint32_t depth = graph.createImage("depth", smallDepth);
+            graph.setFootprint(depth, RenderGraph::estimateFootprint(smallDepth));
+            uint32_t pass = graph.addPass("pass", PassType::Raster, noRecord);
+            VkClearValue clearValue = {};
+            graph.clear(pass, output, ResourceAccess::ColorAttachment, clearValue);
+            graph.clear(pass, depth, ResourceAccess::DepthAttachment, clearValue);
+            CompiledRenderGraph compiled;
+            graph.compile(compiled);
+        }) && passed;
+        passed = expectThrow(test, "transient without footprint", [&]() {
+            RenderGraph graph;
+            uint32_t output = graph.importImage("output", desc, ResourceState(), present, true);
+            uint32_t depth = graph.createImage("depth", depthDesc);
+            uint32_t pass = graph.addPass("pass", PassType::Raster, noRecord);
+            VkClearValue clearValue = {};
+            graph.clear(pass, output, ResourceAccess::ColorAttachment, clearValue);
+            graph.clear(pass, depth, ResourceAccess::DepthAttachment, clearValue);
+            CompiledRenderGraph compiled;
+            graph.compile(compiled);
+        }) && passed;
+        return passed;
+    }
+
+    void benchCompile(const SyntheticFrame &frame) {
+        const uint32_t iterations = 2000;
+        CompiledRenderGraph compiled;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (uint32_t i = 0; i < iterations; ++i) {
+            frame.graph.compile(compiled);
+        }
+        double microseconds = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+        std::cout << "Compile: " << microseconds / iterations << " us for " << frame.graph.getPassCount() << " passes and " <<
+            frame.graph.getResourceCount() << " resources" << std::endl;
+    }
+}
+
+bool runRenderGraphCheck() {
+    SyntheticFrame frame;
+    CompiledRenderGraph compiled;
+    try {
+        buildFrame(frame);
+        frame.graph.compile(compiled);
+    } catch (const std::runtime_error &error) {
+        fail("Synthetic frame", error.what());
+        std::cout << "Render graph check FAILED" << std::endl;
+        return false;
+    }
+    frame.graph.dump(compiled, std::cout);
+
+    bool passed = checkCulling(frame, compiled);
+    passed = checkPlacement(frame, compiled) && passed;
+    passed = checkBarriers(frame, compiled) && passed;
+    passed = checkInvalidGraphs() && passed;
+
+    benchCompile(frame);
+
+    std::cout << (passed ? "Render graph check passed" : "Render graph check FAILED") << std::endl;
+    return passed;
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+// CPU only checks of the render graph compiler on a synthetic deferred frame: culling, heap placement, layouts and
+// barriers, plus compile timings. No Vulkan device needed. Returns false if an invariant was violated.
+bool runRenderGraphCheck();
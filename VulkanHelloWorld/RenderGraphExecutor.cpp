@@ -0,0 +1,406 @@
+#include "RenderGraphExecutor.h"
+
+#include <iostream>
+#include <algorithm>
+#include "VulkanUtils.h"
+
+namespace {
+    VkImageCreateInfo describeImage(const ImageDesc &desc, VkImageUsageFlags usage) {
+        VkImageCreateInfo imageCreateInfo;
+        imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageCreateInfo.pNext = nullptr;
+        imageCreateInfo.flags = 0;
+        imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageCreateInfo.format = desc.format;
+        imageCreateInfo.extent = VkExtent3D{ desc.extent.width, desc.extent.height, 1 };
+        imageCreateInfo.mipLevels = 1;
+        imageCreateInfo.arrayLayers = 1;
+        imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageCreateInfo.usage = usage;
+        imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageCreateInfo.queueFamilyIndexCount = 0;
+        imageCreateInfo.pQueueFamilyIndices = nullptr;
+        imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        return imageCreateInfo;
+    }
+
+    VkBufferCreateInfo describeBuffer(VkDeviceSize size, VkBufferUsageFlags usage) {
+        VkBufferCreateInfo bufferCreateInfo;
+        bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferCreateInfo.pNext = nullptr;
+        bufferCreateInfo.flags = 0;
+        bufferCreateInfo.size = size;
+        bufferCreateInfo.usage = usage;
+        bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        bufferCreateInfo.queueFamilyIndexCount = 0;
+        bufferCreateInfo.pQueueFamilyIndices = nullptr;
+        return bufferCreateInfo;
+    }
+
+    VkImageAspectFlags getAspect(VkFormat format) {
+        if (!RenderGraph::isDepthFormat(format)) {
+            return VK_IMAGE_ASPECT_COLOR_BIT;
+        }
+        bool stencil = format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+        return VK_IMAGE_ASPECT_DEPTH_BIT | (stencil ? VK_IMAGE_ASPECT_STENCIL_BIT : 0);
+    }
+}
+
+void RenderGraphExecutor::init(VkDevice device, MemoryAllocator &memoryAllocator, RenderPassCache &renderPassCache, FramebufferCache &framebufferCache,
+    uint32_t framesInFlight) {
+    this->device = device;
+    this->memoryAllocator = &memoryAllocator;
+    this->renderPassCache = &renderPassCache;
+    this->framebufferCache = &framebufferCache;
+    slots.resize(framesInFlight);
+}
+
+void RenderGraphExecutor::destroy() {
+    for (Slot &slot : slots) {
+        for (uint32_t heap = 0; heap < slot.heaps.size(); ++heap) {
+            releaseHeap(slot, heap);
+        }
+    }
+    slots.clear();
+}
+
+MemoryFootprint RenderGraphExecutor::queryImage(const ImageDesc &desc, VkImageUsageFlags usage) {
+    auto key = std::make_tuple(desc.format, desc.extent.width, desc.extent.height, usage);
+    auto found = imageFootprints.find(key);
+    if (found != imageFootprints.end()) {
+        return found->second;
+    }
+
+    // Requirements only exist for an image, it is never bound
+    VkImageCreateInfo imageCreateInfo = describeImage(desc, usage);
+    VkImage image;
+    VkResult result = vkCreateImage(device, &imageCreateInfo, nullptr, &image);
+    ASSERT_VULKAN(result);
+    VkMemoryRequirements memoryRequirements;
+    vkGetImageMemoryRequirements(device, image, &memoryRequirements);
+    vkDestroyImage(device, image, nullptr);
+
+    MemoryFootprint footprint;
+    footprint.size = memoryRequirements.size;
+    footprint.alignment = memoryRequirements.alignment;
+    footprint.memoryTypeBits = memoryRequirements.memoryTypeBits;
+    imageFootprints[key] = footprint;
+    return footprint;
+}
+
+MemoryFootprint RenderGraphExecutor::queryBuffer(VkDeviceSize size, VkBufferUsageFlags usage) {
+    auto key = std::make_pair(size, usage);
+    auto found = bufferFootprints.find(key);
+    if (found != bufferFootprints.end()) {
+        return found->second;
+    }
+
+    VkBufferCreateInfo bufferCreateInfo = describeBuffer(size, usage);
+    VkBuffer buffer;
+    VkResult result = vkCreateBuffer(device, &bufferCreateInfo, nullptr, &buffer);
+    ASSERT_VULKAN(result);
+    VkMemoryRequirements memoryRequirements;
+    vkGetBufferMemoryRequirements(device, buffer, &memoryRequirements);
+    vkDestroyBuffer(device, buffer, nullptr);
+
+    MemoryFootprint footprint;
+    footprint.size = memoryRequirements.size;
+    footprint.alignment = memoryRequirements.alignment;
+    footprint.memoryTypeBits = memoryRequirements.memoryTypeBits;
+    bufferFootprints[key] = footprint;
+    return footprint;
+}
+
+void RenderGraphExecutor::compile(RenderGraph &graph, CompiledRenderGraph &compiled) {
+    for (uint32_t resource = 0; resource < graph.getResourceCount(); ++resource) {
+        if (graph.isImported(resource)) {
+            continue;
+        }
+        if (graph.isImage(resource)) {
+            graph.setFootprint(resource, queryImage(graph.getImageDesc(resource), graph.getImageUsage(resource)));
+        } else {
+            graph.setFootprint(resource, queryBuffer(graph.getBufferSize(resource), graph.getBufferUsage(resource)));
+        }
+    }
+    graph.compile(compiled);
+}
+
+void RenderGraphExecutor::bindImage(uint32_t resource, VkImage image, VkImageView view) {
+    if (images.size() <= resource) {
+        images.resize(resource + 1, VK_NULL_HANDLE);
+        views.resize(resource + 1, VK_NULL_HANDLE);
+    }
+    images[resource] = image;
+    views[resource] = view;
+}
+
+void RenderGraphExecutor::bindBuffer(uint32_t resource, VkBuffer buffer) {
+    if (buffers.size() <= resource) {
+        buffers.resize(resource + 1, VK_NULL_HANDLE);
+    }
+    buffers[resource] = buffer;
+}
+
+void RenderGraphExecutor::destroyImage(TransientImage &image) {
+    framebufferCache->releaseImageView(image.view);
+    vkDestroyImageView(device, image.view, nullptr);
+    vkDestroyImage(device, image.image, nullptr);
+    ++destroyedResources;
+}
+
+// Everything bound to the allocation goes with it
+void RenderGraphExecutor::releaseHeap(Slot &slot, uint32_t heap) {
+    auto inHeap = [heap](uint32_t resourceHeap) { return resourceHeap == heap; };
+    for (TransientImage &image : slot.images) {
+        if (inHeap(image.heap)) {
+            destroyImage(image);
+        }
+    }
+    for (TransientBuffer &buffer : slot.buffers) {
+        if (inHeap(buffer.heap)) {
+            vkDestroyBuffer(device, buffer.buffer, nullptr);
+            ++destroyedResources;
+        }
+    }
+    slot.images.erase(std::remove_if(slot.images.begin(), slot.images.end(), [&](const TransientImage &image) { return inHeap(image.heap); }),
+        slot.images.end());
+    slot.buffers.erase(std::remove_if(slot.buffers.begin(), slot.buffers.end(), [&](const TransientBuffer &buffer) { return inHeap(buffer.heap); }),
+        slot.buffers.end());
+    if (slot.heaps[heap].memory != VK_NULL_HANDLE) {
+        memoryAllocator->free(slot.heaps[heap]);
+        slot.heaps[heap] = Allocation();
+    }
+}
+
+// The previous frame of the slot is done, so its heaps can grow and its resources can be replaced right away
+void RenderGraphExecutor::prepareSlot(const RenderGraph &graph, const CompiledRenderGraph &compiled, uint32_t frame, uint64_t frameNumber) {
+    Slot &slot = slots[frame];
+    if (slot.heaps.size() < compiled.heaps.size()) {
+        slot.heaps.resize(compiled.heaps.size());
+        slot.heapImages.resize(compiled.heaps.size(), false);
+    }
+    for (uint32_t heap = 0; heap < compiled.heaps.size(); ++heap) {
+        const TransientHeap &needed = compiled.heaps[heap];
+        Allocation &allocation = slot.heaps[heap];
+        bool fits = allocation.memory != VK_NULL_HANDLE && allocation.size >= needed.size && slot.heapImages[heap] == needed.images &&
+            (needed.memoryTypeBits & (1u << allocation.memoryType)) != 0 && allocation.offset % needed.alignment == 0;
+        if (fits) {
+            continue;
+        }
+        releaseHeap(slot, heap);
+        VkMemoryRequirements memoryRequirements;
+        memoryRequirements.size = needed.size;
+        memoryRequirements.alignment = needed.alignment;
+        memoryRequirements.memoryTypeBits = needed.memoryTypeBits;
+        allocation = memoryAllocator->allocate(memoryRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            needed.images ? ResourceKind::Optimal : ResourceKind::Linear);
+        slot.heapImages[heap] = needed.images;
+        ++heapAllocations;
+    }
+
+    images.resize(graph.getResourceCount(), VK_NULL_HANDLE);
+    views.resize(graph.getResourceCount(), VK_NULL_HANDLE);
+    buffers.resize(graph.getResourceCount(), VK_NULL_HANDLE);
+    for (uint32_t resource = 0; resource < graph.getResourceCount(); ++resource) {
+        const CompiledResource &placement = compiled.resources[resource];
+        if (graph.isImported(resource) || !placement.used) {
+            continue;
+        }
+        Allocation &allocation = slot.heaps[placement.heap];
+
+        if (graph.isImage(resource)) {
+            const ImageDesc &desc = graph.getImageDesc(resource);
+            auto existing = std::find_if(slot.images.begin(), slot.images.end(), [&](const TransientImage &image) {
+                return image.desc.format == desc.format && image.desc.extent.width == desc.extent.width && image.desc.extent.height == desc.extent.height &&
+                    image.usage == placement.imageUsage && image.heap == placement.heap && image.offset == placement.offset;
+            });
+            if (existing == slot.images.end()) {
+                TransientImage image;
+                image.desc = desc;
+                image.usage = placement.imageUsage;
+                image.heap = placement.heap;
+                image.offset = placement.offset;
+
+                VkImageCreateInfo imageCreateInfo = describeImage(desc, placement.imageUsage);
+                VkResult result = vkCreateImage(device, &imageCreateInfo, nullptr, &image.image);
+                ASSERT_VULKAN(result);
+                result = vkBindImageMemory(device, image.image, allocation.memory, allocation.offset + placement.offset);
+                ASSERT_VULKAN(result);
+
+                VkImageViewCreateInfo imageViewCreateInfo;
+                imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+                imageViewCreateInfo.pNext = nullptr;
+                imageViewCreateInfo.flags = 0;
+                imageViewCreateInfo.image = image.image;
+                imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+                imageViewCreateInfo.format = desc.format;
+                imageViewCreateInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+                imageViewCreateInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+                imageViewCreateInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+                imageViewCreateInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+                imageViewCreateInfo.subresourceRange.aspectMask = getAspect(desc.format);
+                imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
+                imageViewCreateInfo.subresourceRange.levelCount = 1;
+                imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
+                imageViewCreateInfo.subresourceRange.layerCount = 1;
+                result = vkCreateImageView(device, &imageViewCreateInfo, nullptr, &image.view);
+                ASSERT_VULKAN(result);
+
+                slot.images.push_back(image);
+                existing = slot.images.end() - 1;
+                ++createdResources;
+            }
+            existing->lastUsedFrame = frameNumber;
+            images[resource] = existing->image;
+            views[resource] = existing->view;
+        } else {
+            VkDeviceSize size = graph.getBufferSize(resource);
+            auto existing = std::find_if(slot.buffers.begin(), slot.buffers.end(), [&](const TransientBuffer &buffer) {
+                return buffer.size == size && buffer.usage == placement.bufferUsage && buffer.heap == placement.heap && buffer.offset == placement.offset;
+            });
+            if (existing == slot.buffers.end()) {
+                TransientBuffer buffer;
+                buffer.size = size;
+                buffer.usage = placement.bufferUsage;
+                buffer.heap = placement.heap;
+                buffer.offset = placement.offset;
+
+                VkBufferCreateInfo bufferCreateInfo = describeBuffer(size, placement.bufferUsage);
+                VkResult result = vkCreateBuffer(device, &bufferCreateInfo, nullptr, &buffer.buffer);
+                ASSERT_VULKAN(result);
+                result = vkBindBufferMemory(device, buffer.buffer, allocation.memory, allocation.offset + placement.offset);
+                ASSERT_VULKAN(result);
+
+                slot.buffers.push_back(buffer);
+                existing = slot.buffers.end() - 1;
+                ++createdResources;
+            }
+            existing->lastUsedFrame = frameNumber;
+            buffers[resource] = existing->buffer;
+        }
+    }
+
+    auto stale = [&](uint64_t lastUsedFrame) { return frameNumber > lastUsedFrame + unusedFrames; };
+    for (TransientImage &image : slot.images) {
+        if (stale(image.lastUsedFrame)) {
+            destroyImage(image);
+        }
+    }
+    for (TransientBuffer &buffer : slot.buffers) {
+        if (stale(buffer.lastUsedFrame)) {
+            vkDestroyBuffer(device, buffer.buffer, nullptr);
+            ++destroyedResources;
+        }
+    }
+    slot.images.erase(std::remove_if(slot.images.begin(), slot.images.end(), [&](const TransientImage &image) { return stale(image.lastUsedFrame); }),
+        slot.images.end());
+    slot.buffers.erase(std::remove_if(slot.buffers.begin(), slot.buffers.end(), [&](const TransientBuffer &buffer) {
+        return stale(buffer.lastUsedFrame);
+    }), slot.buffers.end());
+}
+
+// One vkCmdPipelineBarrier per pass: an image barrier per image, the buffers share one global memory barrier
+void RenderGraphExecutor::recordBarriers(VkCommandBuffer commandBuffer, const RenderGraph &graph, const std::vector<GraphBarrier> &barriers) const {
+    if (barriers.empty()) {
+        return;
+    }
+    VkPipelineStageFlags srcStages = 0;
+    VkPipelineStageFlags dstStages = 0;
+    VkMemoryBarrier memoryBarrier;
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memoryBarrier.pNext = nullptr;
+    memoryBarrier.srcAccessMask = 0;
+    memoryBarrier.dstAccessMask = 0;
+    bool hasMemoryBarrier = false;
+    std::vector<VkImageMemoryBarrier> imageBarriers;
+
+    for (const GraphBarrier &barrier : barriers) {
+        srcStages |= barrier.before.stages;
+        dstStages |= barrier.after.stages;
+        if (!graph.isImage(barrier.resource)) {
+            memoryBarrier.srcAccessMask |= barrier.before.access;
+            memoryBarrier.dstAccessMask |= barrier.after.access;
+            hasMemoryBarrier = true;
+            continue;
+        }
+
+        VkImageMemoryBarrier imageBarrier;
+        imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        imageBarrier.pNext = nullptr;
+        imageBarrier.srcAccessMask = barrier.before.access;
+        imageBarrier.dstAccessMask = barrier.after.access;
+        imageBarrier.oldLayout = barrier.before.layout;
+        imageBarrier.newLayout = barrier.after.layout;
+        imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.image = images[barrier.resource];
+        imageBarrier.subresourceRange.aspectMask = getAspect(graph.getImageDesc(barrier.resource).format);
+        imageBarrier.subresourceRange.baseMipLevel = 0;
+        imageBarrier.subresourceRange.levelCount = 1;
+        imageBarrier.subresourceRange.baseArrayLayer = 0;
+        imageBarrier.subresourceRange.layerCount = 1;
+        imageBarriers.push_back(imageBarrier);
+    }
+
+    vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, hasMemoryBarrier ? 1 : 0, hasMemoryBarrier ? &memoryBarrier : nullptr,
+        0, nullptr, (uint32_t)imageBarriers.size(), imageBarriers.data());
+}
+
+void RenderGraphExecutor::execute(VkCommandBuffer commandBuffer, const RenderGraph &graph, const CompiledRenderGraph &compiled, uint32_t frame,
+    uint64_t frameNumber) {
+    prepareSlot(graph, compiled, frame, frameNumber);
+
+    std::vector<VkImageView> attachments;
+    std::vector<VkClearValue> clearValues;
+    for (const CompiledPass &compiledPass : compiled.passes) {
+        recordBarriers(commandBuffer, graph, compiledPass.barriers);
+
+        PassContext context;
+        if (compiledPass.attachments.empty()) {
+            graph.record(compiledPass.pass, commandBuffer, context);
+            continue;
+        }
+
+        attachments.clear();
+        clearValues.clear();
+        for (const CompiledAttachment &attachment : compiledPass.attachments) {
+            attachments.push_back(views[attachment.resource]);
+            clearValues.push_back(attachment.clearValue);
+        }
+        // A lookup after the first frames, new image views after a resize create theirs here
+        context.renderPass = renderPassCache->get(compiledPass.renderPass);
+        context.framebuffer = framebufferCache->get(context.renderPass, attachments.data(), (uint32_t)attachments.size(), compiledPass.extent, frameNumber);
+
+        VkRenderPassBeginInfo renderPassBeginInfo;
+        renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassBeginInfo.pNext = nullptr;
+        renderPassBeginInfo.renderPass = context.renderPass;
+        renderPassBeginInfo.framebuffer = context.framebuffer;
+        renderPassBeginInfo.renderArea.offset = { 0, 0 };
+        renderPassBeginInfo.renderArea.extent = compiledPass.extent;
+        renderPassBeginInfo.clearValueCount = (uint32_t)clearValues.size();
+        renderPassBeginInfo.pClearValues = clearValues.data();
+
+        vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, compiledPass.contents);
+        graph.record(compiledPass.pass, commandBuffer, context);
+        vkCmdEndRenderPass(commandBuffer);
+    }
+    recordBarriers(commandBuffer, graph, compiled.finalBarriers);
+}
+
+void RenderGraphExecutor::printStats() const {
+    size_t imageCount = 0;
+    size_t bufferCount = 0;
+    VkDeviceSize heapBytes = 0;
+    for (const Slot &slot : slots) {
+        imageCount += slot.images.size();
+        bufferCount += slot.buffers.size();
+        for (const Allocation &allocation : slot.heaps) {
+            heapBytes += allocation.memory != VK_NULL_HANDLE ? allocation.size : 0;
+        }
+    }
+    std::cout << "Render graph executor: " << imageCount << " transient images | " << bufferCount << " transient buffers | " <<
+        heapBytes / (1024.0 * 1024.0) << " MiB in heaps over " << slots.size() << " frame slots | " << heapAllocations << " heap allocations | " <<
+        createdResources << " created | " << destroyedResources << " destroyed" << std::endl;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <tuple>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "MemoryAllocator.h"
+#include "RenderGraph.h"
+#include "RenderTargetCache.h"
+
+// Records compiled render graphs on the graphics queue. The transient resources of every frame slot live in one
+// device local allocation per heap of the graph and are bound at the offsets the compiler chose, so resources with
+// disjoint lifetimes share memory. They are created once and reused while a graph keeps their description and
+// placement. Render passes come from the RenderPassCache, framebuffers from the FramebufferCache.
+class RenderGraphExecutor {
+public:
+    void init(VkDevice device, MemoryAllocator &memoryAllocator, RenderPassCache &renderPassCache, FramebufferCache &framebufferCache,
+        uint32_t framesInFlight);
+    // No frame in flight may use the transient resources anymore
+    void destroy();
+
+    // Sets the footprints of the transient resources from the memory requirements of the device and compiles
+    void compile(RenderGraph &graph, CompiledRenderGraph &compiled);
+    VkRenderPass getRenderPass(const CompiledPass &compiledPass) { return renderPassCache->get(compiledPass.renderPass); }
+
+    // Imported resources of the frame being recorded
+    void bindImage(uint32_t resource, VkImage image, VkImageView view);
+    void bindBuffer(uint32_t resource, VkBuffer buffer);
+    VkImage getImage(uint32_t resource) const { return images[resource]; }
+    VkBuffer getBuffer(uint32_t resource) const { return buffers[resource]; }
+
+    // Call after the fence of the frame slot signaled, the transient resources of the slot are reused
+    void execute(VkCommandBuffer commandBuffer, const RenderGraph &graph, const CompiledRenderGraph &compiled, uint32_t frame, uint64_t frameNumber);
+
+    void printStats() const;
+
+private:
+    struct TransientImage {
+        ImageDesc desc;
+        VkImageUsageFlags usage;
+        uint32_t heap;
+        VkDeviceSize offset;
+        VkImage image;
+        VkImageView view;
+        uint64_t lastUsedFrame;
+    };
+
+    struct TransientBuffer {
+        VkDeviceSize size;
+        VkBufferUsageFlags usage;
+        uint32_t heap;
+        VkDeviceSize offset;
+        VkBuffer buffer;
+        uint64_t lastUsedFrame;
+    };
+
+    struct Slot {
+        std::vector<Allocation> heaps;
+        std::vector<bool> heapImages; // the kind the allocation was made for
+        std::vector<TransientImage> images;
+        std::vector<TransientBuffer> buffers;
+    };
+
+    // Transient resources unused for this many frames are destroyed, graphs which alternate keep theirs
+    static const uint64_t unusedFrames = 120;
+
+    MemoryFootprint queryImage(const ImageDesc &desc, VkImageUsageFlags usage);
+    MemoryFootprint queryBuffer(VkDeviceSize size, VkBufferUsageFlags usage);
+    void prepareSlot(const RenderGraph &graph, const CompiledRenderGraph &compiled, uint32_t frame, uint64_t frameNumber);
+    void releaseHeap(Slot &slot, uint32_t heap);
+    void destroyImage(TransientImage &image);
+    void recordBarriers(VkCommandBuffer commandBuffer, const RenderGraph &graph, const std::vector<GraphBarrier> &barriers) const;
+
+    VkDevice device = VK_NULL_HANDLE;
+    MemoryAllocator *memoryAllocator = nullptr;
+    RenderPassCache *renderPassCache = nullptr;
+    FramebufferCache *framebufferCache = nullptr;
+    std::vector<Slot> slots;
+
+    // Memory requirements by format, width, height and usage, buffers by size and usage
+    std::map<std::tuple<VkFormat, uint32_t, uint32_t, VkImageUsageFlags>, MemoryFootprint> imageFootprints;
+    std::map<std::pair<VkDeviceSize, VkBufferUsageFlags>, MemoryFootprint> bufferFootprints;
+
+    // By resource of the graph being recorded, transient ones are filled in per frame
+    std::vector<VkImage> images;
+    std::vector<VkImageView> views;
+    std::vector<VkBuffer> buffers;
+
+    uint64_t createdResources = 0;
+    uint64_t destroyedResources = 0;
+    uint64_t heapAllocations = 0;
+};
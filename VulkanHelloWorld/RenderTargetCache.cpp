@@ -0,0 +1,270 @@
+#include "RenderTargetCache.h"
+
+#include <iostream>
+#include <algorithm>
+#include "VulkanUtils.h"
+
+namespace {
+    const uint64_t fnvOffsetBasis = 14695981039346656037ull;
+    const uint64_t fnvPrime = 1099511628211ull;
+
+    uint64_t hashBytes(uint64_t value, const void *data, size_t size) {
+        const unsigned char *bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++i) {
+            value = (value ^ bytes[i]) * fnvPrime;
+        }
+        return value;
+    }
+
+    uint64_t hashWord(uint64_t value, uint64_t word) {
+        return hashBytes(value, &word, sizeof(word));
+    }
+
+    uint64_t hashAttachment(uint64_t value, const AttachmentDesc &attachment) {
+        value = hashWord(value, (uint64_t)attachment.format);
+        value = hashWord(value, (uint64_t)attachment.loadOp);
+        value = hashWord(value, (uint64_t)attachment.storeOp);
+        value = hashWord(value, (uint64_t)attachment.initialLayout);
+        value = hashWord(value, (uint64_t)attachment.finalLayout);
+        return hashWord(value, attachment.readOnly ? 1 : 0);
+    }
+
+    bool equalAttachments(const AttachmentDesc &a, const AttachmentDesc &b) {
+        return a.format == b.format && a.loadOp == b.loadOp && a.storeOp == b.storeOp && a.initialLayout == b.initialLayout &&
+            a.finalLayout == b.finalLayout && a.readOnly == b.readOnly;
+    }
+}
+
+uint64_t RenderPassDesc::hash() const {
+    uint64_t value = hashWord(fnvOffsetBasis, colorAttachments.size());
+    for (const AttachmentDesc &attachment : colorAttachments) {
+        value = hashAttachment(value, attachment);
+    }
+    return hashAttachment(value, depthAttachment);
+}
+
+bool RenderPassDesc::operator==(const RenderPassDesc &other) const {
+    if (colorAttachments.size() != other.colorAttachments.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < colorAttachments.size(); ++i) {
+        if (!equalAttachments(colorAttachments[i], other.colorAttachments[i])) {
+            return false;
+        }
+    }
+    return equalAttachments(depthAttachment, other.depthAttachment);
+}
+
+void RenderPassCache::init(VkDevice device) {
+    this->device = device;
+}
+
+void RenderPassCache::destroy() {
+    for (const auto &bucket : renderPasses) {
+        for (const Entry &entry : bucket.second) {
+            vkDestroyRenderPass(device, entry.renderPass, nullptr);
+        }
+    }
+    renderPasses.clear();
+}
+
+VkRenderPass RenderPassCache::get(const RenderPassDesc &desc) {
+    std::vector<Entry> &bucket = renderPasses[desc.hash()];
+    for (const Entry &entry : bucket) {
+        if (entry.desc == desc) {
+            ++hits;
+            return entry.renderPass;
+        }
+    }
+
+    ++misses;
+    Entry entry;
+    entry.desc = desc;
+    entry.renderPass = create(desc);
+    bucket.push_back(entry);
+    return entry.renderPass;
+}
+
+void RenderPassCache::printStats() const {
+    size_t count = 0;
+    for (const auto &bucket : renderPasses) {
+        count += bucket.second.size();
+    }
+    std::cout << "Render pass cache: " << count << " render passes | " << hits << " hits | " << misses << " misses" << std::endl;
+}
+
+VkRenderPass RenderPassCache::create(const RenderPassDesc &desc) const {
+    std::vector<VkAttachmentDescription> attachmentDescriptions;
+    std::vector<VkAttachmentReference> attachmentReferences;
+    for (const AttachmentDesc &attachment : desc.colorAttachments) {
+        VkAttachmentDescription attachmentDescription;
+        attachmentDescription.flags = 0;
+        attachmentDescription.format = attachment.format;
+        attachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
+        attachmentDescription.loadOp = attachment.loadOp;
+        attachmentDescription.storeOp = attachment.storeOp;
+        attachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachmentDescription.initialLayout = attachment.initialLayout;
+        attachmentDescription.finalLayout = attachment.finalLayout;
+        attachmentDescriptions.push_back(attachmentDescription);
+
+        VkAttachmentReference attachmentReference;
+        attachmentReference.attachment = (uint32_t)attachmentReferences.size(); // "index in the attachment array"
+        attachmentReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        attachmentReferences.push_back(attachmentReference);
+    }
+
+    // The depth attachment comes last, so the framebuffer lists its view after the color views
+    bool hasDepth = desc.depthAttachment.format != VK_FORMAT_UNDEFINED;
+    VkAttachmentReference depthReference;
+    if (hasDepth) {
+        VkAttachmentDescription attachmentDescription;
+        attachmentDescription.flags = 0;
+        attachmentDescription.format = desc.depthAttachment.format;
+        attachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
+        attachmentDescription.loadOp = desc.depthAttachment.loadOp;
+        attachmentDescription.storeOp = desc.depthAttachment.storeOp;
+        attachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachmentDescription.initialLayout = desc.depthAttachment.initialLayout;
+        attachmentDescription.finalLayout = desc.depthAttachment.finalLayout;
+        attachmentDescriptions.push_back(attachmentDescription);
+
+        depthReference.attachment = (uint32_t)attachmentReferences.size();
+        depthReference.layout = desc.depthAttachment.readOnly ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL :
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    }
+
+    VkSubpassDescription subPassDescription;
+    subPassDescription.flags = 0;
+    subPassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subPassDescription.inputAttachmentCount = 0;
+    subPassDescription.pInputAttachments = nullptr;
+    subPassDescription.colorAttachmentCount = (uint32_t)attachmentReferences.size();
+    subPassDescription.pColorAttachments = attachmentReferences.data();
+    subPassDescription.pResolveAttachments = nullptr;
+    subPassDescription.pDepthStencilAttachment = hasDepth ? &depthReference : nullptr;
+    subPassDescription.preserveAttachmentCount = 0;
+    subPassDescription.pPreserveAttachments = nullptr;
+
+    VkRenderPassCreateInfo renderPassCreateInfo;
+    renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassCreateInfo.pNext = nullptr;
+    renderPassCreateInfo.flags = 0;
+    renderPassCreateInfo.attachmentCount = (uint32_t)attachmentDescriptions.size();
+    renderPassCreateInfo.pAttachments = attachmentDescriptions.data();
+    renderPassCreateInfo.subpassCount = 1;
+    renderPassCreateInfo.pSubpasses = &subPassDescription;
+    // The render graph records the barriers and layout transitions around the pass, so there are no external dependencies
+    renderPassCreateInfo.dependencyCount = 0;
+    renderPassCreateInfo.pDependencies = nullptr;
+
+    VkRenderPass renderPass;
+    VkResult result = vkCreateRenderPass(device, &renderPassCreateInfo, nullptr, &renderPass);
+    ASSERT_VULKAN(result);
+    return renderPass;
+}
+
+bool FramebufferCache::Key::operator==(const Key &other) const {
+    return renderPass == other.renderPass && attachments == other.attachments && width == other.width && height == other.height;
+}
+
+size_t FramebufferCache::KeyHash::operator()(const Key &key) const {
+    uint64_t value = hashWord(fnvOffsetBasis, (uint64_t)(uintptr_t)key.renderPass);
+    for (VkImageView attachment : key.attachments) {
+        value = hashWord(value, (uint64_t)(uintptr_t)attachment);
+    }
+    value = hashWord(value, key.width);
+    value = hashWord(value, key.height);
+    return (size_t)value;
+}
+
+void FramebufferCache::init(VkDevice device, uint32_t capacity, uint32_t framesInFlight) {
+    this->device = device;
+    this->capacity = capacity;
+    this->framesInFlight = framesInFlight;
+}
+
+void FramebufferCache::destroy() {
+    for (const auto &entry : entries) {
+        vkDestroyFramebuffer(device, entry.second.framebuffer, nullptr);
+    }
+    entries.clear();
+    lru.clear();
+}
+
+VkFramebuffer FramebufferCache::get(VkRenderPass renderPass, const VkImageView *attachments, uint32_t attachmentCount, VkExtent2D extent,
+    uint64_t frame) {
+    Key key;
+    key.renderPass = renderPass;
+    key.attachments.assign(attachments, attachments + attachmentCount);
+    key.width = extent.width;
+    key.height = extent.height;
+
+    auto found = entries.find(key);
+    if (found != entries.end()) {
+        ++hits;
+        found->second.lastUsedFrame = frame;
+        lru.splice(lru.begin(), lru, found->second.lruPosition);
+        return found->second.framebuffer;
+    }
+
+    ++misses;
+    VkFramebufferCreateInfo frameBufferCreateInfo;
+    frameBufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    frameBufferCreateInfo.pNext = nullptr;
+    frameBufferCreateInfo.flags = 0;
+    frameBufferCreateInfo.renderPass = renderPass;
+    frameBufferCreateInfo.attachmentCount = attachmentCount;
+    frameBufferCreateInfo.pAttachments = attachments;
+    frameBufferCreateInfo.width = extent.width;
+    frameBufferCreateInfo.height = extent.height;
+    frameBufferCreateInfo.layers = 1;
+
+    Entry entry;
+    VkResult result = vkCreateFramebuffer(device, &frameBufferCreateInfo, nullptr, &entry.framebuffer);
+    ASSERT_VULKAN(result);
+    entry.lastUsedFrame = frame;
+    lru.push_front(key);
+    entry.lruPosition = lru.begin();
+    VkFramebuffer framebuffer = entry.framebuffer;
+    entries.emplace(std::move(key), entry);
+
+    evict(frame);
+    return framebuffer;
+}
+
+void FramebufferCache::releaseImageView(VkImageView imageView) {
+    for (auto entry = entries.begin(); entry != entries.end();) {
+        const std::vector<VkImageView> &attachments = entry->first.attachments;
+        if (std::find(attachments.begin(), attachments.end(), imageView) != attachments.end()) {
+            vkDestroyFramebuffer(device, entry->second.framebuffer, nullptr);
+            lru.erase(entry->second.lruPosition);
+            entry = entries.erase(entry);
+            ++released;
+        } else {
+            ++entry;
+        }
+    }
+}
+
+void FramebufferCache::printStats() const {
+    std::cout << "Framebuffer cache: " << entries.size() << " framebuffers (capacity " << capacity << ") | " << hits << " hits | " << misses <<
+        " misses | " << evictions << " evicted | " << released << " released with their image views" << std::endl;
+}
+
+// Walks from the least recently used end. An entry used by one of the last framesInFlight frames may still be
+// read by the GPU, and everything before it in the list was used even later, so the walk stops there.
+void FramebufferCache::evict(uint64_t frame) {
+    while (entries.size() > capacity) {
+        auto entry = entries.find(lru.back());
+        if (entry->second.lastUsedFrame + framesInFlight > frame) {
+            return;
+        }
+        vkDestroyFramebuffer(device, entry->second.framebuffer, nullptr);
+        entries.erase(entry);
+        lru.pop_back();
+        ++evictions;
+    }
+}
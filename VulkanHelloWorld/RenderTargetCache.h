@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// One attachment of a single subpass render pass, everything else is derived from it
+struct AttachmentDesc {
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    VkAttachmentLoadOp loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    VkAttachmentStoreOp storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkImageLayout finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    bool readOnly = false; // depth only, DEPTH_STENCIL_READ_ONLY_OPTIMAL in the subpass
+};
+
+struct RenderPassDesc {
+    std::vector<AttachmentDesc> colorAttachments;
+    AttachmentDesc depthAttachment; // format VK_FORMAT_UNDEFINED without depth buffer
+
+    uint64_t hash() const;
+    bool operator==(const RenderPassDesc &other) const;
+};
+
+// Render passes by content. There are only a handful of them and any pipeline may be compatible with
+// them, so they live until destroy().
+class RenderPassCache {
+public:
+    void init(VkDevice device);
+    void destroy();
+
+    VkRenderPass get(const RenderPassDesc &desc);
+    void printStats() const;
+
+private:
+    struct Entry {
+        RenderPassDesc desc;
+        VkRenderPass renderPass;
+    };
+
+    VkRenderPass create(const RenderPassDesc &desc) const;
+
+    VkDevice device = VK_NULL_HANDLE;
+    std::unordered_map<uint64_t, std::vector<Entry>> renderPasses; // by hash, the vector only grows on collisions
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+};
+
+// Framebuffers by render pass, image views and size. Least recently used entries are destroyed once
+// there are more than the capacity, but only if no frame in flight can still use them. Entries of an
+// image view have to be released before the view is destroyed.
+class FramebufferCache {
+public:
+    void init(VkDevice device, uint32_t capacity, uint32_t framesInFlight);
+    void destroy();
+
+    // frame is the number of the frame being recorded, it decides when an entry may be evicted
+    VkFramebuffer get(VkRenderPass renderPass, const VkImageView *attachments, uint32_t attachmentCount, VkExtent2D extent, uint64_t frame);
+    // Destroys all framebuffers using the view, the caller guarantees that the GPU is done with them
+    void releaseImageView(VkImageView imageView);
+
+    size_t getSize() const { return entries.size(); }
+    void printStats() const;
+
+private:
+    struct Key {
+        VkRenderPass renderPass;
+        std::vector<VkImageView> attachments;
+        uint32_t width;
+        uint32_t height;
+
+        bool operator==(const Key &other) const;
+    };
+    struct KeyHash {
+        size_t operator()(const Key &key) const;
+    };
+    struct Entry {
+        VkFramebuffer framebuffer;
+        uint64_t lastUsedFrame;
+        std::list<Key>::iterator lruPosition;
+    };
+
+    void evict(uint64_t frame);
+
+    VkDevice device = VK_NULL_HANDLE;
+    uint32_t capacity = 0;
+    uint32_t framesInFlight = 0;
+    std::unordered_map<Key, Entry, KeyHash> entries;
+    std::list<Key> lru; // most recently used first
+
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    uint64_t released = 0;
+};
@@ -0,0 +1,43 @@
+#include "RingAllocator.h"
+
+void RingAllocator::init(VkDeviceSize capacity) {
+    this->capacity = capacity;
+    reset();
+}
+
+bool RingAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &offset) {
+    if (alignment == 0) {
+        alignment = 1;
+    }
+    if (size == 0 || size > capacity) {
+        return false;
+    }
+
+    VkDeviceSize ringOffset = head % capacity;
+    VkDeviceSize alignedOffset = (ringOffset + alignment - 1) / alignment * alignment;
+    VkDeviceSize position = head + (alignedOffset - ringOffset);
+
+    if (alignedOffset + size > capacity) {
+        // Skip the rest of the ring and continue at its start
+        position = head + (capacity - ringOffset);
+        alignedOffset = 0;
+    }
+    if (position + size - tail > capacity) {
+        return false;
+    }
+
+    head = position + size;
+    offset = alignedOffset;
+    return true;
+}
+
+void RingAllocator::release(VkDeviceSize position) {
+    if (position > tail) {
+        tail = position <= head ? position : head;
+    }
+}
+
+void RingAllocator::reset() {
+    head = 0;
+    tail = 0;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// Linear allocator over a ring for data which only lives a few frames. Allocations are never
+// freed one by one: release() drops everything allocated before a position from getHead(),
+// reset() drops everything. Like TlsfAllocator it only does the bookkeeping.
+class RingAllocator {
+public:
+    void init(VkDeviceSize capacity);
+
+    // An allocation never wraps around the end, the rest of the ring is skipped instead
+    bool allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &offset);
+    void release(VkDeviceSize position);
+    void reset();
+
+    VkDeviceSize getHead() const { return head; }
+    VkDeviceSize getCapacity() const { return capacity; }
+    VkDeviceSize getUsed() const { return head - tail; }
+
+private:
+    VkDeviceSize capacity = 0;
+    // Monotonic byte positions, the ring offset is position % capacity
+    VkDeviceSize head = 0;
+    VkDeviceSize tail = 0;
+};
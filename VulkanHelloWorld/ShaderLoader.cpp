@@ -0,0 +1,159 @@
+#include "ShaderLoader.h"
+
+#include <iostream>
+#include <chrono>
+#include <stdexcept>
+#include "VulkanUtils.h"
+
+// The custom build steps of the GLSL sources write embedded/*.inc. A build without them embeds nothing, every shader
+// is then mapped from its .spv file.
+#if __has_include("embedded/vert.inc")
+#define EMBED_SHADERS 1
+#else
+#define EMBED_SHADERS 0
+#endif
+
+namespace {
+    const uint32_t spirvMagic = 0x07230203;
+    const size_t spirvHeaderWords = 5; // magic, version, generator, bound, schema
+
+#if EMBED_SHADERS
+    // glslangValidator -x writes the words as a comma separated list, so the arrays are filled at compile time
+    alignas(16) constexpr uint32_t vertSpv[] = {
+#include "embedded/vert.inc"
+    };
+    alignas(16) constexpr uint32_t fragSpv[] = {
+#include "embedded/frag.inc"
+    };
+    alignas(16) constexpr uint32_t instancedPackedVertSpv[] = {
+#include "embedded/instanced_packed_vert.inc"
+    };
+    alignas(16) constexpr uint32_t instancedFullVertSpv[] = {
+#include "embedded/instanced_full_vert.inc"
+    };
+    alignas(16) constexpr uint32_t instancedFragSpv[] = {
+#include "embedded/instanced_frag.inc"
+    };
+    alignas(16) constexpr uint32_t instancedBindlessFragSpv[] = {
+#include "embedded/instanced_bindless_frag.inc"
+    };
+    alignas(16) constexpr uint32_t cullCompSpv[] = {
+#include "embedded/cull_comp.inc"
+    };
+    alignas(16) constexpr uint32_t meshVertSpv[] = {
+#include "embedded/mesh_vert.inc"
+    };
+    alignas(16) constexpr uint32_t texturedVertSpv[] = {
+#include "embedded/textured_vert.inc"
+    };
+    alignas(16) constexpr uint32_t texturedFragSpv[] = {
+#include "embedded/textured_frag.inc"
+    };
+    alignas(16) constexpr uint32_t particlesVertSpv[] = {
+#include "embedded/particles_vert.inc"
+    };
+    alignas(16) constexpr uint32_t particlesCompSpv[] = {
+#include "embedded/particles_comp.inc"
+    };
+
+    static_assert(vertSpv[0] == spirvMagic && fragSpv[0] == spirvMagic && instancedPackedVertSpv[0] == spirvMagic &&
+        instancedFullVertSpv[0] == spirvMagic && instancedFragSpv[0] == spirvMagic && instancedBindlessFragSpv[0] == spirvMagic &&
+        cullCompSpv[0] == spirvMagic && meshVertSpv[0] == spirvMagic && texturedVertSpv[0] == spirvMagic && texturedFragSpv[0] == spirvMagic &&
+        particlesVertSpv[0] == spirvMagic && particlesCompSpv[0] == spirvMagic,
+        "embedded shader is no SPIR-V, check the output of the custom build step of its GLSL source");
+#endif
+
+    struct EmbeddedShader {
+        const char *file;
+        const uint32_t *words;
+        size_t size;
+    };
+
+#if EMBED_SHADERS
+    constexpr EmbeddedShader embeddedShaders[] = {
+        { "vert.spv", vertSpv, sizeof(vertSpv) },
+        { "frag.spv", fragSpv, sizeof(fragSpv) },
+        { "instanced_packed_vert.spv", instancedPackedVertSpv, sizeof(instancedPackedVertSpv) },
+        { "instanced_full_vert.spv", instancedFullVertSpv, sizeof(instancedFullVertSpv) },
+        { "instanced_frag.spv", instancedFragSpv, sizeof(instancedFragSpv) },
+        { "instanced_bindless_frag.spv", instancedBindlessFragSpv, sizeof(instancedBindlessFragSpv) },
+        { "cull_comp.spv", cullCompSpv, sizeof(cullCompSpv) },
+        { "mesh_vert.spv", meshVertSpv, sizeof(meshVertSpv) },
+        { "textured_vert.spv", texturedVertSpv, sizeof(texturedVertSpv) },
+        { "textured_frag.spv", texturedFragSpv, sizeof(texturedFragSpv) },
+        { "particles_vert.spv", particlesVertSpv, sizeof(particlesVertSpv) },
+        { "particles_comp.spv", particlesCompSpv, sizeof(particlesCompSpv) },
+    };
+#endif
+
+    const EmbeddedShader *findEmbeddedShader(const std::string &file) {
+#if EMBED_SHADERS
+        for (const EmbeddedShader &shader : embeddedShaders) {
+            if (file == shader.file) {
+                return &shader;
+            }
+        }
+#else
+        (void)file;
+#endif
+        return nullptr;
+    }
+
+    // The driver reads the words in place, so everything it relies on is checked before
+    void validateSpirv(const std::string &file, const void *data, size_t size) {
+        if (reinterpret_cast<uintptr_t>(data) % alignof(uint32_t) != 0) {
+            throw std::runtime_error("SPIR-V of '" + file + "' is not word aligned");
+        }
+        if (size % sizeof(uint32_t) != 0 || size < spirvHeaderWords * sizeof(uint32_t)) {
+            throw std::runtime_error("'" + file + "' has " + std::to_string(size) + " bytes, which is no whole SPIR-V module");
+        }
+        uint32_t magic = static_cast<const uint32_t*>(data)[0];
+        if (magic == 0x03022307) {
+            throw std::runtime_error("SPIR-V of '" + file + "' has the wrong endianness");
+        }
+        if (magic != spirvMagic) {
+            throw std::runtime_error("'" + file + "' is no SPIR-V file");
+        }
+    }
+}
+
+ShaderCode loadShader(const std::string &file, ShaderSource source) {
+    auto start = std::chrono::high_resolution_clock::now();
+    ShaderCode code;
+    code.name = file;
+
+    const EmbeddedShader *embedded = source == ShaderSource::Embedded ? findEmbeddedShader(file) : nullptr;
+    if (embedded != nullptr) {
+        code.source = ShaderSource::Embedded;
+        code.words = embedded->words;
+        code.size = embedded->size;
+    } else {
+        code.source = ShaderSource::Mapped;
+        code.file.open(file);
+        code.size = code.file.getSize();
+        code.words = static_cast<const uint32_t*>(code.file.getData());
+    }
+
+    validateSpirv(file, code.words, code.size);
+    code.loadTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    return code;
+}
+
+VkShaderModule createShaderModule(VkDevice device, const ShaderCode &code) {
+    VkShaderModuleCreateInfo shaderCreateInfo;
+    shaderCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    shaderCreateInfo.pNext = nullptr;
+    shaderCreateInfo.flags = 0;
+    shaderCreateInfo.codeSize = code.getSize();
+    shaderCreateInfo.pCode = code.getWords();
+
+    auto start = std::chrono::high_resolution_clock::now();
+    VkShaderModule shaderModule;
+    VkResult result = vkCreateShaderModule(device, &shaderCreateInfo, nullptr, &shaderModule);
+    ASSERT_VULKAN(result);
+    double createTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    std::cout << "Shader " << code.getName() << ": " << (code.getSource() == ShaderSource::Embedded ? "embedded" : "mapped") << " | " <<
+        code.getSize() << " bytes | load " << code.getLoadTime() << " ms | vkCreateShaderModule " << createTime << " ms" << std::endl;
+    return shaderModule;
+}
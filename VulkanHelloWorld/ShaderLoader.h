@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vulkan/vulkan.h>
+#include "MappedFile.h"
+
+// Embedded: the SPIR-V compiled into the executable (embedded/*.inc, written by the build from the GLSL), no file I/O.
+// Mapped: the .spv file is mapped read-only and the mapping is handed to vkCreateShaderModule without a copy.
+enum class ShaderSource { Embedded, Mapped };
+
+// SPIR-V words of one shader. Owns the file mapping in the Mapped case, embedded code lives as long as the program.
+class ShaderCode {
+public:
+    ShaderCode() = default;
+    ShaderCode(const ShaderCode&) = delete;
+    ShaderCode &operator=(const ShaderCode&) = delete;
+    ShaderCode(ShaderCode &&other) noexcept = default;
+    ShaderCode &operator=(ShaderCode &&other) noexcept = default;
+
+    const uint32_t *getWords() const { return words; }
+    size_t getSize() const { return size; } // in bytes, as VkShaderModuleCreateInfo::codeSize
+    const std::string &getName() const { return name; }
+    ShaderSource getSource() const { return source; }
+    double getLoadTime() const { return loadTime; } // ms
+
+private:
+    friend ShaderCode loadShader(const std::string &file, ShaderSource source);
+
+    const uint32_t *words = nullptr;
+    size_t size = 0;
+    std::string name;
+    ShaderSource source = ShaderSource::Embedded;
+    double loadTime = 0.0;
+    MappedFile file; // not open for embedded code
+};
+
+// file is the name of the .spv file, which is also the key of the embedded shaders. Shaders which are not
+// embedded are mapped instead. Throws std::runtime_error if the file can not be mapped or is no valid SPIR-V.
+ShaderCode loadShader(const std::string &file, ShaderSource source);
+
+// Creates the module and prints the load and creation time of it
+VkShaderModule createShaderModule(VkDevice device, const ShaderCode &code);
@@ -0,0 +1,41 @@
+#include "SlotAllocator.h"
+
+namespace {
+    uint64_t makeHead(uint64_t oldHead, uint32_t slot) {
+        return (((oldHead >> 32) + 1) << 32) | slot;
+    }
+}
+
+void SlotAllocator::init(uint32_t capacity) {
+    this->capacity = capacity;
+    next.reset(new std::atomic<uint32_t>[capacity]);
+    for (uint32_t i = 0; i < capacity; ++i) {
+        next[i].store(i + 1 < capacity ? i + 1 : invalidSlot, std::memory_order_relaxed);
+    }
+    used.store(0, std::memory_order_relaxed);
+    head.store(capacity > 0 ? 0 : invalidSlot, std::memory_order_release);
+}
+
+uint32_t SlotAllocator::allocate() {
+    uint64_t oldHead = head.load(std::memory_order_acquire);
+    while (true) {
+        uint32_t slot = (uint32_t)oldHead;
+        if (slot == invalidSlot) {
+            return invalidSlot;
+        }
+        // May be stale if another thread popped the slot in between, the exchange fails then
+        uint32_t nextSlot = next[slot].load(std::memory_order_relaxed);
+        if (head.compare_exchange_weak(oldHead, makeHead(oldHead, nextSlot), std::memory_order_acquire, std::memory_order_acquire)) {
+            used.fetch_add(1, std::memory_order_relaxed);
+            return slot;
+        }
+    }
+}
+
+void SlotAllocator::free(uint32_t slot) {
+    uint64_t oldHead = head.load(std::memory_order_relaxed);
+    do {
+        next[slot].store((uint32_t)oldHead, std::memory_order_relaxed);
+    } while (!head.compare_exchange_weak(oldHead, makeHead(oldHead, slot), std::memory_order_release, std::memory_order_relaxed));
+    used.fetch_sub(1, std::memory_order_relaxed);
+}
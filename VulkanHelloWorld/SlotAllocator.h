@@ -0,0 +1,31 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+// Lock-free free list of the indices [0, capacity). The free slots form a stack linked through next,
+// allocate() pops and free() pushes with a compare exchange on the head, so any thread can take or
+// return slots without a mutex. Like RingAllocator it only does the bookkeeping.
+class SlotAllocator {
+public:
+    static const uint32_t invalidSlot = UINT32_MAX;
+
+    // Not thread safe, all slots are free afterwards and handed out from 0 up
+    void init(uint32_t capacity);
+
+    // invalidSlot if all slots are in use
+    uint32_t allocate();
+    void free(uint32_t slot);
+
+    uint32_t getCapacity() const { return capacity; }
+    uint32_t getUsed() const { return used.load(std::memory_order_relaxed); }
+
+private:
+    // Index of the top slot in the low 32 bits and a counter in the high ones. The counter changes with every
+    // exchange, so a thread which read the head before another one popped and pushed the same slot fails (ABA).
+    std::atomic<uint64_t> head{ invalidSlot };
+    std::unique_ptr<std::atomic<uint32_t>[]> next;
+    std::atomic<uint32_t> used{ 0 };
+    uint32_t capacity = 0;
+};
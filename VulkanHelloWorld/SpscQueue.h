@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// Bounded queue for exactly one producer and one consumer thread, neither takes a lock. The producer only
+// writes tail and the consumer only writes head, each with release so the slot contents are visible to
+// the other side. Both keep a copy of the index they do not own and only reload it when the queue looks
+// full or empty, so most calls do not touch the other thread's cache line.
+template <typename T>
+class SpscQueue {
+public:
+    // One slot always stays empty to tell a full queue from an empty one. Call before the threads start.
+    void init(uint32_t capacity) {
+        slots.assign(capacity + 1, T());
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+        cachedHead = 0;
+        cachedTail = 0;
+    }
+
+    // Producer only, false if the queue is full
+    bool tryPush(const T &value) {
+        uint32_t currentTail = tail.load(std::memory_order_relaxed);
+        uint32_t nextTail = next(currentTail);
+        if (nextTail == cachedHead) {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (nextTail == cachedHead) {
+                return false;
+            }
+        }
+        slots[currentTail] = value;
+        tail.store(nextTail, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only, false if the queue is empty
+    bool tryPop(T &value) {
+        uint32_t currentHead = head.load(std::memory_order_relaxed);
+        if (currentHead == cachedTail) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (currentHead == cachedTail) {
+                return false;
+            }
+        }
+        value = slots[currentHead];
+        head.store(next(currentHead), std::memory_order_release);
+        return true;
+    }
+
+    // Exact on the producer and consumer thread as far as their own side is concerned, a snapshot otherwise
+    uint32_t size() const {
+        uint32_t currentTail = tail.load(std::memory_order_acquire);
+        uint32_t currentHead = head.load(std::memory_order_acquire);
+        return currentTail >= currentHead ? currentTail - currentHead : currentTail + (uint32_t)slots.size() - currentHead;
+    }
+    uint32_t getCapacity() const { return (uint32_t)slots.size() - 1; }
+
+private:
+    uint32_t next(uint32_t index) const { return index + 1 == slots.size() ? 0 : index + 1; }
+
+    std::vector<T> slots;
+    // Consumer side
+    alignas(64) std::atomic<uint32_t> head{ 0 }; // next slot to pop
+    uint32_t cachedTail = 0;
+    // Producer side
+    alignas(64) std::atomic<uint32_t> tail{ 0 }; // next slot to push
+    uint32_t cachedHead = 0;
+};
@@ -0,0 +1,378 @@
+#include "StagingUploader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include "VulkanUtils.h"
+
+namespace {
+    // Smallest piece a copy is split into when the contiguous space at the end of the ring runs out
+    const VkDeviceSize minChunkSize = 64 * 1024;
+
+    // Every stage which may read streamed buffers after they arrived on the graphics queue
+    const VkPipelineStageFlags consumerStages = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+        VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    const VkAccessFlags consumerAccess = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+        VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+    VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+        VkPhysicalDeviceMemoryProperties memoryProperties;
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i) {
+            if ((typeFilter & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+                return i;
+            }
+        }
+
+        throw std::runtime_error("Failed to find a suitable memory type!");
+    }
+}
+
+void StagingUploader::init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t transferFamily, uint32_t graphicsFamily, VkDeviceSize ringSize) {
+    this->device = device;
+    this->transferFamily = transferFamily;
+    this->graphicsFamily = graphicsFamily;
+    vkGetDeviceQueue(device, transferFamily, 0, &transferQueue);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    copyAlignment = std::max<VkDeviceSize>(properties.limits.optimalBufferCopyOffsetAlignment, 16);
+    this->ringSize = alignUp(ringSize, copyAlignment);
+
+    // Only the transfer queue reads the staging buffer, so it stays exclusive to its family
+    VkBufferCreateInfo bufferCreateInfo;
+    bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferCreateInfo.pNext = nullptr;
+    bufferCreateInfo.flags = 0;
+    bufferCreateInfo.size = this->ringSize;
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    bufferCreateInfo.queueFamilyIndexCount = 0;
+    bufferCreateInfo.pQueueFamilyIndices = nullptr;
+
+    VkResult result = vkCreateBuffer(device, &bufferCreateInfo, nullptr, &stagingBuffer);
+    ASSERT_VULKAN(result);
+
+    VkMemoryRequirements memoryRequirements;
+    vkGetBufferMemoryRequirements(device, stagingBuffer, &memoryRequirements);
+
+    VkMemoryAllocateInfo memoryAllocateInfo;
+    memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    memoryAllocateInfo.pNext = nullptr;
+    memoryAllocateInfo.allocationSize = memoryRequirements.size;
+    memoryAllocateInfo.memoryTypeIndex = findMemoryType(physicalDevice, memoryRequirements.memoryTypeBits,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    result = vkAllocateMemory(device, &memoryAllocateInfo, nullptr, &stagingMemory);
+    ASSERT_VULKAN(result);
+
+    result = vkBindBufferMemory(device, stagingBuffer, stagingMemory, 0);
+    ASSERT_VULKAN(result);
+
+    // Mapped once for the whole lifetime, coherent memory needs no flushes
+    void *data;
+    result = vkMapMemory(device, stagingMemory, 0, VK_WHOLE_SIZE, 0, &data);
+    ASSERT_VULKAN(result);
+    mapped = static_cast<char*>(data);
+
+    VkCommandPoolCreateInfo commandPoolCreateInfo;
+    commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    commandPoolCreateInfo.pNext = nullptr;
+    commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    commandPoolCreateInfo.queueFamilyIndex = transferFamily;
+
+    result = vkCreateCommandPool(device, &commandPoolCreateInfo, nullptr, &commandPool);
+    ASSERT_VULKAN(result);
+
+    VkCommandBuffer commandBuffers[amountOfBatches];
+    VkCommandBufferAllocateInfo commandBufferAllocateInfo;
+    commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    commandBufferAllocateInfo.pNext = nullptr;
+    commandBufferAllocateInfo.commandPool = commandPool;
+    commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    commandBufferAllocateInfo.commandBufferCount = amountOfBatches;
+
+    result = vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, commandBuffers);
+    ASSERT_VULKAN(result);
+
+    VkFenceCreateInfo fenceCreateInfo;
+    fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fenceCreateInfo.pNext = nullptr;
+    fenceCreateInfo.flags = 0;
+
+    batches.resize(amountOfBatches);
+    for (uint32_t i = 0; i < amountOfBatches; ++i) {
+        batches[i].commandBuffer = commandBuffers[i];
+        batches[i].ticket = 0;
+        batches[i].ringEnd = 0;
+        result = vkCreateFence(device, &fenceCreateInfo, nullptr, &batches[i].fence);
+        ASSERT_VULKAN(result);
+        freeBatches.push_back(i);
+    }
+}
+
+void StagingUploader::destroy() {
+    for (uint32_t index : batchesInFlight) {
+        VkResult result = vkWaitForFences(device, 1, &batches[index].fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+        ASSERT_VULKAN(result);
+    }
+    batchesInFlight.clear();
+
+    for (Batch &batch : batches) {
+        vkDestroyFence(device, batch.fence, nullptr);
+    }
+    batches.clear();
+    freeBatches.clear();
+
+    vkDestroyCommandPool(device, commandPool, nullptr);
+    vkUnmapMemory(device, stagingMemory);
+    vkDestroyBuffer(device, stagingBuffer, nullptr);
+    vkFreeMemory(device, stagingMemory, nullptr);
+}
+
+bool StagingUploader::allocate(VkDeviceSize maxSize, VkDeviceSize &ringOffset, VkDeviceSize &size) {
+    VkDeviceSize minSize = std::min(maxSize, minChunkSize);
+
+    uint64_t position = alignUp(ringHead, copyAlignment);
+    if (position - ringTail >= ringSize) {
+        return false;
+    }
+    VkDeviceSize offset = position % ringSize;
+    VkDeviceSize available = std::min(ringSize - offset, ringSize - (position - ringTail));
+
+    if (available < minSize) {
+        // Skip the rest of the ring and continue at its start
+        position += ringSize - offset;
+        offset = 0;
+        if (position - ringTail >= ringSize) {
+            return false;
+        }
+        available = ringSize - (position - ringTail);
+        if (available < minSize) {
+            return false;
+        }
+    }
+
+    size = std::min(maxSize, available);
+    ringOffset = offset;
+    ringHead = position + size;
+    return true;
+}
+
+bool StagingUploader::beginBatch() {
+    if (recordingBatch >= 0) {
+        return true;
+    }
+    if (freeBatches.empty()) {
+        poll();
+        if (freeBatches.empty()) {
+            return false;
+        }
+    }
+
+    recordingBatch = freeBatches.back();
+    freeBatches.pop_back();
+
+    Batch &batch = batches[recordingBatch];
+    batch.ticket = nextTicket;
+    batch.regions.clear();
+
+    VkCommandBufferBeginInfo commandBufferBeginInfo;
+    commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    commandBufferBeginInfo.pNext = nullptr;
+    commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    commandBufferBeginInfo.pInheritanceInfo = nullptr;
+
+    VkResult result = vkBeginCommandBuffer(batch.commandBuffer, &commandBufferBeginInfo);
+    ASSERT_VULKAN(result);
+    return true;
+}
+
+VkDeviceSize StagingUploader::tryUpload(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void *data, VkDeviceSize size, uint64_t &ticket) {
+    const char *bytes = static_cast<const char*>(data);
+    VkDeviceSize queued = 0;
+
+    while (queued < size && beginBatch()) {
+        VkDeviceSize ringOffset, chunkSize;
+        if (!allocate(size - queued, ringOffset, chunkSize)) {
+            poll();
+            if (!allocate(size - queued, ringOffset, chunkSize)) {
+                break;
+            }
+        }
+
+        std::memcpy(mapped + ringOffset, bytes + queued, chunkSize);
+
+        VkBufferCopy copyRegion;
+        copyRegion.srcOffset = ringOffset;
+        copyRegion.dstOffset = dstOffset + queued;
+        copyRegion.size = chunkSize;
+
+        Batch &batch = batches[recordingBatch];
+        vkCmdCopyBuffer(batch.commandBuffer, stagingBuffer, dstBuffer, 1, &copyRegion);
+
+        // Consecutive chunks of one upload share a single barrier
+        if (!batch.regions.empty() && batch.regions.back().buffer == dstBuffer &&
+            batch.regions.back().offset + batch.regions.back().size == copyRegion.dstOffset) {
+            batch.regions.back().size += chunkSize;
+        } else {
+            batch.regions.push_back(Region{ dstBuffer, copyRegion.dstOffset, chunkSize });
+        }
+
+        queued += chunkSize;
+        ticket = batch.ticket;
+    }
+
+    bytesUploaded += queued;
+    return queued;
+}
+
+uint64_t StagingUploader::upload(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void *data, VkDeviceSize size) {
+    const char *bytes = static_cast<const char*>(data);
+    uint64_t ticket = 0;
+    VkDeviceSize queued = 0;
+
+    while (queued < size) {
+        queued += tryUpload(dstBuffer, dstOffset + queued, bytes + queued, size - queued, ticket);
+        if (queued < size) {
+            flush();
+            waitOldest();
+        }
+    }
+    return ticket;
+}
+
+void StagingUploader::flush() {
+    if (recordingBatch < 0 || batches[recordingBatch].regions.empty()) {
+        return;
+    }
+    Batch &batch = batches[recordingBatch];
+
+    // Release half of the ownership transfer, the graphics queue acquires in recordAcquireBarriers()
+    if (ownershipTransfer()) {
+        std::vector<VkBufferMemoryBarrier> releaseBarriers;
+        for (const Region &region : batch.regions) {
+            VkBufferMemoryBarrier barrier;
+            barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            barrier.pNext = nullptr;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = 0;
+            barrier.srcQueueFamilyIndex = transferFamily;
+            barrier.dstQueueFamilyIndex = graphicsFamily;
+            barrier.buffer = region.buffer;
+            barrier.offset = region.offset;
+            barrier.size = region.size;
+            releaseBarriers.push_back(barrier);
+        }
+        vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+            0, nullptr, (uint32_t)releaseBarriers.size(), releaseBarriers.data(), 0, nullptr);
+    }
+
+    VkResult result = vkEndCommandBuffer(batch.commandBuffer);
+    ASSERT_VULKAN(result);
+
+    VkSubmitInfo submitInfo;
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = nullptr;
+    submitInfo.waitSemaphoreCount = 0;
+    submitInfo.pWaitSemaphores = nullptr;
+    submitInfo.pWaitDstStageMask = nullptr;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &batch.commandBuffer;
+    submitInfo.signalSemaphoreCount = 0;
+    submitInfo.pSignalSemaphores = nullptr;
+
+    result = vkQueueSubmit(transferQueue, 1, &submitInfo, batch.fence);
+    ASSERT_VULKAN(result);
+
+    batch.ringEnd = ringHead;
+    batchesInFlight.push_back(recordingBatch);
+    recordingBatch = -1;
+    ++nextTicket;
+    ++batchesSubmitted;
+}
+
+void StagingUploader::poll() {
+    // Batches retire in submission order so tickets and the ring tail only move forward
+    while (!batchesInFlight.empty() && vkGetFenceStatus(device, batches[batchesInFlight.front()].fence) == VK_SUCCESS) {
+        retireOldest();
+    }
+}
+
+void StagingUploader::retireOldest() {
+    uint32_t index = batchesInFlight.front();
+    batchesInFlight.pop_front();
+
+    Batch &batch = batches[index];
+    ringTail = batch.ringEnd;
+    retiredTicket = batch.ticket;
+    pendingAcquires.insert(pendingAcquires.end(), batch.regions.begin(), batch.regions.end());
+
+    VkResult result = vkResetFences(device, 1, &batch.fence);
+    ASSERT_VULKAN(result);
+    freeBatches.push_back(index);
+}
+
+void StagingUploader::waitOldest() {
+    if (batchesInFlight.empty()) {
+        return;
+    }
+    ++stalls;
+    VkResult result = vkWaitForFences(device, 1, &batches[batchesInFlight.front()].fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+    ASSERT_VULKAN(result);
+    retireOldest();
+}
+
+void StagingUploader::wait(uint64_t ticket) {
+    if (recordingBatch >= 0 && batches[recordingBatch].ticket <= ticket) {
+        flush();
+    }
+    while (retiredTicket < ticket && !batchesInFlight.empty()) {
+        waitOldest();
+    }
+}
+
+void StagingUploader::recordAcquireBarriers(VkCommandBuffer commandBuffer) {
+    if (pendingAcquires.empty()) {
+        acquiredTicket = retiredTicket;
+        return;
+    }
+
+    if (ownershipTransfer()) {
+        std::vector<VkBufferMemoryBarrier> acquireBarriers;
+        for (const Region &region : pendingAcquires) {
+            VkBufferMemoryBarrier barrier;
+            barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            barrier.pNext = nullptr;
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = consumerAccess;
+            barrier.srcQueueFamilyIndex = transferFamily;
+            barrier.dstQueueFamilyIndex = graphicsFamily;
+            barrier.buffer = region.buffer;
+            barrier.offset = region.offset;
+            barrier.size = region.size;
+            acquireBarriers.push_back(barrier);
+        }
+        // The fence of the release batch already signaled, so no semaphore is needed between the queues
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, consumerStages, 0,
+            0, nullptr, (uint32_t)acquireBarriers.size(), acquireBarriers.data(), 0, nullptr);
+    } else {
+        // Same family: one global barrier makes all copies visible
+        VkMemoryBarrier barrier;
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.pNext = nullptr;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = consumerAccess;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, consumerStages, 0,
+            1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    pendingAcquires.clear();
+    acquiredTicket = retiredTicket;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// Streams data into device local buffers through a persistently mapped staging ring.
+// Copies are recorded into batches which are submitted on the transfer queue family
+// (the dedicated DMA family if the device has one) and tracked with one fence per batch.
+// Every upload returns a ticket, tickets complete in order.
+//
+// If the transfer family differs from the graphics family the batches release the buffer
+// ranges and recordAcquireBarriers() acquires them on the graphics queue. Otherwise the same
+// call only makes the transfer writes visible. A range must not be used by the graphics
+// queue while it is uploaded into again.
+//
+// Nothing here is thread safe. When transfer and graphics share a queue, upload from the
+// thread which submits the frames.
+class StagingUploader {
+public:
+    void init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t transferFamily, uint32_t graphicsFamily, VkDeviceSize ringSize);
+    void destroy();
+
+    // Queues as much of the data as fits into the ring without waiting and returns the amount of
+    // bytes queued (0 if the ring is full). 'ticket' is set whenever something was queued.
+    VkDeviceSize tryUpload(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void *data, VkDeviceSize size, uint64_t &ticket);
+    // Queues all data, waits for older batches if the ring is full
+    uint64_t upload(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void *data, VkDeviceSize size);
+
+    // Submits the batch which is being recorded, call once per frame
+    void flush();
+    // Retires batches whose fence signaled, never blocks
+    void poll();
+
+    // Has to be recorded on the graphics queue outside of a render pass before the uploaded data is read
+    void recordAcquireBarriers(VkCommandBuffer commandBuffer);
+
+    // True once the copies finished and their acquire barrier was recorded
+    bool isComplete(uint64_t ticket) const { return ticket <= acquiredTicket; }
+    // Blocks until the copies of the ticket finished, the data is usable after the next recordAcquireBarriers()
+    void wait(uint64_t ticket);
+
+    VkDeviceSize freeSpace() const { return ringSize - (ringHead - ringTail); }
+    bool ownershipTransfer() const { return transferFamily != graphicsFamily; }
+    uint64_t getBytesUploaded() const { return bytesUploaded; }
+    uint64_t getBatchesSubmitted() const { return batchesSubmitted; }
+    uint64_t getStalls() const { return stalls; }
+
+private:
+    struct Region {
+        VkBuffer buffer;
+        VkDeviceSize offset;
+        VkDeviceSize size;
+    };
+
+    struct Batch {
+        VkCommandBuffer commandBuffer;
+        VkFence fence;
+        uint64_t ticket;
+        uint64_t ringEnd; // ring head after the last copy of this batch
+        std::vector<Region> regions;
+    };
+
+    bool allocate(VkDeviceSize maxSize, VkDeviceSize &ringOffset, VkDeviceSize &size);
+    bool beginBatch();
+    void retireOldest();
+    void waitOldest();
+
+    static const uint32_t amountOfBatches = 8;
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkQueue transferQueue = VK_NULL_HANDLE;
+    uint32_t transferFamily = 0;
+    uint32_t graphicsFamily = 0;
+
+    VkBuffer stagingBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory stagingMemory = VK_NULL_HANDLE;
+    char *mapped = nullptr;
+    VkDeviceSize ringSize = 0;
+    VkDeviceSize copyAlignment = 16;
+    // Monotonic byte positions, the ring offset is position % ringSize
+    uint64_t ringHead = 0;
+    uint64_t ringTail = 0;
+
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    std::vector<Batch> batches;
+    std::vector<uint32_t> freeBatches;
+    std::deque<uint32_t> batchesInFlight;
+    int32_t recordingBatch = -1;
+
+    uint64_t nextTicket = 1;
+    uint64_t retiredTicket = 0;
+    uint64_t acquiredTicket = 0;
+    std::vector<Region> pendingAcquires;
+
+    uint64_t bytesUploaded = 0;
+    uint64_t batchesSubmitted = 0;
+    uint64_t stalls = 0;
+};
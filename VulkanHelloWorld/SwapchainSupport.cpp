@@ -0,0 +1,208 @@
+#include "SwapchainSupport.h"
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include "VulkanUtils.h"
+
+namespace {
+    const VkPresentModeKHR lowLatencyModes[] = { VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_FIFO_KHR };
+    const VkPresentModeKHR powerSavingModes[] = { VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_FIFO_KHR };
+
+    std::vector<VkPresentModeKHR> getPresentModes(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface) {
+        uint32_t amountOfPresentModes = 0;
+        VkResult result = vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &amountOfPresentModes, nullptr);
+        ASSERT_VULKAN(result);
+        std::vector<VkPresentModeKHR> presentModes(amountOfPresentModes);
+        result = vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &amountOfPresentModes, presentModes.data());
+        ASSERT_VULKAN(result);
+        return presentModes;
+    }
+
+    bool contains(const std::vector<VkPresentModeKHR> &modes, VkPresentModeKHR mode) {
+        return std::find(modes.begin(), modes.end(), mode) != modes.end();
+    }
+
+    VkPresentModeKHR choosePresentMode(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, PresentPolicy policy, VkPresentModeKHR requestedMode) {
+        std::vector<VkPresentModeKHR> supported = getPresentModes(physicalDevice, surface);
+        if (requestedMode != VK_PRESENT_MODE_MAX_ENUM_KHR) {
+            if (contains(supported, requestedMode)) {
+                return requestedMode;
+            }
+            std::cout << "Present mode " << presentModeName(requestedMode) << " is not supported by the surface, using the policy" << std::endl;
+        }
+
+        if (policy == PresentPolicy::LowLatency) {
+            for (VkPresentModeKHR mode : lowLatencyModes) {
+                if (contains(supported, mode)) {
+                    return mode;
+                }
+            }
+        } else {
+            for (VkPresentModeKHR mode : powerSavingModes) {
+                if (contains(supported, mode)) {
+                    return mode;
+                }
+            }
+        }
+        return VK_PRESENT_MODE_FIFO_KHR;
+    }
+
+    // Keeps the previous format so the render pass stays compatible, otherwise prefers 8 bit UNORM like the offscreen images
+    VkSurfaceFormatKHR chooseSurfaceFormat(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, VkFormat preferredFormat) {
+        uint32_t amountOfFormats = 0;
+        VkResult result = vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &amountOfFormats, nullptr);
+        ASSERT_VULKAN(result);
+        std::vector<VkSurfaceFormatKHR> formats(amountOfFormats);
+        result = vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &amountOfFormats, formats.data());
+        ASSERT_VULKAN(result);
+
+        // A single undefined entry means the surface takes any format
+        if (formats.empty() || (formats.size() == 1 && formats[0].format == VK_FORMAT_UNDEFINED)) {
+            return { preferredFormat, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR };
+        }
+
+        const VkFormat candidates[] = { preferredFormat, VK_FORMAT_B8G8R8A8_UNORM, VK_FORMAT_R8G8B8A8_UNORM };
+        for (VkFormat candidate : candidates) {
+            for (const VkSurfaceFormatKHR &format : formats) {
+                if (format.format == candidate && format.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
+                    return format;
+                }
+            }
+        }
+        return formats[0];
+    }
+
+    // MAILBOX needs one image on screen, one queued and one to render into. The other modes get one more than
+    // the minimum, so acquire does not wait for the presentation engine to give back an image.
+    uint32_t chooseImageCount(const VkSurfaceCapabilitiesKHR &capabilities, VkPresentModeKHR presentMode) {
+        uint32_t imageCount = capabilities.minImageCount + 1;
+        if (presentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
+            imageCount = std::max(imageCount, 3u);
+        }
+        if (capabilities.maxImageCount > 0) { // 0 means no limit
+            imageCount = std::min(imageCount, capabilities.maxImageCount);
+        }
+        return imageCount;
+    }
+
+    VkExtent2D chooseExtent(const VkSurfaceCapabilitiesKHR &capabilities, VkExtent2D windowExtent) {
+        if (capabilities.currentExtent.width != UINT32_MAX) {
+            return capabilities.currentExtent;
+        }
+        VkExtent2D extent;
+        extent.width = std::clamp(windowExtent.width, capabilities.minImageExtent.width, capabilities.maxImageExtent.width);
+        extent.height = std::clamp(windowExtent.height, capabilities.minImageExtent.height, capabilities.maxImageExtent.height);
+        return extent;
+    }
+
+    VkCompositeAlphaFlagBitsKHR chooseCompositeAlpha(const VkSurfaceCapabilitiesKHR &capabilities) {
+        const VkCompositeAlphaFlagBitsKHR candidates[] = { VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR, VK_COMPOSITE_ALPHA_INHERIT_BIT_KHR,
+            VK_COMPOSITE_ALPHA_PRE_MULTIPLIED_BIT_KHR, VK_COMPOSITE_ALPHA_POST_MULTIPLIED_BIT_KHR };
+        for (VkCompositeAlphaFlagBitsKHR candidate : candidates) {
+            if (capabilities.supportedCompositeAlpha & candidate) {
+                return candidate;
+            }
+        }
+        return VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+    }
+}
+
+SwapchainSettings chooseSwapchainSettings(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, PresentPolicy policy,
+    VkPresentModeKHR requestedMode, VkFormat preferredFormat, VkExtent2D windowExtent) {
+    VkSurfaceCapabilitiesKHR capabilities;
+    VkResult result = vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface, &capabilities);
+    ASSERT_VULKAN(result);
+
+    SwapchainSettings settings;
+    settings.surfaceFormat = chooseSurfaceFormat(physicalDevice, surface, preferredFormat);
+    settings.presentMode = choosePresentMode(physicalDevice, surface, policy, requestedMode);
+    settings.minImageCount = chooseImageCount(capabilities, settings.presentMode);
+    settings.extent = chooseExtent(capabilities, windowExtent);
+    settings.preTransform = capabilities.currentTransform; // no rotation by the presentation engine
+    settings.compositeAlpha = chooseCompositeAlpha(capabilities);
+    settings.supportedUsage = capabilities.supportedUsageFlags;
+    return settings;
+}
+
+VkPresentModeKHR nextPresentMode(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, VkPresentModeKHR current) {
+    std::vector<VkPresentModeKHR> supported = getPresentModes(physicalDevice, surface);
+    const VkPresentModeKHR order[] = { VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR };
+    const size_t amountOfModes = sizeof(order) / sizeof(order[0]);
+
+    size_t position = std::find(order, order + amountOfModes, current) - order;
+    for (size_t i = 1; i <= amountOfModes; ++i) {
+        VkPresentModeKHR mode = order[(position + i) % amountOfModes];
+        if (contains(supported, mode)) {
+            return mode;
+        }
+    }
+    return current;
+}
+
+const char *presentModeName(VkPresentModeKHR mode) {
+    switch (mode) {
+    case VK_PRESENT_MODE_IMMEDIATE_KHR: return "IMMEDIATE";
+    case VK_PRESENT_MODE_MAILBOX_KHR: return "MAILBOX";
+    case VK_PRESENT_MODE_FIFO_KHR: return "FIFO";
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "FIFO_RELAXED";
+    default: return "UNKNOWN";
+    }
+}
+
+bool parsePresentMode(const std::string &name, VkPresentModeKHR &mode) {
+    if (name == "immediate") {
+        mode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+    } else if (name == "mailbox") {
+        mode = VK_PRESENT_MODE_MAILBOX_KHR;
+    } else if (name == "fifo") {
+        mode = VK_PRESENT_MODE_FIFO_KHR;
+    } else if (name == "fifo-relaxed") {
+        mode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool parsePresentPolicy(const std::string &name, PresentPolicy &policy) {
+    if (name == "low-latency") {
+        policy = PresentPolicy::LowLatency;
+    } else if (name == "power-saving") {
+        policy = PresentPolicy::PowerSaving;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void PresentStats::Times::add(double acquireTime, double acquireToPresentTime) {
+    ++frames;
+    acquireSum += acquireTime;
+    latencySum += acquireToPresentTime;
+    latencyMax = std::max(latencyMax, acquireToPresentTime);
+}
+
+void PresentStats::record(VkPresentModeKHR mode, double acquireTime, double acquireToPresentTime) {
+    total[mode].add(acquireTime, acquireToPresentTime);
+    interval.add(acquireTime, acquireToPresentTime);
+}
+
+void PresentStats::printReport(VkPresentModeKHR mode) {
+    if (interval.frames == 0) {
+        return;
+    }
+    std::cout << "Present " << presentModeName(mode) << " | acquire avg: " << interval.acquireSum / interval.frames << " ms" <<
+        " | acquire to present avg: " << interval.latencySum / interval.frames << " ms" <<
+        " | max: " << interval.latencyMax << " ms" << std::endl;
+    interval = Times();
+}
+
+void PresentStats::printSummary() const {
+    for (const auto &entry : total) {
+        const Times &times = entry.second;
+        std::cout << "Present " << presentModeName(entry.first) << ": " << times.frames << " frames | acquire avg: " <<
+            times.acquireSum / times.frames << " ms | acquire to present avg: " << times.latencySum / times.frames <<
+            " ms | max: " << times.latencyMax << " ms" << std::endl;
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <map>
+#include <vulkan/vulkan.h>
+
+// LowLatency: MAILBOX, then IMMEDIATE. New frames replace queued ones, the GPU never waits for vblank.
+// PowerSaving: FIFO_RELAXED, then FIFO. Rendering is throttled to the refresh rate.
+// FIFO is the fallback of both since every surface supports it.
+enum class PresentPolicy { LowLatency, PowerSaving };
+
+struct SwapchainSettings {
+    VkSurfaceFormatKHR surfaceFormat = {};
+    VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+    uint32_t minImageCount = 0;
+    VkExtent2D extent = {};
+    VkSurfaceTransformFlagBitsKHR preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
+    VkCompositeAlphaFlagBitsKHR compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+    VkImageUsageFlags supportedUsage = 0; // COLOR_ATTACHMENT is always supported, TRANSFER_SRC usually
+};
+
+// Everything is derived from the current surface capabilities, so call it again for every recreation.
+// requestedMode wins over the policy if the surface supports it, VK_PRESENT_MODE_MAX_ENUM_KHR leaves the choice
+// to the policy. preferredFormat keeps the format of the previous swapchain, windowExtent is used when the
+// surface lets the swapchain decide its size. An extent of 0x0 means the window is minimized.
+SwapchainSettings chooseSwapchainSettings(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, PresentPolicy policy,
+    VkPresentModeKHR requestedMode, VkFormat preferredFormat, VkExtent2D windowExtent);
+
+// The supported present mode after current, wraps around
+VkPresentModeKHR nextPresentMode(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, VkPresentModeKHR current);
+
+const char *presentModeName(VkPresentModeKHR mode);
+// "immediate", "mailbox", "fifo" or "fifo-relaxed"
+bool parsePresentMode(const std::string &name, VkPresentModeKHR &mode);
+// "low-latency" or "power-saving"
+bool parsePresentPolicy(const std::string &name, PresentPolicy &policy);
+
+// CPU side acquire-to-present latency per present mode: from calling vkAcquireNextImageKHR until
+// vkQueuePresentKHR returned. The acquire part is where FIFO throttles the application, so it is
+// tracked separately. Switching the mode at runtime gives a comparison on the same machine.
+class PresentStats {
+public:
+    void record(VkPresentModeKHR mode, double acquireTime, double acquireToPresentTime);
+
+    // Averages since the last report of the current mode
+    void printReport(VkPresentModeKHR mode);
+    // Averages of every mode used during the run
+    void printSummary() const;
+
+private:
+    struct Times {
+        uint64_t frames = 0;
+        double acquireSum = 0.0;
+        double latencySum = 0.0;
+        double latencyMax = 0.0;
+
+        void add(double acquireTime, double acquireToPresentTime);
+    };
+
+    std::map<VkPresentModeKHR, Times> total;
+    Times interval;
+};
@@ -0,0 +1,626 @@
+#include "TextureStreamer.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include "VulkanUtils.h"
+#include "Profiler.h"
+
+namespace {
+    const VkFormat textureFormat = VK_FORMAT_R8G8B8A8_UNORM;
+    const uint32_t decodesPerThread = 4; // requested ahead, so the threads never run dry between two frames
+    const VkDeviceSize uploadAlignment = 16; // a multiple of the texel size, optimal for most copy engines
+
+    VkImageCreateInfo describeImage(uint32_t size, uint32_t levels) {
+        VkImageCreateInfo imageCreateInfo;
+        imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageCreateInfo.pNext = nullptr;
+        imageCreateInfo.flags = 0;
+        imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageCreateInfo.format = textureFormat;
+        imageCreateInfo.extent = { size, size, 1 };
+        imageCreateInfo.mipLevels = levels;
+        imageCreateInfo.arrayLayers = 1;
+        imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        // The next image of the texture copies the resident levels out of this one
+        imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageCreateInfo.queueFamilyIndexCount = 0;
+        imageCreateInfo.pQueueFamilyIndices = nullptr;
+        imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        return imageCreateInfo;
+    }
+
+    VkImageMemoryBarrier describeBarrier(VkImage image, uint32_t levels, VkImageLayout oldLayout, VkImageLayout newLayout,
+        VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask) {
+        VkImageMemoryBarrier barrier;
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.pNext = nullptr;
+        barrier.srcAccessMask = srcAccessMask;
+        barrier.dstAccessMask = dstAccessMask;
+        barrier.oldLayout = oldLayout;
+        barrier.newLayout = newLayout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = levels;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+        return barrier;
+    }
+
+    double toMiB(VkDeviceSize bytes) {
+        return bytes / (1024.0 * 1024.0);
+    }
+}
+
+void TextureStreamer::start(VkDevice device, MemoryAllocator &memoryAllocator, BindlessTable &bindlessTable, uint32_t textureCount,
+    uint32_t textureSize, VkDeviceSize budget, VkDeviceSize uploadPerFrame, uint32_t decodeThreads, uint32_t framesInFlight) {
+    this->device = device;
+    this->memoryAllocator = &memoryAllocator;
+    this->bindlessTable = &bindlessTable;
+    this->textureSize = textureSize;
+    this->budget = budget;
+    this->uploadPerFrame = uploadPerFrame;
+    decodeThreads = std::max(1u, decodeThreads);
+    maxOutstandingDecodes = decodeThreads * decodesPerThread;
+
+    levelCount = 1;
+    while (getLevelSize(levelCount) > 0) {
+        ++levelCount;
+    }
+    tailLevel = 0;
+    while (getLevelSize(tailLevel) > mipTailSize) {
+        ++tailLevel;
+    }
+
+    // Every texture has the same size, so the memory of every possible image is known up front and the budget
+    // can be checked before anything is allocated
+    imageBytes.resize(levelCount);
+    for (uint32_t top = 0; top < levelCount; ++top) {
+        VkImageCreateInfo imageCreateInfo = describeImage(getLevelSize(top), levelCount - top);
+        VkImage image;
+        VkResult result = vkCreateImage(device, &imageCreateInfo, nullptr, &image);
+        ASSERT_VULKAN(result);
+        VkMemoryRequirements memoryRequirements;
+        vkGetImageMemoryRequirements(device, image, &memoryRequirements);
+        imageBytes[top] = memoryRequirements.size;
+        vkDestroyImage(device, image, nullptr);
+    }
+
+    VkSamplerCreateInfo samplerCreateInfo;
+    samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerCreateInfo.pNext = nullptr;
+    samplerCreateInfo.flags = 0;
+    samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+    samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+    samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerCreateInfo.mipLodBias = 0.0f;
+    samplerCreateInfo.anisotropyEnable = VK_FALSE;
+    samplerCreateInfo.maxAnisotropy = 1.0f;
+    samplerCreateInfo.compareEnable = VK_FALSE;
+    samplerCreateInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+    samplerCreateInfo.minLod = 0.0f;
+    samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE; // the view limits the levels
+    samplerCreateInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+    samplerCreateInfo.unnormalizedCoordinates = VK_FALSE;
+    VkResult result = vkCreateSampler(device, &samplerCreateInfo, nullptr, &sampler);
+    ASSERT_VULKAN(result);
+
+    textures = std::vector<Texture>(textureCount);
+    for (Texture &texture : textures) {
+        texture.residentLevel = levelCount;
+        texture.wantedLevel = tailLevel;
+    }
+    retiredImages.assign(framesInFlight, std::vector<Image>());
+
+    stopping = false;
+    for (uint32_t i = 0; i < decodeThreads; ++i) {
+        decoders.emplace_back(&TextureStreamer::decodeLoop, this);
+    }
+
+    std::cout << "Texture streaming: " << textureCount << " textures of " << textureSize << "x" << textureSize << " with " << levelCount <<
+        " levels, mip tail from level " << tailLevel << " | " << toMiB(imageBytes[0]) << " MiB per full chain, " << toMiB(imageBytes[tailLevel]) * 1024.0 <<
+        " KiB per mip tail | budget " << toMiB(budget) << " MiB | " << decodeThreads << " decode threads | " << toMiB(uploadPerFrame) <<
+        " MiB uploads per frame" << std::endl;
+}
+
+void TextureStreamer::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread &decoder : decoders) {
+        decoder.join();
+    }
+    decoders.clear();
+
+    for (Texture &texture : textures) {
+        destroyImage(texture.image);
+        if (texture.transition) {
+            destroyImage(texture.transition->target);
+        }
+    }
+    for (std::vector<Image> &images : retiredImages) {
+        for (Image &image : images) {
+            destroyImage(image);
+        }
+    }
+    printSummary();
+    textures.clear();
+    transitions.clear();
+    retiredImages.clear();
+    vkDestroySampler(device, sampler, nullptr);
+}
+
+void TextureStreamer::setScreenSize(uint32_t texture, float pixels) {
+    textures[texture].screenSize = pixels;
+}
+
+void TextureStreamer::update(uint32_t frame, uint64_t frameNumber) {
+    PROFILE_ZONE("updateTextures");
+    for (Image &image : retiredImages[frame]) {
+        releasingBytes -= image.allocation.size;
+        destroyImage(image);
+    }
+    retiredImages[frame].clear();
+
+    // The level with about one texel per pixel, off screen textures only need their mip tail
+    for (Texture &texture : textures) {
+        if (texture.screenSize > 0.0f) {
+            float level = std::floor(std::log2((float)textureSize / texture.screenSize));
+            texture.wantedLevel = (uint32_t)std::min((float)tailLevel, std::max(0.0f, level));
+            texture.lastVisibleFrame = frameNumber;
+        } else {
+            texture.wantedLevel = tailLevel;
+        }
+    }
+
+    takeDecodes();
+    startTransitions();
+    requestDecodes();
+}
+
+float TextureStreamer::getPriority(const Texture &texture) const {
+    return texture.residentLevel == levelCount ? std::numeric_limits<float>::max() : texture.screenSize;
+}
+
+void TextureStreamer::decodeLoop() {
+    Profiler::setThreadName("Texture decoder");
+
+    while (true) {
+        DecodeRequest request;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this]() { return stopping || !requests.empty(); });
+            if (stopping) {
+                return;
+            }
+            auto next = std::max_element(requests.begin(), requests.end(), [](const DecodeRequest &a, const DecodeRequest &b) {
+                return a.priority < b.priority;
+            });
+            request = *next;
+            requests.erase(next);
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        DecodeResult result;
+        result.texture = request.texture;
+        result.level = request.level;
+        decode(request, result.texels);
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        results.push_back(std::move(result));
+        decodeTimeSum += milliseconds;
+        ++decodeCount;
+    }
+}
+
+// Stands in for reading a compressed texture and transcoding it into the upload format: a checkerboard in a color of
+// its own per texture, with grid lines one texel wide on every level, so the resident level shows on screen.
+// A mip tail request decodes all levels of the tail one after the other.
+void TextureStreamer::decode(const DecodeRequest &request, std::vector<uint8_t> &texels) const {
+    uint32_t lastLevel = request.level == tailLevel ? levelCount - 1 : request.level;
+    VkDeviceSize size = 0;
+    for (uint32_t level = request.level; level <= lastLevel; ++level) {
+        size += getLevelBytes(level);
+    }
+    texels.resize((size_t)size);
+
+    uint32_t hash = (request.texture + 1) * 2654435761u;
+    float color[3] = { 0.4f + (float)((hash >> 8) & 255) / 425.0f, 0.4f + (float)((hash >> 16) & 255) / 425.0f, 0.4f + (float)(hash >> 24) / 425.0f };
+    uint8_t *target = texels.data();
+    for (uint32_t level = request.level; level <= lastLevel; ++level) {
+        uint32_t levelSize = getLevelSize(level);
+        uint32_t cell = std::max(1u, levelSize / 8);
+        for (uint32_t y = 0; y < levelSize; ++y) {
+            for (uint32_t x = 0; x < levelSize; ++x) {
+                bool line = cell > 1 && (x % cell == 0 || y % cell == 0);
+                float shade = line ? 0.2f : (((x / cell) + (y / cell)) & 1) ? 0.6f : 1.0f;
+                target[0] = (uint8_t)(color[0] * shade * 255.0f);
+                target[1] = (uint8_t)(color[1] * shade * 255.0f);
+                target[2] = (uint8_t)(color[2] * shade * 255.0f);
+                target[3] = 255;
+                target += 4;
+            }
+        }
+    }
+}
+
+// The texture expects the next finer level than the resident one, the mip tail if none is resident. Anything else
+// was overtaken by an eviction or a smaller screen size while it was decoded.
+void TextureStreamer::takeDecodes() {
+    std::vector<DecodeResult> finished;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished.swap(results);
+    }
+    for (DecodeResult &result : finished) {
+        Texture &texture = textures[result.texture];
+        texture.decoding = false;
+        uint32_t expected = texture.residentLevel == levelCount ? tailLevel : texture.residentLevel - 1;
+        if (!texture.transition && result.level == expected && result.level >= texture.wantedLevel) {
+            texture.decoded = std::move(result.texels);
+            texture.decodedLevel = result.level;
+        } else {
+            --outstandingDecodes;
+            ++discardedDecodes;
+        }
+    }
+}
+
+// Decoded levels become transitions by priority as long as the budget allows. The mip tails are the minimum every
+// texture needs and are never held back, the levels above them wait until evictions made room.
+void TextureStreamer::startTransitions() {
+    std::vector<uint32_t> waiting;
+    for (uint32_t i = 0; i < textures.size(); ++i) {
+        if (!textures[i].decoded.empty()) {
+            waiting.push_back(i);
+        }
+    }
+    std::sort(waiting.begin(), waiting.end(), [this](uint32_t a, uint32_t b) { return getPriority(textures[a]) > getPriority(textures[b]); });
+
+    for (uint32_t i : waiting) {
+        Texture &texture = textures[i];
+        bool tail = texture.residentLevel == levelCount;
+        if (!tail && texture.decodedLevel < texture.wantedLevel) {
+            texture.decoded.clear();
+            --outstandingDecodes;
+            ++discardedDecodes;
+            continue;
+        }
+        VkDeviceSize needed = imageBytes[texture.decodedLevel];
+        if (!tail && allocatedBytes + needed > budget) {
+            // Either nothing can be evicted for it, or the evicted images are not released yet. Less important
+            // textures do not get ahead of it in the meantime.
+            evict(needed);
+            break;
+        }
+        beginTransition(i, texture.decodedLevel);
+    }
+}
+
+// Starts dropping levels of the least recently visible textures until needed bytes are within the budget once those
+// transitions finished and their images were released. Visible textures only give up levels they do not need.
+bool TextureStreamer::evict(VkDeviceSize needed) {
+    while (allocatedBytes - releasingBytes + needed > budget) {
+        uint32_t victim = UINT32_MAX;
+        for (uint32_t i = 0; i < textures.size(); ++i) {
+            const Texture &candidate = textures[i];
+            if (candidate.transition || candidate.residentLevel >= candidate.wantedLevel) {
+                continue;
+            }
+            if (victim == UINT32_MAX || candidate.lastVisibleFrame < textures[victim].lastVisibleFrame ||
+                (candidate.lastVisibleFrame == textures[victim].lastVisibleFrame && candidate.screenSize < textures[victim].screenSize)) {
+                victim = i;
+            }
+        }
+        if (victim == UINT32_MAX) {
+            return false;
+        }
+        beginTransition(victim, textures[victim].wantedLevel);
+    }
+    return true;
+}
+
+// Textures without mip tail come first, then the ones wanting a finer level by screen size. Few requests are queued
+// at a time, so a texture which grew on screen does not wait behind a long queue of ones which shrank meanwhile.
+void TextureStreamer::requestDecodes() {
+    std::vector<uint32_t> candidates;
+    for (uint32_t i = 0; i < textures.size(); ++i) {
+        const Texture &texture = textures[i];
+        if (texture.decoding || !texture.decoded.empty() || texture.transition) {
+            continue;
+        }
+        if (texture.residentLevel == levelCount || texture.wantedLevel < texture.residentLevel) {
+            candidates.push_back(i);
+        }
+    }
+    size_t count = std::min<size_t>(candidates.size(), maxOutstandingDecodes - std::min(maxOutstandingDecodes, outstandingDecodes));
+    std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(), [this](uint32_t a, uint32_t b) {
+        return getPriority(textures[a]) > getPriority(textures[b]);
+    });
+
+    auto now = std::chrono::high_resolution_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        // Queued requests follow the screen sizes of this frame
+        for (DecodeRequest &request : requests) {
+            request.priority = getPriority(textures[request.texture]);
+        }
+        for (size_t i = 0; i < count; ++i) {
+            Texture &texture = textures[candidates[i]];
+            DecodeRequest request;
+            request.texture = candidates[i];
+            request.level = texture.residentLevel == levelCount ? tailLevel : texture.residentLevel - 1;
+            request.priority = getPriority(texture);
+            requests.push_back(request);
+            texture.decoding = true;
+            texture.requestTime = now;
+            ++outstandingDecodes;
+        }
+    }
+    if (count > 0) {
+        wake.notify_all();
+    }
+}
+
+// The decoded texels move into the transition if they are its top level, a texture without them drops levels
+void TextureStreamer::beginTransition(uint32_t texture, uint32_t topLevel) {
+    Texture &target = textures[texture];
+    std::unique_ptr<Transition> transition(new Transition());
+    transition->topLevel = topLevel;
+    if (!target.decoded.empty()) {
+        // An eviction of a texture whose decode still waits for the budget, the finer level is not wanted anymore
+        if (topLevel == target.decodedLevel) {
+            transition->texels = std::move(target.decoded);
+        } else {
+            ++discardedDecodes;
+        }
+        target.decoded.clear();
+        --outstandingDecodes;
+    }
+    createImage(topLevel, transition->target);
+    if (target.image.image != VK_NULL_HANDLE) {
+        releasingBytes += target.image.allocation.size;
+    }
+    target.transition = std::move(transition);
+    transitions.push_back(texture);
+}
+
+void TextureStreamer::createImage(uint32_t topLevel, Image &image) {
+    VkImageCreateInfo imageCreateInfo = describeImage(getLevelSize(topLevel), levelCount - topLevel);
+    memoryAllocator->createImage(imageCreateInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image.image, image.allocation);
+    allocatedBytes += image.allocation.size;
+    peakAllocatedBytes = std::max(peakAllocatedBytes, allocatedBytes);
+
+    VkImageViewCreateInfo imageViewCreateInfo;
+    imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    imageViewCreateInfo.pNext = nullptr;
+    imageViewCreateInfo.flags = 0;
+    imageViewCreateInfo.image = image.image;
+    imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    imageViewCreateInfo.format = textureFormat;
+    imageViewCreateInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+    imageViewCreateInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+    imageViewCreateInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+    imageViewCreateInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+    imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
+    imageViewCreateInfo.subresourceRange.levelCount = imageCreateInfo.mipLevels;
+    imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
+    imageViewCreateInfo.subresourceRange.layerCount = 1;
+
+    VkResult result = vkCreateImageView(device, &imageViewCreateInfo, nullptr, &image.view);
+    ASSERT_VULKAN(result);
+}
+
+void TextureStreamer::destroyImage(Image &image) {
+    if (image.image == VK_NULL_HANDLE) {
+        return;
+    }
+    if (image.slot != SlotAllocator::invalidSlot) {
+        bindlessTable->removeImage(image.slot);
+        image.slot = SlotAllocator::invalidSlot;
+    }
+    vkDestroyImageView(device, image.view, nullptr);
+    image.view = VK_NULL_HANDLE;
+    allocatedBytes -= image.allocation.size;
+    memoryAllocator->destroyImage(image.image, image.allocation);
+}
+
+void TextureStreamer::recordUploads(VkCommandBuffer commandBuffer, uint32_t frame) {
+    PROFILE_ZONE("recordTextureUploads");
+    VkDeviceSize uploadBudget = uploadPerFrame;
+    for (size_t i = 0; i < transitions.size();) {
+        uint32_t texture = transitions[i];
+        if (recordTransition(commandBuffer, texture, uploadBudget)) {
+            finishTransition(commandBuffer, texture, frame);
+            transitions.erase(transitions.begin() + i);
+        } else {
+            ++i;
+        }
+    }
+}
+
+// Copies the next slice of rows of the new top level, or the whole mip tail at once. True once all texels are in
+// the image, which is right away for dropped levels.
+bool TextureStreamer::recordTransition(VkCommandBuffer commandBuffer, uint32_t texture, VkDeviceSize &uploadBudget) {
+    Transition &transition = *textures[texture].transition;
+    if (!transition.initialized) {
+        VkImageMemoryBarrier toTransfer = describeBarrier(transition.target.image, levelCount - transition.topLevel, VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT);
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr,
+            1, &toTransfer);
+        transition.initialized = true;
+    }
+    if (transition.texels.empty()) {
+        return true;
+    }
+
+    bool tail = transition.topLevel == tailLevel;
+    uint32_t levelSize = getLevelSize(transition.topLevel);
+    VkDeviceSize rowBytes = (VkDeviceSize)levelSize * 4;
+    uint32_t rows = tail ? levelSize : (uint32_t)std::min<VkDeviceSize>(levelSize - transition.uploadedRows, uploadBudget / rowBytes);
+    VkDeviceSize size = tail ? (VkDeviceSize)transition.texels.size() : rows * rowBytes;
+    TransientAllocation staging;
+    if (rows == 0 || size > uploadBudget || !memoryAllocator->allocateTransient(size, uploadAlignment, staging)) {
+        return false;
+    }
+    std::memcpy(staging.mapped, transition.texels.data() + transition.uploadedRows * rowBytes, (size_t)size);
+
+    // One region per level of the tail, a band of rows of the top level otherwise
+    std::vector<VkBufferImageCopy> regions;
+    uint32_t lastLevel = tail ? levelCount - 1 : transition.topLevel;
+    VkDeviceSize bufferOffset = staging.offset;
+    for (uint32_t level = transition.topLevel; level <= lastLevel; ++level) {
+        VkBufferImageCopy region;
+        region.bufferOffset = bufferOffset;
+        region.bufferRowLength = 0; // tightly packed
+        region.bufferImageHeight = 0;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = level - transition.topLevel;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = { 0, (int32_t)transition.uploadedRows, 0 };
+        region.imageExtent = { getLevelSize(level), tail ? getLevelSize(level) : rows, 1 };
+        regions.push_back(region);
+        bufferOffset += getLevelBytes(level);
+    }
+    vkCmdCopyBufferToImage(commandBuffer, staging.buffer, transition.target.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t)regions.size(),
+        regions.data());
+
+    uploadBudget -= size;
+    uploadedBytes += size;
+    totalUploadedBytes += size;
+    transition.uploadedRows += rows;
+    if (transition.uploadedRows < levelSize) {
+        return false;
+    }
+    transition.texels = std::vector<uint8_t>();
+    return true;
+}
+
+// Copies the levels both images have, makes the new image readable and swaps the slots. Frames in flight still
+// sample the old slot, so it is released with the image once this frame finished.
+void TextureStreamer::finishTransition(VkCommandBuffer commandBuffer, uint32_t texture, uint32_t frame) {
+    Texture &target = textures[texture];
+    Transition &transition = *target.transition;
+    uint32_t newLevels = levelCount - transition.topLevel;
+
+    if (target.image.image != VK_NULL_HANDLE) {
+        uint32_t oldLevels = levelCount - target.residentLevel;
+        VkImageMemoryBarrier toSource = describeBarrier(target.image.image, oldLevels, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, 0, VK_ACCESS_TRANSFER_READ_BIT);
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr,
+            1, &toSource);
+
+        std::vector<VkImageCopy> regions;
+        for (uint32_t level = std::max(target.residentLevel, transition.topLevel); level < levelCount; ++level) {
+            VkImageCopy region;
+            region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.srcSubresource.mipLevel = level - target.residentLevel;
+            region.srcSubresource.baseArrayLayer = 0;
+            region.srcSubresource.layerCount = 1;
+            region.srcOffset = { 0, 0, 0 };
+            region.dstSubresource = region.srcSubresource;
+            region.dstSubresource.mipLevel = level - transition.topLevel;
+            region.dstOffset = { 0, 0, 0 };
+            region.extent = { getLevelSize(level), getLevelSize(level), 1 };
+            regions.push_back(region);
+        }
+        vkCmdCopyImage(commandBuffer, target.image.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, transition.target.image,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t)regions.size(), regions.data());
+    }
+
+    VkImageMemoryBarrier toShader = describeBarrier(transition.target.image, newLevels, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr,
+        1, &toShader);
+
+    transition.target.slot = bindlessTable->addImage(transition.target.view, sampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    if (transition.target.slot == SlotAllocator::invalidSlot) {
+        throw std::runtime_error("Bindless table is full");
+    }
+
+    // From the request of the decode to the first frame which samples the level
+    if (transition.topLevel < target.residentLevel) {
+        double latency = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - target.requestTime).count();
+        latencySum += latency;
+        latencyMax = std::max(latencyMax, latency);
+        totalLatencySum += latency;
+        totalLatencyMax = std::max(totalLatencyMax, latency);
+        ++streamedLevels;
+        if (target.residentLevel == levelCount) {
+            ++totalTails;
+        } else {
+            ++totalStreamedLevels;
+        }
+    } else {
+        ++evictions;
+        ++totalEvictions;
+    }
+
+    if (target.image.image != VK_NULL_HANDLE) {
+        retiredImages[frame].push_back(target.image);
+    }
+    target.image = transition.target;
+    target.residentLevel = transition.topLevel;
+    target.transition.reset();
+}
+
+void TextureStreamer::printReport() {
+    uint64_t decodes;
+    double decodeTime;
+    size_t queued;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        decodes = decodeCount;
+        decodeTime = decodeTimeSum;
+        queued = requests.size();
+        decodeCount = 0;
+        decodeTimeSum = 0.0;
+    }
+
+    uint32_t tails = 0;
+    uint32_t visible = 0;
+    uint32_t sharp = 0;
+    for (const Texture &texture : textures) {
+        tails += texture.residentLevel < levelCount ? 1 : 0;
+        if (texture.screenSize > 0.0f) {
+            ++visible;
+            sharp += texture.residentLevel <= texture.wantedLevel ? 1 : 0;
+        }
+    }
+
+    std::cout << "Texture streaming: " << sharp << "/" << visible << " visible textures at their wanted level | " << tails << "/" << textures.size() <<
+        " mip tails | budget " << toMiB(allocatedBytes) << " of " << toMiB(budget) << " MiB (" << toMiB(releasingBytes) << " MiB releasing) | streamed " <<
+        streamedLevels << " levels, latency avg " << (streamedLevels > 0 ? latencySum / streamedLevels : 0.0) << " ms, max " << latencyMax <<
+        " ms | evicted " << evictions << " | uploaded " << toMiB(uploadedBytes) << " MiB | decoded " << decodes << ", avg " <<
+        (decodes > 0 ? decodeTime / decodes : 0.0) << " ms, " << queued << " queued, " << discardedDecodes << " discarded" << std::endl;
+
+    streamedLevels = 0;
+    evictions = 0;
+    discardedDecodes = 0;
+    uploadedBytes = 0;
+    latencySum = 0.0;
+    latencyMax = 0.0;
+}
+
+void TextureStreamer::printSummary() const {
+    uint64_t loads = totalTails + totalStreamedLevels;
+    std::cout << "Texture streaming: " << totalTails << " mip tails and " << totalStreamedLevels << " levels streamed in, latency avg " <<
+        (loads > 0 ? totalLatencySum / loads : 0.0) << " ms, max " << totalLatencyMax << " ms | " << totalEvictions << " evictions | " <<
+        toMiB(totalUploadedBytes) << " MiB uploaded | peak " << toMiB(peakAllocatedBytes) << " of " << toMiB(budget) << " MiB budget" << std::endl;
+}
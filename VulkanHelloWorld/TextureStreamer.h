@@ -0,0 +1,148 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "BindlessTable.h"
+#include "MemoryAllocator.h"
+
+// Streams the mip levels of square RGBA8 textures into device local images under a memory budget. Every texture
+// first gets its packed mip tail (all levels of mipTailSize texels and below), then one finer level at a time
+// while the screen size set each frame asks for it. Levels are decoded on a pool of threads, the larger on-screen
+// size first, and copied from the frame ring of the memory allocator in slices of rows, at most uploadPerFrame bytes
+// per frame. Vulkan 1.0 has no way to add levels to an image without sparse residency, so a residency change
+// creates an image with the new range of levels, copies the resident ones over on the GPU and swaps the bindless
+// slots in the same frame. The old image is destroyed once that frame finished. When the budget is exhausted, the
+// least recently visible textures drop back to the level they need, their mip tail if they are off screen.
+class TextureStreamer {
+public:
+    static const uint32_t mipTailSize = 64;
+
+    // Needs the frame ring of memoryAllocator with TRANSFER_SRC usage and a bindless table
+    void start(VkDevice device, MemoryAllocator &memoryAllocator, BindlessTable &bindlessTable, uint32_t textureCount, uint32_t textureSize,
+        VkDeviceSize budget, VkDeviceSize uploadPerFrame, uint32_t decodeThreads, uint32_t framesInFlight);
+    // Call once no frame in flight uses the textures anymore
+    void stop();
+
+    // Edge length in pixels the texture covers this frame, 0 if it is not visible
+    void setScreenSize(uint32_t texture, float pixels);
+    // Call after the fence of the frame slot signaled and after the screen sizes were set: destroys the images the
+    // slot's last frame replaced, takes the decoded levels and decides what to decode, upload and evict
+    void update(uint32_t frame, uint64_t frameNumber);
+    // Before the render pass: upload slices, mip copies and layout transitions, then swaps the slots of the finished
+    // textures, so the draws recorded afterwards already sample the new images
+    void recordUploads(VkCommandBuffer commandBuffer, uint32_t frame);
+
+    // Bindless image slot of the resident levels, SlotAllocator::invalidSlot until the mip tail is resident
+    uint32_t getSlot(uint32_t texture) const { return textures[texture].image.slot; }
+
+    // Residency, budget usage, stream-in latency and decode times since the last report
+    void printReport();
+    void printSummary() const;
+
+private:
+    struct Image {
+        VkImage image = VK_NULL_HANDLE;
+        Allocation allocation;
+        VkImageView view = VK_NULL_HANDLE;
+        uint32_t slot = SlotAllocator::invalidSlot;
+    };
+
+    // A new image for the texture which replaces the current one once its levels are uploaded and copied
+    struct Transition {
+        Image target;
+        uint32_t topLevel = 0;
+        std::vector<uint8_t> texels; // the mip tail or the new top level, empty when levels are dropped
+        uint32_t uploadedRows = 0;
+        bool initialized = false; // in TRANSFER_DST_OPTIMAL
+    };
+
+    struct Texture {
+        Image image;
+        uint32_t residentLevel = 0; // finest level in the image, levelCount without image
+        uint32_t wantedLevel = 0;
+        float screenSize = 0.0f;
+        uint64_t lastVisibleFrame = 0;
+        bool decoding = false;
+        std::vector<uint8_t> decoded; // finished decode of the next finer level, waiting for the budget
+        uint32_t decodedLevel = 0;
+        std::unique_ptr<Transition> transition;
+        std::chrono::high_resolution_clock::time_point requestTime; // of the level streaming in
+    };
+
+    struct DecodeRequest {
+        uint32_t texture;
+        uint32_t level; // the top level of the mip tail for a tail request
+        float priority;
+    };
+
+    struct DecodeResult {
+        uint32_t texture;
+        uint32_t level;
+        std::vector<uint8_t> texels;
+    };
+
+    uint32_t getLevelSize(uint32_t level) const { return textureSize >> level; }
+    VkDeviceSize getLevelBytes(uint32_t level) const { return (VkDeviceSize)getLevelSize(level) * getLevelSize(level) * 4; }
+    float getPriority(const Texture &texture) const;
+
+    void decodeLoop();
+    void decode(const DecodeRequest &request, std::vector<uint8_t> &texels) const;
+    void requestDecodes();
+    void takeDecodes();
+    void startTransitions();
+    bool evict(VkDeviceSize needed);
+    void beginTransition(uint32_t texture, uint32_t topLevel);
+    void createImage(uint32_t topLevel, Image &image);
+    void destroyImage(Image &image);
+    bool recordTransition(VkCommandBuffer commandBuffer, uint32_t texture, VkDeviceSize &uploadBudget);
+    void finishTransition(VkCommandBuffer commandBuffer, uint32_t texture, uint32_t frame);
+
+    VkDevice device = VK_NULL_HANDLE;
+    MemoryAllocator *memoryAllocator = nullptr;
+    BindlessTable *bindlessTable = nullptr;
+    VkSampler sampler = VK_NULL_HANDLE;
+    uint32_t textureSize = 0;
+    uint32_t levelCount = 0;
+    uint32_t tailLevel = 0; // first level of the mip tail
+    VkDeviceSize budget = 0;
+    VkDeviceSize uploadPerFrame = 0;
+    uint32_t maxOutstandingDecodes = 0;
+    std::vector<VkDeviceSize> imageBytes; // memory of an image with levels [top, levelCount), by top level
+
+    std::vector<Texture> textures;
+    std::vector<uint32_t> transitions; // textures with a transition, in the order they started
+    std::vector<std::vector<Image>> retiredImages; // per frame slot, destroyed when its fence signaled
+    VkDeviceSize allocatedBytes = 0; // every image including transitions and retired ones
+    VkDeviceSize releasingBytes = 0; // images which are destroyed once a transition finished and its frame is done
+    uint32_t outstandingDecodes = 0; // requested or decoded but not uploaded yet
+
+    std::vector<std::thread> decoders;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<DecodeRequest> requests; // guarded by mutex
+    std::vector<DecodeResult> results; // guarded by mutex
+    bool stopping = false; // guarded by mutex
+    double decodeTimeSum = 0.0; // guarded by mutex
+    uint64_t decodeCount = 0; // guarded by mutex
+
+    // Render thread counters since the last report
+    uint64_t streamedLevels = 0;
+    uint64_t evictions = 0;
+    uint64_t discardedDecodes = 0; // the texture did not want the level anymore when it was decoded
+    VkDeviceSize uploadedBytes = 0;
+    double latencySum = 0.0;
+    double latencyMax = 0.0;
+    uint64_t totalStreamedLevels = 0;
+    uint64_t totalEvictions = 0;
+    uint64_t totalTails = 0;
+    VkDeviceSize totalUploadedBytes = 0;
+    VkDeviceSize peakAllocatedBytes = 0;
+    double totalLatencySum = 0.0;
+    double totalLatencyMax = 0.0;
+};
@@ -0,0 +1,237 @@
+#include "TlsfAllocator.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+    uint32_t lowestBit(uint64_t value) {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward64(&index, value);
+        return index;
+#else
+        return (uint32_t)__builtin_ctzll(value);
+#endif
+    }
+
+    uint32_t highestBit(uint64_t value) {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        return index;
+#else
+        return 63 - (uint32_t)__builtin_clzll(value);
+#endif
+    }
+
+    VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+void TlsfAllocator::init(VkDeviceSize capacity) {
+    this->capacity = capacity;
+    used = 0;
+    allocationCount = 0;
+    nodes.clear();
+    unusedNodes.clear();
+
+    firstLevelBitmap = 0;
+    for (uint32_t i = 0; i < firstLevelCount; ++i) {
+        secondLevelBitmaps[i] = 0;
+        for (uint32_t j = 0; j < secondLevelCount; ++j) {
+            freeHeads[i][j] = invalidHandle;
+        }
+    }
+
+    uint32_t index = newNode();
+    nodes[index] = Node{ 0, capacity, invalidHandle, invalidHandle, invalidHandle, invalidHandle, true };
+    insertFree(index);
+}
+
+// Sizes below 16 get one class each, above that every power of two is split into 16 classes
+void TlsfAllocator::mapping(VkDeviceSize size, uint32_t &firstLevel, uint32_t &secondLevel) {
+    if (size < secondLevelCount) {
+        firstLevel = 0;
+        secondLevel = (uint32_t)size;
+        return;
+    }
+    uint32_t log2 = highestBit(size);
+    firstLevel = log2 - secondLevelBits + 1;
+    secondLevel = (uint32_t)(size >> (log2 - secondLevelBits)) ^ secondLevelCount;
+}
+
+uint32_t TlsfAllocator::findFree(VkDeviceSize size) const {
+    // Round up to the next class so every range of the found class is large enough
+    if (size >= secondLevelCount) {
+        size += (1ull << (highestBit(size) - secondLevelBits)) - 1;
+    }
+    uint32_t firstLevel, secondLevel;
+    mapping(size, firstLevel, secondLevel);
+    if (firstLevel >= firstLevelCount) {
+        return invalidHandle;
+    }
+
+    uint32_t secondLevelMap = secondLevelBitmaps[firstLevel] & (~0u << secondLevel);
+    if (secondLevelMap == 0) {
+        uint64_t firstLevelMap = firstLevel + 1 < 64 ? firstLevelBitmap & (~0ull << (firstLevel + 1)) : 0;
+        if (firstLevelMap == 0) {
+            return invalidHandle;
+        }
+        firstLevel = lowestBit(firstLevelMap);
+        secondLevelMap = secondLevelBitmaps[firstLevel];
+    }
+    return freeHeads[firstLevel][lowestBit(secondLevelMap)];
+}
+
+void TlsfAllocator::insertFree(uint32_t index) {
+    uint32_t firstLevel, secondLevel;
+    mapping(nodes[index].size, firstLevel, secondLevel);
+
+    uint32_t head = freeHeads[firstLevel][secondLevel];
+    nodes[index].free = true;
+    nodes[index].prevFree = invalidHandle;
+    nodes[index].nextFree = head;
+    if (head != invalidHandle) {
+        nodes[head].prevFree = index;
+    }
+    freeHeads[firstLevel][secondLevel] = index;
+
+    firstLevelBitmap |= 1ull << firstLevel;
+    secondLevelBitmaps[firstLevel] |= 1u << secondLevel;
+}
+
+void TlsfAllocator::removeFree(uint32_t index) {
+    uint32_t firstLevel, secondLevel;
+    mapping(nodes[index].size, firstLevel, secondLevel);
+
+    Node &node = nodes[index];
+    if (node.prevFree != invalidHandle) {
+        nodes[node.prevFree].nextFree = node.nextFree;
+    } else {
+        freeHeads[firstLevel][secondLevel] = node.nextFree;
+    }
+    if (node.nextFree != invalidHandle) {
+        nodes[node.nextFree].prevFree = node.prevFree;
+    }
+    node.free = false;
+
+    if (freeHeads[firstLevel][secondLevel] == invalidHandle) {
+        secondLevelBitmaps[firstLevel] &= ~(1u << secondLevel);
+        if (secondLevelBitmaps[firstLevel] == 0) {
+            firstLevelBitmap &= ~(1ull << firstLevel);
+        }
+    }
+}
+
+uint32_t TlsfAllocator::newNode() {
+    if (!unusedNodes.empty()) {
+        uint32_t index = unusedNodes.back();
+        unusedNodes.pop_back();
+        return index;
+    }
+    nodes.push_back(Node());
+    return (uint32_t)nodes.size() - 1;
+}
+
+void TlsfAllocator::releaseNode(uint32_t index) {
+    unusedNodes.push_back(index);
+}
+
+uint32_t TlsfAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &offset) {
+    if (size == 0) {
+        size = 1;
+    }
+    if (alignment == 0) {
+        alignment = 1;
+    }
+    // Search for enough space to align any range of the class
+    uint32_t index = findFree(size + alignment - 1);
+    if (index == invalidHandle) {
+        return invalidHandle;
+    }
+    removeFree(index);
+
+    // Nodes may move when new ones are added, so they are accessed by index only
+    VkDeviceSize alignedOffset = alignUp(nodes[index].offset, alignment);
+    VkDeviceSize padding = alignedOffset - nodes[index].offset;
+    if (padding > 0) {
+        // The physical neighbours of a free range are never free, so the padding cannot be merged
+        uint32_t front = newNode();
+        uint32_t prev = nodes[index].prevPhysical;
+        nodes[front] = Node{ nodes[index].offset, padding, prev, index, invalidHandle, invalidHandle, true };
+        if (prev != invalidHandle) {
+            nodes[prev].nextPhysical = front;
+        }
+        nodes[index].prevPhysical = front;
+        nodes[index].offset = alignedOffset;
+        nodes[index].size -= padding;
+        insertFree(front);
+    }
+
+    if (nodes[index].size > size) {
+        uint32_t back = newNode();
+        uint32_t next = nodes[index].nextPhysical;
+        nodes[back] = Node{ alignedOffset + size, nodes[index].size - size, index, next, invalidHandle, invalidHandle, true };
+        if (next != invalidHandle) {
+            nodes[next].prevPhysical = back;
+        }
+        nodes[index].nextPhysical = back;
+        nodes[index].size = size;
+        insertFree(back);
+    }
+
+    used += size;
+    ++allocationCount;
+    offset = alignedOffset;
+    return index;
+}
+
+void TlsfAllocator::free(uint32_t handle) {
+    uint32_t index = handle;
+    used -= nodes[index].size;
+    --allocationCount;
+
+    uint32_t prev = nodes[index].prevPhysical;
+    if (prev != invalidHandle && nodes[prev].free) {
+        removeFree(prev);
+        nodes[prev].size += nodes[index].size;
+        nodes[prev].nextPhysical = nodes[index].nextPhysical;
+        if (nodes[index].nextPhysical != invalidHandle) {
+            nodes[nodes[index].nextPhysical].prevPhysical = prev;
+        }
+        releaseNode(index);
+        index = prev;
+    }
+
+    uint32_t next = nodes[index].nextPhysical;
+    if (next != invalidHandle && nodes[next].free) {
+        removeFree(next);
+        nodes[index].size += nodes[next].size;
+        nodes[index].nextPhysical = nodes[next].nextPhysical;
+        if (nodes[next].nextPhysical != invalidHandle) {
+            nodes[nodes[next].nextPhysical].prevPhysical = index;
+        }
+        releaseNode(next);
+    }
+
+    insertFree(index);
+}
+
+VkDeviceSize TlsfAllocator::largestFreeRange() const {
+    if (firstLevelBitmap == 0) {
+        return 0;
+    }
+    // The largest range is in the highest non-empty class, which is not sorted by size
+    uint32_t firstLevel = highestBit(firstLevelBitmap);
+    uint32_t secondLevel = highestBit(secondLevelBitmaps[firstLevel]);
+
+    VkDeviceSize largest = 0;
+    for (uint32_t index = freeHeads[firstLevel][secondLevel]; index != invalidHandle; index = nodes[index].nextFree) {
+        if (nodes[index].size > largest) {
+            largest = nodes[index].size;
+        }
+    }
+    return largest;
+}
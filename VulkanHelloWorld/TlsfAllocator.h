@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// Two level segregated fit allocator which manages ranges of one memory block. It only keeps
+// the bookkeeping on the CPU, so it never touches device memory and can be tested on its own.
+// Allocating and freeing are O(1): free ranges are sorted into size classes (power of two
+// ranges split into 16 linear steps) and two bitmaps find the smallest non-empty class.
+// Neighbouring free ranges are merged immediately.
+class TlsfAllocator {
+public:
+    static const uint32_t invalidHandle = UINT32_MAX;
+
+    void init(VkDeviceSize capacity);
+
+    // Returns invalidHandle if no free range is large enough
+    uint32_t allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &offset);
+    void free(uint32_t handle);
+
+    VkDeviceSize getCapacity() const { return capacity; }
+    VkDeviceSize getUsed() const { return used; }
+    uint32_t getAllocationCount() const { return allocationCount; }
+    bool isEmpty() const { return allocationCount == 0; }
+    VkDeviceSize largestFreeRange() const;
+
+private:
+    struct Node {
+        VkDeviceSize offset;
+        VkDeviceSize size;
+        uint32_t prevPhysical;
+        uint32_t nextPhysical;
+        uint32_t prevFree;
+        uint32_t nextFree;
+        bool free;
+    };
+
+    static const uint32_t secondLevelBits = 4;
+    static const uint32_t secondLevelCount = 1 << secondLevelBits;
+    static const uint32_t firstLevelCount = 64 - secondLevelBits + 1;
+
+    static void mapping(VkDeviceSize size, uint32_t &firstLevel, uint32_t &secondLevel);
+    uint32_t findFree(VkDeviceSize size) const;
+    void insertFree(uint32_t index);
+    void removeFree(uint32_t index);
+    uint32_t newNode();
+    void releaseNode(uint32_t index);
+
+    VkDeviceSize capacity = 0;
+    VkDeviceSize used = 0;
+    uint32_t allocationCount = 0;
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> unusedNodes;
+
+    uint64_t firstLevelBitmap = 0;
+    uint32_t secondLevelBitmaps[firstLevelCount];
+    uint32_t freeHeads[firstLevelCount][secondLevelCount];
+};
@@ -0,0 +1,128 @@
+#include "TransformBench.h"
+
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <glm/gtc/matrix_transform.hpp>
+#include "TransformStore.h"
+#include "JobScheduler.h"
+
+namespace {
+    // About 10M transforms are updated per measurement, so small counts are repeated
+    const size_t transformsPerMeasurement = 10000000;
+    const size_t amountOfSamples = 1000;
+    const float tolerance = 0.001f;
+
+    struct Samples {
+        std::vector<glm::mat4> mvp;
+        std::vector<glm::vec3> boundsMin;
+        std::vector<glm::vec3> boundsMax;
+    };
+
+    void fill(TransformStore &store, size_t count) {
+        std::mt19937 random(1234);
+        std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        std::uniform_real_distribution<float> size(0.1f, 4.0f);
+
+        store.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            glm::quat rotation = glm::normalize(glm::quat(unit(random), unit(random), unit(random), unit(random)));
+            glm::vec3 extent(size(random), size(random), size(random));
+            store.set(i, glm::vec3(position(random), position(random), position(random)), rotation,
+                glm::vec3(size(random), size(random), size(random)), glm::vec3(unit(random), unit(random), unit(random)), extent);
+        }
+    }
+
+    Samples takeSamples(const TransformStore &store) {
+        Samples samples;
+        size_t stride = std::max<size_t>(1, store.size() / amountOfSamples);
+        for (size_t i = 0; i < store.size(); i += stride) {
+            samples.mvp.push_back(store.getMvp(i));
+            samples.boundsMin.push_back(store.getBoundsMin(i));
+            samples.boundsMax.push_back(store.getBoundsMax(i));
+        }
+        return samples;
+    }
+
+    // Relative to the magnitude, positions go up to 100 and the projection scales them further
+    bool near(float a, float b) {
+        return std::abs(a - b) <= tolerance * std::max(1.0f, std::max(std::abs(a), std::abs(b)));
+    }
+
+    size_t countMismatches(const Samples &expected, const Samples &actual) {
+        size_t errors = 0;
+        for (size_t i = 0; i < expected.mvp.size(); ++i) {
+            bool equal = true;
+            for (int column = 0; column < 4; ++column) {
+                for (int row = 0; row < 4; ++row) {
+                    equal = equal && near(expected.mvp[i][column][row], actual.mvp[i][column][row]);
+                }
+            }
+            for (int axis = 0; axis < 3; ++axis) {
+                equal = equal && near(expected.boundsMin[i][axis], actual.boundsMin[i][axis]);
+                equal = equal && near(expected.boundsMax[i][axis], actual.boundsMax[i][axis]);
+            }
+            errors += equal ? 0 : 1;
+        }
+        return errors;
+    }
+
+    // Average milliseconds of one update() after a warm up run
+    double measure(TransformStore &store, const glm::mat4 &viewProjection, TransformPath path, JobScheduler *scheduler) {
+        size_t iterations = std::max<size_t>(1, transformsPerMeasurement / store.size());
+        store.update(viewProjection, path, scheduler);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < iterations; ++i) {
+            store.update(viewProjection, path, scheduler);
+        }
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / iterations;
+    }
+
+    void printResult(const char *name, double milliseconds, size_t count, double baseline) {
+        std::cout << "- " << name << ": " << milliseconds << " ms | " << count / milliseconds / 1000.0 << " M transforms/s | " <<
+            baseline / milliseconds << "x" << std::endl;
+    }
+}
+
+bool runTransformBench() {
+    uint32_t threads = std::max(1u, std::thread::hardware_concurrency());
+    JobScheduler scheduler;
+    scheduler.start(threads - 1);
+
+    std::cout << "Transform bench: TRS + MVP + AABB | SIMD: " << TransformStore::simdInstructionSet() << " | " <<
+        scheduler.getWorkerCount() << " threads" << std::endl;
+
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 50.0f, -250.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 viewProjection = projection * view;
+
+    size_t errors = 0;
+    const size_t counts[] = { 10000, 100000, 1000000, 10000000 };
+    for (size_t count : counts) {
+        TransformStore store;
+        fill(store, count);
+        std::cout << count << " transforms:" << std::endl;
+
+        double scalar = measure(store, viewProjection, TransformPath::Scalar, nullptr);
+        Samples expected = takeSamples(store);
+        printResult("Scalar", scalar, count, scalar);
+
+        double simd = measure(store, viewProjection, TransformPath::Simd, nullptr);
+        errors += countMismatches(expected, takeSamples(store));
+        printResult("SIMD", simd, count, scalar);
+
+        double parallel = measure(store, viewProjection, TransformPath::Simd, &scheduler);
+        errors += countMismatches(expected, takeSamples(store));
+        printResult("SIMD MT", parallel, count, scalar);
+    }
+
+    scheduler.stop();
+
+    std::cout << (errors == 0 ? "Transform bench passed" : "Transform bench FAILED, SIMD results differ from scalar") << std::endl;
+    return errors == 0;
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+// CPU only throughput comparison of the TransformStore kernels: scalar, SIMD and SIMD on all
+// cores for 10k to 10M transforms. Returns false if the SIMD results differ from the scalar ones.
+bool runTransformBench();
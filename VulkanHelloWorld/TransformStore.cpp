@@ -0,0 +1,303 @@
+#include "TransformStore.h"
+
+#include <algorithm>
+#include <glm/simd/matrix.h>
+#include "JobScheduler.h"
+
+namespace {
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+    // Per lane helpers of the TRS kernel, 4 objects per SSE register
+    struct SseLanes {
+        typedef __m128 Type;
+        static const size_t width = 4;
+
+        static Type load(const float *data) { return _mm_loadu_ps(data); }
+        static Type set(float value) { return _mm_set1_ps(value); }
+        static Type add(Type a, Type b) { return _mm_add_ps(a, b); }
+        static Type sub(Type a, Type b) { return _mm_sub_ps(a, b); }
+        static Type mul(Type a, Type b) { return _mm_mul_ps(a, b); }
+
+        // x, y, z and w hold one matrix column of 4 objects, written to world[0 .. 3]
+        static void storeColumn(Type x, Type y, Type z, Type w, glm::mat4 *world, int column) {
+            _MM_TRANSPOSE4_PS(x, y, z, w);
+            _mm_storeu_ps(&world[0][column][0], x);
+            _mm_storeu_ps(&world[1][column][0], y);
+            _mm_storeu_ps(&world[2][column][0], z);
+            _mm_storeu_ps(&world[3][column][0], w);
+        }
+    };
+#endif
+
+    // Pointers to the input arrays of the TRS kernel
+    struct TrsInputs {
+        const float *translation[3];
+        const float *rotation[4];
+        const float *scale[3];
+    };
+
+    // Same math as composeScalar() on Lanes::width objects at once, returns the first object it did not compose
+    template <typename Lanes>
+    size_t composeLanes(const TrsInputs &inputs, size_t begin, size_t end, glm::mat4 *world) {
+        typedef typename Lanes::Type V;
+        const V zero = Lanes::set(0.0f);
+        const V one = Lanes::set(1.0f);
+        const V two = Lanes::set(2.0f);
+
+        size_t i = begin;
+        for (; i + Lanes::width <= end; i += Lanes::width) {
+            V x = Lanes::load(inputs.rotation[0] + i);
+            V y = Lanes::load(inputs.rotation[1] + i);
+            V z = Lanes::load(inputs.rotation[2] + i);
+            V w = Lanes::load(inputs.rotation[3] + i);
+
+            V x2 = Lanes::mul(x, two);
+            V y2 = Lanes::mul(y, two);
+            V z2 = Lanes::mul(z, two);
+            V xx = Lanes::mul(x, x2);
+            V yy = Lanes::mul(y, y2);
+            V zz = Lanes::mul(z, z2);
+            V xy = Lanes::mul(x, y2);
+            V xz = Lanes::mul(x, z2);
+            V yz = Lanes::mul(y, z2);
+            V wx = Lanes::mul(w, x2);
+            V wy = Lanes::mul(w, y2);
+            V wz = Lanes::mul(w, z2);
+
+            V sx = Lanes::load(inputs.scale[0] + i);
+            V sy = Lanes::load(inputs.scale[1] + i);
+            V sz = Lanes::load(inputs.scale[2] + i);
+
+            glm::mat4 *out = world + (i - begin);
+            Lanes::storeColumn(
+                Lanes::mul(Lanes::sub(one, Lanes::add(yy, zz)), sx),
+                Lanes::mul(Lanes::add(xy, wz), sx),
+                Lanes::mul(Lanes::sub(xz, wy), sx),
+                zero, out, 0);
+            Lanes::storeColumn(
+                Lanes::mul(Lanes::sub(xy, wz), sy),
+                Lanes::mul(Lanes::sub(one, Lanes::add(xx, zz)), sy),
+                Lanes::mul(Lanes::add(yz, wx), sy),
+                zero, out, 1);
+            Lanes::storeColumn(
+                Lanes::mul(Lanes::add(xz, wy), sz),
+                Lanes::mul(Lanes::sub(yz, wx), sz),
+                Lanes::mul(Lanes::sub(one, Lanes::add(xx, yy)), sz),
+                zero, out, 2);
+            Lanes::storeColumn(
+                Lanes::load(inputs.translation[0] + i),
+                Lanes::load(inputs.translation[1] + i),
+                Lanes::load(inputs.translation[2] + i),
+                one, out, 3);
+        }
+        return i;
+    }
+}
+
+void TransformStore::resize(size_t count) {
+    this->count = count;
+
+    std::vector<float> *arrays[] = {
+        &translationX, &translationY, &translationZ,
+        &rotationX, &rotationY, &rotationZ, &rotationW,
+        &scaleX, &scaleY, &scaleZ,
+        &centerX, &centerY, &centerZ,
+        &extentX, &extentY, &extentZ,
+        &minX, &minY, &minZ,
+        &maxX, &maxY, &maxZ
+    };
+    for (std::vector<float> *array : arrays) {
+        array->resize(count);
+    }
+    mvp.resize(count);
+}
+
+void TransformStore::set(size_t index, const glm::vec3 &translation, const glm::quat &rotation, const glm::vec3 &scale,
+    const glm::vec3 &boundsCenter, const glm::vec3 &boundsExtent) {
+    translationX[index] = translation.x;
+    translationY[index] = translation.y;
+    translationZ[index] = translation.z;
+    rotationX[index] = rotation.x;
+    rotationY[index] = rotation.y;
+    rotationZ[index] = rotation.z;
+    rotationW[index] = rotation.w;
+    scaleX[index] = scale.x;
+    scaleY[index] = scale.y;
+    scaleZ[index] = scale.z;
+    centerX[index] = boundsCenter.x;
+    centerY[index] = boundsCenter.y;
+    centerZ[index] = boundsCenter.z;
+    extentX[index] = boundsExtent.x;
+    extentY[index] = boundsExtent.y;
+    extentZ[index] = boundsExtent.z;
+}
+
+void TransformStore::update(const glm::mat4 &viewProjection, TransformPath path, JobScheduler *scheduler) {
+    uint32_t workers = scheduler != nullptr ? scheduler->getWorkerCount() : 1;
+    if (scratch.size() < workers) {
+        scratch.resize(workers, std::vector<glm::mat4>(chunkSize));
+    }
+
+    uint32_t amountOfChunks = (uint32_t)((count + chunkSize - 1) / chunkSize);
+    auto updateChunk = [&](uint32_t worker, uint32_t chunk) {
+        size_t begin = (size_t)chunk * chunkSize;
+        updateRange(viewProjection, path, begin, std::min(begin + chunkSize, count), scratch[worker].data());
+    };
+
+    if (scheduler != nullptr) {
+        scheduler->run(amountOfChunks, updateChunk);
+    } else {
+        for (uint32_t chunk = 0; chunk < amountOfChunks; ++chunk) {
+            updateChunk(0, chunk);
+        }
+    }
+}
+
+void TransformStore::updateRange(const glm::mat4 &viewProjection, TransformPath path, size_t begin, size_t end, glm::mat4 *world) {
+    if (path == TransformPath::Simd && simdAvailable()) {
+        composeSimd(begin, end, world);
+        multiplySimd(viewProjection, world, begin, end);
+        boundsSimd(world, begin, end);
+    } else {
+        composeScalar(begin, end, world);
+        multiplyScalar(viewProjection, world, begin, end);
+        boundsScalar(world, begin, end);
+    }
+}
+
+bool TransformStore::simdAvailable() {
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+    return true;
+#else
+    return false;
+#endif
+}
+
+const char *TransformStore::simdInstructionSet() {
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+    return "SSE2";
+#else
+    return "none";
+#endif
+}
+
+// Rotation matrix of the unit quaternion with the scale folded into the columns, then the translation
+void TransformStore::composeScalar(size_t begin, size_t end, glm::mat4 *world) const {
+    for (size_t i = begin; i < end; ++i) {
+        float x = rotationX[i];
+        float y = rotationY[i];
+        float z = rotationZ[i];
+        float w = rotationW[i];
+        float xx = 2.0f * x * x, yy = 2.0f * y * y, zz = 2.0f * z * z;
+        float xy = 2.0f * x * y, xz = 2.0f * x * z, yz = 2.0f * y * z;
+        float wx = 2.0f * w * x, wy = 2.0f * w * y, wz = 2.0f * w * z;
+
+        glm::mat4 &m = world[i - begin];
+        m[0] = glm::vec4((1.0f - yy - zz) * scaleX[i], (xy + wz) * scaleX[i], (xz - wy) * scaleX[i], 0.0f);
+        m[1] = glm::vec4((xy - wz) * scaleY[i], (1.0f - xx - zz) * scaleY[i], (yz + wx) * scaleY[i], 0.0f);
+        m[2] = glm::vec4((xz + wy) * scaleZ[i], (yz - wx) * scaleZ[i], (1.0f - xx - yy) * scaleZ[i], 0.0f);
+        m[3] = glm::vec4(translationX[i], translationY[i], translationZ[i], 1.0f);
+    }
+}
+
+void TransformStore::composeSimd(size_t begin, size_t end, glm::mat4 *world) const {
+    size_t next = begin;
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+    TrsInputs inputs = {
+        { translationX.data(), translationY.data(), translationZ.data() },
+        { rotationX.data(), rotationY.data(), rotationZ.data(), rotationW.data() },
+        { scaleX.data(), scaleY.data(), scaleZ.data() }
+    };
+    next = composeLanes<SseLanes>(inputs, next, end, world + (next - begin));
+#endif
+    // Objects left over by the last full register
+    composeScalar(next, end, world + (next - begin));
+}
+
+void TransformStore::multiplyScalar(const glm::mat4 &viewProjection, const glm::mat4 *world, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+        mvp[i] = viewProjection * world[i - begin];
+    }
+}
+
+void TransformStore::multiplySimd(const glm::mat4 &viewProjection, const glm::mat4 *world, size_t begin, size_t end) {
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+    glm_vec4 left[4];
+    for (int column = 0; column < 4; ++column) {
+        left[column] = _mm_loadu_ps(&viewProjection[column][0]);
+    }
+
+    for (size_t i = begin; i < end; ++i) {
+        const glm::mat4 &m = world[i - begin];
+        glm_vec4 right[4] = { _mm_loadu_ps(&m[0][0]), _mm_loadu_ps(&m[1][0]), _mm_loadu_ps(&m[2][0]), _mm_loadu_ps(&m[3][0]) };
+        glm_vec4 product[4];
+        glm_mat4_mul(left, right, product);
+        for (int column = 0; column < 4; ++column) {
+            _mm_storeu_ps(&mvp[i][column][0], product[column]);
+        }
+    }
+#else
+    multiplyScalar(viewProjection, world, begin, end);
+#endif
+}
+
+// World space AABB of a local center/extent box: the center is transformed, the extent is
+// projected on the axes with the absolute values of the upper 3x3
+void TransformStore::boundsScalar(const glm::mat4 *world, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+        const glm::mat4 &m = world[i - begin];
+        glm::vec3 center = glm::vec3(m * glm::vec4(centerX[i], centerY[i], centerZ[i], 1.0f));
+        glm::vec3 extent = glm::abs(glm::vec3(m[0])) * extentX[i] + glm::abs(glm::vec3(m[1])) * extentY[i] + glm::abs(glm::vec3(m[2])) * extentZ[i];
+
+        minX[i] = center.x - extent.x;
+        minY[i] = center.y - extent.y;
+        minZ[i] = center.z - extent.z;
+        maxX[i] = center.x + extent.x;
+        maxY[i] = center.y + extent.y;
+        maxZ[i] = center.z + extent.z;
+    }
+}
+
+void TransformStore::boundsSimd(const glm::mat4 *world, size_t begin, size_t end) {
+    size_t i = begin;
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+
+    // Transposing the matrices of 4 objects turns every matrix element into one register
+    for (; i + 4 <= end; i += 4) {
+        const glm::mat4 *m = world + (i - begin);
+        __m128 elements[4][4]; // [column][row], one object per lane
+        for (int column = 0; column < 4; ++column) {
+            __m128 a = _mm_loadu_ps(&m[0][column][0]);
+            __m128 b = _mm_loadu_ps(&m[1][column][0]);
+            __m128 c = _mm_loadu_ps(&m[2][column][0]);
+            __m128 d = _mm_loadu_ps(&m[3][column][0]);
+            _MM_TRANSPOSE4_PS(a, b, c, d);
+            elements[column][0] = a;
+            elements[column][1] = b;
+            elements[column][2] = c;
+            elements[column][3] = d;
+        }
+
+        __m128 cx = _mm_loadu_ps(&centerX[i]);
+        __m128 cy = _mm_loadu_ps(&centerY[i]);
+        __m128 cz = _mm_loadu_ps(&centerZ[i]);
+        __m128 ex = _mm_loadu_ps(&extentX[i]);
+        __m128 ey = _mm_loadu_ps(&extentY[i]);
+        __m128 ez = _mm_loadu_ps(&extentZ[i]);
+
+        float *mins[] = { &minX[i], &minY[i], &minZ[i] };
+        float *maxs[] = { &maxX[i], &maxY[i], &maxZ[i] };
+        for (int row = 0; row < 3; ++row) {
+            __m128 center = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(elements[0][row], cx), _mm_mul_ps(elements[1][row], cy)),
+                _mm_add_ps(_mm_mul_ps(elements[2][row], cz), elements[3][row]));
+            __m128 extent = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, elements[0][row]), ex), _mm_mul_ps(_mm_andnot_ps(signMask, elements[1][row]), ey)),
+                _mm_mul_ps(_mm_andnot_ps(signMask, elements[2][row]), ez));
+            _mm_storeu_ps(mins[row], _mm_sub_ps(center, extent));
+            _mm_storeu_ps(maxs[row], _mm_add_ps(center, extent));
+        }
+    }
+#endif
+    boundsScalar(world + (i - begin), i, end);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+class JobScheduler;
+
+// Scalar runs the plain C++ kernels, Simd the SSE kernels built on glm/simd.
+// Simd falls back to Scalar on targets where glm has no SSE2 path.
+enum class TransformPath {
+    Scalar,
+    Simd
+};
+
+// Structure of arrays transform store for many animated objects. Every component of the
+// translation, rotation quaternion, scale and local bounds has its own array, so the TRS
+// kernel loads 4 objects per register. update() composes the world matrices, multiplies
+// them with the view projection and transforms the local bounds into world space AABBs.
+//
+// World matrices are only an intermediate: they go through a per chunk scratch buffer which
+// stays in the cache, only the MVP matrices and world bounds are written out.
+class TransformStore {
+public:
+    // Objects are updated in chunks of this size, also the unit of work for the job scheduler
+    static const size_t chunkSize = 2048;
+
+    void resize(size_t count);
+    size_t size() const { return count; }
+
+    void set(size_t index, const glm::vec3 &translation, const glm::quat &rotation, const glm::vec3 &scale,
+        const glm::vec3 &boundsCenter, const glm::vec3 &boundsExtent);
+
+    // Single threaded if scheduler is nullptr
+    void update(const glm::mat4 &viewProjection, TransformPath path, JobScheduler *scheduler);
+    // Updates the objects [begin, end), world has to hold end - begin matrices
+    void updateRange(const glm::mat4 &viewProjection, TransformPath path, size_t begin, size_t end, glm::mat4 *world);
+
+    const glm::mat4 &getMvp(size_t index) const { return mvp[index]; }
+    glm::vec3 getBoundsMin(size_t index) const { return glm::vec3(minX[index], minY[index], minZ[index]); }
+    glm::vec3 getBoundsMax(size_t index) const { return glm::vec3(maxX[index], maxY[index], maxZ[index]); }
+
+    // True if the glm SIMD kernels are compiled in
+    static bool simdAvailable();
+    static const char *simdInstructionSet();
+
+private:
+    void composeScalar(size_t begin, size_t end, glm::mat4 *world) const;
+    void composeSimd(size_t begin, size_t end, glm::mat4 *world) const;
+    void multiplyScalar(const glm::mat4 &viewProjection, const glm::mat4 *world, size_t begin, size_t end);
+    void multiplySimd(const glm::mat4 &viewProjection, const glm::mat4 *world, size_t begin, size_t end);
+    void boundsScalar(const glm::mat4 *world, size_t begin, size_t end);
+    void boundsSimd(const glm::mat4 *world, size_t begin, size_t end);
+
+    size_t count = 0;
+
+    // Inputs
+    std::vector<float> translationX, translationY, translationZ;
+    std::vector<float> rotationX, rotationY, rotationZ, rotationW;
+    std::vector<float> scaleX, scaleY, scaleZ;
+    std::vector<float> centerX, centerY, centerZ;
+    std::vector<float> extentX, extentY, extentZ;
+
+    // Outputs
+    std::vector<glm::mat4> mvp;
+    std::vector<float> minX, minY, minZ;
+    std::vector<float> maxX, maxY, maxZ;
+
+    // One scratch chunk of world matrices per worker for update()
+    std::vector<std::vector<glm::mat4>> scratch;
+};
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdlib>
+#include <vulkan/vulkan.h>
+
+// Headless runs happen on build machines without MSVC, so fall back to abort there
+#ifdef _MSC_VER
+#define DEBUG_BREAK() __debugbreak()
+#else
+#define DEBUG_BREAK() std::abort()
+#endif
+
+#define ASSERT_VULKAN(val) if(val != VK_SUCCESS) { DEBUG_BREAK();}
@@ -0,0 +1,22 @@
+#version 450
+#extension GL_ARB_separate_shader_objects: enable
+
+// Set per pipeline variant through VkSpecializationInfo (PipelineVariants.h), the driver folds them like literals
+layout(constant_id = 0) const uint shadingIterations = 0; // extra ALU work per fragment
+layout(constant_id = 1) const bool grayscale = false;
+
+layout(location = 0) in vec4 fragColor;
+
+layout(location = 0) out vec4 outColor;
+
+void main()
+{
+	vec3 color = fragColor.rgb;
+	for (uint i = 0; i < shadingIterations; ++i) {
+		color = sqrt(color * color + vec3(0.000001));
+	}
+	if (grayscale) {
+		color = vec3(dot(color, vec3(0.299, 0.587, 0.114)));
+	}
+	outColor = vec4(color, fragColor.a);
+}
@@ -0,0 +1,34 @@
+#version 450
+#extension GL_ARB_separate_shader_objects: enable
+#extension GL_EXT_nonuniform_qualifier: enable
+
+// instanced.frag with a material tint read from the bindless table (BindlessTable.h)
+layout(constant_id = 0) const uint shadingIterations = 0; // extra ALU work per fragment
+layout(constant_id = 1) const bool grayscale = false;
+
+// DrawConstants in BindlessTable.h, pushed before every draw
+layout(push_constant) uniform DrawConstants {
+	uint material;
+} draw;
+
+// Every material is its own buffer in binding 0 of the table
+layout(set = 0, binding = 0) readonly buffer Material {
+	vec4 tint;
+} materials[];
+
+layout(location = 0) in vec4 fragColor;
+
+layout(location = 0) out vec4 outColor;
+
+void main()
+{
+	vec4 tint = materials[draw.material].tint; // dynamically uniform, no nonuniformEXT needed
+	vec3 color = fragColor.rgb * tint.rgb;
+	for (uint i = 0; i < shadingIterations; ++i) {
+		color = sqrt(color * color + vec3(0.000001));
+	}
+	if (grayscale) {
+		color = vec3(dot(color, vec3(0.299, 0.587, 0.114)));
+	}
+	outColor = vec4(color, fragColor.a * tint.a);
+}
@@ -0,0 +1,18 @@
+#version 450
+#extension GL_ARB_separate_shader_objects: enable
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in mat4 inModel;
+layout(location = 5) in vec4 inColor;
+
+layout(location = 0) out vec4 fragColor;
+
+out gl_PerVertex {
+	invariant vec4 gl_Position;
+};
+
+void main()
+{
+	gl_Position = inModel * vec4(inPosition, 0.0, 1.0);
+	fragColor = inColor;
+}
@@ -0,0 +1,21 @@
+#version 450
+#extension GL_ARB_separate_shader_objects: enable
+
+layout(location = 0) in vec2 inPosition;
+// xy: offset, zw: scale * (cos, sin) of the rotation
+layout(location = 1) in vec4 inTransform;
+layout(location = 2) in vec4 inColor;
+
+layout(location = 0) out vec4 fragColor;
+
+out gl_PerVertex {
+	invariant vec4 gl_Position;
+};
+
+void main()
+{
+	vec2 rotated = vec2(inPosition.x * inTransform.z - inPosition.y * inTransform.w,
+	                    inPosition.x * inTransform.w + inPosition.y * inTransform.z);
+	gl_Position = vec4(rotated + inTransform.xy, 0.0, 1.0);
+	fragColor = inColor;
+}
@@ -0,0 +1,28 @@
+#version 450
+#extension GL_ARB_separate_shader_objects: enable
+
+// Maps the vertex position to clip space, set per mesh through VkSpecializationInfo. Quantized meshes deliver
+// snorm positions relative to their bounding box, float meshes object space positions, see MeshAsset.h.
+layout(constant_id = 0) const float scaleX = 1.0;
+layout(constant_id = 1) const float scaleY = 1.0;
+layout(constant_id = 2) const float scaleZ = 1.0;
+layout(constant_id = 3) const float offsetX = 0.0;
+layout(constant_id = 4) const float offsetY = 0.0;
+layout(constant_id = 5) const float offsetZ = 0.0;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+
+layout(location = 0) out vec4 fragColor;
+
+out gl_PerVertex {
+	invariant vec4 gl_Position;
+};
+
+void main()
+{
+	vec3 position = inPosition * vec3(scaleX, scaleY, scaleZ) + vec3(offsetX, offsetY, offsetZ);
+	gl_Position = vec4(position, 1.0);
+	// snorm8 normals are only close to unit length
+	fragColor = vec4(normalize(inNormal) * 0.5 + 0.5, 1.0);
+}
@@ -0,0 +1,20 @@
+#version 450
+#extension GL_ARB_separate_shader_objects: enable
+
+// One point per particle, the position comes straight from the state buffer the simulation wrote
+layout(location = 0) in vec2 inPosition;
+
+layout(location = 0) out vec4 fragColor;
+
+out gl_PerVertex {
+	invariant vec4 gl_Position;
+	float gl_PointSize;
+};
+
+void main()
+{
+	gl_Position = vec4(inPosition, 0.0, 1.0);
+	gl_PointSize = 1.0;
+	// Translucent, so dense regions of the swarm end up brighter
+	fragColor = vec4(inPosition * 0.5 + 0.5, 1.0, 0.5);
+}
@@ -1,3 +1,25 @@
 D:\Vulkan\1.2.154.1\Bin32\glslangValidator.exe -V shader.vert
 D:\Vulkan\1.2.154.1\Bin32\glslangValidator.exe -V shader.frag
+D:\Vulkan\1.2.154.1\Bin32\glslangValidator.exe -V instanced_packed.vert -o instanced_packed_vert.spv
+D:\Vulkan\1.2.154.1\Bin32\glslangValidator.exe -V instanced_full.vert -o instanced_full_vert.spv
+D:\Vulkan\1.2.154.1\Bin32\glslangValidator.exe -V instanced.frag -o instanced_frag.spv
+D:\Vulkan\1.2.154.1\Bin32\glslangValidator.exe -V instanced_bindless.frag -o instanced_bindless_frag.spv
+D:\Vulkan\1.2.154.1\Bin32\glslangValidator.exe -V cull.comp -o cull_comp.spv
+D:\Vulkan\1.2.154.1\Bin32\glslangValidator.exe -V mesh.vert -o mesh_vert.spv
+D:\Vulkan\1.2.154.1\Bin32\glslangValidator.exe -V textured.vert -o textured_vert.spv
+D:\Vulkan\1.2.154.1\Bin32\glslangValidator.exe -V textured.frag -o textured_frag.spv
+D:\Vulkan\1.2.154.1\Bin32\glslangValidator.exe -V particles.vert -o particles_vert.spv
+D:\Vulkan\1.2.154.1\Bin32\glslangValidator.exe -V particles.comp -o particles_comp.spv
+D:\Vulkan\1.2.154.1\Bin32\glslangValidator.exe -V -x shader.vert -o embedded\vert.inc
+D:\Vulkan\1.2.154.1\Bin32\glslangValidator.exe -V -x shader.frag -o embedded\frag.inc
+D:\Vulkan\1.2.154.1\Bin32\glslangValidator.exe -V -x instanced_packed.vert -o embedded\instanced_packed_vert.inc
+D:\Vulkan\1.2.154.1\Bin32\glslangValidator.exe -V -x instanced_full.vert -o embedded\instanced_full_vert.inc
+D:\Vulkan\1.2.154.1\Bin32\glslangValidator.exe -V -x instanced.frag -o embedded\instanced_frag.inc
+D:\Vulkan\1.2.154.1\Bin32\glslangValidator.exe -V -x instanced_bindless.frag -o embedded\instanced_bindless_frag.inc
+D:\Vulkan\1.2.154.1\Bin32\glslangValidator.exe -V -x cull.comp -o embedded\cull_comp.inc
+D:\Vulkan\1.2.154.1\Bin32\glslangValidator.exe -V -x mesh.vert -o embedded\mesh_vert.inc
+D:\Vulkan\1.2.154.1\Bin32\glslangValidator.exe -V -x textured.vert -o embedded\textured_vert.inc
+D:\Vulkan\1.2.154.1\Bin32\glslangValidator.exe -V -x textured.frag -o embedded\textured_frag.inc
+D:\Vulkan\1.2.154.1\Bin32\glslangValidator.exe -V -x particles.vert -o embedded\particles_vert.inc
+D:\Vulkan\1.2.154.1\Bin32\glslangValidator.exe -V -x particles.comp -o embedded\particles_comp.inc
 pause
\ No newline at end of file
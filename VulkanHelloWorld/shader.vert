@@ -2,7 +2,7 @@
 #extension GL_ARB_separate_shader_objects: enable
 
 out gl_PerVertex {
-	vec4 gl_Position;
+	invariant vec4 gl_Position;
 };
 
 vec2 positions[3] = vec2[](
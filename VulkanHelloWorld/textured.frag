@@ -0,0 +1,23 @@
+#version 450
+#extension GL_ARB_separate_shader_objects: enable
+#extension GL_EXT_nonuniform_qualifier: enable
+
+// QuadConstants in BindlessTable.h, pushed before every quad of --textures
+layout(push_constant) uniform QuadConstants {
+	vec2 offset;
+	vec2 scale;
+	uint texture;
+} quad;
+
+// Every streamed texture is its own image in binding 1 of the table. The image only holds the resident mip
+// levels, the implicit LOD picks the right one of them because the coordinates are normalized.
+layout(set = 0, binding = 1) uniform sampler2D textures[];
+
+layout(location = 0) in vec2 fragTexCoord;
+
+layout(location = 0) out vec4 outColor;
+
+void main()
+{
+	outColor = texture(textures[quad.texture], fragTexCoord); // dynamically uniform, no nonuniformEXT needed
+}
@@ -0,0 +1,23 @@
+#version 450
+#extension GL_ARB_separate_shader_objects: enable
+
+// QuadConstants in BindlessTable.h, pushed before every quad of --textures
+layout(push_constant) uniform QuadConstants {
+	vec2 offset; // top left corner in clip space
+	vec2 scale;
+	uint texture; // image slot in the bindless table, read by textured.frag
+} quad;
+
+layout(location = 0) out vec2 fragTexCoord;
+
+out gl_PerVertex {
+	invariant vec4 gl_Position;
+};
+
+void main()
+{
+	// Two clockwise triangles, the corners of vertex i are the bits i of 0x16 (x) and 0x34 (y)
+	vec2 corner = vec2((0x16 >> gl_VertexIndex) & 1, (0x34 >> gl_VertexIndex) & 1);
+	gl_Position = vec4(quad.offset + quad.scale * corner, 0.0, 1.0);
+	fragTexCoord = corner;
+}